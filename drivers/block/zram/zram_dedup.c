@@ -0,0 +1,251 @@
+/*
+ * Compressed RAM block device - content based deduplication
+ *
+ * Every compressed object stored while dedup is enabled gets an entry,
+ * keyed by the xxh32 checksum of its uncompressed content, in one of a
+ * set of rbtree buckets. A write whose checksum matches an entry is
+ * verified against the stored content and, if identical, shares the
+ * entry's zsmalloc handle instead of allocating a new one.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#define KMSG_COMPONENT "zram"
+#define pr_fmt(fmt) KMSG_COMPONENT ": " fmt
+
+#include <linux/kernel.h>
+#include <linux/rbtree.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/vmalloc.h>
+#include <linux/xxhash.h>
+
+#include "zcomp.h"
+#include "zram_drv.h"
+#include "zram_dedup.h"
+
+/* one bucket per this many pages of disksize, within the bounds below */
+#define ZRAM_HASH_SHIFT		10
+#define ZRAM_HASH_SIZE_MIN	(1 << 10)
+#define ZRAM_HASH_SIZE_MAX	(1 << 16)
+
+struct zram_hash {
+	spinlock_t lock;
+	struct rb_root rb_root;
+};
+
+struct zram_entry {
+	struct rb_node rb_node;
+	unsigned long handle;
+	unsigned int len;
+	u32 checksum;
+	/* protected by the bucket lock */
+	int refcount;
+};
+
+static inline struct zram_hash *zram_dedup_hash(struct zram *zram,
+						u32 checksum)
+{
+	return &zram->hash[checksum % zram->hash_size];
+}
+
+u32 zram_dedup_checksum(void *mem)
+{
+	return xxh32(mem, PAGE_SIZE, 0);
+}
+
+/* Leftmost entry with @checksum, or NULL. Caller holds the bucket lock. */
+static struct zram_entry *zram_dedup_lookup(struct zram_hash *hash,
+					    u32 checksum)
+{
+	struct rb_node *node = hash->rb_root.rb_node;
+	struct zram_entry *found = NULL;
+
+	while (node) {
+		struct zram_entry *entry = rb_entry(node,
+					struct zram_entry, rb_node);
+
+		if (checksum < entry->checksum) {
+			node = node->rb_left;
+		} else if (checksum > entry->checksum) {
+			node = node->rb_right;
+		} else {
+			found = entry;
+			node = node->rb_left;
+		}
+	}
+
+	return found;
+}
+
+/*
+ * Drop a reference to @entry. Returns true if it was the last one; the
+ * entry is then unlinked and freed and the caller owns its handle.
+ */
+static bool zram_dedup_release(struct zram_hash *hash,
+			       struct zram_entry *entry)
+{
+	bool last;
+
+	spin_lock(&hash->lock);
+	last = --entry->refcount == 0;
+	if (last)
+		rb_erase(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	if (last)
+		kfree(entry);
+
+	return last;
+}
+
+/*
+ * Look for a stored object with the same content as @mem. On a match a
+ * reference is taken for the caller, the object size is returned in
+ * @len and its handle is returned. @zstrm is used as scratch space for
+ * the comparison and must be held by the caller.
+ */
+unsigned long zram_dedup_find(struct zram *zram, struct zcomp_strm *zstrm,
+			void *mem, u32 checksum, unsigned int *len)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry;
+	unsigned long handle;
+	unsigned int size;
+	void *src;
+	bool match;
+
+	spin_lock(&hash->lock);
+	entry = zram_dedup_lookup(hash, checksum);
+	if (entry)
+		entry->refcount++;
+	spin_unlock(&hash->lock);
+
+	if (!entry)
+		return 0;
+
+	handle = entry->handle;
+	size = entry->len;
+
+	src = zs_map_object(zram->mem_pool, handle, ZS_MM_RO);
+	if (size == PAGE_SIZE)
+		match = !memcmp(src, mem, PAGE_SIZE);
+	else
+		match = !zcomp_decompress(zstrm, src, size, zstrm->buffer) &&
+			!memcmp(zstrm->buffer, mem, PAGE_SIZE);
+	zs_unmap_object(zram->mem_pool, handle);
+
+	if (match) {
+		*len = size;
+		return handle;
+	}
+
+	/* checksum collision; the owner may have gone away meanwhile */
+	if (zram_dedup_release(hash, entry)) {
+		zs_free(zram->mem_pool, handle);
+		atomic64_sub(size, &zram->stats.compr_data_size);
+	}
+
+	return 0;
+}
+
+/*
+ * Make a freshly stored object findable. Returns false if no entry could
+ * be allocated, in which case the slot is stored without dedup.
+ */
+bool zram_dedup_insert(struct zram *zram, unsigned long handle,
+			unsigned int len, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry, *cur;
+	struct rb_node **link, *parent = NULL;
+
+	entry = kmalloc(sizeof(*entry), GFP_NOIO | __GFP_NOWARN);
+	if (!entry)
+		return false;
+
+	entry->handle = handle;
+	entry->len = len;
+	entry->checksum = checksum;
+	entry->refcount = 1;
+
+	spin_lock(&hash->lock);
+	link = &hash->rb_root.rb_node;
+	while (*link) {
+		parent = *link;
+		cur = rb_entry(parent, struct zram_entry, rb_node);
+		if (checksum < cur->checksum)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+	rb_link_node(&entry->rb_node, parent, link);
+	rb_insert_color(&entry->rb_node, &hash->rb_root);
+	spin_unlock(&hash->lock);
+
+	return true;
+}
+
+/*
+ * Drop the reference a slot holds on @handle. Returns true if the caller
+ * must free the handle.
+ */
+bool zram_dedup_put(struct zram *zram, unsigned long handle, u32 checksum)
+{
+	struct zram_hash *hash = zram_dedup_hash(zram, checksum);
+	struct zram_entry *entry;
+	struct rb_node *node;
+
+	spin_lock(&hash->lock);
+	entry = zram_dedup_lookup(hash, checksum);
+	for (node = entry ? &entry->rb_node : NULL; node; node = rb_next(node)) {
+		entry = rb_entry(node, struct zram_entry, rb_node);
+		if (entry->checksum != checksum)
+			break;
+		if (entry->handle == handle)
+			goto found;
+	}
+	spin_unlock(&hash->lock);
+
+	WARN_ONCE(1, "zram: no dedup entry for handle %lx\n", handle);
+	return true;
+
+found:
+	spin_unlock(&hash->lock);
+	return zram_dedup_release(hash, entry);
+}
+
+int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	size_t i;
+
+	if (!zram_dedup_enabled(zram))
+		return 0;
+
+	zram->hash_size = clamp_t(size_t, num_pages >> ZRAM_HASH_SHIFT,
+				  ZRAM_HASH_SIZE_MIN, ZRAM_HASH_SIZE_MAX);
+	zram->hash = vzalloc(zram->hash_size * sizeof(struct zram_hash));
+	if (!zram->hash) {
+		pr_err("Error allocating zram entry hash\n");
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < zram->hash_size; i++) {
+		spin_lock_init(&zram->hash[i].lock);
+		zram->hash[i].rb_root = RB_ROOT;
+	}
+
+	return 0;
+}
+
+/* Called once every slot has been freed, so all buckets are empty. */
+void zram_dedup_fini(struct zram *zram)
+{
+	vfree(zram->hash);
+	zram->hash = NULL;
+	zram->hash_size = 0;
+}
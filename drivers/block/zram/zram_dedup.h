@@ -0,0 +1,53 @@
+/*
+ * Compressed RAM block device - content based deduplication
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version
+ * 2 of the License, or (at your option) any later version.
+ */
+
+#ifndef _ZRAM_DEDUP_H_
+#define _ZRAM_DEDUP_H_
+
+struct zram;
+struct zcomp_strm;
+
+#ifdef CONFIG_ZRAM_DEDUP
+u32 zram_dedup_checksum(void *mem);
+unsigned long zram_dedup_find(struct zram *zram, struct zcomp_strm *zstrm,
+			void *mem, u32 checksum, unsigned int *len);
+bool zram_dedup_insert(struct zram *zram, unsigned long handle,
+			unsigned int len, u32 checksum);
+bool zram_dedup_put(struct zram *zram, unsigned long handle, u32 checksum);
+
+int zram_dedup_init(struct zram *zram, size_t num_pages);
+void zram_dedup_fini(struct zram *zram);
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return zram->use_dedup;
+}
+#else
+static inline u32 zram_dedup_checksum(void *mem) { return 0; }
+static inline unsigned long zram_dedup_find(struct zram *zram,
+			struct zcomp_strm *zstrm, void *mem, u32 checksum,
+			unsigned int *len) { return 0; }
+static inline bool zram_dedup_insert(struct zram *zram, unsigned long handle,
+			unsigned int len, u32 checksum) { return false; }
+static inline bool zram_dedup_put(struct zram *zram, unsigned long handle,
+			u32 checksum) { return true; }
+
+static inline int zram_dedup_init(struct zram *zram, size_t num_pages)
+{
+	return 0;
+}
+static inline void zram_dedup_fini(struct zram *zram) {}
+
+static inline bool zram_dedup_enabled(struct zram *zram)
+{
+	return false;
+}
+#endif
+
+#endif /* _ZRAM_DEDUP_H_ */
@@ -36,6 +36,7 @@
 #include <linux/cpuhotplug.h>
 
 #include "zram_drv.h"
+#include "zram_dedup.h"
 
 static DEFINE_IDR(zram_index_idr);
 /* idr index must be protected */
@@ -151,6 +152,57 @@ static inline bool zram_allocated(struct zram *zram, u32 index)
 			zram_test_flag(zram, index, ZRAM_WB);
 }
 
+#ifdef CONFIG_ZRAM_DEDUP
+static u32 zram_get_checksum(struct zram *zram, u32 index)
+{
+	return zram->table[index].checksum;
+}
+
+static void zram_set_checksum(struct zram *zram, u32 index, u32 checksum)
+{
+	zram->table[index].checksum = checksum;
+}
+
+static inline bool zram_test_dedup(struct zram *zram, u32 index)
+{
+	return zram_test_flag(zram, index, ZRAM_DEDUP);
+}
+
+static inline void zram_set_dedup(struct zram *zram, u32 index, u32 checksum)
+{
+	zram_set_flag(zram, index, ZRAM_DEDUP);
+	zram_set_checksum(zram, index, checksum);
+}
+
+static inline void zram_clear_dedup(struct zram *zram, u32 index)
+{
+	zram_clear_flag(zram, index, ZRAM_DEDUP);
+}
+#else
+static inline u32 zram_get_checksum(struct zram *zram, u32 index)
+{
+	return 0;
+}
+
+static inline bool zram_test_dedup(struct zram *zram, u32 index)
+{
+	return false;
+}
+
+static inline void zram_set_dedup(struct zram *zram, u32 index,
+				  u32 checksum) {}
+static inline void zram_clear_dedup(struct zram *zram, u32 index) {}
+#endif
+
+static inline struct zcomp *zram_slot_comp(struct zram *zram, u32 index)
+{
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram_test_flag(zram, index, ZRAM_RECOMP))
+		return zram->recomp;
+#endif
+	return zram->comp;
+}
+
 #if PAGE_SIZE != 4096
 static inline bool is_partial_io(struct bio_vec *bvec)
 {
@@ -624,19 +676,125 @@ static int read_from_bdev_async(struct zram *zram, struct bio_vec *bvec,
 #define HUGE_WRITEBACK 1
 #define IDLE_WRITEBACK 2
 
+/* slots gathered before their pages are written out */
+#define ZRAM_WB_BATCH	32
+/* upper bound of writeback_ra_pages */
+#define ZRAM_WB_RA_MAX	32
+
+struct zram_wb_batch {
+	unsigned int nr;
+	unsigned long index[ZRAM_WB_BATCH];
+	unsigned long blk_idx[ZRAM_WB_BATCH];
+	struct page *pages[ZRAM_WB_BATCH];
+};
+
+static void zram_wb_abort_slot(struct zram *zram, unsigned long index)
+{
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+	zram_slot_unlock(zram, index);
+}
+
+static bool zram_wb_limit_reached(struct zram *zram, unsigned int pending)
+{
+	bool reached;
+
+	spin_lock(&zram->wb_limit_lock);
+	reached = zram->wb_limit_enable && zram->bd_wb_limit <=
+		(u64)pending << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+
+	return reached;
+}
+
+/* Turn a slot whose page is now on the backing device into ZRAM_WB. */
+static void zram_wb_commit(struct zram *zram, unsigned long index,
+			   unsigned long blk_idx)
+{
+	atomic64_inc(&zram->stats.bd_writes);
+	/*
+	 * We released zram_slot_lock so need to check if the slot was
+	 * changed. If there is freeing for the slot, we can catch it
+	 * easily by zram_allocated.
+	 * A subtle case is the slot is freed/reallocated/marked as
+	 * ZRAM_IDLE again. To close the race, idle_store doesn't
+	 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
+	 * Thus, we could close the race by checking ZRAM_IDLE bit.
+	 */
+	zram_slot_lock(zram, index);
+	if (!zram_allocated(zram, index) ||
+		  !zram_test_flag(zram, index, ZRAM_IDLE)) {
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_clear_flag(zram, index, ZRAM_IDLE);
+		zram_slot_unlock(zram, index);
+		free_block_bdev(zram, blk_idx);
+		return;
+	}
+
+	zram_free_page(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_set_flag(zram, index, ZRAM_WB);
+	zram_set_element(zram, index, blk_idx);
+	atomic64_inc(&zram->stats.pages_stored);
+	spin_lock(&zram->wb_limit_lock);
+	if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
+		zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
+	spin_unlock(&zram->wb_limit_lock);
+	zram_slot_unlock(zram, index);
+}
+
+/*
+ * Write out the gathered pages, one bio per run of contiguous backing
+ * blocks. alloc_block_bdev() hands out the lowest free block, so a batch
+ * normally ends up as a single large write.
+ */
+static void zram_wb_flush(struct zram *zram, struct zram_wb_batch *wb)
+{
+	unsigned int i, j, k;
+
+	for (i = 0; i < wb->nr; i = j) {
+		struct bio *bio;
+		int err;
+
+		for (j = i + 1; j < wb->nr; j++)
+			if (wb->blk_idx[j] != wb->blk_idx[j - 1] + 1)
+				break;
+
+		bio = bio_alloc(GFP_NOIO, j - i);
+		bio_set_dev(bio, zram->bdev);
+		bio->bi_iter.bi_sector = wb->blk_idx[i] * (PAGE_SIZE >> 9);
+		bio->bi_opf = REQ_OP_WRITE | REQ_SYNC;
+		for (k = i; k < j; k++)
+			bio_add_page(bio, wb->pages[k], PAGE_SIZE, 0);
+
+		err = submit_bio_wait(bio);
+		bio_put(bio);
+
+		for (k = i; k < j; k++) {
+			if (err) {
+				zram_wb_abort_slot(zram, wb->index[k]);
+				free_block_bdev(zram, wb->blk_idx[k]);
+				continue;
+			}
+			zram_wb_commit(zram, wb->index[k], wb->blk_idx[k]);
+		}
+	}
+
+	wb->nr = 0;
+}
+
 static ssize_t writeback_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
 	struct zram *zram = dev_to_zram(dev);
 	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
 	unsigned long index;
-	struct bio bio;
-	struct bio_vec bio_vec;
-	struct page *page;
+	struct zram_wb_batch *wb;
 	ssize_t ret, sz;
 	char mode_buf[8];
 	int mode = -1;
-	unsigned long blk_idx = 0;
+	unsigned int i;
 
 	sz = strscpy(mode_buf, buf, sizeof(mode_buf));
 	if (sz <= 0)
@@ -665,34 +823,28 @@ static ssize_t writeback_store(struct device *dev,
 		goto release_init_lock;
 	}
 
-	page = alloc_page(GFP_KERNEL);
-	if (!page) {
+	wb = kzalloc(sizeof(*wb), GFP_KERNEL);
+	if (!wb) {
 		ret = -ENOMEM;
 		goto release_init_lock;
 	}
 
+	for (i = 0; i < ZRAM_WB_BATCH; i++) {
+		wb->pages[i] = alloc_page(GFP_KERNEL);
+		if (!wb->pages[i]) {
+			ret = -ENOMEM;
+			goto free_batch;
+		}
+	}
+
 	for (index = 0; index < nr_pages; index++) {
 		struct bio_vec bvec;
+		unsigned long blk_idx;
 
-		bvec.bv_page = page;
-		bvec.bv_len = PAGE_SIZE;
-		bvec.bv_offset = 0;
-
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && !zram->bd_wb_limit) {
-			spin_unlock(&zram->wb_limit_lock);
+		if (zram_wb_limit_reached(zram, wb->nr)) {
 			ret = -EIO;
 			break;
 		}
-		spin_unlock(&zram->wb_limit_lock);
-
-		if (!blk_idx) {
-			blk_idx = alloc_block_bdev(zram);
-			if (!blk_idx) {
-				ret = -ENOSPC;
-				break;
-			}
-		}
 
 		zram_slot_lock(zram, index);
 		if (!zram_allocated(zram, index))
@@ -717,76 +869,243 @@ static ssize_t writeback_store(struct device *dev,
 		/* Need for hugepage writeback racing */
 		zram_set_flag(zram, index, ZRAM_IDLE);
 		zram_slot_unlock(zram, index);
-		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
-			continue;
-		}
-
-		bio_init(&bio, &bio_vec, 1);
-		bio_set_dev(&bio, zram->bdev);
-		bio.bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
-		bio.bi_opf = REQ_OP_WRITE | REQ_SYNC;
 
-		bio_add_page(&bio, bvec.bv_page, bvec.bv_len,
-				bvec.bv_offset);
-		/*
-		 * XXX: A single page IO would be inefficient for write
-		 * but it would be not bad as starter.
-		 */
-		ret = submit_bio_wait(&bio);
-		if (ret) {
-			zram_slot_lock(zram, index);
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			zram_slot_unlock(zram, index);
+		bvec.bv_page = wb->pages[wb->nr];
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+		if (zram_bvec_read(zram, &bvec, index, 0, NULL)) {
+			zram_wb_abort_slot(zram, index);
 			continue;
 		}
 
-		atomic64_inc(&zram->stats.bd_writes);
-		/*
-		 * We released zram_slot_lock so need to check if the slot was
-		 * changed. If there is freeing for the slot, we can catch it
-		 * easily by zram_allocated.
-		 * A subtle case is the slot is freed/reallocated/marked as
-		 * ZRAM_IDLE again. To close the race, idle_store doesn't
-		 * mark ZRAM_IDLE once it found the slot was ZRAM_UNDER_WB.
-		 * Thus, we could close the race by checking ZRAM_IDLE bit.
-		 */
-		zram_slot_lock(zram, index);
-		if (!zram_allocated(zram, index) ||
-			  !zram_test_flag(zram, index, ZRAM_IDLE)) {
-			zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-			zram_clear_flag(zram, index, ZRAM_IDLE);
-			goto next;
+		blk_idx = alloc_block_bdev(zram);
+		if (!blk_idx) {
+			zram_wb_abort_slot(zram, index);
+			ret = -ENOSPC;
+			break;
 		}
 
-		zram_free_page(zram, index);
-		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
-		zram_set_flag(zram, index, ZRAM_WB);
-		zram_set_element(zram, index, blk_idx);
-		blk_idx = 0;
-		atomic64_inc(&zram->stats.pages_stored);
-		spin_lock(&zram->wb_limit_lock);
-		if (zram->wb_limit_enable && zram->bd_wb_limit > 0)
-			zram->bd_wb_limit -=  1UL << (PAGE_SHIFT - 12);
-		spin_unlock(&zram->wb_limit_lock);
+		wb->index[wb->nr] = index;
+		wb->blk_idx[wb->nr] = blk_idx;
+		if (++wb->nr == ZRAM_WB_BATCH)
+			zram_wb_flush(zram, wb);
+		continue;
 next:
 		zram_slot_unlock(zram, index);
 	}
 
-	if (blk_idx)
-		free_block_bdev(zram, blk_idx);
+	zram_wb_flush(zram, wb);
 	ret = len;
-	__free_page(page);
+free_batch:
+	for (i = 0; i < ZRAM_WB_BATCH && wb->pages[i]; i++)
+		__free_page(wb->pages[i]);
+	kfree(wb);
 release_init_lock:
 	up_read(&zram->init_lock);
 
 	return ret;
 }
 
+/*
+ * Slots written back in the same batch sit on contiguous backing blocks.
+ * When one of them faults, bring its successors in the run back into
+ * zsmalloc with a single read, so that the next swap-ins of the same app
+ * do not go to the backing device one page at a time.
+ */
+static void zram_wb_ra_install(struct zram *zram, unsigned long index,
+			       unsigned long blk_idx, struct page *page)
+{
+	struct zcomp_strm *zstrm;
+	unsigned int comp_len;
+	unsigned long handle;
+	void *src, *dst;
+	int ret;
+
+	zstrm = zcomp_stream_get(zram->comp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len);
+	kunmap_atomic(src);
+	if (ret) {
+		zcomp_stream_put(zram->comp);
+		goto out;
+	}
+
+	if (comp_len >= huge_class_size)
+		comp_len = PAGE_SIZE;
+
+	handle = zs_malloc(zram->mem_pool, comp_len,
+			__GFP_KSWAPD_RECLAIM |
+			__GFP_NOWARN |
+			__GFP_HIGHMEM |
+			__GFP_MOVABLE);
+	if (!handle) {
+		zcomp_stream_put(zram->comp);
+		goto out;
+	}
+
+	dst = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+	src = zstrm->buffer;
+	if (comp_len == PAGE_SIZE)
+		src = kmap_atomic(page);
+	memcpy(dst, src, comp_len);
+	if (comp_len == PAGE_SIZE)
+		kunmap_atomic(src);
+	zcomp_stream_put(zram->comp);
+	zs_unmap_object(zram->mem_pool, handle);
+
+	zram_slot_lock(zram, index);
+	if ((zram->limit_pages &&
+	     zs_get_total_pages(zram->mem_pool) > zram->limit_pages) ||
+	    !zram_test_flag(zram, index, ZRAM_WB) ||
+	    zram_get_element(zram, index) != blk_idx) {
+		zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+		zram_slot_unlock(zram, index);
+		zs_free(zram->mem_pool, handle);
+		return;
+	}
+
+	zram_free_page(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	if (comp_len == PAGE_SIZE) {
+		zram_set_flag(zram, index, ZRAM_HUGE);
+		atomic64_inc(&zram->stats.huge_pages);
+	}
+	zram_set_handle(zram, index, handle);
+	zram_set_obj_size(zram, index, comp_len);
+	zram_slot_unlock(zram, index);
+
+	atomic64_add(comp_len, &zram->stats.compr_data_size);
+	atomic64_inc(&zram->stats.pages_stored);
+	atomic64_inc(&zram->stats.bd_ra_pages);
+	return;
+out:
+	zram_slot_lock(zram, index);
+	zram_clear_flag(zram, index, ZRAM_UNDER_WB);
+	zram_slot_unlock(zram, index);
+}
+
+static void zram_wb_ra_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, wb_ra_work);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long index = zram->wb_ra_index;
+	unsigned long blk_idx = zram->wb_ra_blk;
+	struct page *pages[ZRAM_WB_RA_MAX];
+	unsigned int nr, i;
+	struct bio *bio;
+	int err;
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram) || !zram->backing_dev)
+		goto out;
+
+	/*
+	 * Pin the run with ZRAM_UNDER_WB: writeback skips such slots, so a
+	 * slot cannot be freed and written back to the same block while
+	 * its old content is in flight.
+	 */
+	for (nr = 0; nr < zram->wb_ra_nr && index + nr < nr_pages; nr++) {
+		bool same_run;
+
+		zram_slot_lock(zram, index + nr);
+		same_run = zram_test_flag(zram, index + nr, ZRAM_WB) &&
+			!zram_test_flag(zram, index + nr, ZRAM_UNDER_WB) &&
+			zram_get_element(zram, index + nr) == blk_idx + nr;
+		if (same_run)
+			zram_set_flag(zram, index + nr, ZRAM_UNDER_WB);
+		zram_slot_unlock(zram, index + nr);
+		if (!same_run)
+			break;
+
+		pages[nr] = alloc_page(GFP_NOIO | __GFP_NOWARN);
+		if (!pages[nr]) {
+			zram_slot_lock(zram, index + nr);
+			zram_clear_flag(zram, index + nr, ZRAM_UNDER_WB);
+			zram_slot_unlock(zram, index + nr);
+			break;
+		}
+	}
+
+	if (!nr)
+		goto out;
+
+	bio = bio_alloc(GFP_NOIO, nr);
+	bio_set_dev(bio, zram->bdev);
+	bio->bi_iter.bi_sector = blk_idx * (PAGE_SIZE >> 9);
+	bio->bi_opf = REQ_OP_READ;
+	for (i = 0; i < nr; i++)
+		bio_add_page(bio, pages[i], PAGE_SIZE, 0);
+	err = submit_bio_wait(bio);
+	bio_put(bio);
+
+	if (!err)
+		atomic64_add(nr, &zram->stats.bd_reads);
+
+	for (i = 0; i < nr; i++) {
+		if (!err) {
+			zram_wb_ra_install(zram, index + i, blk_idx + i,
+					   pages[i]);
+		} else {
+			zram_slot_lock(zram, index + i);
+			zram_clear_flag(zram, index + i, ZRAM_UNDER_WB);
+			zram_slot_unlock(zram, index + i);
+		}
+		__free_page(pages[i]);
+	}
+out:
+	up_read(&zram->init_lock);
+	atomic_set(&zram->wb_ra_inflight, 0);
+}
+
+static void zram_wb_readahead(struct zram *zram, u32 index,
+			      unsigned long blk_idx)
+{
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned int ra_pages = READ_ONCE(zram->wb_ra_pages);
+	bool same_run;
+
+	if (!ra_pages || index + 1 >= nr_pages)
+		return;
+
+	zram_slot_lock(zram, index + 1);
+	same_run = zram_test_flag(zram, index + 1, ZRAM_WB) &&
+		   zram_get_element(zram, index + 1) == blk_idx + 1;
+	zram_slot_unlock(zram, index + 1);
+	if (!same_run)
+		return;
+
+	/* one read-ahead in flight per device */
+	if (atomic_cmpxchg(&zram->wb_ra_inflight, 0, 1))
+		return;
+
+	zram->wb_ra_index = index + 1;
+	zram->wb_ra_blk = blk_idx + 1;
+	zram->wb_ra_nr = ra_pages;
+	queue_work(system_unbound_wq, &zram->wb_ra_work);
+}
+
+static ssize_t writeback_ra_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(zram->wb_ra_pages));
+}
+
+static ssize_t writeback_ra_pages_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val) || val > ZRAM_WB_RA_MAX)
+		return -EINVAL;
+
+	WRITE_ONCE(zram->wb_ra_pages, val);
+	return len;
+}
+
 struct zram_work {
 	struct work_struct work;
 	struct zram *zram;
@@ -848,6 +1167,8 @@ static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 }
 #else
 static inline void reset_bdev(struct zram *zram) {};
+static inline void zram_wb_readahead(struct zram *zram, u32 index,
+				     unsigned long blk_idx) {};
 static int read_from_bdev(struct zram *zram, struct bio_vec *bvec,
 			unsigned long entry, struct bio *parent, bool sync)
 {
@@ -914,118 +1235,394 @@ static ssize_t read_block_state(struct file *file, char __user *buf,
 			zram_test_flag(zram, index, ZRAM_HUGE) ? 'h' : '.',
 			zram_test_flag(zram, index, ZRAM_IDLE) ? 'i' : '.');
 
-		if (count < copied) {
-			zram_slot_unlock(zram, index);
+		if (count < copied) {
+			zram_slot_unlock(zram, index);
+			break;
+		}
+		written += copied;
+		count -= copied;
+next:
+		zram_slot_unlock(zram, index);
+		*ppos += 1;
+	}
+
+	up_read(&zram->init_lock);
+	if (copy_to_user(buf, kbuf, written))
+		written = -EFAULT;
+	kvfree(kbuf);
+
+	return written;
+}
+
+static const struct file_operations proc_zram_block_state_op = {
+	.open = simple_open,
+	.read = read_block_state,
+	.llseek = default_llseek,
+};
+
+static void zram_debugfs_register(struct zram *zram)
+{
+	if (!zram_debugfs_root)
+		return;
+
+	zram->debugfs_dir = debugfs_create_dir(zram->disk->disk_name,
+						zram_debugfs_root);
+	debugfs_create_file("block_state", 0400, zram->debugfs_dir,
+				zram, &proc_zram_block_state_op);
+}
+
+static void zram_debugfs_unregister(struct zram *zram)
+{
+	debugfs_remove_recursive(zram->debugfs_dir);
+}
+#else
+static void zram_debugfs_create(void) {};
+static void zram_debugfs_destroy(void) {};
+static void zram_accessed(struct zram *zram, u32 index)
+{
+	zram_clear_flag(zram, index, ZRAM_IDLE);
+};
+static void zram_debugfs_register(struct zram *zram) {};
+static void zram_debugfs_unregister(struct zram *zram) {};
+#endif
+
+/*
+ * We switched to per-cpu streams and this attr is not needed anymore.
+ * However, we will keep it around for some time, because:
+ * a) we may revert per-cpu streams in the future
+ * b) it's visible to user space and we need to follow our 2 years
+ *    retirement rule; but we already have a number of 'soon to be
+ *    altered' attrs, so max_comp_streams need to wait for the next
+ *    layoff cycle.
+ */
+static ssize_t max_comp_streams_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	return scnprintf(buf, PAGE_SIZE, "%d\n", num_online_cpus());
+}
+
+static ssize_t max_comp_streams_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	return len;
+}
+
+static ssize_t comp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->compressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->compressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->compressor, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static ssize_t recomp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->recomp_algorithm, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t recomp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[ARRAY_SIZE(zram->recomp_algorithm)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (init_done(zram)) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+
+	strcpy(zram->recomp_algorithm, compressor);
+	up_write(&zram->init_lock);
+	return len;
+}
+
+#define RECOMPRESS_IDLE		(1 << 0)
+#define RECOMPRESS_HUGE		(1 << 1)
+
+/*
+ * Recompress the slot with the secondary algorithm. Called with the slot
+ * lock held. A slot the secondary algorithm does not shrink below its
+ * current size (or below @threshold) is marked ZRAM_INCOMPRESSIBLE so
+ * that later passes skip it.
+ */
+static int zram_recompress(struct zram *zram, u32 index, struct page *page,
+			   unsigned int threshold)
+{
+	unsigned int comp_len_old = zram_get_obj_size(zram, index);
+	unsigned int comp_len_new;
+	unsigned long handle;
+	struct zcomp_strm *zstrm;
+	void *src, *dst;
+	int ret;
+
+	ret = zram_read_from_zspool(zram, page, index);
+	if (ret)
+		return ret;
+
+	zstrm = zcomp_stream_get(zram->recomp);
+	src = kmap_atomic(page);
+	ret = zcomp_compress(zstrm, src, &comp_len_new);
+	kunmap_atomic(src);
+
+	if (ret) {
+		zcomp_stream_put(zram->recomp);
+		return ret;
+	}
+
+	if (comp_len_new >= huge_class_size ||
+	    comp_len_new >= comp_len_old ||
+	    (threshold && comp_len_new >= threshold)) {
+		zcomp_stream_put(zram->recomp);
+		zram_set_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+		return 0;
+	}
+
+	/* we hold the slot lock, so this allocation must not sleep */
+	handle = zs_malloc(zram->mem_pool, comp_len_new,
+			   __GFP_KSWAPD_RECLAIM |
+			   __GFP_NOWARN |
+			   __GFP_HIGHMEM |
+			   __GFP_MOVABLE);
+	if (!handle) {
+		zcomp_stream_put(zram->recomp);
+		return -ENOMEM;
+	}
+
+	dst = zs_map_object(zram->mem_pool, handle, ZS_MM_WO);
+	memcpy(dst, zstrm->buffer, comp_len_new);
+	zcomp_stream_put(zram->recomp);
+	zs_unmap_object(zram->mem_pool, handle);
+
+	zram_free_page(zram, index);
+	zram_set_handle(zram, index, handle);
+	zram_set_obj_size(zram, index, comp_len_new);
+	zram_set_flag(zram, index, ZRAM_RECOMP);
+
+	atomic64_add(comp_len_new, &zram->stats.compr_data_size);
+	atomic64_add(comp_len_new, &zram->stats.recomp_data_size);
+	atomic64_inc(&zram->stats.recomp_pages);
+	atomic64_inc(&zram->stats.pages_stored);
+
+	return 0;
+}
+
+/*
+ * echo "type=idle|huge|huge_idle [threshold=bytes] [max_pages=n]" > recompress
+ *
+ * threshold: only recompress slots of at least this compressed size, and
+ *            only keep the result if it is below it
+ * max_pages: stop after this many slots have been tried
+ */
+static ssize_t recompress_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned long nr_pages = zram->disksize >> PAGE_SHIFT;
+	unsigned long max_pages = ULONG_MAX;
+	unsigned int threshold = 0;
+	char *args, *param, *val, *tmp;
+	struct page *page;
+	unsigned long index;
+	int mode = 0;
+	ssize_t ret = len;
+
+	tmp = args = kstrndup(buf, len, GFP_KERNEL);
+	if (!args)
+		return -ENOMEM;
+
+	args = skip_spaces(args);
+	while (*args) {
+		args = next_arg(args, &param, &val);
+
+		if (!val || !*val) {
+			ret = -EINVAL;
+			goto out_free;
+		}
+
+		if (!strcmp(param, "type")) {
+			if (!strcmp(val, "idle"))
+				mode = RECOMPRESS_IDLE;
+			else if (!strcmp(val, "huge"))
+				mode = RECOMPRESS_HUGE;
+			else if (!strcmp(val, "huge_idle"))
+				mode = RECOMPRESS_IDLE | RECOMPRESS_HUGE;
+			else
+				ret = -EINVAL;
+		} else if (!strcmp(param, "threshold")) {
+			if (kstrtouint(val, 10, &threshold) ||
+			    threshold >= PAGE_SIZE)
+				ret = -EINVAL;
+		} else if (!strcmp(param, "max_pages")) {
+			if (kstrtoul(val, 10, &max_pages) || !max_pages)
+				ret = -EINVAL;
+		} else {
+			ret = -EINVAL;
+		}
+
+		if (ret < 0)
+			goto out_free;
+	}
+
+	if (!mode && !threshold) {
+		ret = -EINVAL;
+		goto out_free;
+	}
+
+	down_read(&zram->init_lock);
+	if (!init_done(zram)) {
+		ret = -EINVAL;
+		goto release_init_lock;
+	}
+
+	if (!zram->recomp) {
+		ret = -ENODEV;
+		goto release_init_lock;
+	}
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page) {
+		ret = -ENOMEM;
+		goto release_init_lock;
+	}
+
+	for (index = 0; index < nr_pages && max_pages; index++) {
+		int err;
+
+		zram_slot_lock(zram, index);
+		if (!zram_allocated(zram, index))
+			goto next;
+
+		if (zram_test_flag(zram, index, ZRAM_WB) ||
+		    zram_test_flag(zram, index, ZRAM_UNDER_WB) ||
+		    zram_test_flag(zram, index, ZRAM_SAME) ||
+		    zram_test_flag(zram, index, ZRAM_RECOMP) ||
+		    zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE) ||
+		    zram_test_dedup(zram, index))
+			goto next;
+
+		if ((mode & RECOMPRESS_IDLE) &&
+		    !zram_test_flag(zram, index, ZRAM_IDLE))
+			goto next;
+
+		if ((mode & RECOMPRESS_HUGE) &&
+		    !zram_test_flag(zram, index, ZRAM_HUGE))
+			goto next;
+
+		if (threshold && zram_get_obj_size(zram, index) < threshold)
+			goto next;
+
+		max_pages--;
+		err = zram_recompress(zram, index, page, threshold);
+		zram_slot_unlock(zram, index);
+		if (err) {
+			ret = err;
 			break;
 		}
-		written += copied;
-		count -= copied;
+
+		cond_resched();
+		continue;
 next:
 		zram_slot_unlock(zram, index);
-		*ppos += 1;
 	}
 
+	__free_page(page);
+release_init_lock:
 	up_read(&zram->init_lock);
-	if (copy_to_user(buf, kbuf, written))
-		written = -EFAULT;
-	kvfree(kbuf);
-
-	return written;
-}
-
-static const struct file_operations proc_zram_block_state_op = {
-	.open = simple_open,
-	.read = read_block_state,
-	.llseek = default_llseek,
-};
-
-static void zram_debugfs_register(struct zram *zram)
-{
-	if (!zram_debugfs_root)
-		return;
-
-	zram->debugfs_dir = debugfs_create_dir(zram->disk->disk_name,
-						zram_debugfs_root);
-	debugfs_create_file("block_state", 0400, zram->debugfs_dir,
-				zram, &proc_zram_block_state_op);
-}
+out_free:
+	kfree(tmp);
 
-static void zram_debugfs_unregister(struct zram *zram)
-{
-	debugfs_remove_recursive(zram->debugfs_dir);
+	return ret;
 }
-#else
-static void zram_debugfs_create(void) {};
-static void zram_debugfs_destroy(void) {};
-static void zram_accessed(struct zram *zram, u32 index)
-{
-	zram_clear_flag(zram, index, ZRAM_IDLE);
-};
-static void zram_debugfs_register(struct zram *zram) {};
-static void zram_debugfs_unregister(struct zram *zram) {};
 #endif
 
-/*
- * We switched to per-cpu streams and this attr is not needed anymore.
- * However, we will keep it around for some time, because:
- * a) we may revert per-cpu streams in the future
- * b) it's visible to user space and we need to follow our 2 years
- *    retirement rule; but we already have a number of 'soon to be
- *    altered' attrs, so max_comp_streams need to wait for the next
- *    layoff cycle.
- */
-static ssize_t max_comp_streams_show(struct device *dev,
-		struct device_attribute *attr, char *buf)
-{
-	return scnprintf(buf, PAGE_SIZE, "%d\n", num_online_cpus());
-}
-
-static ssize_t max_comp_streams_store(struct device *dev,
-		struct device_attribute *attr, const char *buf, size_t len)
-{
-	return len;
-}
-
-static ssize_t comp_algorithm_show(struct device *dev,
+#ifdef CONFIG_ZRAM_DEDUP
+static ssize_t use_dedup_show(struct device *dev,
 		struct device_attribute *attr, char *buf)
 {
-	size_t sz;
+	bool val;
 	struct zram *zram = dev_to_zram(dev);
 
 	down_read(&zram->init_lock);
-	sz = zcomp_available_show(zram->compressor, buf);
+	val = zram->use_dedup;
 	up_read(&zram->init_lock);
 
-	return sz;
+	return scnprintf(buf, PAGE_SIZE, "%d\n", (int)val);
 }
 
-static ssize_t comp_algorithm_store(struct device *dev,
+static ssize_t use_dedup_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
 {
+	bool val;
 	struct zram *zram = dev_to_zram(dev);
-	char compressor[ARRAY_SIZE(zram->compressor)];
-	size_t sz;
-
-	strlcpy(compressor, buf, sizeof(compressor));
-	/* ignore trailing newline */
-	sz = strlen(compressor);
-	if (sz > 0 && compressor[sz - 1] == '\n')
-		compressor[sz - 1] = 0x00;
 
-	if (!zcomp_available_algorithm(compressor))
+	if (kstrtobool(buf, &val))
 		return -EINVAL;
 
 	down_write(&zram->init_lock);
 	if (init_done(zram)) {
 		up_write(&zram->init_lock);
-		pr_info("Can't change algorithm for initialized device\n");
+		pr_info("Can't change dedup usage for initialized device\n");
 		return -EBUSY;
 	}
-
-	strcpy(zram->compressor, compressor);
+	zram->use_dedup = val;
 	up_write(&zram->init_lock);
 	return len;
 }
+#endif
 
 static ssize_t compact_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t len)
@@ -1083,7 +1680,7 @@ static ssize_t mm_stat_show(struct device *dev,
 	max_used = atomic_long_read(&zram->stats.max_used_pages);
 
 	ret = scnprintf(buf, PAGE_SIZE,
-			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu\n",
+			"%8llu %8llu %8llu %8lu %8ld %8llu %8lu %8llu %8llu %8llu %8llu\n",
 			orig_size << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.compr_data_size),
 			mem_used << PAGE_SHIFT,
@@ -1091,7 +1688,10 @@ static ssize_t mm_stat_show(struct device *dev,
 			max_used << PAGE_SHIFT,
 			(u64)atomic64_read(&zram->stats.same_pages),
 			pool_stats.pages_compacted,
-			(u64)atomic64_read(&zram->stats.huge_pages));
+			(u64)atomic64_read(&zram->stats.huge_pages),
+			(u64)atomic64_read(&zram->stats.recomp_pages),
+			(u64)atomic64_read(&zram->stats.recomp_data_size),
+			(u64)atomic64_read(&zram->stats.dedup_saved_bytes));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1107,10 +1707,11 @@ static ssize_t bd_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-		"%8llu %8llu %8llu\n",
+		"%8llu %8llu %8llu %8llu\n",
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_count)),
 			FOUR_K((u64)atomic64_read(&zram->stats.bd_reads)),
-			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)));
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_writes)),
+			FOUR_K((u64)atomic64_read(&zram->stats.bd_ra_pages)));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1126,10 +1727,11 @@ static ssize_t debug_stat_show(struct device *dev,
 
 	down_read(&zram->init_lock);
 	ret = scnprintf(buf, PAGE_SIZE,
-			"version: %d\n%8llu %8llu\n",
+			"version: %d\n%8llu %8llu %8llu\n",
 			version,
 			(u64)atomic64_read(&zram->stats.writestall),
-			(u64)atomic64_read(&zram->stats.miss_free));
+			(u64)atomic64_read(&zram->stats.miss_free),
+			(u64)atomic64_read(&zram->stats.batched_writes));
 	up_read(&zram->init_lock);
 
 	return ret;
@@ -1151,6 +1753,7 @@ static void zram_meta_free(struct zram *zram, u64 disksize)
 	for (index = 0; index < num_pages; index++)
 		zram_free_page(zram, index);
 
+	zram_dedup_fini(zram);
 	zs_destroy_pool(zram->mem_pool);
 	vfree(zram->table);
 }
@@ -1170,6 +1773,12 @@ static bool zram_meta_alloc(struct zram *zram, u64 disksize)
 		return false;
 	}
 
+	if (zram_dedup_init(zram, num_pages)) {
+		zs_destroy_pool(zram->mem_pool);
+		vfree(zram->table);
+		return false;
+	}
+
 	if (!huge_class_size)
 		huge_class_size = zs_huge_class_size(zram->mem_pool);
 	return true;
@@ -1195,6 +1804,16 @@ static void zram_free_page(struct zram *zram, size_t index)
 		atomic64_dec(&zram->stats.huge_pages);
 	}
 
+	if (zram_test_flag(zram, index, ZRAM_INCOMPRESSIBLE))
+		zram_clear_flag(zram, index, ZRAM_INCOMPRESSIBLE);
+
+	if (zram_test_flag(zram, index, ZRAM_RECOMP)) {
+		zram_clear_flag(zram, index, ZRAM_RECOMP);
+		atomic64_dec(&zram->stats.recomp_pages);
+		atomic64_sub(zram_get_obj_size(zram, index),
+				&zram->stats.recomp_data_size);
+	}
+
 	if (zram_test_flag(zram, index, ZRAM_WB)) {
 		zram_clear_flag(zram, index, ZRAM_WB);
 		free_block_bdev(zram, zram_get_element(zram, index));
@@ -1215,6 +1834,17 @@ static void zram_free_page(struct zram *zram, size_t index)
 	if (!handle)
 		return;
 
+	if (zram_test_dedup(zram, index)) {
+		zram_clear_dedup(zram, index);
+		if (!zram_dedup_put(zram, handle,
+				zram_get_checksum(zram, index))) {
+			/* still referenced by another slot */
+			atomic64_sub(zram_get_obj_size(zram, index),
+					&zram->stats.dedup_saved_bytes);
+			goto out;
+		}
+	}
+
 	zs_free(zram->mem_pool, handle);
 
 	atomic64_sub(zram_get_obj_size(zram, index),
@@ -1227,28 +1857,18 @@ static void zram_free_page(struct zram *zram, size_t index)
 		~(1UL << ZRAM_LOCK | 1UL << ZRAM_UNDER_WB));
 }
 
-static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
-				struct bio *bio, bool partial_io)
+/*
+ * Decompress the slot into @page. Caller holds the slot lock and has
+ * checked that the slot is not ZRAM_WB.
+ */
+static int zram_read_from_zspool(struct zram *zram, struct page *page,
+				 u32 index)
 {
 	int ret;
 	unsigned long handle;
 	unsigned int size;
 	void *src, *dst;
 
-	zram_slot_lock(zram, index);
-	if (zram_test_flag(zram, index, ZRAM_WB)) {
-		struct bio_vec bvec;
-
-		zram_slot_unlock(zram, index);
-
-		bvec.bv_page = page;
-		bvec.bv_len = PAGE_SIZE;
-		bvec.bv_offset = 0;
-		return read_from_bdev(zram, &bvec,
-				zram_get_element(zram, index),
-				bio, partial_io);
-	}
-
 	handle = zram_get_handle(zram, index);
 	if (!handle || zram_test_flag(zram, index, ZRAM_SAME)) {
 		unsigned long value;
@@ -1258,7 +1878,6 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		mem = kmap_atomic(page);
 		zram_fill_page(mem, PAGE_SIZE, value);
 		kunmap_atomic(mem);
-		zram_slot_unlock(zram, index);
 		return 0;
 	}
 
@@ -1271,14 +1890,41 @@ static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
 		kunmap_atomic(dst);
 		ret = 0;
 	} else {
-		struct zcomp_strm *zstrm = zcomp_stream_get(zram->comp);
+		struct zcomp *comp = zram_slot_comp(zram, index);
+		struct zcomp_strm *zstrm = zcomp_stream_get(comp);
 
 		dst = kmap_atomic(page);
 		ret = zcomp_decompress(zstrm, src, size, dst);
 		kunmap_atomic(dst);
-		zcomp_stream_put(zram->comp);
+		zcomp_stream_put(comp);
 	}
 	zs_unmap_object(zram->mem_pool, handle);
+
+	return ret;
+}
+
+static int __zram_bvec_read(struct zram *zram, struct page *page, u32 index,
+				struct bio *bio, bool partial_io)
+{
+	int ret;
+
+	zram_slot_lock(zram, index);
+	if (zram_test_flag(zram, index, ZRAM_WB)) {
+		struct bio_vec bvec;
+		unsigned long blk_idx = zram_get_element(zram, index);
+
+		zram_slot_unlock(zram, index);
+
+		if (!partial_io)
+			zram_wb_readahead(zram, index, blk_idx);
+
+		bvec.bv_page = page;
+		bvec.bv_len = PAGE_SIZE;
+		bvec.bv_offset = 0;
+		return read_from_bdev(zram, &bvec, blk_idx, bio, partial_io);
+	}
+
+	ret = zram_read_from_zspool(zram, page, index);
 	zram_slot_unlock(zram, index);
 
 	/* Should NEVER happen. Return bio error if it does. */
@@ -1333,6 +1979,8 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	struct page *page = bvec->bv_page;
 	unsigned long element = 0;
 	enum zram_pageflags flags = 0;
+	u32 checksum = 0;
+	bool dedup = false;
 
 	mem = kmap_atomic(page);
 	if (page_same_filled(mem, &element)) {
@@ -1347,6 +1995,18 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 compress_again:
 	zstrm = zcomp_stream_get(zram->comp);
 	src = kmap_atomic(page);
+	if (!handle && zram_dedup_enabled(zram)) {
+		checksum = zram_dedup_checksum(src);
+		handle = zram_dedup_find(zram, zstrm, src, checksum,
+					 &comp_len);
+		if (handle) {
+			kunmap_atomic(src);
+			zcomp_stream_put(zram->comp);
+			atomic64_add(comp_len, &zram->stats.dedup_saved_bytes);
+			dedup = true;
+			goto out;
+		}
+	}
 	ret = zcomp_compress(zstrm, src, &comp_len);
 	kunmap_atomic(src);
 
@@ -1410,6 +2070,8 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 	zcomp_stream_put(zram->comp);
 	zs_unmap_object(zram->mem_pool, handle);
 	atomic64_add(comp_len, &zram->stats.compr_data_size);
+	if (zram_dedup_enabled(zram))
+		dedup = zram_dedup_insert(zram, handle, comp_len, checksum);
 out:
 	/*
 	 * Free memory associated with this sector
@@ -1430,6 +2092,9 @@ static int __zram_bvec_write(struct zram *zram, struct bio_vec *bvec,
 		zram_set_handle(zram, index, handle);
 		zram_set_obj_size(zram, index, comp_len);
 	}
+
+	if (dedup)
+		zram_set_dedup(zram, index, checksum);
 	zram_slot_unlock(zram, index);
 
 	/* Update stats */
@@ -1557,6 +2222,205 @@ static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 	return ret;
 }
 
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+#define ZRAM_BATCH_DEFAULT_PAGES	32
+#define ZRAM_BATCH_MIN_CHUNK		8
+#define ZRAM_BATCH_MAX_CHUNKS		8
+
+static struct workqueue_struct *zram_batch_wq;
+
+struct zram_batch;
+
+struct zram_batch_chunk {
+	struct work_struct work;
+	struct zram_batch *batch;
+	u32 index;
+	unsigned int first;
+	unsigned int nr;
+	int ret;
+};
+
+struct zram_batch {
+	struct zram *zram;
+	atomic_t pending;
+	struct completion done;
+	struct zram_batch_chunk chunks[ZRAM_BATCH_MAX_CHUNKS];
+	struct page *pages[];
+};
+
+static void zram_batch_write_chunk(struct zram_batch_chunk *chunk)
+{
+	struct zram_batch *batch = chunk->batch;
+	struct zram *zram = batch->zram;
+	unsigned int i;
+
+	for (i = 0; i < chunk->nr; i++) {
+		struct bio_vec bv = {
+			.bv_page = batch->pages[chunk->first + i],
+			.bv_len = PAGE_SIZE,
+			.bv_offset = 0,
+		};
+		u32 index = chunk->index + i;
+		int ret;
+
+		ret = __zram_bvec_write(zram, &bv, index, NULL);
+
+		zram_slot_lock(zram, index);
+		zram_accessed(zram, index);
+		zram_slot_unlock(zram, index);
+
+		if (unlikely(ret)) {
+			chunk->ret = ret;
+			break;
+		}
+	}
+
+	if (atomic_dec_and_test(&batch->pending))
+		complete(&batch->done);
+}
+
+static void zram_batch_work_fn(struct work_struct *work)
+{
+	zram_batch_write_chunk(container_of(work, struct zram_batch_chunk,
+					    work));
+}
+
+/*
+ * Compress a write bio made of whole pages on several CPUs at once. The
+ * submitting context takes the first chunk itself and waits for the
+ * others, so the bio still completes synchronously. Returns false when
+ * the bio does not qualify and has to go through the per-page path.
+ */
+static bool zram_batch_write(struct zram *zram, struct bio *bio,
+			     u32 index, int offset)
+{
+	unsigned int nr_pages = bio->bi_iter.bi_size >> PAGE_SHIFT;
+	unsigned int batch_pages = READ_ONCE(zram->batch_write_pages);
+	struct request_queue *q = zram->disk->queue;
+	unsigned long start_time = jiffies;
+	struct zram_batch *batch;
+	struct bio_vec bvec;
+	struct bvec_iter iter;
+	unsigned int nr_chunks, per_chunk, i, n = 0;
+	int cpu, ret = 0;
+
+	if (!batch_pages || nr_pages < batch_pages || offset ||
+	    bio_op(bio) != REQ_OP_WRITE ||
+	    (bio->bi_iter.bi_size & ~PAGE_MASK))
+		return false;
+
+	nr_chunks = min3(num_online_cpus(), nr_pages / ZRAM_BATCH_MIN_CHUNK,
+			 (unsigned int)ZRAM_BATCH_MAX_CHUNKS);
+	if (nr_chunks < 2)
+		return false;
+
+	batch = kmalloc(sizeof(*batch) + nr_pages * sizeof(struct page *),
+			GFP_NOIO | __GFP_NOWARN);
+	if (!batch)
+		return false;
+
+	bio_for_each_segment(bvec, bio, iter) {
+		if (bvec.bv_offset || bvec.bv_len != PAGE_SIZE) {
+			kfree(batch);
+			return false;
+		}
+		batch->pages[n++] = bvec.bv_page;
+	}
+
+	batch->zram = zram;
+	atomic_set(&batch->pending, nr_chunks);
+	init_completion(&batch->done);
+
+	per_chunk = DIV_ROUND_UP(nr_pages, nr_chunks);
+	for (i = 0; i < nr_chunks; i++) {
+		struct zram_batch_chunk *chunk = &batch->chunks[i];
+
+		chunk->batch = batch;
+		chunk->first = i * per_chunk;
+		chunk->index = index + chunk->first;
+		chunk->nr = min(per_chunk, nr_pages - chunk->first);
+		chunk->ret = 0;
+		INIT_WORK(&chunk->work, zram_batch_work_fn);
+	}
+
+	generic_start_io_acct(q, REQ_OP_WRITE, bio_sectors(bio),
+			&zram->disk->part0);
+	atomic64_add(nr_pages, &zram->stats.num_writes);
+	atomic64_add(nr_pages, &zram->stats.batched_writes);
+
+	cpu = raw_smp_processor_id();
+	for (i = 1; i < nr_chunks; i++) {
+		cpu = cpumask_next(cpu, cpu_online_mask);
+		if (cpu >= nr_cpu_ids)
+			cpu = cpumask_first(cpu_online_mask);
+		queue_work_on(cpu, zram_batch_wq, &batch->chunks[i].work);
+	}
+	zram_batch_write_chunk(&batch->chunks[0]);
+	wait_for_completion(&batch->done);
+
+	generic_end_io_acct(q, REQ_OP_WRITE, &zram->disk->part0, start_time);
+
+	for (i = 0; i < nr_chunks; i++) {
+		if (batch->chunks[i].ret) {
+			ret = batch->chunks[i].ret;
+			atomic64_inc(&zram->stats.failed_writes);
+		}
+	}
+	kfree(batch);
+
+	if (ret)
+		bio_io_error(bio);
+	else
+		bio_endio(bio);
+	return true;
+}
+
+static ssize_t batch_write_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n",
+			READ_ONCE(zram->batch_write_pages));
+}
+
+static ssize_t batch_write_pages_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	unsigned int val;
+
+	if (kstrtouint(buf, 10, &val))
+		return -EINVAL;
+
+	if (val && val < 2 * ZRAM_BATCH_MIN_CHUNK)
+		return -EINVAL;
+
+	WRITE_ONCE(zram->batch_write_pages, val);
+	return len;
+}
+
+static int zram_batch_init(void)
+{
+	zram_batch_wq = alloc_workqueue("zram_batch",
+			WQ_HIGHPRI | WQ_MEM_RECLAIM, 0);
+	return zram_batch_wq ? 0 : -ENOMEM;
+}
+
+static void zram_batch_exit(void)
+{
+	destroy_workqueue(zram_batch_wq);
+}
+#else
+static bool zram_batch_write(struct zram *zram, struct bio *bio,
+			     u32 index, int offset)
+{
+	return false;
+}
+static int zram_batch_init(void) { return 0; }
+static void zram_batch_exit(void) {};
+#endif
+
 static void __zram_make_request(struct zram *zram, struct bio *bio)
 {
 	int offset;
@@ -1578,6 +2442,9 @@ static void __zram_make_request(struct zram *zram, struct bio *bio)
 		break;
 	}
 
+	if (zram_batch_write(zram, bio, index, offset))
+		return;
+
 	bio_for_each_segment(bvec, bio, iter) {
 		struct bio_vec bv = bvec;
 		unsigned int unwritten = bvec.bv_len;
@@ -1714,10 +2581,21 @@ static void zram_reset_device(struct zram *zram)
 	part_stat_set_all(&zram->disk->part0, 0);
 
 	up_write(&zram->init_lock);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	cancel_work_sync(&zram->wb_ra_work);
+	/* a cancelled read-ahead never cleared its slot */
+	atomic_set(&zram->wb_ra_inflight, 0);
+#endif
 	/* I/O operation under all of CPU are done so let's free */
 	zram_meta_free(zram, disksize);
 	memset(&zram->stats, 0, sizeof(zram->stats));
 	zcomp_destroy(comp);
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram->recomp) {
+		zcomp_destroy(zram->recomp);
+		zram->recomp = NULL;
+	}
+#endif
 	reset_bdev(zram);
 }
 
@@ -1755,6 +2633,18 @@ static ssize_t disksize_store(struct device *dev,
 	}
 
 	zram->comp = comp;
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	if (zram->recomp_algorithm[0]) {
+		comp = zcomp_create(zram->recomp_algorithm);
+		if (IS_ERR(comp)) {
+			pr_err("Cannot initialise %s compressing backend\n",
+					zram->recomp_algorithm);
+			err = PTR_ERR(comp);
+			goto out_free_comp;
+		}
+		zram->recomp = comp;
+	}
+#endif
 	barrier();
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
@@ -1764,6 +2654,11 @@ static ssize_t disksize_store(struct device *dev,
 
 	return len;
 
+#ifdef CONFIG_ZRAM_MULTI_COMP
+out_free_comp:
+	zcomp_destroy(zram->comp);
+	zram->comp = NULL;
+#endif
 out_free_meta:
 	zram_meta_free(zram, disksize);
 out_unlock:
@@ -1847,11 +2742,22 @@ static DEVICE_ATTR_WO(mem_used_max);
 static DEVICE_ATTR_WO(idle);
 static DEVICE_ATTR_RW(max_comp_streams);
 static DEVICE_ATTR_RW(comp_algorithm);
+#ifdef CONFIG_ZRAM_MULTI_COMP
+static DEVICE_ATTR_RW(recomp_algorithm);
+static DEVICE_ATTR_WO(recompress);
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+static DEVICE_ATTR_RW(batch_write_pages);
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+static DEVICE_ATTR_RW(use_dedup);
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 static DEVICE_ATTR_RW(backing_dev);
 static DEVICE_ATTR_WO(writeback);
 static DEVICE_ATTR_RW(writeback_limit);
 static DEVICE_ATTR_RW(writeback_limit_enable);
+static DEVICE_ATTR_RW(writeback_ra_pages);
 #endif
 
 static struct attribute *zram_disk_attrs[] = {
@@ -1864,11 +2770,22 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_idle.attr,
 	&dev_attr_max_comp_streams.attr,
 	&dev_attr_comp_algorithm.attr,
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	&dev_attr_recomp_algorithm.attr,
+	&dev_attr_recompress.attr,
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+	&dev_attr_batch_write_pages.attr,
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	&dev_attr_use_dedup.attr,
+#endif
 #ifdef CONFIG_ZRAM_WRITEBACK
 	&dev_attr_backing_dev.attr,
 	&dev_attr_writeback.attr,
 	&dev_attr_writeback_limit.attr,
 	&dev_attr_writeback_limit_enable.attr,
+	&dev_attr_writeback_ra_pages.attr,
 #endif
 	&dev_attr_io_stat.attr,
 	&dev_attr_mm_stat.attr,
@@ -1910,6 +2827,10 @@ static int zram_add(void)
 	init_rwsem(&zram->init_lock);
 #ifdef CONFIG_ZRAM_WRITEBACK
 	spin_lock_init(&zram->wb_limit_lock);
+	INIT_WORK(&zram->wb_ra_work, zram_wb_ra_work);
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+	zram->batch_write_pages = ZRAM_BATCH_DEFAULT_PAGES;
 #endif
 	queue = blk_alloc_queue(GFP_KERNEL);
 	if (!queue) {
@@ -2111,6 +3032,7 @@ static void destroy_devices(void)
 	idr_destroy(&zram_index_idr);
 	unregister_blkdev(zram_major, "zram");
 	cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+	zram_batch_exit();
 }
 
 unsigned long zram_mlog(void)
@@ -2191,15 +3113,24 @@ static int __init zram_init(void)
 {
 	int ret;
 
+	BUILD_BUG_ON(__NR_ZRAM_PAGEFLAGS > BITS_PER_LONG);
+
+	ret = zram_batch_init();
+	if (ret)
+		return ret;
+
 	ret = cpuhp_setup_state_multi(CPUHP_ZCOMP_PREPARE, "block/zram:prepare",
 				      zcomp_cpu_up_prepare, zcomp_cpu_dead);
-	if (ret < 0)
+	if (ret < 0) {
+		zram_batch_exit();
 		return ret;
+	}
 
 	ret = class_register(&zram_control_class);
 	if (ret) {
 		pr_err("Unable to register zram-control class\n");
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		zram_batch_exit();
 		return ret;
 	}
 
@@ -2209,6 +3140,7 @@ static int __init zram_init(void)
 		pr_err("Unable to get major number\n");
 		class_unregister(&zram_control_class);
 		cpuhp_remove_multi_state(CPUHP_ZCOMP_PREPARE);
+		zram_batch_exit();
 		return -EBUSY;
 	}
 
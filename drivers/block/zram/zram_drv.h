@@ -51,6 +51,12 @@ enum zram_pageflags {
 	ZRAM_UNDER_WB,	/* page is under writeback */
 	ZRAM_HUGE,	/* Incompressible page */
 	ZRAM_IDLE,	/* not accessed page since last idle marking */
+	ZRAM_RECOMP,	/* page is compressed with the secondary algorithm */
+	ZRAM_INCOMPRESSIBLE, /* secondary algorithm did not save space */
+#ifdef CONFIG_ZRAM_DEDUP
+	/* bit 32, ZRAM_DEDUP depends on 64BIT for that */
+	ZRAM_DEDUP,	/* handle is shared through a dedup entry */
+#endif
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -67,6 +73,9 @@ struct zram_table_entry {
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	ktime_t ac_time;
 #endif
+#ifdef CONFIG_ZRAM_DEDUP
+	u32 checksum;
+#endif
 };
 
 struct zram_stats {
@@ -83,10 +92,15 @@ struct zram_stats {
 	atomic_long_t max_used_pages;	/* no. of maximum pages stored */
 	atomic64_t writestall;		/* no. of write slow paths */
 	atomic64_t miss_free;		/* no. of missed free */
+	atomic64_t recomp_pages;	/* no. of pages stored by recomp */
+	atomic64_t recomp_data_size;	/* compressed size of those pages */
+	atomic64_t batched_writes;	/* no. of pages written in batches */
+	atomic64_t dedup_saved_bytes;	/* compressed bytes shared by dedup */
 #ifdef	CONFIG_ZRAM_WRITEBACK
 	atomic64_t bd_count;		/* no. of pages in backing device */
 	atomic64_t bd_reads;		/* no. of reads from backing device */
 	atomic64_t bd_writes;		/* no. of writes from backing device */
+	atomic64_t bd_ra_pages;		/* no. of pages brought back by read-ahead */
 #endif
 };
 
@@ -109,6 +123,20 @@ struct zram {
 	 */
 	u64 disksize;	/* bytes */
 	char compressor[CRYPTO_MAX_ALG_NAME];
+#ifdef CONFIG_ZRAM_MULTI_COMP
+	/* secondary algorithm for recompression, may be empty */
+	struct zcomp *recomp;
+	char recomp_algorithm[CRYPTO_MAX_ALG_NAME];
+#endif
+#ifdef CONFIG_ZRAM_BATCH_WRITE
+	/* min. pages in a write bio to compress it on several CPUs */
+	unsigned int batch_write_pages;
+#endif
+#ifdef CONFIG_ZRAM_DEDUP
+	bool use_dedup;
+	struct zram_hash *hash;
+	size_t hash_size;
+#endif
 	/*
 	 * zram is claimed so open request will be failed
 	 */
@@ -122,6 +150,13 @@ struct zram {
 	unsigned int old_block_size;
 	unsigned long *bitmap;
 	unsigned long nr_pages;
+	/* backing device read-ahead, see zram_wb_readahead() */
+	unsigned int wb_ra_pages;
+	atomic_t wb_ra_inflight;
+	struct work_struct wb_ra_work;
+	unsigned long wb_ra_index;
+	unsigned long wb_ra_blk;
+	unsigned int wb_ra_nr;
 #endif
 #ifdef CONFIG_ZRAM_MEMORY_TRACKING
 	struct dentry *debugfs_dir;
@@ -30,6 +30,15 @@
 #include <linux/blk_types.h>
 #include <linux/module.h>
 #include <linux/vmstat.h>
+#include <linux/mm.h>
+#include <linux/log2.h>
+#include <linux/percpu.h>
+#include <linux/math64.h>
+#include <linux/hashtable.h>
+#include <linux/pid_namespace.h>
+#include <linux/cred.h>
+#include <linux/proc_fs.h>
+#include <linux/uaccess.h>
 
 #define BLOCKIO_MIN_VER	"3.09"
 
@@ -38,6 +47,7 @@
 #endif
 
 #include <mt-plat/mtk_blocktag.h>
+#include <mt-plat/mtk_io_boost.h>
 
 /*
  * snprintf may return a value of size or "more" to indicate
@@ -86,12 +96,97 @@ static struct mtk_btag_mictx_struct *mtk_btag_mictx;
 static bool mtk_btag_mictx_ready;
 static bool mtk_btag_mictx_debug;
 
+/*
+ * Throughput and request counters of the mini context are kept per CPU
+ * and folded into the window by mtk_btag_mictx_get_data(). The lock is
+ * only contended while the window is read. Queue depth and idle time
+ * stay in mtk_btag_mictx, the adapters update them under their own
+ * context lock anyway.
+ */
+struct mtk_btag_mictx_cpu {
+	spinlock_t lock;
+	struct mtk_btag_throughput tp;
+	struct mtk_btag_req req;
+	__u64 tp_min_time;
+	__u64 tp_max_time;
+};
+
+static DEFINE_PER_CPU(struct mtk_btag_mictx_cpu, mtk_btag_mictx_cpu);
+
 static void mtk_btag_init_debugfs(void);
 
 /* blocktag */
 static DEFINE_MUTEX(mtk_btag_list_lock);
 static LIST_HEAD(mtk_btag_list);
 
+/*
+ * Ring traces are kept per CPU. Producers run with local interrupts
+ * disabled and only ever touch their own CPU's ring, so no lock or cache
+ * line is shared on the I/O path. Readers merge the rings by trace time.
+ *
+ * All rings of a blocktag live in one vmalloc_user() area which user
+ * space can map read-only through debugfs "blockio_ring":
+ *
+ *   struct mtk_btag_ring_hdr
+ *   struct mtk_btag_ring_cpu[nr_cpus]	(cache line aligned)
+ *   struct mtk_btag_trace[nr_cpus][per_cpu]	(at trace_offset)
+ *
+ * A trace of sequence s on a CPU is at index (s & (per_cpu - 1)) and is
+ * valid while s is in [head - per_cpu + 1, head).
+ */
+#define MTK_BTAG_RING_MAGIC	0x47415442	/* "BTAG" */
+#define MTK_BTAG_RING_VERSION	1
+#define MTK_BTAG_RING_MIN	16
+
+struct mtk_btag_ring_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 nr_cpus;
+	__u32 per_cpu;
+	__u32 trace_size;
+	__u32 trace_offset;
+};
+
+struct mtk_btag_ring_cpu {
+	__u64 head;	/* no. of traces published by this CPU */
+	__u64 tail;	/* first sequence not cleared by a reader */
+} ____cacheline_aligned_in_smp;
+
+/*
+ * Pidlogs are staged per CPU, one logger per context, as they are
+ * updated for every mapped segment. mtk_btag_pidlog_merge() folds them
+ * into a trace; the lock is only contended while that happens.
+ */
+struct mtk_btag_pidlog_cpu {
+	spinlock_t lock;
+	struct mtk_btag_pidlogger pl[];
+};
+
+struct mtk_btag_priv {
+	struct mtk_blocktag btag;
+	void *ring;
+	size_t ring_size;
+	unsigned int per_cpu;
+	struct mtk_btag_ring_cpu *cpu;
+	struct mtk_btag_trace *trace;
+	struct dentry *dring;
+	struct mtk_btag_pidlog_cpu __percpu *pidlog;
+};
+
+static inline struct mtk_btag_priv *mtk_btag_rt_priv(
+	struct mtk_btag_ringtrace *rt)
+{
+	return container_of(container_of(rt, struct mtk_blocktag, rt),
+		struct mtk_btag_priv, btag);
+}
+
+static inline struct mtk_btag_trace *mtk_btag_ring_trace(
+	struct mtk_btag_priv *priv, int cpu, __u64 seq)
+{
+	return &priv->trace[cpu * priv->per_cpu +
+		((unsigned int)seq & (priv->per_cpu - 1))];
+}
+
 static struct mtk_blocktag *mtk_btag_find(const char *name)
 {
 	struct mtk_blocktag *btag, *n;
@@ -113,6 +208,280 @@ static struct mtk_blocktag *mtk_btag_find_locked(const char *name)
 	return btag;
 }
 
+/*
+ * Per-UID accounting
+ *
+ * The pid tagged on a page by the pid logger is resolved to a UID when
+ * the page is mapped for a request. The storage adapter picks up that
+ * UID when it queues the command and reports bytes and submit-to-
+ * completion latency when the command is done. Statistics are kept
+ * until cleared, independent of the trace windows.
+ */
+#define MTK_BTAG_UID_UNKNOWN	((uid_t)-1)
+#define MTK_BTAG_UID_MAX	512
+/* 4 sub-buckets per power of two of microseconds, 1us .. ~32s */
+#define MTK_BTAG_LAT_BUCKETS	100
+
+struct mtk_btag_uid_stat {
+	struct hlist_node node;
+	uid_t uid;
+	__u64 bytes[2];
+	__u64 reqs[2];
+	__u32 lat[2][MTK_BTAG_LAT_BUCKETS];
+};
+
+/*
+ * Binary layout of /proc/blocktag_uid: one mtk_btag_uid_hdr followed by
+ * nr_records mtk_btag_uid_record. Index 0 is read, 1 is write. Latency
+ * percentiles are the lower bound of their bucket, in microseconds.
+ */
+#define MTK_BTAG_UID_MAGIC	0x55544142	/* "BATU" */
+#define MTK_BTAG_UID_VERSION	1
+
+struct mtk_btag_uid_hdr {
+	__u32 magic;
+	__u32 version;
+	__u32 record_size;
+	__u32 nr_records;
+};
+
+struct mtk_btag_uid_record {
+	__u32 uid;
+	__u32 reserved;
+	__u64 bytes[2];
+	__u64 reqs[2];
+	__u32 p50_us[2];
+	__u32 p99_us[2];
+	__u32 p999_us[2];
+	__u32 pad;
+};
+
+static DEFINE_HASHTABLE(mtk_btag_uid_hash, 6);
+static DEFINE_SPINLOCK(mtk_btag_uid_lock);
+static unsigned int mtk_btag_uid_count;
+static DEFINE_PER_CPU(uid_t, mtk_btag_uid_mapped) = MTK_BTAG_UID_UNKNOWN;
+
+struct mtk_btag_uid_cache {
+	pid_t pid;
+	uid_t uid;
+};
+static DEFINE_PER_CPU(struct mtk_btag_uid_cache, mtk_btag_uid_cache);
+
+/* remember the owner of the ufs page being mapped on this CPU */
+static void __maybe_unused mtk_btag_uid_map(pid_t pid)
+{
+	struct mtk_btag_uid_cache *c = get_cpu_ptr(&mtk_btag_uid_cache);
+	struct task_struct *task;
+
+	if (c->pid != pid || !pid) {
+		c->pid = pid;
+		c->uid = MTK_BTAG_UID_UNKNOWN;
+
+		rcu_read_lock();
+		task = pid_task(find_pid_ns(pid, &init_pid_ns), PIDTYPE_PID);
+		if (task)
+			c->uid = from_kuid_munged(&init_user_ns,
+				task_uid(task));
+		rcu_read_unlock();
+	}
+
+	__this_cpu_write(mtk_btag_uid_mapped, c->uid);
+	put_cpu_ptr(&mtk_btag_uid_cache);
+}
+
+/* owner of the request just mapped on this CPU, called when queueing it */
+uid_t mtk_btag_uid_fetch(void)
+{
+	return this_cpu_xchg(mtk_btag_uid_mapped, MTK_BTAG_UID_UNKNOWN);
+}
+EXPORT_SYMBOL_GPL(mtk_btag_uid_fetch);
+
+static unsigned int mtk_btag_lat_bucket(__u64 latency)
+{
+	__u64 us = div_u64(latency, NSEC_PER_USEC);
+	unsigned int msb, idx;
+
+	if (us < 4)
+		return us;
+
+	msb = fls64(us) - 1;
+	idx = (msb - 1) * 4 + ((us >> (msb - 2)) & 3);
+
+	return min_t(unsigned int, idx, MTK_BTAG_LAT_BUCKETS - 1);
+}
+
+static __u32 mtk_btag_lat_bucket_us(unsigned int idx)
+{
+	if (idx < 4)
+		return idx;
+
+	return (4 + (idx & 3)) << (idx / 4 - 1);
+}
+
+static struct mtk_btag_uid_stat *mtk_btag_uid_get(uid_t uid)
+{
+	struct mtk_btag_uid_stat *st;
+
+	hash_for_each_possible(mtk_btag_uid_hash, st, node, uid)
+		if (st->uid == uid)
+			return st;
+
+	/* fold new apps into the unknown bucket once the table is full */
+	if (mtk_btag_uid_count >= MTK_BTAG_UID_MAX &&
+	    uid != MTK_BTAG_UID_UNKNOWN)
+		return mtk_btag_uid_get(MTK_BTAG_UID_UNKNOWN);
+
+	st = kzalloc(sizeof(*st), GFP_ATOMIC);
+	if (!st)
+		return NULL;
+
+	st->uid = uid;
+	hash_add(mtk_btag_uid_hash, &st->node, uid);
+	mtk_btag_uid_count++;
+	return st;
+}
+
+/* account one completed request, @latency in ns, may run in IRQ context */
+void mtk_btag_uid_account(uid_t uid, int write, __u32 size, __u64 latency)
+{
+	struct mtk_btag_uid_stat *st;
+	unsigned long flags;
+
+	write = !!write;
+
+	spin_lock_irqsave(&mtk_btag_uid_lock, flags);
+	st = mtk_btag_uid_get(uid);
+	if (st) {
+		st->bytes[write] += size;
+		st->reqs[write]++;
+		st->lat[write][mtk_btag_lat_bucket(latency)]++;
+	}
+	spin_unlock_irqrestore(&mtk_btag_uid_lock, flags);
+}
+EXPORT_SYMBOL_GPL(mtk_btag_uid_account);
+
+static __u32 mtk_btag_lat_percentile(__u32 *lat, __u64 total,
+	unsigned int permille)
+{
+	__u64 target = div_u64(total * permille + 999, 1000);
+	__u64 sum = 0;
+	unsigned int i;
+
+	if (!total)
+		return 0;
+
+	for (i = 0; i < MTK_BTAG_LAT_BUCKETS; i++) {
+		sum += lat[i];
+		if (sum >= target)
+			break;
+	}
+
+	return mtk_btag_lat_bucket_us(min_t(unsigned int, i,
+		MTK_BTAG_LAT_BUCKETS - 1));
+}
+
+struct mtk_btag_uid_snapshot {
+	size_t size;
+	char data[];
+};
+
+static int mtk_btag_uid_open(struct inode *inode, struct file *file)
+{
+	struct mtk_btag_uid_snapshot *snap;
+	struct mtk_btag_uid_record *rec;
+	struct mtk_btag_uid_hdr *hdr;
+	struct mtk_btag_uid_stat *st;
+	unsigned long flags;
+	unsigned int bkt, n = 0, max;
+	int i;
+
+	/* the table can only grow to MTK_BTAG_UID_MAX + the unknown bucket */
+	max = MTK_BTAG_UID_MAX + 1;
+	snap = kvzalloc(sizeof(*snap) + sizeof(*hdr) + max * sizeof(*rec),
+		GFP_KERNEL);
+	if (!snap)
+		return -ENOMEM;
+
+	hdr = (struct mtk_btag_uid_hdr *)snap->data;
+	rec = (struct mtk_btag_uid_record *)(hdr + 1);
+
+	spin_lock_irqsave(&mtk_btag_uid_lock, flags);
+	hash_for_each(mtk_btag_uid_hash, bkt, st, node) {
+		if (n >= max)
+			break;
+		rec[n].uid = st->uid;
+		for (i = 0; i < 2; i++) {
+			rec[n].bytes[i] = st->bytes[i];
+			rec[n].reqs[i] = st->reqs[i];
+			rec[n].p50_us[i] = mtk_btag_lat_percentile(st->lat[i],
+				st->reqs[i], 500);
+			rec[n].p99_us[i] = mtk_btag_lat_percentile(st->lat[i],
+				st->reqs[i], 990);
+			rec[n].p999_us[i] = mtk_btag_lat_percentile(st->lat[i],
+				st->reqs[i], 999);
+		}
+		n++;
+	}
+	spin_unlock_irqrestore(&mtk_btag_uid_lock, flags);
+
+	hdr->magic = MTK_BTAG_UID_MAGIC;
+	hdr->version = MTK_BTAG_UID_VERSION;
+	hdr->record_size = sizeof(*rec);
+	hdr->nr_records = n;
+	snap->size = sizeof(*hdr) + n * sizeof(*rec);
+
+	file->private_data = snap;
+	return 0;
+}
+
+static ssize_t mtk_btag_uid_read(struct file *file, char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	struct mtk_btag_uid_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(ubuf, count, ppos, snap->data,
+		snap->size);
+}
+
+/* any write clears the statistics */
+static ssize_t mtk_btag_uid_write(struct file *file, const char __user *ubuf,
+	size_t count, loff_t *ppos)
+{
+	struct mtk_btag_uid_stat *st;
+	struct hlist_node *tmp;
+	unsigned long flags;
+	unsigned int bkt;
+	HLIST_HEAD(free_list);
+
+	spin_lock_irqsave(&mtk_btag_uid_lock, flags);
+	hash_for_each_safe(mtk_btag_uid_hash, bkt, tmp, st, node) {
+		hash_del(&st->node);
+		hlist_add_head(&st->node, &free_list);
+	}
+	mtk_btag_uid_count = 0;
+	spin_unlock_irqrestore(&mtk_btag_uid_lock, flags);
+
+	hlist_for_each_entry_safe(st, tmp, &free_list, node)
+		kfree(st);
+
+	return count;
+}
+
+static int mtk_btag_uid_release(struct inode *inode, struct file *file)
+{
+	kvfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations mtk_btag_uid_fops = {
+	.owner		= THIS_MODULE,
+	.open		= mtk_btag_uid_open,
+	.read		= mtk_btag_uid_read,
+	.write		= mtk_btag_uid_write,
+	.llseek		= default_llseek,
+	.release	= mtk_btag_uid_release,
+};
+
 /* pid logger: page loger*/
 unsigned long long mtk_btag_system_dram_size;
 struct page_pid_logger *mtk_btag_pagelogger;
@@ -169,6 +538,8 @@ static void mtk_btag_pidlog_add(struct request_queue *q, struct bio *bio,
 	if (pid != 0xFFFF && major) {
 #ifdef CONFIG_MTK_UFS_BLOCK_IO_LOG
 		if (major == SCSI_DISK0_MAJOR || major == BLOCK_EXT_MAJOR) {
+			/* only ufs fetches the owner when queueing */
+			mtk_btag_uid_map(pid);
 			mtk_btag_pidlog_add_ufs(q, pid, len, write);
 			return;
 		}
@@ -257,6 +628,9 @@ void mtk_btag_pidlog_submit_bio(struct bio *bio)
 	struct bio_vec bvec;
 	struct bvec_iter iter;
 
+	/* tag foreground I/O while still in the submitter's context */
+	mtk_iobst_submit_bio(bio);
+
 	if (!mtk_btag_pagelogger)
 		return;
 
@@ -346,6 +720,81 @@ void mtk_btag_pidlog_eval(struct mtk_btag_pidlogger *pl,
 }
 EXPORT_SYMBOL_GPL(mtk_btag_pidlog_eval);
 
+/* append a pidlog to context @idx of @btag on this CPU */
+void mtk_btag_pidlog_stage(struct mtk_blocktag *btag, unsigned int idx,
+	pid_t pid, __u32 len, int write)
+{
+	struct mtk_btag_pidlog_cpu *pc;
+	struct mtk_btag_priv *priv;
+	unsigned long flags;
+
+	if (!btag || idx >= btag->ctx.count)
+		return;
+
+	priv = container_of(btag, struct mtk_btag_priv, btag);
+	local_irq_save(flags);
+	pc = this_cpu_ptr(priv->pidlog);
+	spin_lock(&pc->lock);
+	mtk_btag_pidlog_insert(&pc->pl[idx], pid, len, write);
+	spin_unlock(&pc->lock);
+	local_irq_restore(flags);
+}
+EXPORT_SYMBOL_GPL(mtk_btag_pidlog_stage);
+
+static void mtk_btag_pidlog_fold(struct mtk_btag_pidlogger *pl,
+	struct mtk_btag_pidlogger_entry *src)
+{
+	struct mtk_btag_pidlogger_entry *pe;
+	int i;
+
+	for (i = 0; i < BLOCKTAG_PIDLOG_ENTRIES; i++) {
+		pe = &pl->info[i];
+		if ((pe->pid == src->pid) || (pe->pid == 0)) {
+			pe->pid = src->pid;
+			pe->r.count += src->r.count;
+			pe->r.length += src->r.length;
+			pe->w.count += src->w.count;
+			pe->w.length += src->w.length;
+			break;
+		}
+	}
+}
+
+/* evaluate pidlog trace from the staged pidlogs of context @idx */
+void mtk_btag_pidlog_merge(struct mtk_btag_pidlogger *pl,
+	struct mtk_blocktag *btag, unsigned int idx)
+{
+	struct mtk_btag_pidlog_cpu *pc;
+	struct mtk_btag_pidlogger *cpl;
+	struct mtk_btag_priv *priv;
+	unsigned long flags;
+	int cpu, i;
+
+	if (!btag || idx >= btag->ctx.count)
+		return;
+
+	priv = container_of(btag, struct mtk_btag_priv, btag);
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(priv->pidlog, cpu);
+		cpl = &pc->pl[idx];
+
+		spin_lock_irqsave(&pc->lock, flags);
+		for (i = 0; i < BLOCKTAG_PIDLOG_ENTRIES; i++) {
+			if (cpl->info[i].pid == 0)
+				break;
+			mtk_btag_pidlog_fold(pl, &cpl->info[i]);
+		}
+		if (i != 0)
+			memset(&cpl->info[0], 0,
+				i * sizeof(struct mtk_btag_pidlogger_entry));
+		spin_unlock_irqrestore(&pc->lock, flags);
+	}
+
+	if (mtk_btag_mictx_debug)
+		mtk_btag_mictx_dump();
+}
+EXPORT_SYMBOL_GPL(mtk_btag_pidlog_merge);
+
 static __u64 mtk_btag_cpu_idle_time(int cpu)
 {
 	u64 idle, idle_usecs = -1ULL;
@@ -666,63 +1115,120 @@ static void mtk_btag_seq_trace(char **buff, unsigned long *size,
 	SPREAD_PRINTF(buff, size, seq, ".\n");
 }
 
-/* get current trace in debugfs ring buffer */
+/*
+ * get current trace in this CPU's ring buffer, must be called with local
+ * interrupts disabled until mtk_btag_next_trace() publishes it
+ */
 struct mtk_btag_trace *mtk_btag_curr_trace(struct mtk_btag_ringtrace *rt)
 {
-	if (rt)
-		return &rt->trace[rt->index];
-	else
+	struct mtk_btag_priv *priv;
+	int cpu;
+
+	if (!rt)
 		return NULL;
+
+	priv = mtk_btag_rt_priv(rt);
+	cpu = smp_processor_id();
+	return mtk_btag_ring_trace(priv, cpu, priv->cpu[cpu].head);
 }
 EXPORT_SYMBOL_GPL(mtk_btag_curr_trace);
 
-/* step to next trace in debugfs ring buffer */
+/* publish current trace and step to next one in this CPU's ring buffer */
 struct mtk_btag_trace *mtk_btag_next_trace(struct mtk_btag_ringtrace *rt)
 {
-	rt->index++;
-	if (rt->index >= rt->max)
-		rt->index = 0;
+	struct mtk_btag_ring_cpu *rc;
+
+	rc = &mtk_btag_rt_priv(rt)->cpu[smp_processor_id()];
+
+	/* trace content must be visible before the new head */
+	smp_wmb();
+	WRITE_ONCE(rc->head, rc->head + 1);
 
 	return mtk_btag_curr_trace(rt);
 }
 EXPORT_SYMBOL_GPL(mtk_btag_next_trace);
 
-/* clear debugfs ring buffer */
+/* clear debugfs ring buffer, producers are left untouched */
 static void mtk_btag_clear_trace(struct mtk_btag_ringtrace *rt)
 {
-	unsigned long flags;
+	struct mtk_btag_priv *priv = mtk_btag_rt_priv(rt);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		WRITE_ONCE(priv->cpu[cpu].tail, READ_ONCE(priv->cpu[cpu].head));
+}
+
+/* oldest sequence of @cpu's ring that may still be read */
+static __u64 mtk_btag_ring_first(struct mtk_btag_priv *priv, int cpu,
+	__u64 head)
+{
+	__u64 first = READ_ONCE(priv->cpu[cpu].tail);
+
+	if (head >= priv->per_cpu && first < head - priv->per_cpu + 1)
+		first = head - priv->per_cpu + 1;
 
-	spin_lock_irqsave(&rt->lock, flags);
-	memset(rt->trace, 0, (sizeof(struct mtk_btag_trace) * rt->max));
-	rt->index = 0;
-	spin_unlock_irqrestore(&rt->lock, flags);
+	return first;
 }
 
+/*
+ * Merge the per-CPU rings oldest first. Each trace is copied out and
+ * dropped if its producer may have overwritten it meanwhile.
+ */
 static void mtk_btag_seq_debug_show_ringtrace(char **buff, unsigned long *size,
 	struct seq_file *seq, struct mtk_blocktag *btag)
 {
 	struct mtk_btag_ringtrace *rt = BTAG_RT(btag);
-	unsigned long flags;
-	int i, end;
+	struct mtk_btag_priv *priv;
+	struct mtk_btag_trace tr;
+	__u64 *pos, *end;
+	int cpu;
 
 	if (!rt)
 		return;
 
-	if (rt->index >= rt->max || rt->index < 0)
-		rt->index = 0;
+	priv = mtk_btag_rt_priv(rt);
 
 	SPREAD_PRINTF(buff, size, seq, "<%s: blocktag trace %s>\n",
 		btag->name, BLOCKIO_MIN_VER);
 
-	spin_lock_irqsave(&rt->lock, flags);
-	end = (rt->index > 0) ? rt->index-1 : rt->max-1;
-	for (i = rt->index;;) {
-		mtk_btag_seq_trace(buff, size, seq, btag->name, &rt->trace[i]);
-		if (i == end)
+	pos = kcalloc(2 * nr_cpu_ids, sizeof(__u64), GFP_ATOMIC);
+	if (!pos)
+		return;
+	end = pos + nr_cpu_ids;
+
+	for_each_possible_cpu(cpu) {
+		end[cpu] = READ_ONCE(priv->cpu[cpu].head);
+		pos[cpu] = mtk_btag_ring_first(priv, cpu, end[cpu]);
+	}
+	smp_rmb();
+
+	for (;;) {
+		struct mtk_btag_trace *t;
+		__u64 best_time = U64_MAX;
+		int best = -1;
+
+		for_each_possible_cpu(cpu) {
+			if (pos[cpu] >= end[cpu])
+				continue;
+			t = mtk_btag_ring_trace(priv, cpu, pos[cpu]);
+			if (READ_ONCE(t->time) < best_time) {
+				best_time = READ_ONCE(t->time);
+				best = cpu;
+			}
+		}
+		if (best < 0)
 			break;
-		i = (i >= rt->max-1) ? 0 : i+1;
-	};
-	spin_unlock_irqrestore(&rt->lock, flags);
+
+		memcpy(&tr, mtk_btag_ring_trace(priv, best, pos[best]),
+			sizeof(tr));
+		smp_rmb();
+		if (pos[best] >= mtk_btag_ring_first(priv, best,
+			READ_ONCE(priv->cpu[best].head)))
+			mtk_btag_seq_trace(buff, size, seq, btag->name, &tr);
+		pos[best]++;
+	}
+
+	kfree(pos);
 }
 
 
@@ -738,10 +1244,11 @@ static size_t mtk_btag_seq_sub_show_usedmem(char **buff, unsigned long *size,
 	used_mem += sizeof(struct mtk_blocktag);
 
 	if (BTAG_RT(btag)) {
-		size_l = (sizeof(struct mtk_btag_trace) * BTAG_RT(btag)->max);
+		size_l = mtk_btag_rt_priv(BTAG_RT(btag))->ring_size;
 		SPREAD_PRINTF(buff, size, seq,
-		"%s debug ring buffer: %d traces * %zu = %zu bytes\n",
+		"%s debug ring buffer: %u cpus * %d traces * %zu = %zu bytes\n",
 			btag->name,
+			nr_cpu_ids,
 			BTAG_RT(btag)->max,
 			sizeof(struct mtk_btag_trace),
 			size_l);
@@ -939,11 +1446,65 @@ static const struct file_operations mtk_btag_mictx_sub_fops = {
 	.write		= mtk_btag_mictx_sub_write,
 };
 
+static int mtk_btag_ring_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct mtk_btag_priv *priv = file->private_data;
+
+	if (vma->vm_flags & VM_WRITE)
+		return -EPERM;
+	vma->vm_flags &= ~VM_MAYWRITE;
+
+	return remap_vmalloc_range(vma, priv->ring, vma->vm_pgoff);
+}
+
+static const struct file_operations mtk_btag_ring_fops = {
+	.owner		= THIS_MODULE,
+	.open		= simple_open,
+	.mmap		= mtk_btag_ring_mmap,
+	.llseek		= no_llseek,
+};
+
+static int mtk_btag_ring_alloc(struct mtk_btag_priv *priv,
+	unsigned int ringtrace_count)
+{
+	struct mtk_btag_ring_hdr *hdr;
+	size_t cpu_offset, trace_offset;
+
+	priv->per_cpu = max_t(unsigned int, MTK_BTAG_RING_MIN,
+		rounddown_pow_of_two(DIV_ROUND_UP(ringtrace_count,
+			nr_cpu_ids)));
+
+	cpu_offset = ALIGN(sizeof(*hdr), SMP_CACHE_BYTES);
+	trace_offset = PAGE_ALIGN(cpu_offset +
+		nr_cpu_ids * sizeof(struct mtk_btag_ring_cpu));
+	priv->ring_size = PAGE_ALIGN(trace_offset + (size_t)nr_cpu_ids *
+		priv->per_cpu * sizeof(struct mtk_btag_trace));
+
+	priv->ring = vmalloc_user(priv->ring_size);
+	if (!priv->ring)
+		return -ENOMEM;
+
+	hdr = priv->ring;
+	hdr->magic = MTK_BTAG_RING_MAGIC;
+	hdr->version = MTK_BTAG_RING_VERSION;
+	hdr->nr_cpus = nr_cpu_ids;
+	hdr->per_cpu = priv->per_cpu;
+	hdr->trace_size = sizeof(struct mtk_btag_trace);
+	hdr->trace_offset = trace_offset;
+
+	priv->cpu = priv->ring + cpu_offset;
+	priv->trace = priv->ring + trace_offset;
+	return 0;
+}
+
 struct mtk_blocktag *mtk_btag_alloc(const char *name,
 	unsigned int ringtrace_count, size_t ctx_size, unsigned int ctx_count,
 	mtk_btag_seq_f seq_show)
 {
+	struct mtk_btag_priv *priv;
 	struct mtk_blocktag *btag;
+	size_t pidlog_size;
+	int cpu;
 
 	if (!name || !ringtrace_count || !ctx_size || !ctx_count)
 		return NULL;
@@ -955,38 +1516,47 @@ struct mtk_blocktag *mtk_btag_alloc(const char *name,
 		return NULL;
 	}
 
-	btag = kmalloc(sizeof(struct mtk_blocktag), GFP_NOFS);
-	if (!btag)
+	priv = kzalloc(sizeof(struct mtk_btag_priv), GFP_NOFS);
+	if (!priv)
 		return NULL;
 
-	memset(btag, 0, sizeof(struct mtk_blocktag));
+	btag = &priv->btag;
 	btag->seq_show = seq_show;
-	btag->used_mem = sizeof(struct mtk_blocktag) +
-		(sizeof(struct mtk_btag_trace) * ringtrace_count) +
-		(ctx_count * ctx_size);
 
-	/* ringtrace */
+	/* ringtrace: per-CPU rings, see mtk_btag_ring_hdr */
+	if (mtk_btag_ring_alloc(priv, ringtrace_count)) {
+		kfree(priv);
+		return NULL;
+	}
 	btag->rt.index = 0;
-	btag->rt.max = ringtrace_count;
+	btag->rt.max = priv->per_cpu;
+	btag->rt.trace = priv->trace;
 	spin_lock_init(&btag->rt.lock);
-	btag->rt.trace = kmalloc_array(ringtrace_count,
-		sizeof(struct mtk_btag_trace), GFP_NOFS);
-	if (!btag->rt.trace) {
-		kfree(btag);
+	strncpy(btag->name, name, BLOCKTAG_NAME_LEN-1);
+
+	/* pidlog: per-CPU staging, one logger per context */
+	pidlog_size = sizeof(struct mtk_btag_pidlog_cpu) +
+		ctx_count * sizeof(struct mtk_btag_pidlogger);
+	priv->pidlog = __alloc_percpu(pidlog_size, SMP_CACHE_BYTES);
+	if (!priv->pidlog) {
+		vfree(priv->ring);
+		kfree(priv);
 		return NULL;
 	}
-	memset(btag->rt.trace, 0,
-		(sizeof(struct mtk_btag_trace) * ringtrace_count));
-	strncpy(btag->name, name, BLOCKTAG_NAME_LEN-1);
-	spin_lock_init(&btag->rt.lock);
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(priv->pidlog, cpu)->lock);
+
+	btag->used_mem = sizeof(struct mtk_btag_priv) + priv->ring_size +
+		(ctx_count * ctx_size) + nr_cpu_ids * pidlog_size;
 
 	/* context */
 	btag->ctx.count = ctx_count;
 	btag->ctx.size = ctx_size;
 	btag->ctx.priv = kmalloc_array(ctx_count, ctx_size, GFP_NOFS);
 	if (!btag->ctx.priv) {
-		kfree(btag->rt.trace);
-		kfree(btag);
+		free_percpu(priv->pidlog);
+		vfree(priv->ring);
+		kfree(priv);
 		return NULL;
 	}
 	memset(btag->ctx.priv, 0, ctx_size * ctx_count);
@@ -1029,6 +1599,13 @@ struct mtk_blocktag *mtk_btag_alloc(const char *name,
 		pr_info("[BLOCK_TAG] %s: fail to create blockio_mictx at debugfs\n",
 			name);
 
+	priv->dring = debugfs_create_file("blockio_ring", S_IFREG | 0440,
+		btag->dentry.droot, priv, &mtk_btag_ring_fops);
+
+	if (IS_ERR(priv->dring))
+		pr_info("[BLOCK_TAG] %s: fail to create blockio_ring at debugfs\n",
+			name);
+
 out:
 	spin_lock_init(&btag->prbuf.lock);
 	list_add(&btag->list, &mtk_btag_list);
@@ -1039,14 +1616,18 @@ EXPORT_SYMBOL_GPL(mtk_btag_alloc);
 
 void mtk_btag_free(struct mtk_blocktag *btag)
 {
+	struct mtk_btag_priv *priv;
+
 	if (!btag)
 		return;
 
+	priv = container_of(btag, struct mtk_btag_priv, btag);
 	list_del(&btag->list);
 	debugfs_remove_recursive(btag->dentry.droot);
 	kfree(btag->ctx.priv);
-	kfree(btag->rt.trace);
-	kfree(btag);
+	free_percpu(priv->pidlog);
+	vfree(priv->ring);
+	kfree(priv);
 }
 EXPORT_SYMBOL_GPL(mtk_btag_free);
 
@@ -1188,49 +1769,54 @@ struct mtk_btag_mictx_struct *mtk_btag_mictx_get_ctx(void)
 void mtk_btag_mictx_eval_tp(
 	unsigned int write, __u64 usage, __u32 size)
 {
-	struct mtk_btag_mictx_struct *ctx;
+	struct mtk_btag_mictx_cpu *pc;
 	struct mtk_btag_throughput_rw *tprw;
 	unsigned long flags;
 	__u64 cur_time = sched_clock();
 	__u64 req_begin_time;
 
-	ctx = mtk_btag_mictx_get_ctx();
-	if (!ctx)
+	if (!mtk_btag_mictx_get_ctx())
 		return;
 
-	tprw = (write) ? &ctx->tp.w : &ctx->tp.r;
-	spin_lock_irqsave(&ctx->lock, flags);
+	local_irq_save(flags);
+	pc = this_cpu_ptr(&mtk_btag_mictx_cpu);
+	tprw = (write) ? &pc->tp.w : &pc->tp.r;
+	spin_lock(&pc->lock);
 	tprw->size += size;
 	tprw->usage += usage;
 
-	ctx->tp_max_time = cur_time;
+	if (cur_time > pc->tp_max_time)
+		pc->tp_max_time = cur_time;
 	req_begin_time = cur_time - usage;
 
-	if (!ctx->tp_min_time)
-		ctx->tp_min_time = req_begin_time;
+	if (!pc->tp_min_time)
+		pc->tp_min_time = req_begin_time;
 	else {
-		if (req_begin_time < ctx->tp_min_time)
-			ctx->tp_min_time = req_begin_time;
+		if (req_begin_time < pc->tp_min_time)
+			pc->tp_min_time = req_begin_time;
 	}
-	spin_unlock_irqrestore(&ctx->lock, flags);
+	spin_unlock(&pc->lock);
+	local_irq_restore(flags);
 }
 
 void mtk_btag_mictx_eval_req(
 	unsigned int write, __u32 cnt, __u32 size)
 {
-	struct mtk_btag_mictx_struct *ctx;
+	struct mtk_btag_mictx_cpu *pc;
 	struct mtk_btag_req_rw *reqrw;
 	unsigned long flags;
 
-	ctx = mtk_btag_mictx_get_ctx();
-	if (!ctx)
+	if (!mtk_btag_mictx_get_ctx())
 		return;
 
-	reqrw = (write) ? &ctx->req.w : &ctx->req.r;
-	spin_lock_irqsave(&ctx->lock, flags);
+	local_irq_save(flags);
+	pc = this_cpu_ptr(&mtk_btag_mictx_cpu);
+	reqrw = (write) ? &pc->req.w : &pc->req.r;
+	spin_lock(&pc->lock);
 	reqrw->count += cnt;
 	reqrw->size += size;
-	spin_unlock_irqrestore(&ctx->lock, flags);
+	spin_unlock(&pc->lock);
+	local_irq_restore(flags);
 }
 
 void mtk_btag_mictx_update_ctx(
@@ -1277,6 +1863,39 @@ static void mtk_btag_mictx_reset(
 	memset(&ctx->req, 0, sizeof(struct mtk_btag_req));
 }
 
+/* move the per-CPU counters into @ctx and restart them */
+static void mtk_btag_mictx_fold(struct mtk_btag_mictx_struct *ctx)
+{
+	struct mtk_btag_mictx_cpu *pc;
+	unsigned long flags;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		pc = per_cpu_ptr(&mtk_btag_mictx_cpu, cpu);
+
+		spin_lock_irqsave(&pc->lock, flags);
+		ctx->tp.r.size += pc->tp.r.size;
+		ctx->tp.r.usage += pc->tp.r.usage;
+		ctx->tp.w.size += pc->tp.w.size;
+		ctx->tp.w.usage += pc->tp.w.usage;
+		ctx->req.r.count += pc->req.r.count;
+		ctx->req.r.size += pc->req.r.size;
+		ctx->req.w.count += pc->req.w.count;
+		ctx->req.w.size += pc->req.w.size;
+
+		if (pc->tp_max_time > ctx->tp_max_time)
+			ctx->tp_max_time = pc->tp_max_time;
+		if (pc->tp_min_time && (!ctx->tp_min_time ||
+			pc->tp_min_time < ctx->tp_min_time))
+			ctx->tp_min_time = pc->tp_min_time;
+
+		memset(&pc->tp, 0, sizeof(struct mtk_btag_throughput));
+		memset(&pc->req, 0, sizeof(struct mtk_btag_req));
+		pc->tp_min_time = pc->tp_max_time = 0;
+		spin_unlock_irqrestore(&pc->lock, flags);
+	}
+}
+
 int mtk_btag_mictx_get_data(
 	struct mtk_btag_mictx_iostat_struct *iostat)
 {
@@ -1290,6 +1909,7 @@ int mtk_btag_mictx_get_data(
 
 	spin_lock_irqsave(&ctx->lock, flags);
 
+	mtk_btag_mictx_fold(ctx);
 	time_cur = sched_clock();
 	dur = time_cur - ctx->window_begin;
 
@@ -1347,6 +1967,8 @@ void mtk_btag_mictx_enable(int enable)
 		}
 
 		spin_lock_init(&mtk_btag_mictx->lock);
+		/* drop counts left from an earlier window */
+		mtk_btag_mictx_fold(mtk_btag_mictx);
 		mtk_btag_mictx_reset(mtk_btag_mictx, 0);
 		mtk_btag_mictx_ready = 1;
 
@@ -1362,8 +1984,14 @@ void mtk_btag_mictx_enable(int enable)
 
 static int __init mtk_btag_init(void)
 {
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu_ptr(&mtk_btag_mictx_cpu, cpu)->lock);
 	mtk_btag_pidlogger_init();
 	mtk_btag_init_debugfs();
+	if (!proc_create("blocktag_uid", 0660, NULL, &mtk_btag_uid_fops))
+		pr_info("[BLOCK_TAG] fail to create /proc/blocktag_uid\n");
 	return 0;
 }
 
@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+/*
+ * Microbenchmark of the blocktag per-request accounting
+ *
+ * Writing a duration in ms to debugfs blocktag/bench runs one writer
+ * thread per online cpu. For every 4KB request a writer stages a pidlog
+ * and counts it in the mini context as the UFS/eMMC adapters do when a
+ * request is mapped and completed. One reader merges the pidlogs and
+ * reads the mini context every ms, as the trace timer and the perf
+ * service do. Reading the file shows the cost per request and the share
+ * of one cpu it takes at 100k IOPS.
+ *
+ * The mini context is enabled for the run and left enabled, the reader
+ * consumes the windows of real pollers while it runs.
+ */
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/delay.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+
+#include <mt-plat/mtk_blocktag.h>
+
+#define BENCH_MAX_MS	10000
+#define BENCH_REQ_SIZE	4096
+
+/* per-CPU pidlog staging, provided by blocktag core */
+void mtk_btag_pidlog_stage(struct mtk_blocktag *btag, unsigned int idx,
+	pid_t pid, __u32 len, int write);
+void mtk_btag_pidlog_merge(struct mtk_btag_pidlogger *pl,
+	struct mtk_blocktag *btag, unsigned int idx);
+
+struct bench_res {
+	u64 calls;
+	u64 ns;
+	u64 max_ns;
+};
+
+static DEFINE_PER_CPU(struct bench_res, bench_writer);
+static struct bench_res bench_reader;
+static struct mtk_blocktag *bench_btag;
+static unsigned int bench_ms;
+static bool bench_done;
+
+static DEFINE_MUTEX(bench_mutex);
+static atomic_t bench_running;
+static DECLARE_COMPLETION(bench_finished);
+static unsigned long bench_end;
+
+static inline void bench_account(struct bench_res *res, u64 start)
+{
+	u64 delta = sched_clock() - start;
+
+	res->calls++;
+	res->ns += delta;
+	if (delta > res->max_ns)
+		res->max_ns = delta;
+}
+
+static void bench_thread_done(void)
+{
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_finished);
+}
+
+static int bench_writer_fn(void *data)
+{
+	int cpu = (long)data;
+	struct bench_res *res = &per_cpu(bench_writer, cpu);
+	unsigned int n = 0;
+	int write;
+	u64 start;
+
+	while (time_before(jiffies, bench_end)) {
+		write = n++ & 1;
+		start = sched_clock();
+		/* mapped: mtk_btag_pidlog_add_{ufs,mmc}() */
+		mtk_btag_pidlog_stage(bench_btag, 0, current->pid,
+			BENCH_REQ_SIZE, write);
+		mtk_btag_mictx_eval_req(write, 1, BENCH_REQ_SIZE);
+		/* completed: the adapters' done handlers */
+		mtk_btag_mictx_eval_tp(write, 100000, BENCH_REQ_SIZE);
+		bench_account(res, start);
+		cond_resched();
+	}
+
+	bench_thread_done();
+	return 0;
+}
+
+static int bench_reader_fn(void *data)
+{
+	struct mtk_btag_mictx_iostat_struct iostat;
+	struct mtk_btag_pidlogger pl;
+	u64 start;
+
+	while (time_before(jiffies, bench_end)) {
+		memset(&pl, 0, sizeof(pl));
+		start = sched_clock();
+		mtk_btag_pidlog_merge(&pl, bench_btag, 0);
+		mtk_btag_mictx_get_data(&iostat);
+		bench_account(&bench_reader, start);
+		usleep_range(1000, 1100);
+	}
+
+	bench_thread_done();
+	return 0;
+}
+
+static int bench_run(unsigned int ms)
+{
+	struct task_struct *tsk;
+	int cpu, ret = 0;
+
+	if (!bench_btag) {
+		bench_btag = mtk_btag_alloc("bench", 1, sizeof(long), 1, NULL);
+		if (!bench_btag)
+			return -ENOMEM;
+	}
+	mtk_btag_mictx_enable(1);
+
+	get_online_cpus();
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(bench_writer, cpu), 0, sizeof(struct bench_res));
+	memset(&bench_reader, 0, sizeof(bench_reader));
+	reinit_completion(&bench_finished);
+	/* held by us until every thread was started */
+	atomic_set(&bench_running, 1);
+	bench_end = jiffies + msecs_to_jiffies(ms);
+
+	for_each_online_cpu(cpu) {
+		tsk = kthread_create_on_node(bench_writer_fn, (void *)(long)cpu,
+				cpu_to_node(cpu), "btag_bench/%d", cpu);
+		if (IS_ERR(tsk)) {
+			ret = PTR_ERR(tsk);
+			break;
+		}
+		kthread_bind(tsk, cpu);
+		atomic_inc(&bench_running);
+		wake_up_process(tsk);
+	}
+
+	if (!ret) {
+		tsk = kthread_run(bench_reader_fn, NULL, "btag_bench_rd");
+		if (IS_ERR(tsk))
+			ret = PTR_ERR(tsk);
+		else
+			atomic_inc(&bench_running);
+	}
+
+	bench_thread_done();
+	wait_for_completion(&bench_finished);
+	put_online_cpus();
+
+	bench_ms = ms;
+	bench_done = !ret;
+
+	return ret;
+}
+
+static void bench_show_res(struct seq_file *m, const char *name,
+			   struct bench_res *res)
+{
+	u64 avg = res->calls ? div64_u64(res->ns, res->calls) : 0;
+
+	/* avg_ns * 100k / 1s, in hundredths of a percent */
+	seq_printf(m, "%s: calls=%llu avg_ns=%llu max_ns=%llu cpu_at_100k_iops=%llu.%02llu%%\n",
+		   name, res->calls, avg, res->max_ns, div64_u64(avg, 100),
+		   avg % 100);
+}
+
+static int bench_show(struct seq_file *m, void *v)
+{
+	char name[16];
+	int cpu;
+
+	mutex_lock(&bench_mutex);
+	if (!bench_done) {
+		seq_puts(m, "echo <ms> to run\n");
+		goto out;
+	}
+
+	seq_printf(m, "duration_ms: %u\n", bench_ms);
+	for_each_possible_cpu(cpu) {
+		if (!per_cpu(bench_writer, cpu).calls)
+			continue;
+		snprintf(name, sizeof(name), "writer%d", cpu);
+		bench_show_res(m, name, &per_cpu(bench_writer, cpu));
+	}
+	seq_printf(m, "reader: calls=%llu avg_ns=%llu max_ns=%llu\n",
+		   bench_reader.calls, bench_reader.calls ?
+		   div64_u64(bench_reader.ns, bench_reader.calls) : 0,
+		   bench_reader.max_ns);
+out:
+	mutex_unlock(&bench_mutex);
+
+	return 0;
+}
+
+static int bench_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, bench_show, NULL);
+}
+
+static ssize_t bench_write(struct file *filp, const char __user *ubuf,
+			   size_t cnt, loff_t *ppos)
+{
+	unsigned int ms;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, cnt, 0, &ms);
+	if (ret)
+		return ret;
+	if (!ms || ms > BENCH_MAX_MS)
+		return -EINVAL;
+
+	mutex_lock(&bench_mutex);
+	ret = bench_run(ms);
+	mutex_unlock(&bench_mutex);
+
+	return ret ? ret : cnt;
+}
+
+static const struct file_operations bench_fops = {
+	.open		= bench_open,
+	.read		= seq_read,
+	.write		= bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init blocktag_bench_init(void)
+{
+	struct dentry *droot;
+
+	droot = debugfs_lookup("blocktag", NULL);
+	debugfs_create_file("bench", 0600, droot, NULL, &bench_fops);
+	dput(droot);
+
+	return 0;
+}
+late_initcall(blocktag_bench_init);
@@ -0,0 +1,23 @@
+/*
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+#ifndef __MTK_IO_BOOST_H__
+#define __MTK_IO_BOOST_H__
+
+struct bio;
+
+int mtk_iobst_register_tid(int tid);
+void mtk_iobst_unregister_tid(int tid);
+void mtk_iobst_submit_bio(struct bio *bio);
+
+#endif
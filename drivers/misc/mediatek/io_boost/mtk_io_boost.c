@@ -15,25 +15,37 @@
 
 #if defined(CONFIG_MTK_IO_BOOST)
 
+#include <linux/bio.h>
 #include <linux/delay.h>
 #include <linux/fs.h>
+#include <linux/iocontext.h>
+#include <linux/ioprio.h>
 #include <linux/kernel.h>
 #include <linux/kthread.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
 #include <linux/types.h>
 #include <linux/sched.h>
+#include <linux/sched/task.h>
 #include <linux/sched_clock.h>
 #include <linux/time.h>
 #include <linux/uaccess.h>
 #include <linux/wait.h>
+#include <mt-plat/mtk_io_boost.h>
+#ifdef VENDOR_EDIT
+// Liujie.Xie@TECH.Kernel.Sched, 2019/05/22, add for ui first
+#include <linux/oppocfs/oppo_cfs_common.h>
+#endif
 
 struct bst_tid_struct {
-	pid_t tid;
+	pid_t tid;		/* 0 once unregistered */
+	int old_ioprio;		/* ioprio before boosting, -1 if not boosted */
 };
 
 #define BST_TASK_FILE_PATH  "/dev/stune/io/tasks"
 #define BST_MAX_TID         (20)
+#define BST_TOP_APP_STUNE   "top-app"
+#define BST_FG_IOPRIO       IOPRIO_PRIO_VALUE(IOPRIO_CLASS_RT, IOPRIO_NORM)
 
 #define boost_print(fmt, arg...) \
 	pr_debug(BOOST_PRINT_PREFIX fmt, ##arg)
@@ -47,6 +59,8 @@ static int bst_tid_pending_cnt;
 static int bst_init_done;
 static wait_queue_head_t bst_wq;
 static struct file *bst_task_fd;
+/* serializes boosting and restoring the ioprio of registered tids */
+static DEFINE_MUTEX(bst_ioprio_lock);
 
 static int mtk_iobst_open_task_file(void)
 {
@@ -83,13 +97,14 @@ static void mtk_iobst_close_task_file(void)
 		filp_close(bst_task_fd, NULL);
 }
 
-static int mtk_iobst_get_next_tid(void)
+static int mtk_iobst_get_next_tid(int *idx)
 {
 	int tid = -1;
 
 	spin_lock_irq(&bst_lock);
 
 	if (bst_tid_pending_cnt) {
+		*idx = bst_tid_handled_cnt;
 		tid = bst_tid[bst_tid_handled_cnt].tid;
 		bst_tid_handled_cnt++;
 		bst_tid_pending_cnt--;
@@ -100,7 +115,57 @@ static int mtk_iobst_get_next_tid(void)
 	return tid;
 }
 
-static int mtk_iobst_add_task_internal(int tid)
+static struct task_struct *mtk_iobst_get_task(int tid)
+{
+	struct task_struct *task;
+
+	rcu_read_lock();
+	task = find_task_by_vpid(tid);
+	if (task)
+		get_task_struct(task);
+	rcu_read_unlock();
+
+	return task;
+}
+
+/*
+ * Registered tasks also get the real-time I/O class for the I/O they
+ * issue themselves. Their previous ioprio is kept and given back by
+ * mtk_iobst_unregister_tid().
+ */
+static void mtk_iobst_set_ioprio(int idx, int tid)
+{
+	struct task_struct *task;
+	int old_ioprio;
+	int ret;
+
+	mutex_lock(&bst_ioprio_lock);
+
+	/* unregistered before we got to it */
+	if (READ_ONCE(bst_tid[idx].tid) != tid)
+		goto out;
+
+	task = mtk_iobst_get_task(tid);
+	if (!task)
+		goto out;
+
+	task_lock(task);
+	old_ioprio = task->io_context ? task->io_context->ioprio :
+		IOPRIO_PRIO_VALUE(IOPRIO_CLASS_NONE, 0);
+	task_unlock(task);
+
+	ret = set_task_ioprio(task, BST_FG_IOPRIO);
+	if (ret)
+		pr_info("failed to set ioprio of tid=%d, ret=%d\n", tid, ret);
+	else
+		bst_tid[idx].old_ioprio = old_ioprio;
+
+	put_task_struct(task);
+out:
+	mutex_unlock(&bst_ioprio_lock);
+}
+
+static int mtk_iobst_add_task_internal(int idx, int tid)
 {
 	/* specialized itoa -- works for tid > 0 */
 	char text[22];
@@ -110,6 +175,8 @@ static int mtk_iobst_add_task_internal(int tid)
 	ssize_t ret;
 	mm_segment_t old_fs;
 
+	mtk_iobst_set_ioprio(idx, tid);
+
 	*ptr = '\0';
 
 	while (tid > 0) {
@@ -135,7 +202,7 @@ static int mtk_iobst_add_task_internal(int tid)
 static int mtk_iobst_add_task(void)
 {
 	int ret = 0;
-	int tid;
+	int idx, tid;
 
 	ret = mtk_iobst_open_task_file();
 
@@ -144,8 +211,12 @@ static int mtk_iobst_add_task(void)
 		return ret;
 	}
 
-	while ((tid = mtk_iobst_get_next_tid()) != -1) {
-		ret = mtk_iobst_add_task_internal(tid);
+	while ((tid = mtk_iobst_get_next_tid(&idx)) != -1) {
+		/* unregistered while pending */
+		if (!tid)
+			continue;
+
+		ret = mtk_iobst_add_task_internal(idx, tid);
 		if (ret)
 			pr_info("failed to add tid=%d, ret=%d\n", tid, ret);
 	}
@@ -163,6 +234,7 @@ int mtk_iobst_register_tid(int tid)
 
 	if (bst_tid_cnt < BST_MAX_TID) {
 		bst_tid[bst_tid_cnt].tid = tid;
+		bst_tid[bst_tid_cnt].old_ioprio = -1;
 		bst_tid_cnt++;
 		bst_tid_pending_cnt++;
 		ret = 0;
@@ -178,6 +250,72 @@ int mtk_iobst_register_tid(int tid)
 	return ret;
 }
 
+/*
+ * Give a registered task its ioprio back, e.g. when a queue thread exits.
+ * The tid stays in the stune io group until it exits. May sleep.
+ */
+void mtk_iobst_unregister_tid(int tid)
+{
+	struct task_struct *task;
+	int old_ioprio = -1;
+	int i;
+
+	mutex_lock(&bst_ioprio_lock);
+
+	spin_lock_irq(&bst_lock);
+	for (i = 0; i < bst_tid_cnt; i++) {
+		if (bst_tid[i].tid != tid)
+			continue;
+		WRITE_ONCE(bst_tid[i].tid, 0);
+		old_ioprio = bst_tid[i].old_ioprio;
+		bst_tid[i].old_ioprio = -1;
+		break;
+	}
+	spin_unlock_irq(&bst_lock);
+
+	if (old_ioprio < 0)
+		goto out;
+
+	task = mtk_iobst_get_task(tid);
+	if (!task)
+		goto out;
+
+	if (set_task_ioprio(task, old_ioprio))
+		pr_info("failed to restore ioprio of tid=%d\n", tid);
+	put_task_struct(task);
+out:
+	mutex_unlock(&bst_ioprio_lock);
+}
+
+static bool mtk_iobst_task_is_fg(struct task_struct *task)
+{
+#ifdef VENDOR_EDIT
+	if (sysctl_uifirst_enabled && test_task_ux(task))
+		return true;
+#endif
+#ifdef CONFIG_SCHED_TUNE
+	if (schedtune_task_in_group(task, BST_TOP_APP_STUNE))
+		return true;
+#endif
+	return false;
+}
+
+/*
+ * Called from submit_bio(). I/O submitted by a UX thread or a top-app
+ * task without an explicit priority gets the real-time class on the bio,
+ * which the request inherits, so the storage driver sees it as
+ * foreground (UFS keeps a few tags reserved for it). Elevators that
+ * queue per io_context, like cfq, still schedule by the task's ioprio.
+ */
+void mtk_iobst_submit_bio(struct bio *bio)
+{
+	if (ioprio_valid(bio_prio(bio)))
+		return;
+
+	if (mtk_iobst_task_is_fg(current))
+		bio_set_prio(bio, BST_FG_IOPRIO);
+}
+
 static int mtk_iobst_thread(void *data)
 {
 	spin_lock_irq(&bst_lock);
@@ -219,11 +357,19 @@ module_init(mtk_iobst_init);
 
 #else
 
-int mtk_iobst_register_tid(int tid, bool *done)
+int mtk_iobst_register_tid(int tid)
 {
 	return 0;
 }
 
+void mtk_iobst_unregister_tid(int tid)
+{
+}
+
+void mtk_iobst_submit_bio(struct bio *bio)
+{
+}
+
 #endif
 
 MODULE_AUTHOR("Stanley Chu <stanley.chu@mediatek.com>");
@@ -39,7 +39,10 @@ extern struct rq_data rq_info;
 extern struct workqueue_struct *rq_wq;
 
 /* For heavy task detection */
+extern int sched_get_nr_running_avg(int *avg, int *iowait_avg);
 extern int sched_get_nr_heavy_running_avg(int cid, int *avg);
+/* boosted cfs util of a cluster, kept incrementally by the scheduler */
+extern unsigned long sched_cluster_util_sum(int cluster_id);
 extern void sched_update_nr_heavy_prod(int invoker,
 	struct task_struct *p, int cpu, int heavy_nr_inc, bool ack_cap);
 extern int reset_heavy_task_stats(int cpu);
@@ -23,6 +23,10 @@
 #include <linux/sched/clock.h>
 #include <linux/topology.h>
 #include <linux/arch_topology.h>
+#include <linux/seqlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/log2.h>
 #include <trace/events/sched.h>
 //TODO: remove comment after met ready
 //#include <mt-plat/mt_sched.h>
@@ -43,13 +47,79 @@ static DEFINE_PER_CPU(u64, last_time);
 static DEFINE_PER_CPU(u64, last_heavy_time);
 static DEFINE_PER_CPU(u64, nr);
 static DEFINE_PER_CPU(u64, nr_heavy);
-static DEFINE_PER_CPU(unsigned long, iowait_prod_sum);
-static DEFINE_PER_CPU(spinlock_t, nr_lock) = __SPIN_LOCK_UNLOCKED(nr_lock);
+static DEFINE_PER_CPU(u64, iowait_prod_sum);
 static DEFINE_PER_CPU(spinlock_t, nr_heavy_lock) =
 			__SPIN_LOCK_UNLOCKED(nr_heavy_lock);
 static u64 last_get_time;
 static int init_heavy;
 
+/*
+ * The *_prod_sum accumulators only grow and are published through
+ * per-cpu seqcounts, so pollers snapshot them without taking any lock
+ * that the enqueue/dequeue path needs. nr_seq writers are serialized by
+ * the rq lock, nr_heavy_seq writers by nr_heavy_lock. A threshold change
+ * restarts the heavy/overutil sums and bumps the matching generation.
+ */
+static DEFINE_PER_CPU(seqcount_t, nr_seq) = SEQCNT_ZERO(nr_seq);
+static DEFINE_PER_CPU(seqcount_t, nr_heavy_seq) = SEQCNT_ZERO(nr_heavy_seq);
+static DEFINE_PER_CPU(unsigned int, nr_heavy_gen);
+static DEFINE_PER_CPU(unsigned int, overutil_gen);
+
+/* poller side copies of the accumulators at the previous poll */
+struct nr_avg_snap_t {
+	u64 nr_prod;
+	u64 iowait_prod;
+	u64 heavy_prod;
+	u64 overutil_l_prod;
+	u64 overutil_h_prod;
+	unsigned int heavy_gen;
+	unsigned int overutil_gen;
+};
+
+static DEFINE_PER_CPU(struct nr_avg_snap_t, nr_avg_snap);
+
+/*
+ * Growth of an accumulator since the previous poll. The poller's copy may
+ * include an in-flight estimate the writer settles differently later, do
+ * not let that wrap.
+ */
+static inline u64 prod_since(u64 cum, u64 prev)
+{
+	return cum > prev ? cum - prev : 0;
+}
+static DEFINE_SPINLOCK(nr_avg_read_lock);
+static DEFINE_SPINLOCK(heavy_avg_read_lock);
+
+/*
+ * Read cost of the cluster queries polled at frame rate, in log2(ns)
+ * buckets, exported through debugfs sched_avg_read_cost.
+ */
+enum read_cost_type_t {
+	READ_COST_CLUSTER_UTIL = 0,
+	READ_COST_HEAVY_AVG,
+	READ_COST_NR
+};
+
+#define READ_COST_BUCKETS 16
+
+static const char * const read_cost_name[READ_COST_NR] = {
+	"cluster_util",
+	"nr_heavy_running_avg",
+};
+
+static DEFINE_PER_CPU(u64 [READ_COST_NR][READ_COST_BUCKETS], read_cost_hist);
+
+static inline void read_cost_account(int type, u64 start)
+{
+	u64 delta = sched_clock() - start;
+	int bucket = delta ? ilog2(delta) : 0;
+
+	if (bucket >= READ_COST_BUCKETS)
+		bucket = READ_COST_BUCKETS - 1;
+
+	this_cpu_inc(read_cost_hist[type][bucket]);
+}
+
 struct overutil_stats_t {
 	int nr_overutil_l;
 	int nr_overutil_h;
@@ -352,57 +422,81 @@ unsigned int sched_get_cpu_util(int cpu)
 int sched_get_nr_running_avg(int *avg, int *iowait_avg)
 {
 	int cpu;
-	u64 curr_time = sched_clock();
-	s64 diff = (s64) (curr_time - last_get_time);
+	u64 curr_time;
+	s64 diff;
 	u64 tmp_avg = 0, tmp_iowait = 0, old_lgt;
 	bool clk_faulty = 0;
 	u32 cpumask = 0;
 	int scaled_tlp = 0; /* the tasks number of last poll */
+	unsigned long flags;
 
 	*avg = 0;
 	*iowait_avg = 0;
 
-	if (!diff)
+	spin_lock_irqsave(&nr_avg_read_lock, flags);
+	curr_time = sched_clock();
+	diff = (s64) (curr_time - last_get_time);
+	if (!diff) {
+		spin_unlock_irqrestore(&nr_avg_read_lock, flags);
 		return 0;
+	}
 	if (diff < 0)
 		printk_deferred("[%s] time last:%llu curr:%llu ",
 		__func__, last_get_time, curr_time);
 
 	old_lgt = last_get_time;
 	last_get_time = curr_time;
-	/* read and reset nr_running counts */
+	/* snapshot nr_running counts, writers are never blocked */
 	for_each_possible_cpu(cpu) {
-		unsigned long flags;
+		struct nr_avg_snap_t *snap = &per_cpu(nr_avg_snap, cpu);
+		seqcount_t *seq = &per_cpu(nr_seq, cpu);
+		u64 prod, iowait, nr_curr, last;
+		u64 nr_cum;
+		s64 delta;
+		unsigned int start;
+
+		do {
+			start = read_seqcount_begin(seq);
+			prod = per_cpu(nr_prod_sum, cpu);
+			iowait = per_cpu(iowait_prod_sum, cpu);
+			nr_curr = per_cpu(nr, cpu);
+			last = per_cpu(last_time, cpu);
+		} while (read_seqcount_retry(seq, start));
 
-		spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
 		/* error handling for problematic clock violation */
-		if ((s64) (curr_time - per_cpu(last_time, cpu) < 0)) {
+		delta = (s64) (curr_time - last);
+		if (delta < 0) {
 			clk_faulty = 1;
 			cpumask |= 1 << cpu;
+			delta = 0;
 		}
-		tmp_avg += per_cpu(nr_prod_sum, cpu);
+
 		/* record tasks nr of last poll */
-		scaled_tlp += per_cpu(nr, cpu);
-		tmp_avg += per_cpu(nr, cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		tmp_iowait = per_cpu(iowait_prod_sum, cpu);
-		tmp_iowait += nr_iowait_cpu(cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		per_cpu(last_time, cpu) = curr_time;
-		per_cpu(nr_prod_sum, cpu) = 0;
-		per_cpu(iowait_prod_sum, cpu) = 0;
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+		scaled_tlp += nr_curr;
+		/* nr is constant since last, so the in-flight part is exact */
+		nr_cum = prod + nr_curr * delta;
+
+		tmp_avg += prod_since(nr_cum, snap->nr_prod);
+		/*
+		 * nr_iowait changes without a writer update, only what the
+		 * writer accumulated counts, the rest goes to the next poll
+		 */
+		tmp_iowait += prod_since(iowait, snap->iowait_prod);
+		snap->nr_prod = nr_cum;
+		snap->iowait_prod = iowait;
 	}
+	spin_unlock_irqrestore(&nr_avg_read_lock, flags);
 
 	/* error handling for problematic clock violation */
 	if (clk_faulty) {
-		*avg = 0;
-		*iowait_avg = 0;
 		printk_deferred("[%s] **** CPU (0x%08x)clock may unstable !!\n",
 		__func__, cpumask);
 		return 0;
 	}
 
+	if (diff < 0)
+		return 0;
+
 	*avg = (int)div64_u64(tmp_avg * 100, (u64) diff);
 	*iowait_avg = (int)div64_u64(tmp_iowait * 100, (u64) diff);
 
@@ -432,6 +526,7 @@ int reset_heavy_task_stats(int cpu)
 		&per_cpu(cpu_overutil_state, cpu);
 
 	spin_lock_irqsave(&per_cpu(nr_heavy_lock, cpu), flags);
+	write_seqcount_begin(&per_cpu(nr_heavy_seq, cpu));
 	nr_heavy_tasks = per_cpu(nr_heavy, cpu);
 	if (nr_heavy_tasks) {
 		printk_deferred(
@@ -456,6 +551,7 @@ int reset_heavy_task_stats(int cpu)
 	cpu_overutil->max_task_util = 0;
 	cpu_overutil->max_task_pid = 0;
 
+	write_seqcount_end(&per_cpu(nr_heavy_seq, cpu));
 	spin_unlock_irqrestore(&per_cpu(nr_heavy_lock, cpu), flags);
 
 	return nr_heavy_tasks + nr_overutil_l + nr_overutil_h;
@@ -484,9 +580,12 @@ void heavy_thresh_chg_notify(void)
 
 		/* Threshold for heavy is changed. Need to reset stats */
 		spin_lock(&per_cpu(nr_heavy_lock, cpu));
+		write_seqcount_begin(&per_cpu(nr_heavy_seq, cpu));
 		per_cpu(nr_heavy_prod_sum, cpu) = 0;
 		per_cpu(nr_heavy, cpu) = nr_heavy_task;
 		per_cpu(last_heavy_time, cpu) = curr_time;
+		per_cpu(nr_heavy_gen, cpu)++;
+		write_seqcount_end(&per_cpu(nr_heavy_seq, cpu));
 		spin_unlock(&per_cpu(nr_heavy_lock, cpu));
 
 		raw_spin_unlock_irqrestore(&cpu_rq(cpu)->lock, flags);
@@ -571,6 +670,7 @@ void overutil_thresh_chg_notify(void)
 
 		/* Threshold for heavy is changed. Need to reset stats */
 		spin_lock(&per_cpu(nr_heavy_lock, cpu)); /* heavy-lock */
+		write_seqcount_begin(&per_cpu(nr_heavy_seq, cpu));
 		cpu_overutil->nr_overutil_h = nr_overutil_h;
 		cpu_overutil->nr_overutil_h_prod_sum = 0;
 		cpu_overutil->h_last_update_time = curr_time;
@@ -578,6 +678,8 @@ void overutil_thresh_chg_notify(void)
 		cpu_overutil->nr_overutil_l = nr_overutil_l;
 		cpu_overutil->nr_overutil_l_prod_sum = 0;
 		cpu_overutil->l_last_update_time = curr_time;
+		per_cpu(overutil_gen, cpu)++;
+		write_seqcount_end(&per_cpu(nr_heavy_seq, cpu));
 		spin_unlock(&per_cpu(nr_heavy_lock, cpu)); /* heavy-unlock */
 
 		/* rq-unlock */
@@ -585,9 +687,9 @@ void overutil_thresh_chg_notify(void)
 	}
 }
 
-int sched_get_nr_heavy_running_avg(int cluster_id, int *avg)
+static int __sched_get_nr_heavy_running_avg(int cluster_id, int *avg)
 {
-	u64 curr_time = sched_clock();
+	u64 curr_time;
 	s64 diff;
 
 	u64 tmp_avg = 0, old_lgt;
@@ -615,10 +717,14 @@ int sched_get_nr_heavy_running_avg(int cluster_id, int *avg)
 		return -1;
 	}
 
+	spin_lock_irqsave(&heavy_avg_read_lock, flags);
+
 	/* Time diff can't be zero. */
+	curr_time = sched_clock();
 	diff = (s64)(curr_time -
 		cluster_heavy_tbl[cluster_id].last_get_heavy_time);
 	if (!diff) {
+		spin_unlock_irqrestore(&heavy_avg_read_lock, flags);
 		*avg = 0;
 		return -1;
 	}
@@ -629,38 +735,55 @@ int sched_get_nr_heavy_running_avg(int cluster_id, int *avg)
 
 	/* visit all cpus of this cluster */
 	for_each_cpu(cpu, &cls_cpus) {
-		spin_lock_irqsave(&per_cpu(nr_heavy_lock, cpu), flags);
-		if ((s64) (curr_time - per_cpu(last_heavy_time, cpu) < 0)) {
+		struct nr_avg_snap_t *snap = &per_cpu(nr_avg_snap, cpu);
+		seqcount_t *seq = &per_cpu(nr_heavy_seq, cpu);
+		u64 prod, nr_curr, last;
+		unsigned int gen, start;
+		s64 delta;
+
+		do {
+			start = read_seqcount_begin(seq);
+			prod = per_cpu(nr_heavy_prod_sum, cpu);
+			nr_curr = per_cpu(nr_heavy, cpu);
+			last = per_cpu(last_heavy_time, cpu);
+			gen = per_cpu(nr_heavy_gen, cpu);
+		} while (read_seqcount_retry(seq, start));
+
+		/* the sums were restarted by a threshold change */
+		if (gen != snap->heavy_gen) {
+			snap->heavy_gen = gen;
+			snap->heavy_prod = 0;
+		}
+
+		delta = (s64) (curr_time - last);
+		if (delta < 0) {
 			clk_faulty = 1;
 			cpumask |= 1 << cpu;
+			delta = 0;
 		}
 
-		last_heavy_nr += per_cpu(nr_heavy, cpu);
+		last_heavy_nr += nr_curr;
 
-		tmp_avg += per_cpu(nr_heavy_prod_sum, cpu);
+		tmp_avg += prod_since(prod, snap->heavy_prod);
 #ifdef CONFIG_MTK_SCHED_RQAVG_US
 		ack_cap = is_ack_curcap(cpu);
 		if (ack_cap)
-			tmp_avg += per_cpu(nr_heavy, cpu) *
-			(curr_time - per_cpu(last_heavy_time, cpu));
+			tmp_avg += nr_curr * delta;
 
-		trace_sched_avg_heavy_nr(5, per_cpu(nr_heavy, cpu),
-			(curr_time - per_cpu(last_heavy_time, cpu)),
-			ack_cap, cpu);
+		trace_sched_avg_heavy_nr(5, nr_curr, delta, ack_cap, cpu);
 #else
 		ack_cap = -1;
-		tmp_avg +=
-		per_cpu(nr_heavy, cpu) *
-		(curr_time - per_cpu(last_heavy_time, cpu));
+		tmp_avg += nr_curr * delta;
 #endif
-		per_cpu(last_heavy_time, cpu) = curr_time;
-
-		/* clear prod_sum */
-		per_cpu(nr_heavy_prod_sum, cpu) = 0;
-
-		spin_unlock_irqrestore(&per_cpu(nr_heavy_lock, cpu), flags);
+		/*
+		 * The in-flight part up to curr_time belongs to this poll,
+		 * the writer adds it to the sum later.
+		 */
+		snap->heavy_prod = prod + nr_curr * delta;
 	}
 
+	spin_unlock_irqrestore(&heavy_avg_read_lock, flags);
+
 	if (clk_faulty) {
 		*avg = 0;
 		trace_sched_avg_heavy_time(-1, -1, cluster_id);
@@ -673,6 +796,15 @@ int sched_get_nr_heavy_running_avg(int cluster_id, int *avg)
 
 	return last_heavy_nr;
 }
+int sched_get_nr_heavy_running_avg(int cluster_id, int *avg)
+{
+	u64 start = sched_clock();
+	int ret = __sched_get_nr_heavy_running_avg(cluster_id, avg);
+
+	read_cost_account(READ_COST_HEAVY_AVG, start);
+
+	return ret;
+}
 EXPORT_SYMBOL(sched_get_nr_heavy_running_avg);
 
 /* sched_get_cluster_util:
@@ -688,8 +820,7 @@ int sched_get_cluster_util(int cluster_id,
 	int cluster_nr;
 	int cpu;
 	struct cpumask cls_cpus;
-	unsigned long cpu_cap = 0;
-	int cpu_nr = 0;
+	u64 start = sched_clock();
 
 	/* initialized */
 	if (usage)
@@ -702,27 +833,22 @@ int sched_get_cluster_util(int cluster_id,
 	if (cluster_id < 0 || cluster_id >= cluster_nr)
 		return -1;
 
-	arch_get_cluster_cpus(&cls_cpus, cluster_id);
-
-	 /* visit all cpus of this cluster */
-	for_each_cpu(cpu, &cls_cpus) {
-		/*
-		 * cpu_util returns the amount of capacity of
-		 * a CPU that is used by CFS tasks
-		 */
-		cpu_nr++;
-
-		if (!cpu_online(cpu))
-			continue;
-
-		cpu_cap = capacity_orig_of(cpu);
-
-		if (usage)
-			*usage += boosted_cpu_util(cpu, 0);
+	/*
+	 * cfs usage of the online cpus is summed up by the scheduler
+	 * whenever a cpu's util changes, see update_cluster_util()
+	 */
+	if (usage)
+		*usage = sched_cluster_util_sum(cluster_id);
+
+	if (capacity) {
+		arch_get_cluster_cpus(&cls_cpus, cluster_id);
+		cpu = cpumask_any_and(&cls_cpus, cpu_online_mask);
+		if (cpu < nr_cpu_ids)
+			*capacity = capacity_orig_of(cpu) *
+				cpumask_weight(&cls_cpus);
 	}
 
-	if (capacity)
-		*capacity = cpu_cap*cpu_nr;
+	read_cost_account(READ_COST_CLUSTER_UTIL, start);
 
 	return 0;
 }
@@ -731,7 +857,7 @@ EXPORT_SYMBOL(sched_get_cluster_util);
 
 int sched_get_nr_overutil_avg(int cluster_id, int *l_avg, int *h_avg)
 {
-	u64 curr_time = sched_clock();
+	u64 curr_time;
 	s64 diff;
 	u64 l_tmp_avg = 0, h_tmp_avg = 0;
 	u32 cpumask = 0;
@@ -755,10 +881,14 @@ int sched_get_nr_overutil_avg(int cluster_id, int *l_avg, int *h_avg)
 		return -1;
 	}
 
+	spin_lock_irqsave(&heavy_avg_read_lock, flags);
+
 	/* Time diff can't be zero/negative. */
+	curr_time = sched_clock();
 	diff = (s64)(curr_time -
 			cluster_heavy_tbl[cluster_id].last_get_overutil_time);
 	if (diff <= 0) {
+		spin_unlock_irqrestore(&heavy_avg_read_lock, flags);
 		*l_avg = *h_avg = 0;
 		return -1;
 	}
@@ -769,38 +899,57 @@ int sched_get_nr_overutil_avg(int cluster_id, int *l_avg, int *h_avg)
 	/* visit all cpus of this cluster */
 	for_each_cpu(cpu, &cls_cpus) {
 		struct overutil_stats_t *cpu_overutil;
-
-		spin_lock_irqsave(&per_cpu(nr_heavy_lock, cpu), flags);
+		struct nr_avg_snap_t *snap = &per_cpu(nr_avg_snap, cpu);
+		seqcount_t *seq = &per_cpu(nr_heavy_seq, cpu);
+		u64 l_prod, h_prod, l_last, h_last;
+		u64 l_cum, h_cum;
+		int nr_l, nr_h;
+		unsigned int gen, start;
+		s64 l_delta, h_delta;
 
 		cpu_overutil = &per_cpu(cpu_overutil_state, cpu);
 
-		if ((s64) (curr_time - cpu_overutil->l_last_update_time < 0)) {
+		do {
+			start = read_seqcount_begin(seq);
+			l_prod = cpu_overutil->nr_overutil_l_prod_sum;
+			h_prod = cpu_overutil->nr_overutil_h_prod_sum;
+			nr_l = cpu_overutil->nr_overutil_l;
+			nr_h = cpu_overutil->nr_overutil_h;
+			l_last = cpu_overutil->l_last_update_time;
+			h_last = cpu_overutil->h_last_update_time;
+			gen = per_cpu(overutil_gen, cpu);
+		} while (read_seqcount_retry(seq, start));
+
+		/* the sums were restarted by a threshold change */
+		if (gen != snap->overutil_gen) {
+			snap->overutil_gen = gen;
+			snap->overutil_l_prod = 0;
+			snap->overutil_h_prod = 0;
+		}
+
+		l_delta = (s64) (curr_time - l_last);
+		h_delta = (s64) (curr_time - h_last);
+		if (l_delta < 0 || h_delta < 0) {
 			clk_faulty = 1;
 			cpumask |= 1 << cpu;
 		}
+		l_delta = max_t(s64, l_delta, 0);
+		h_delta = max_t(s64, h_delta, 0);
 
-		/* get prod sum */
-		l_tmp_avg += cpu_overutil->nr_overutil_l_prod_sum;
-		l_tmp_avg += cpu_overutil->nr_overutil_l *
-			(curr_time - cpu_overutil->l_last_update_time);
-
-		h_tmp_avg += cpu_overutil->nr_overutil_h_prod_sum;
-		h_tmp_avg += cpu_overutil->nr_overutil_h *
-			(curr_time - cpu_overutil->h_last_update_time);
-
-		/* update last update time */
-		cpu_overutil->l_last_update_time = curr_time;
-		cpu_overutil->h_last_update_time = curr_time;
+		l_cum = l_prod + nr_l * l_delta;
+		h_cum = h_prod + nr_h * h_delta;
 
-		/* clear prod_sum */
-		cpu_overutil->nr_overutil_l_prod_sum = 0;
-		cpu_overutil->nr_overutil_h_prod_sum = 0;
+		l_tmp_avg += prod_since(l_cum, snap->overutil_l_prod);
+		h_tmp_avg += prod_since(h_cum, snap->overutil_h_prod);
 
-		spin_unlock_irqrestore(&per_cpu(nr_heavy_lock, cpu), flags);
+		snap->overutil_l_prod = l_cum;
+		snap->overutil_h_prod = h_cum;
 	}
 
+	spin_unlock_irqrestore(&heavy_avg_read_lock, flags);
+
 	if (clk_faulty) {
-		l_avg = h_avg = 0;
+		*l_avg = *h_avg = 0;
 		return -1;
 	}
 
@@ -964,16 +1113,15 @@ void sched_update_nr_prod(int cpu, unsigned long nr_running, int inc)
 {
 	s64 diff;
 	u64 curr_time;
-	unsigned long flags;
+	seqcount_t *seq = &per_cpu(nr_seq, cpu);
 
-	spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
+	/* serialized against other writers of this cpu by the rq lock */
+	write_seqcount_begin(seq);
 	curr_time = sched_clock();
 	diff = (s64) (curr_time - per_cpu(last_time, cpu));
 	/* skip this problematic clock violation */
-	if (diff < 0) {
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
-		return;
-	}
+	if (diff < 0)
+		goto out;
 	/* ////////////////////////////////////// */
 
 	per_cpu(last_time, cpu) = curr_time;
@@ -986,8 +1134,8 @@ void sched_update_nr_prod(int cpu, unsigned long nr_running, int inc)
 
 	per_cpu(nr_prod_sum, cpu) += nr_running * diff;
 	per_cpu(iowait_prod_sum, cpu) += nr_iowait_cpu(cpu) * diff;
-
-	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+out:
+	write_seqcount_end(seq);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
 
@@ -1042,6 +1190,7 @@ void sched_update_nr_heavy_prod(int invoker, struct task_struct *p,
 	}
 
 	spin_lock_irqsave(&per_cpu(nr_heavy_lock, cpu), flags);
+	write_seqcount_begin(&per_cpu(nr_heavy_seq, cpu));
 
 	curr_time = sched_clock();
 	over_type = is_task_overutil(p);
@@ -1116,6 +1265,7 @@ void sched_update_nr_heavy_prod(int invoker, struct task_struct *p,
 OUT:
 #endif
 
+	write_seqcount_end(&per_cpu(nr_heavy_seq, cpu));
 	spin_unlock_irqrestore(&per_cpu(nr_heavy_lock, cpu), flags);
 }
 EXPORT_SYMBOL(sched_update_nr_heavy_prod);
@@ -1212,3 +1362,42 @@ static int init_heavy_tlb(void)
 	return init_heavy;
 }
 
+static int read_cost_show(struct seq_file *m, void *v)
+{
+	int type, i, cpu;
+	u64 cnt;
+
+	for (type = 0; type < READ_COST_NR; type++) {
+		seq_printf(m, "%s:\n", read_cost_name[type]);
+		for (i = 0; i < READ_COST_BUCKETS; i++) {
+			cnt = 0;
+			for_each_possible_cpu(cpu)
+				cnt += per_cpu(read_cost_hist, cpu)[type][i];
+			seq_printf(m, "  [%6llu ns, %6llu ns): %llu\n",
+				i ? 1ULL << i : 0ULL, 1ULL << (i + 1), cnt);
+		}
+	}
+
+	return 0;
+}
+
+static int read_cost_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, read_cost_show, NULL);
+}
+
+static const struct file_operations read_cost_fops = {
+	.open		= read_cost_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init sched_avg_debugfs_init(void)
+{
+	debugfs_create_file("sched_avg_read_cost", 0444, NULL, NULL,
+			&read_cost_fops);
+
+	return 0;
+}
+late_initcall(sched_avg_debugfs_init);
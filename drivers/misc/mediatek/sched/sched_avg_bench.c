@@ -0,0 +1,223 @@
+/*
+ * Copyright (C) 2017 MediaTek Inc.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
+ */
+
+/*
+ * Microbenchmark of the sched_avg nr_running accounting
+ *
+ * Writing a duration in ms to debugfs sched_avg_bench runs one writer
+ * thread per online cpu, calling sched_update_nr_prod() under the rq lock
+ * as enqueue/dequeue do, while one reader polls sched_get_nr_running_avg()
+ * as the perf service does. Reading the file shows the cost per call.
+ * The reader consumes the averages of real pollers while it runs.
+ */
+#include <linux/completion.h>
+#include <linux/cpu.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/mutex.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
+#include <linux/sched/clock.h>
+#include <linux/seq_file.h>
+#include <linux/uaccess.h>
+#include "rq_stats.h"
+
+#define BENCH_MAX_MS	10000
+
+struct bench_res {
+	u64 calls;
+	u64 ns;
+	u64 max_ns;
+};
+
+static DEFINE_PER_CPU(struct bench_res, bench_writer);
+static struct bench_res bench_reader;
+static unsigned int bench_ms;
+static bool bench_done;
+
+static DEFINE_MUTEX(bench_mutex);
+static atomic_t bench_running;
+static DECLARE_COMPLETION(bench_finished);
+static unsigned long bench_end;
+
+static inline void bench_account(struct bench_res *res, u64 start)
+{
+	u64 delta = sched_clock() - start;
+
+	res->calls++;
+	res->ns += delta;
+	if (delta > res->max_ns)
+		res->max_ns = delta;
+}
+
+static void bench_thread_done(void)
+{
+	if (atomic_dec_and_test(&bench_running))
+		complete(&bench_finished);
+}
+
+static int bench_writer_fn(void *data)
+{
+	int cpu = (long)data;
+	struct bench_res *res = &per_cpu(bench_writer, cpu);
+	struct rq *rq = cpu_rq(cpu);
+	u64 start;
+
+	while (time_before(jiffies, bench_end)) {
+		raw_spin_lock_irq(&rq->lock);
+		start = sched_clock();
+		/* inc 0 keeps nr in sync with the real rq */
+		sched_update_nr_prod(cpu, rq->nr_running, 0);
+		bench_account(res, start);
+		raw_spin_unlock_irq(&rq->lock);
+		cond_resched();
+	}
+
+	bench_thread_done();
+	return 0;
+}
+
+static int bench_reader_fn(void *data)
+{
+	int avg, iowait_avg;
+	u64 start;
+
+	while (time_before(jiffies, bench_end)) {
+		start = sched_clock();
+		sched_get_nr_running_avg(&avg, &iowait_avg);
+		bench_account(&bench_reader, start);
+		cond_resched();
+	}
+
+	bench_thread_done();
+	return 0;
+}
+
+static int bench_run(unsigned int ms)
+{
+	struct task_struct *tsk;
+	int cpu, ret = 0;
+
+	get_online_cpus();
+
+	for_each_possible_cpu(cpu)
+		memset(&per_cpu(bench_writer, cpu), 0, sizeof(struct bench_res));
+	memset(&bench_reader, 0, sizeof(bench_reader));
+	reinit_completion(&bench_finished);
+	/* held by us until every thread was started */
+	atomic_set(&bench_running, 1);
+	bench_end = jiffies + msecs_to_jiffies(ms);
+
+	for_each_online_cpu(cpu) {
+		tsk = kthread_create_on_node(bench_writer_fn, (void *)(long)cpu,
+				cpu_to_node(cpu), "sched_avg_bench/%d", cpu);
+		if (IS_ERR(tsk)) {
+			ret = PTR_ERR(tsk);
+			break;
+		}
+		kthread_bind(tsk, cpu);
+		atomic_inc(&bench_running);
+		wake_up_process(tsk);
+	}
+
+	if (!ret) {
+		tsk = kthread_run(bench_reader_fn, NULL, "sched_avg_bench_rd");
+		if (IS_ERR(tsk))
+			ret = PTR_ERR(tsk);
+		else
+			atomic_inc(&bench_running);
+	}
+
+	bench_thread_done();
+	wait_for_completion(&bench_finished);
+	put_online_cpus();
+
+	bench_ms = ms;
+	bench_done = !ret;
+
+	return ret;
+}
+
+static void bench_show_res(struct seq_file *m, const char *name,
+			   struct bench_res *res)
+{
+	seq_printf(m, "%s: calls=%llu avg_ns=%llu max_ns=%llu\n", name,
+		   res->calls, res->calls ? div64_u64(res->ns, res->calls) : 0,
+		   res->max_ns);
+}
+
+static int bench_show(struct seq_file *m, void *v)
+{
+	char name[16];
+	int cpu;
+
+	mutex_lock(&bench_mutex);
+	if (!bench_done) {
+		seq_puts(m, "echo <ms> to run\n");
+		goto out;
+	}
+
+	seq_printf(m, "duration_ms: %u\n", bench_ms);
+	for_each_possible_cpu(cpu) {
+		if (!per_cpu(bench_writer, cpu).calls)
+			continue;
+		snprintf(name, sizeof(name), "writer%d", cpu);
+		bench_show_res(m, name, &per_cpu(bench_writer, cpu));
+	}
+	bench_show_res(m, "reader", &bench_reader);
+out:
+	mutex_unlock(&bench_mutex);
+
+	return 0;
+}
+
+static int bench_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, bench_show, NULL);
+}
+
+static ssize_t bench_write(struct file *filp, const char __user *ubuf,
+			   size_t cnt, loff_t *ppos)
+{
+	unsigned int ms;
+	int ret;
+
+	ret = kstrtouint_from_user(ubuf, cnt, 0, &ms);
+	if (ret)
+		return ret;
+	if (!ms || ms > BENCH_MAX_MS)
+		return -EINVAL;
+
+	mutex_lock(&bench_mutex);
+	ret = bench_run(ms);
+	mutex_unlock(&bench_mutex);
+
+	return ret ? ret : cnt;
+}
+
+static const struct file_operations bench_fops = {
+	.open		= bench_open,
+	.read		= seq_read,
+	.write		= bench_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init sched_avg_bench_init(void)
+{
+	debugfs_create_file("sched_avg_bench", 0600, NULL, NULL, &bench_fops);
+
+	return 0;
+}
+late_initcall(sched_avg_bench_init);
@@ -672,6 +672,7 @@ int mmc_run_queue_thread(void *data)
 		if (kthread_should_stop())
 			break;
 	}
+	mtk_iobst_unregister_tid(current->pid);
 	mt_bio_queue_free(current);
 	return 0;
 }
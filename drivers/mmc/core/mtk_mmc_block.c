@@ -224,25 +224,29 @@ static struct mt_bio_context *mt_bio_get_ctx(int id)
 	return mt_ctx_map[id];
 }
 
+/* index of given context in the blocktag context array */
+static inline unsigned int mt_bio_ctx_idx(struct mt_bio_context *ctx)
+{
+	return ctx - (struct mt_bio_context *)BTAG_CTX(mtk_btag_mmc);
+}
+
 /* append a pidlog to given context */
 int mtk_btag_pidlog_add_mmc(struct request_queue *q, pid_t pid, __u32 len,
 	int write)
 {
-	unsigned long flags;
 	struct mt_bio_context *ctx;
 
 	ctx = mt_bio_curr_queue(q);
 	if (!ctx)
 		return 0;
 
-	spin_lock_irqsave(&ctx->lock, flags);
-	mtk_btag_pidlog_insert(&ctx->pidlog, pid, len, write);
+	/* per-CPU staging, ctx->lock is not needed */
+	mtk_btag_pidlog_stage(mtk_btag_mmc, mt_bio_ctx_idx(ctx), pid, len,
+		write);
 
 	if (ctx->qid == BTAG_STORAGE_EMBEDDED)
 		mtk_btag_mictx_eval_req(write, 1, len);
 
-	spin_unlock_irqrestore(&ctx->lock, flags);
-
 	return 1;
 }
 EXPORT_SYMBOL_GPL(mtk_btag_pidlog_add_mmc);
@@ -297,7 +301,8 @@ static void mt_bio_print_trace(struct mt_bio_context *ctx)
 	if (ctx->id == CTX_EXECQ)
 		pid_ctx = mt_bio_get_ctx(CTX_MMCQD0);
 
-	spin_lock_irqsave(&rt->lock, flags);
+	/* per-CPU ring, stay on this CPU until the trace is published */
+	local_irq_save(flags);
 	tr = mtk_btag_curr_trace(rt);
 
 	if (!tr)
@@ -311,7 +316,8 @@ static void mt_bio_print_trace(struct mt_bio_context *ctx)
 	memcpy(&tr->workload, &ctx->workload, sizeof(struct mtk_btag_workload));
 
 	if (pid_ctx)
-		mtk_btag_pidlog_eval(&tr->pidlog, &pid_ctx->pidlog);
+		mtk_btag_pidlog_merge(&tr->pidlog, mtk_btag_mmc,
+			mt_bio_ctx_idx(pid_ctx));
 
 	mtk_btag_vmstat_eval(&tr->vmstat);
 	mtk_btag_cpu_eval(&tr->cpu);
@@ -321,7 +327,7 @@ static void mt_bio_print_trace(struct mt_bio_context *ctx)
 	mtk_btag_klog(mtk_btag_mmc, tr);
 	mtk_btag_next_trace(rt);
 out:
-	spin_unlock_irqrestore(&rt->lock, flags);
+	local_irq_restore(flags);
 }
 
 
@@ -43,6 +43,12 @@ void mt_biolog_cqhci_check(void);
 void mt_biolog_cqhci_queue_task(unsigned int task_id, struct mmc_request *req);
 void mt_biolog_cqhci_complete(unsigned int task_id);
 
+/* per-CPU pidlog staging, provided by blocktag core */
+void mtk_btag_pidlog_stage(struct mtk_blocktag *btag, unsigned int idx,
+	pid_t pid, __u32 len, int write);
+void mtk_btag_pidlog_merge(struct mtk_btag_pidlogger *pl,
+	struct mtk_blocktag *btag, unsigned int idx);
+
 #define MMC_BIOLOG_RINGBUF_MAX 120
 #define MMC_BIOLOG_CONTEXTS 10       /* number of request queues */
 #define MMC_BIOLOG_CONTEXT_TASKS 32  /* number concurrent tasks in cmdq */
@@ -85,7 +91,6 @@ struct mt_bio_context {
 	struct mt_bio_context_task task[MMC_BIOLOG_CONTEXT_TASKS];
 	struct mtk_btag_workload workload;
 	struct mtk_btag_throughput throughput;
-	struct mtk_btag_pidlogger pidlog;
 };
 
 #else
@@ -289,6 +289,7 @@ static int mmc_queue_thread(void *d)
 
 		}
 	} while (1);
+	mtk_iobst_unregister_tid(current->pid);
 	mt_bio_queue_free(current);
 	up(&mq->thread_sem);
 
@@ -0,0 +1,271 @@
+/*
+ * Universal Flash Storage idle gap predictor
+ *
+ * Learns the distribution of idle gaps between busy periods of the host
+ * and picks the idle timeout after which the link should enter hibern8
+ * (auto-hibern8 timer, clock gating delay). A gap of g us under timeout
+ * T costs g us of active link if g <= T, or T us of active link plus the
+ * cost of one hibern8 exit if g > T. For every workload phase, the
+ * timeout minimising the summed cost over the gap histogram of that
+ * phase is chosen. The policy sets how expensive an exit is relative to
+ * active link time and how far the timeout may grow past the fixed one.
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * See the COPYING file in the top-level directory or visit
+ * <http://www.gnu.org/licenses/gpl-2.0.html>
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/kernel.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
+#include <linux/module.h>
+#include <linux/string.h>
+
+#include "ufs-idle-pred.h"
+
+static const char * const ufs_idle_policy_names[] = {
+	[UFS_IDLE_POLICY_FIXED]		= "fixed",
+	[UFS_IDLE_POLICY_POWER]		= "power",
+	[UFS_IDLE_POLICY_BALANCED]	= "balanced",
+	[UFS_IDLE_POLICY_PERFORMANCE]	= "performance",
+};
+
+/*
+ * @exit_mult: exit cost in multiples of exit_us
+ * @max_mult: upper bound of the timeout in multiples of fixed_us
+ */
+static const struct {
+	u32 exit_mult;
+	u32 max_mult;
+} ufs_idle_policy_tbl[] = {
+	[UFS_IDLE_POLICY_FIXED]		= { 0, 1 },
+	[UFS_IDLE_POLICY_POWER]		= { 1, 1 },
+	[UFS_IDLE_POLICY_BALANCED]	= { 4, 2 },
+	[UFS_IDLE_POLICY_PERFORMANCE]	= { 16, 4 },
+};
+
+static inline u32 ufs_idle_bucket(u32 gap_us)
+{
+	u32 units = gap_us >> UFS_IDLE_BUCKET_SHIFT;
+
+	if (!units)
+		return 0;
+
+	return min_t(u32, ilog2(units), UFS_IDLE_BUCKETS - 1);
+}
+
+/* lower bound of bucket @b, also the candidate timeouts */
+static inline u32 ufs_idle_bucket_floor(u32 b)
+{
+	return 1U << (b + UFS_IDLE_BUCKET_SHIFT);
+}
+
+/* gap accounted for every sample of bucket @b */
+static inline u32 ufs_idle_bucket_gap(u32 b)
+{
+	return 3U << (b + UFS_IDLE_BUCKET_SHIFT - 1);
+}
+
+static u32 ufs_idle_pred_choose(struct ufs_idle_pred *pred, u32 phase)
+{
+	const u32 *hist = pred->hist[phase];
+	u64 exit_cost = (u64)pred->exit_us *
+			ufs_idle_policy_tbl[pred->policy].exit_mult;
+	u32 min_us = min_t(u32, UFS_IDLE_MIN_TIMEOUT_US, pred->fixed_us);
+	u32 max_us = min_t(u64, (u64)pred->fixed_us *
+			   ufs_idle_policy_tbl[pred->policy].max_mult, U32_MAX);
+	u64 cost, best_cost = U64_MAX;
+	u32 best = pred->fixed_us;
+	u32 c, b, t, gap;
+
+	/* ties go to the shorter timeout */
+	for (c = 0; c <= UFS_IDLE_BUCKETS; c++) {
+		t = clamp_t(u32, ufs_idle_bucket_floor(c), min_us, max_us);
+		cost = 0;
+		for (b = 0; b < UFS_IDLE_BUCKETS; b++) {
+			if (!hist[b])
+				continue;
+			gap = ufs_idle_bucket_gap(b);
+			cost += (u64)hist[b] * (gap <= t ? gap : t + exit_cost);
+		}
+		if (cost < best_cost) {
+			best_cost = cost;
+			best = t;
+		}
+	}
+
+	return best;
+}
+
+static void ufs_idle_pred_decide(struct ufs_idle_pred *pred, u32 phase)
+{
+	u32 timeout;
+
+	pred->pending[phase] = 0;
+
+	if (pred->policy == UFS_IDLE_POLICY_FIXED ||
+	    pred->samples[phase] < UFS_IDLE_MIN_SAMPLES) {
+		timeout = pred->fixed_us;
+	} else {
+		timeout = ufs_idle_pred_choose(pred, phase);
+		pred->stats.decisions++;
+	}
+
+	if (timeout != pred->timeout_us[phase]) {
+		pred->timeout_us[phase] = timeout;
+		pred->stats.changes++;
+	}
+}
+
+static void ufs_idle_pred_add_gap(struct ufs_idle_pred *pred, u32 gap_us)
+{
+	u32 *hist = pred->hist[pred->phase];
+	u32 b, samples;
+
+	pred->stats.gaps++;
+	if (gap_us > ufs_idle_pred_timeout_us(pred))
+		pred->stats.exits++;
+	if (gap_us > pred->fixed_us)
+		pred->stats.fixed_exits++;
+
+	hist[ufs_idle_bucket(gap_us)]++;
+	pred->pending[pred->phase]++;
+
+	if (++pred->samples[pred->phase] >= UFS_IDLE_DECAY_SAMPLES) {
+		samples = 0;
+		for (b = 0; b < UFS_IDLE_BUCKETS; b++) {
+			hist[b] >>= 1;
+			samples += hist[b];
+		}
+		pred->samples[pred->phase] = samples;
+	}
+
+	if (pred->pending[pred->phase] >= UFS_IDLE_UPDATE_SAMPLES)
+		ufs_idle_pred_decide(pred, pred->phase);
+}
+
+static void ufs_idle_pred_update_phase(struct ufs_idle_pred *pred, u64 now_ns)
+{
+	u8 phase;
+
+	if (now_ns - pred->window_start_ns < UFS_IDLE_WINDOW_NS) {
+		pred->window_busy++;
+		return;
+	}
+
+	if (pred->window_busy >= UFS_IDLE_HEAVY_BUSY)
+		phase = UFS_IDLE_PHASE_HEAVY;
+	else if (pred->window_busy >= UFS_IDLE_MODERATE_BUSY)
+		phase = UFS_IDLE_PHASE_MODERATE;
+	else
+		phase = UFS_IDLE_PHASE_LIGHT;
+
+	if (phase != pred->phase) {
+		pred->phase = phase;
+		pred->stats.phase_changes++;
+	}
+
+	pred->window_start_ns = now_ns;
+	pred->window_busy = 1;
+}
+
+/**
+ * ufs_idle_pred_busy - a busy period starts
+ * @pred: predictor
+ * @now_ns: time the first request of the busy period is issued
+ *
+ * Accounts the idle gap that ends now to the phase it started in, then
+ * updates the workload phase.
+ */
+void ufs_idle_pred_busy(struct ufs_idle_pred *pred, u64 now_ns)
+{
+	u64 gap_us;
+
+	if (pred->idle) {
+		pred->idle = false;
+		gap_us = now_ns > pred->idle_start_ns ?
+			 div_u64(now_ns - pred->idle_start_ns, NSEC_PER_USEC) : 0;
+		ufs_idle_pred_add_gap(pred, min_t(u64, gap_us, U32_MAX));
+	}
+
+	ufs_idle_pred_update_phase(pred, now_ns);
+}
+EXPORT_SYMBOL_GPL(ufs_idle_pred_busy);
+
+/**
+ * ufs_idle_pred_idle - the last outstanding request completed
+ * @pred: predictor
+ * @now_ns: completion time
+ */
+void ufs_idle_pred_idle(struct ufs_idle_pred *pred, u64 now_ns)
+{
+	pred->idle = true;
+	pred->idle_start_ns = now_ns;
+}
+EXPORT_SYMBOL_GPL(ufs_idle_pred_idle);
+
+/**
+ * ufs_idle_pred_set_policy - switch policy and choose all timeouts again
+ * @pred: predictor
+ * @policy: new policy
+ *
+ * The histograms are kept, so a switch takes effect immediately.
+ */
+void ufs_idle_pred_set_policy(struct ufs_idle_pred *pred,
+			      enum ufs_idle_policy policy)
+{
+	u32 phase;
+
+	pred->policy = policy;
+	for (phase = 0; phase < UFS_IDLE_PHASE_MAX; phase++)
+		ufs_idle_pred_decide(pred, phase);
+}
+EXPORT_SYMBOL_GPL(ufs_idle_pred_set_policy);
+
+/**
+ * ufs_idle_pred_init - reset a predictor
+ * @pred: predictor
+ * @fixed_us: timeout of the fixed policy, must not be 0
+ * @exit_us: cost of one hibern8 exit
+ * @policy: initial policy
+ */
+void ufs_idle_pred_init(struct ufs_idle_pred *pred, u32 fixed_us, u32 exit_us,
+			enum ufs_idle_policy policy)
+{
+	u32 phase;
+
+	memset(pred, 0, sizeof(*pred));
+	pred->fixed_us = fixed_us;
+	pred->exit_us = exit_us;
+	pred->policy = policy;
+	pred->phase = UFS_IDLE_PHASE_LIGHT;
+	for (phase = 0; phase < UFS_IDLE_PHASE_MAX; phase++)
+		pred->timeout_us[phase] = fixed_us;
+}
+EXPORT_SYMBOL_GPL(ufs_idle_pred_init);
+
+int ufs_idle_pred_parse_policy(const char *buf)
+{
+	return sysfs_match_string(ufs_idle_policy_names, buf);
+}
+EXPORT_SYMBOL_GPL(ufs_idle_pred_parse_policy);
+
+const char *ufs_idle_pred_policy_name(enum ufs_idle_policy policy)
+{
+	if (policy >= UFS_IDLE_POLICY_MAX)
+		return "unknown";
+
+	return ufs_idle_policy_names[policy];
+}
+EXPORT_SYMBOL_GPL(ufs_idle_pred_policy_name);
+
+MODULE_DESCRIPTION("UFS idle gap predictor");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,132 @@
+/*
+ * Universal Flash Storage idle gap predictor
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * See the COPYING file in the top-level directory or visit
+ * <http://www.gnu.org/licenses/gpl-2.0.html>
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UFS_IDLE_PRED_H_
+#define _UFS_IDLE_PRED_H_
+
+#include <linux/time64.h>
+#include <linux/types.h>
+
+/*
+ * Idle gaps are binned in power of two buckets of microseconds, the
+ * first one covering everything below 128us and the last one everything
+ * above 2s.
+ */
+#define UFS_IDLE_BUCKETS		16
+#define UFS_IDLE_BUCKET_SHIFT		6
+
+/* a histogram is halved once it holds this many gaps */
+#define UFS_IDLE_DECAY_SAMPLES		1024
+/* below this many gaps the phase uses the fixed timeout */
+#define UFS_IDLE_MIN_SAMPLES		16
+/* new gaps in a phase before its timeout is chosen again */
+#define UFS_IDLE_UPDATE_SAMPLES		32
+
+/* the workload phase is classified once per window */
+#define UFS_IDLE_WINDOW_NS		(100 * NSEC_PER_MSEC)
+#define UFS_IDLE_MODERATE_BUSY		10
+#define UFS_IDLE_HEAVY_BUSY		100
+
+/* default cost of one hibern8 exit */
+#define UFS_IDLE_EXIT_US		500
+/* lower bound of any predicted timeout */
+#define UFS_IDLE_MIN_TIMEOUT_US		1000
+
+enum ufs_idle_phase {
+	UFS_IDLE_PHASE_LIGHT,
+	UFS_IDLE_PHASE_MODERATE,
+	UFS_IDLE_PHASE_HEAVY,
+	UFS_IDLE_PHASE_MAX,
+};
+
+enum ufs_idle_policy {
+	UFS_IDLE_POLICY_FIXED,
+	UFS_IDLE_POLICY_POWER,
+	UFS_IDLE_POLICY_BALANCED,
+	UFS_IDLE_POLICY_PERFORMANCE,
+	UFS_IDLE_POLICY_MAX,
+};
+
+/**
+ * struct ufs_idle_stats - predictor decision counters
+ * @gaps: idle gaps observed
+ * @exits: gaps longer than the timeout in use, i.e. hibern8 exits
+ * @fixed_exits: gaps longer than the fixed timeout
+ * @decisions: timeouts chosen from a histogram
+ * @changes: decisions that changed the timeout of a phase
+ * @phase_changes: workload phase transitions
+ */
+struct ufs_idle_stats {
+	u64 gaps;
+	u64 exits;
+	u64 fixed_exits;
+	u64 decisions;
+	u64 changes;
+	u64 phase_changes;
+};
+
+/**
+ * struct ufs_idle_pred - learns idle gaps and predicts the idle timeout
+ * @hist: idle gap histogram per workload phase
+ * @samples: gaps in each histogram
+ * @pending: gaps added to each histogram since its last decision
+ * @timeout_us: chosen timeout per phase
+ * @fixed_us: timeout of the fixed policy, also used while learning
+ * @exit_us: cost of one hibern8 exit under the power policy
+ * @policy: enum ufs_idle_policy
+ * @phase: current enum ufs_idle_phase
+ * @idle: the device is idle since @idle_start_ns
+ * @idle_start_ns: time the last request completed
+ * @window_start_ns: start of the phase classification window
+ * @window_busy: busy periods started in the current window
+ * @stats: decision counters
+ *
+ * The predictor has no locking and does not read the clock; callers
+ * serialize all calls and pass in the time stamps, which also allows
+ * replaying recorded request traces through it.
+ */
+struct ufs_idle_pred {
+	u32 hist[UFS_IDLE_PHASE_MAX][UFS_IDLE_BUCKETS];
+	u32 samples[UFS_IDLE_PHASE_MAX];
+	u32 pending[UFS_IDLE_PHASE_MAX];
+	u32 timeout_us[UFS_IDLE_PHASE_MAX];
+	u32 fixed_us;
+	u32 exit_us;
+	u8 policy;
+	u8 phase;
+	bool idle;
+	u64 idle_start_ns;
+	u64 window_start_ns;
+	u32 window_busy;
+	struct ufs_idle_stats stats;
+};
+
+void ufs_idle_pred_init(struct ufs_idle_pred *pred, u32 fixed_us, u32 exit_us,
+			enum ufs_idle_policy policy);
+void ufs_idle_pred_set_policy(struct ufs_idle_pred *pred,
+			      enum ufs_idle_policy policy);
+void ufs_idle_pred_busy(struct ufs_idle_pred *pred, u64 now_ns);
+void ufs_idle_pred_idle(struct ufs_idle_pred *pred, u64 now_ns);
+int ufs_idle_pred_parse_policy(const char *buf);
+const char *ufs_idle_pred_policy_name(enum ufs_idle_policy policy);
+
+/* timeout to use for the idle period that starts now */
+static inline u32 ufs_idle_pred_timeout_us(struct ufs_idle_pred *pred)
+{
+	return pred->timeout_us[pred->phase];
+}
+
+#endif /* _UFS_IDLE_PRED_H_ */
@@ -97,17 +97,15 @@ static struct ufs_mtk_bio_context_task *ufs_mtk_bio_curr_task(
 int mtk_btag_pidlog_add_ufs(struct request_queue *q, pid_t pid,
 	__u32 len, int rw)
 {
-	unsigned long flags;
 	struct ufs_mtk_bio_context *ctx;
 
 	ctx = ufs_mtk_bio_curr_ctx();
 	if (!ctx)
 		return 0;
 
-	spin_lock_irqsave(&ctx->lock, flags);
-	mtk_btag_pidlog_insert(&ctx->pidlog, pid, len, rw);
+	/* per-CPU staging, ctx->lock is not needed */
+	mtk_btag_pidlog_stage(ufs_mtk_btag, 0, pid, len, rw);
 	mtk_btag_mictx_eval_req(rw, 1, len);
-	spin_unlock_irqrestore(&ctx->lock, flags);
 
 	return 1;
 }
@@ -155,6 +153,7 @@ void ufs_mtk_biolog_queue_command(unsigned int task_id, struct scsi_cmnd *cmd)
 	tsk->lba = scsi_cmnd_lba(cmd);
 	tsk->len = scsi_cmnd_len(cmd);
 	tsk->cmd = scsi_cmnd_cmd(cmd);
+	tsk->uid = mtk_btag_uid_fetch();
 
 	tsk->t[tsk_request_start] = sched_clock();
 	for (i = tsk_send_cmd; i < tsk_max; i++)
@@ -208,7 +207,7 @@ void ufs_mtk_biolog_scsi_done_end(unsigned int task_id)
 	unsigned long flags;
 	int rw = -1, i;
 	__u64 busy_time;
-	__u32 size;
+	__u32 size = 0;
 
 	tsk = ufs_mtk_bio_curr_task(task_id, &ctx);
 	if (!tsk)
@@ -249,6 +248,9 @@ void ufs_mtk_biolog_scsi_done_end(unsigned int task_id)
 
 	spin_unlock_irqrestore(&ctx->lock, flags);
 
+	if (tp)
+		mtk_btag_uid_account(tsk->uid, rw, size, busy_time);
+
 	ufs_mtk_pr_tsk(tsk, tsk_scsi_done_end);
 }
 
@@ -281,7 +283,8 @@ static struct mtk_btag_trace *ufs_mtk_bio_print_trace(
 	if (!rt)
 		return NULL;
 
-	spin_lock_irqsave(&rt->lock, flags);
+	/* per-CPU ring, stay on this CPU until the trace is published */
+	local_irq_save(flags);
 	tr = mtk_btag_curr_trace(rt);
 
 	if (!tr)
@@ -290,7 +293,7 @@ static struct mtk_btag_trace *ufs_mtk_bio_print_trace(
 	memset(tr, 0, sizeof(struct mtk_btag_trace));
 	tr->pid = ctx->pid;
 	tr->qid = ctx->qid;
-	mtk_btag_pidlog_eval(&tr->pidlog, &ctx->pidlog);
+	mtk_btag_pidlog_merge(&tr->pidlog, ufs_mtk_btag, 0);
 	mtk_btag_vmstat_eval(&tr->vmstat);
 	mtk_btag_cpu_eval(&tr->cpu);
 	memcpy(&tr->throughput, &ctx->throughput,
@@ -300,7 +303,7 @@ static struct mtk_btag_trace *ufs_mtk_bio_print_trace(
 	tr->time = sched_clock();
 	mtk_btag_next_trace(rt);
 out:
-	spin_unlock_irqrestore(&rt->lock, flags);
+	local_irq_restore(flags);
 	return tr;
 }
 
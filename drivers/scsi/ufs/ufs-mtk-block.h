@@ -30,6 +30,16 @@ void ufs_mtk_biolog_scsi_done_start(unsigned int taski_id);
 void ufs_mtk_biolog_scsi_done_end(unsigned int taski_id);
 void ufs_mtk_biolog_check(unsigned long req_mask);
 
+/* per-UID accounting, provided by blocktag core */
+uid_t mtk_btag_uid_fetch(void);
+void mtk_btag_uid_account(uid_t uid, int write, __u32 size, __u64 latency);
+
+/* per-CPU pidlog staging, provided by blocktag core */
+void mtk_btag_pidlog_stage(struct mtk_blocktag *btag, unsigned int idx,
+	pid_t pid, __u32 len, int write);
+void mtk_btag_pidlog_merge(struct mtk_btag_pidlogger *pl,
+	struct mtk_blocktag *btag, unsigned int idx);
+
 #define UFS_BIOLOG_RINGBUF_MAX    120
 #define UFS_BIOLOG_CONTEXT_TASKS  32
 #define UFS_BIOLOG_CONTEXTS       1
@@ -48,6 +58,7 @@ struct ufs_mtk_bio_context_task {
 	__u16 cmd;
 	__u16 len;
 	__u32 lba;
+	uid_t uid;
 	uint64_t t[tsk_max];
 };
 
@@ -66,7 +77,6 @@ struct ufs_mtk_bio_context {
 	struct ufs_mtk_bio_context_task task[UFS_BIOLOG_CONTEXT_TASKS];
 	struct mtk_btag_workload workload;
 	struct mtk_btag_throughput throughput;
-	struct mtk_btag_pidlogger pidlog;
 };
 
 #else
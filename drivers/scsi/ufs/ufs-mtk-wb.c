@@ -0,0 +1,645 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Write booster control.
+ *
+ * The write booster buffer is enabled when non-background writes exceed
+ * UFS_MTK_WB_BURST_BYTES within a burst window and disabled again once
+ * no burst was seen for UFS_MTK_WB_HOLD_MS. Flush during hibern8 is
+ * enabled whenever the buffer holds data, explicit flush additionally
+ * while the display is blanked. In simulation mode the flags and
+ * attributes are answered by a buffer model, so the policy can be
+ * exercised on devices without a write booster.
+ */
+
+#include <linux/fb.h>
+#include <linux/math64.h>
+#include <linux/pm_runtime.h>
+#include <linux/sched/clock.h>
+#include <linux/string.h>
+#include <asm/unaligned.h>
+#include <scsi/scsi_cmnd.h>
+
+#include "ufshcd.h"
+#include "ufs-mtk.h"
+#include "ufs-mtk-wb.h"
+
+static const char * const ufs_mtk_wb_mode_names[] = {
+	[UFS_MTK_WB_OFF]	= "off",
+	[UFS_MTK_WB_AUTO]	= "auto",
+	[UFS_MTK_WB_ON]		= "on",
+};
+
+static inline struct ufs_mtk_wb *ufs_mtk_get_wb(struct ufs_hba *hba)
+{
+	struct ufs_mtk_host *host = ufshcd_get_variant(hba);
+
+	return host ? &host->wb : NULL;
+}
+
+static inline bool ufs_mtk_wb_usable(struct ufs_mtk_wb *wb)
+{
+	return wb->supported || wb->sim;
+}
+
+/* simulated buffer: flush during an idle gap of @gap_ns */
+static void ufs_mtk_wb_sim_idle(struct ufs_mtk_wb_sim *sim, u64 gap_ns)
+{
+	u64 flushed;
+
+	if (!sim->used || !(sim->flush_en || sim->flush_h8))
+		return;
+
+	flushed = div_u64(gap_ns, NSEC_PER_MSEC) *
+		  div_u64(sim->flush_bps, MSEC_PER_SEC);
+	sim->used -= min(sim->used, flushed);
+}
+
+/* simulated buffer: returns true if the write went to the buffer */
+static bool ufs_mtk_wb_sim_write(struct ufs_mtk_wb_sim *sim, u32 bytes)
+{
+	if (!sim->wb_en || sim->used + bytes > sim->capacity)
+		return false;
+
+	sim->used += bytes;
+	return true;
+}
+
+static void ufs_mtk_wb_sim_reset(struct ufs_mtk_wb_sim *sim)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->capacity = UFS_MTK_WB_SIM_CAPACITY;
+	sim->flush_bps = UFS_MTK_WB_SIM_FLUSH_BPS;
+}
+
+static int ufs_mtk_wb_set_flag(struct ufs_hba *hba, struct ufs_mtk_wb *wb,
+			       enum flag_idn idn, bool set)
+{
+	struct ufs_mtk_wb_sim *sim = &wb->sim_dev;
+	unsigned long flags;
+	bool *flag;
+	int err;
+
+	if (wb->sim) {
+		switch (idn) {
+		case QUERY_FLAG_IDN_WB_EN:
+			flag = &sim->wb_en;
+			break;
+		case QUERY_FLAG_IDN_WB_BUFF_FLUSH_EN:
+			flag = &sim->flush_en;
+			break;
+		case QUERY_FLAG_IDN_WB_BUFF_FLUSH_DURING_HIBERN8:
+			flag = &sim->flush_h8;
+			break;
+		default:
+			return -EINVAL;
+		}
+
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		*flag = set;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+		return 0;
+	}
+
+	err = ufshcd_query_flag(hba, set ? UPIU_QUERY_OPCODE_SET_FLAG :
+				UPIU_QUERY_OPCODE_CLEAR_FLAG, idn, NULL);
+	if (err) {
+		dev_err(hba->dev, "%s: %s flag 0x%x failed, err %d\n",
+			__func__, set ? "set" : "clear", idn, err);
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		wb->stats.query_err++;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+	}
+
+	return err;
+}
+
+static int ufs_mtk_wb_read_attr(struct ufs_hba *hba, struct ufs_mtk_wb *wb,
+				enum attr_idn idn, u32 *val)
+{
+	struct ufs_mtk_wb_sim *sim = &wb->sim_dev;
+	unsigned long flags;
+	int err = 0;
+
+	if (wb->sim) {
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		switch (idn) {
+		case QUERY_ATTR_IDN_AVAIL_WB_BUFF_SIZE:
+			*val = div64_u64((sim->capacity - sim->used) *
+					 UFS_MTK_WB_AVAIL_FULL, sim->capacity);
+			break;
+		case QUERY_ATTR_IDN_WB_FLUSH_STATUS:
+			if (!sim->used)
+				*val = WB_FLUSH_STATUS_COMPLETED;
+			else if (sim->flush_en)
+				*val = WB_FLUSH_STATUS_IN_PROGRESS;
+			else
+				*val = WB_FLUSH_STATUS_IDLE;
+			break;
+		case QUERY_ATTR_IDN_WB_BUFF_LIFE_TIME_EST:
+			*val = 0x01;
+			break;
+		default:
+			err = -EINVAL;
+			break;
+		}
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+		return err;
+	}
+
+	err = ufshcd_query_attr(hba, UPIU_QUERY_OPCODE_READ_ATTR, idn, 0, 0,
+				val);
+	if (err) {
+		dev_err(hba->dev, "%s: read attr 0x%x failed, err %d\n",
+			__func__, idn, err);
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		wb->stats.query_err++;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+	}
+
+	return err;
+}
+
+/*
+ * Only a device that is already active is touched, unless the display
+ * state changed; a suspended device keeps its flags and the next burst
+ * runs the policy again.
+ */
+static bool ufs_mtk_wb_get_device(struct ufs_hba *hba, struct ufs_mtk_wb *wb,
+				  bool wake)
+{
+	if (wb->sim)
+		return true;
+
+	if (wake) {
+		if (pm_runtime_get_sync(hba->dev) < 0) {
+			pm_runtime_put_noidle(hba->dev);
+			return false;
+		}
+		return true;
+	}
+
+	return pm_runtime_get_if_in_use(hba->dev) > 0;
+}
+
+static void ufs_mtk_wb_put_device(struct ufs_hba *hba, struct ufs_mtk_wb *wb)
+{
+	if (!wb->sim)
+		pm_runtime_put(hba->dev);
+}
+
+static void ufs_mtk_wb_ctrl(struct ufs_mtk_wb *wb)
+{
+	struct ufs_hba *hba = wb->hba;
+	bool want_wb, want_flush, want_flush_h8, force;
+	unsigned long flags;
+	u64 last_burst;
+	u32 val;
+
+	mutex_lock(&wb->ctrl_lock);
+
+	if (!ufs_mtk_wb_usable(wb))
+		goto out_unlock;
+
+	if (!ufs_mtk_wb_get_device(hba, wb, xchg(&wb->screen_changed, false)))
+		goto out_unlock;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	force = wb->stale;
+	wb->stale = false;
+	last_burst = wb->last_burst_ns;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	if (!ufs_mtk_wb_read_attr(hba, wb, QUERY_ATTR_IDN_AVAIL_WB_BUFF_SIZE,
+				  &val))
+		wb->avail = min_t(u32, val, UFS_MTK_WB_AVAIL_FULL);
+	if (!ufs_mtk_wb_read_attr(hba, wb,
+				  QUERY_ATTR_IDN_WB_BUFF_LIFE_TIME_EST, &val))
+		wb->life = val;
+
+	switch (wb->mode) {
+	case UFS_MTK_WB_ON:
+		want_wb = true;
+		break;
+	case UFS_MTK_WB_AUTO:
+		want_wb = last_burst && sched_clock() - last_burst <
+			  UFS_MTK_WB_HOLD_MS * NSEC_PER_MSEC;
+		break;
+	default:
+		want_wb = false;
+		break;
+	}
+
+	if (wb->life >= UFS_MTK_WB_LIFE_EXCEEDED)
+		want_wb = false;
+
+	want_flush_h8 = wb->avail < UFS_MTK_WB_AVAIL_FULL;
+	want_flush = want_flush_h8 && READ_ONCE(wb->screen_off);
+
+	if ((force || want_wb != wb->enabled) &&
+	    !ufs_mtk_wb_set_flag(hba, wb, QUERY_FLAG_IDN_WB_EN, want_wb)) {
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		if (want_wb && !wb->enabled)
+			wb->stats.enables++;
+		wb->enabled = want_wb;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+	}
+
+	if ((force || want_flush_h8 != wb->flush_h8) &&
+	    !ufs_mtk_wb_set_flag(hba, wb,
+				 QUERY_FLAG_IDN_WB_BUFF_FLUSH_DURING_HIBERN8,
+				 want_flush_h8))
+		wb->flush_h8 = want_flush_h8;
+
+	if ((force || want_flush != wb->flush_en) &&
+	    !ufs_mtk_wb_set_flag(hba, wb, QUERY_FLAG_IDN_WB_BUFF_FLUSH_EN,
+				 want_flush)) {
+		if (want_flush && !wb->flush_en) {
+			spin_lock_irqsave(hba->host->host_lock, flags);
+			wb->stats.flushes++;
+			spin_unlock_irqrestore(hba->host->host_lock, flags);
+		}
+		wb->flush_en = want_flush;
+	}
+
+	ufs_mtk_wb_put_device(hba, wb);
+
+	if (wb->enabled || wb->flush_en)
+		queue_delayed_work(system_freezable_wq, &wb->poll_work,
+				   msecs_to_jiffies(UFS_MTK_WB_POLL_MS));
+out_unlock:
+	mutex_unlock(&wb->ctrl_lock);
+}
+
+static void ufs_mtk_wb_ctrl_work(struct work_struct *work)
+{
+	ufs_mtk_wb_ctrl(container_of(work, struct ufs_mtk_wb, ctrl_work));
+}
+
+static void ufs_mtk_wb_poll_work(struct work_struct *work)
+{
+	ufs_mtk_wb_ctrl(container_of(to_delayed_work(work), struct ufs_mtk_wb,
+				     poll_work));
+}
+
+/*
+ * ufs_mtk_wb_ctrl() leaves a runtime suspended device alone and does not
+ * poll again, so a hold that expired meanwhile is noticed by the next
+ * write once the device is back.
+ */
+static void ufs_mtk_wb_check_hold(struct ufs_mtk_wb *wb, u64 now)
+{
+	if ((wb->enabled || wb->flush_en) &&
+	    !delayed_work_pending(&wb->poll_work) &&
+	    now - wb->last_burst_ns >= UFS_MTK_WB_HOLD_MS * NSEC_PER_MSEC)
+		queue_work(system_freezable_wq, &wb->ctrl_work);
+}
+
+/**
+ * ufs_mtk_wb_issue - account a command about to be issued
+ * @hba: per adapter instance
+ * @cmd: SCSI command
+ * @io_class: enum ufs_io_class of @cmd
+ *
+ * Called with the host lock held.
+ */
+void ufs_mtk_wb_issue(struct ufs_hba *hba, struct scsi_cmnd *cmd, u8 io_class)
+{
+	struct ufs_mtk_wb *wb = ufs_mtk_get_wb(hba);
+	u32 bytes = scsi_bufflen(cmd);
+	u64 now, elapsed;
+	bool hit;
+
+	if (!wb || !ufs_mtk_wb_usable(wb) ||
+	    cmd->sc_data_direction != DMA_TO_DEVICE || !bytes)
+		return;
+
+	now = sched_clock();
+
+	if (wb->sim) {
+		/* the model flushes while nothing is outstanding */
+		if (!hba->outstanding_reqs && hba->idle_pred.idle)
+			ufs_mtk_wb_sim_idle(&wb->sim_dev,
+					    now - hba->idle_pred.idle_start_ns);
+		hit = ufs_mtk_wb_sim_write(&wb->sim_dev, bytes);
+	} else {
+		hit = wb->enabled && wb->avail;
+	}
+
+	wb->stats.write_bytes += bytes;
+	if (hit)
+		wb->stats.hit_bytes += bytes;
+
+	elapsed = now - wb->rate_start_ns;
+	if (elapsed >= UFS_MTK_WB_RATE_WINDOW_NS) {
+		/* bytes per us is MB/s */
+		wb->stats.cur_mbps = div64_u64(wb->rate_acc * NSEC_PER_USEC,
+					       elapsed);
+		if (wb->stats.cur_mbps > wb->stats.peak_mbps)
+			wb->stats.peak_mbps = wb->stats.cur_mbps;
+		wb->rate_start_ns = now;
+		wb->rate_acc = 0;
+	}
+	wb->rate_acc += bytes;
+
+	ufs_mtk_wb_check_hold(wb, now);
+
+	if (io_class == UFS_IO_CLASS_BG)
+		return;
+
+	if (now - wb->burst_start_ns >= UFS_MTK_WB_BURST_WINDOW_NS) {
+		wb->burst_start_ns = now;
+		wb->burst_acc = 0;
+	}
+	wb->burst_acc += bytes;
+	if (wb->burst_acc < UFS_MTK_WB_BURST_BYTES)
+		return;
+
+	wb->stats.burst_bytes += bytes;
+	wb->last_burst_ns = now;
+	if (!wb->enabled && wb->mode == UFS_MTK_WB_AUTO)
+		queue_work(system_freezable_wq, &wb->ctrl_work);
+}
+
+/**
+ * ufs_mtk_wb_reset - the device was reset or power cycled
+ * @hba: per adapter instance
+ *
+ * The write booster flags are volatile; write all of them again.
+ */
+void ufs_mtk_wb_reset(struct ufs_hba *hba)
+{
+	struct ufs_mtk_wb *wb = ufs_mtk_get_wb(hba);
+	unsigned long flags;
+
+	if (!wb || !wb->supported)
+		return;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	wb->stale = true;
+	wb->enabled = false;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	queue_work(system_freezable_wq, &wb->ctrl_work);
+}
+
+/**
+ * ufs_mtk_wb_probe - detect a write booster buffer
+ * @hba: per adapter instance
+ *
+ * Only the shared buffer is supported; a buffer dedicated to one LU
+ * would need the LU index on every attribute query.
+ */
+void ufs_mtk_wb_probe(struct ufs_hba *hba)
+{
+	struct ufs_mtk_wb *wb = ufs_mtk_get_wb(hba);
+	u8 desc_buf[QUERY_DESC_MAX_SIZE] = { 0 };
+	int len = QUERY_DESC_MAX_SIZE;
+	u32 ext_feat, alloc_units;
+	int err;
+
+	if (!wb)
+		return;
+
+	err = ufshcd_query_descriptor_retry(hba, UPIU_QUERY_OPCODE_READ_DESC,
+		QUERY_DESC_IDN_DEVICE, 0, 0, desc_buf, &len);
+	if (err) {
+		dev_err(hba->dev, "%s: read device desc failed, err %d\n",
+			__func__, err);
+		return;
+	}
+
+	if (len < DEVICE_DESC_PARAM_WB_SHARED_ALLOC_UNITS + 4)
+		return;
+
+	ext_feat = get_unaligned_be32(
+			&desc_buf[DEVICE_DESC_PARAM_EXT_UFS_FEATURE_SUP]);
+	if (!(ext_feat & UFS_DEV_WRITE_BOOSTER_SUP))
+		return;
+
+	alloc_units = get_unaligned_be32(
+			&desc_buf[DEVICE_DESC_PARAM_WB_SHARED_ALLOC_UNITS]);
+	if (desc_buf[DEVICE_DESC_PARAM_WB_TYPE] != WB_BUF_MODE_SHARED ||
+	    !alloc_units) {
+		dev_info(hba->dev, "write booster: LU dedicated buffer not supported\n");
+		return;
+	}
+
+	wb->supported = true;
+	dev_info(hba->dev, "write booster: shared buffer, %u alloc units\n",
+		 alloc_units);
+}
+
+#ifdef CONFIG_FB
+static int ufs_mtk_wb_fb_notifier(struct notifier_block *nb,
+				  unsigned long event, void *data)
+{
+	struct ufs_mtk_wb *wb = container_of(nb, struct ufs_mtk_wb, fb_nb);
+	struct fb_event *evdata = data;
+	bool screen_off;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return 0;
+
+	switch (*(int *)evdata->data) {
+	case FB_BLANK_UNBLANK:
+		screen_off = false;
+		break;
+	case FB_BLANK_POWERDOWN:
+		screen_off = true;
+		break;
+	default:
+		return 0;
+	}
+
+	if (screen_off == READ_ONCE(wb->screen_off))
+		return 0;
+
+	WRITE_ONCE(wb->screen_off, screen_off);
+	if (ufs_mtk_wb_usable(wb)) {
+		WRITE_ONCE(wb->screen_changed, true);
+		queue_work(system_freezable_wq, &wb->ctrl_work);
+	}
+
+	return 0;
+}
+#endif
+
+static ssize_t ufs_mtk_wb_mode_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_mtk_wb *wb = container_of(attr, struct ufs_mtk_wb,
+					     mode_attr);
+
+	return snprintf(buf, PAGE_SIZE, "%s\n",
+			ufs_mtk_wb_mode_names[wb->mode]);
+}
+
+static ssize_t ufs_mtk_wb_mode_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_mtk_wb *wb = container_of(attr, struct ufs_mtk_wb,
+					     mode_attr);
+	int mode;
+
+	mode = sysfs_match_string(ufs_mtk_wb_mode_names, buf);
+	if (mode < 0)
+		return -EINVAL;
+
+	mutex_lock(&wb->ctrl_lock);
+	wb->mode = mode;
+	mutex_unlock(&wb->ctrl_lock);
+
+	queue_work(system_freezable_wq, &wb->ctrl_work);
+
+	return count;
+}
+
+static ssize_t ufs_mtk_wb_sim_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_mtk_wb *wb = container_of(attr, struct ufs_mtk_wb,
+					     sim_attr);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", wb->sim);
+}
+
+/* switching the model on or off starts from an empty, disabled buffer */
+static ssize_t ufs_mtk_wb_sim_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_mtk_wb *wb = container_of(attr, struct ufs_mtk_wb,
+					     sim_attr);
+	struct ufs_hba *hba = wb->hba;
+	unsigned long flags;
+	bool sim;
+
+	if (strtobool(buf, &sim))
+		return -EINVAL;
+
+	mutex_lock(&wb->ctrl_lock);
+	if (sim != wb->sim) {
+		spin_lock_irqsave(hba->host->host_lock, flags);
+		wb->sim = sim;
+		ufs_mtk_wb_sim_reset(&wb->sim_dev);
+		wb->enabled = false;
+		wb->stale = true;
+		spin_unlock_irqrestore(hba->host->host_lock, flags);
+		wb->flush_en = false;
+		wb->flush_h8 = false;
+		wb->avail = UFS_MTK_WB_AVAIL_FULL;
+		wb->life = 0;
+	}
+	mutex_unlock(&wb->ctrl_lock);
+
+	queue_work(system_freezable_wq, &wb->ctrl_work);
+
+	return count;
+}
+
+static ssize_t ufs_mtk_wb_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_mtk_wb *wb = container_of(attr, struct ufs_mtk_wb,
+					     stats_attr);
+	struct ufs_hba *hba = wb->hba;
+	struct ufs_mtk_wb_stats stats;
+	unsigned long flags;
+	bool enabled;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	stats = wb->stats;
+	enabled = wb->enabled;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return snprintf(buf, PAGE_SIZE,
+			"supported: %d\nsim: %d\nmode: %s\nenabled: %d\n"
+			"flush: %d\nflush_h8: %d\navail_pct: %u\n"
+			"life_est: 0x%x\nwrite_bytes: %llu\nhit_bytes: %llu\n"
+			"hit_pct: %llu\nburst_bytes: %llu\nenables: %llu\n"
+			"flushes: %llu\nquery_err: %llu\ncur_mbps: %u\n"
+			"peak_mbps: %u\n",
+			wb->supported, wb->sim,
+			ufs_mtk_wb_mode_names[wb->mode], enabled,
+			wb->flush_en, wb->flush_h8, wb->avail * 10, wb->life,
+			stats.write_bytes, stats.hit_bytes,
+			stats.write_bytes ?
+			div64_u64(stats.hit_bytes * 100, stats.write_bytes) : 0,
+			stats.burst_bytes, stats.enables, stats.flushes,
+			stats.query_err, stats.cur_mbps, stats.peak_mbps);
+}
+
+/* any write resets the counters */
+static ssize_t ufs_mtk_wb_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_mtk_wb *wb = container_of(attr, struct ufs_mtk_wb,
+					     stats_attr);
+	struct ufs_hba *hba = wb->hba;
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memset(&wb->stats, 0, sizeof(wb->stats));
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static void ufs_mtk_wb_add_sysfs_nodes(struct ufs_hba *hba,
+				       struct ufs_mtk_wb *wb)
+{
+	wb->mode_attr.show = ufs_mtk_wb_mode_show;
+	wb->mode_attr.store = ufs_mtk_wb_mode_store;
+	sysfs_attr_init(&wb->mode_attr.attr);
+	wb->mode_attr.attr.name = "wb_mode";
+	wb->mode_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &wb->mode_attr))
+		dev_err(hba->dev, "Failed to create sysfs for wb_mode\n");
+
+	wb->sim_attr.show = ufs_mtk_wb_sim_show;
+	wb->sim_attr.store = ufs_mtk_wb_sim_store;
+	sysfs_attr_init(&wb->sim_attr.attr);
+	wb->sim_attr.attr.name = "wb_sim";
+	wb->sim_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &wb->sim_attr))
+		dev_err(hba->dev, "Failed to create sysfs for wb_sim\n");
+
+	wb->stats_attr.show = ufs_mtk_wb_stats_show;
+	wb->stats_attr.store = ufs_mtk_wb_stats_store;
+	sysfs_attr_init(&wb->stats_attr.attr);
+	wb->stats_attr.attr.name = "wb_stats";
+	wb->stats_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &wb->stats_attr))
+		dev_err(hba->dev, "Failed to create sysfs for wb_stats\n");
+}
+
+void ufs_mtk_wb_init(struct ufs_hba *hba)
+{
+	struct ufs_mtk_wb *wb = ufs_mtk_get_wb(hba);
+
+	wb->hba = hba;
+	wb->mode = UFS_MTK_WB_AUTO;
+	wb->avail = UFS_MTK_WB_AVAIL_FULL;
+	ufs_mtk_wb_sim_reset(&wb->sim_dev);
+	mutex_init(&wb->ctrl_lock);
+	INIT_WORK(&wb->ctrl_work, ufs_mtk_wb_ctrl_work);
+	INIT_DELAYED_WORK(&wb->poll_work, ufs_mtk_wb_poll_work);
+
+#ifdef CONFIG_FB
+	wb->fb_nb.notifier_call = ufs_mtk_wb_fb_notifier;
+	if (fb_register_client(&wb->fb_nb))
+		dev_err(hba->dev, "%s: register fb notifier failed\n",
+			__func__);
+#endif
+
+	ufs_mtk_wb_add_sysfs_nodes(hba, wb);
+}
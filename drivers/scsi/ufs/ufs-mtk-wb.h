@@ -0,0 +1,160 @@
+/*
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UFS_MTK_WB_H
+#define _UFS_MTK_WB_H
+
+#include <linux/device.h>
+#include <linux/mutex.h>
+#include <linux/notifier.h>
+#include <linux/sizes.h>
+#include <linux/time64.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+struct ufs_hba;
+struct scsi_cmnd;
+
+/* non-background writes within a burst window that enable the buffer */
+#define UFS_MTK_WB_BURST_WINDOW_NS	(100 * NSEC_PER_MSEC)
+#define UFS_MTK_WB_BURST_BYTES		(8 * SZ_1M)
+/* the buffer stays enabled this long after the last burst */
+#define UFS_MTK_WB_HOLD_MS		1000
+/* buffer state is polled at this period while enabled or flushing */
+#define UFS_MTK_WB_POLL_MS		1000
+/* write throughput is sampled over this window */
+#define UFS_MTK_WB_RATE_WINDOW_NS	NSEC_PER_SEC
+
+/* bAvailableWBBufferSize is in units of 10% */
+#define UFS_MTK_WB_AVAIL_FULL		10
+/* bWBBufferLifeTimeEst at or above this value means the buffer is worn out */
+#define UFS_MTK_WB_LIFE_EXCEEDED	0x0B
+
+/* simulated device */
+#define UFS_MTK_WB_SIM_CAPACITY		(1024ULL * SZ_1M)
+#define UFS_MTK_WB_SIM_FLUSH_BPS	(200ULL * SZ_1M)
+
+enum ufs_mtk_wb_mode {
+	UFS_MTK_WB_OFF,
+	UFS_MTK_WB_AUTO,
+	UFS_MTK_WB_ON,
+	UFS_MTK_WB_MODE_MAX,
+};
+
+/**
+ * struct ufs_mtk_wb_sim - write buffer model answering the wb queries
+ * @capacity: buffer size in bytes
+ * @used: bytes written to the buffer and not flushed yet
+ * @flush_bps: flush speed in bytes per second of idle time
+ * @wb_en: fWriteBoosterEn
+ * @flush_en: fWBBufferFlushEn
+ * @flush_h8: fWBBufferFlushDuringHibernate
+ */
+struct ufs_mtk_wb_sim {
+	u64 capacity;
+	u64 used;
+	u64 flush_bps;
+	bool wb_en;
+	bool flush_en;
+	bool flush_h8;
+};
+
+/**
+ * struct ufs_mtk_wb_stats - write buffer counters
+ * @write_bytes: bytes written to the device
+ * @hit_bytes: bytes written while the buffer was enabled and not full
+ * @burst_bytes: bytes written after a burst window crossed the threshold
+ * @enables: times the buffer was enabled
+ * @flushes: explicit flushes started
+ * @query_err: failed flag or attribute queries
+ * @cur_mbps: write throughput of the last sampling window
+ * @peak_mbps: highest @cur_mbps
+ */
+struct ufs_mtk_wb_stats {
+	u64 write_bytes;
+	u64 hit_bytes;
+	u64 burst_bytes;
+	u64 enables;
+	u64 flushes;
+	u64 query_err;
+	u32 cur_mbps;
+	u32 peak_mbps;
+};
+
+/**
+ * struct ufs_mtk_wb - write booster (SLC buffer) control
+ * @hba: host the buffer belongs to
+ * @supported: device has a shared write booster buffer
+ * @sim: queries are answered by @sim_dev instead of the device
+ * @mode: enum ufs_mtk_wb_mode
+ * @enabled: fWriteBoosterEn as last set
+ * @flush_en: fWBBufferFlushEn as last set
+ * @flush_h8: fWBBufferFlushDuringHibernate as last set
+ * @screen_off: display is blanked, explicit flushes are allowed
+ * @screen_changed: @screen_off changed, resume the device to apply it
+ * @stale: the device was reset, the flag copies are unknown
+ * @avail: last bAvailableWBBufferSize
+ * @life: last bWBBufferLifeTimeEst
+ * @ctrl_lock: serializes @ctrl_work and sysfs against each other
+ * @ctrl_work: applies the policy to the device flags
+ * @poll_work: refreshes buffer state and runs @ctrl_work again
+ * @fb_nb: display blank notifier
+ * @burst_start_ns: start of the current burst window
+ * @burst_acc: non-background bytes in the current burst window
+ * @last_burst_ns: end of the last window that was a burst
+ * @rate_start_ns: start of the throughput sampling window
+ * @rate_acc: bytes in the throughput sampling window
+ * @sim_dev: simulated device
+ * @stats: counters
+ *
+ * The fields used on the I/O path (@burst_*, @rate_*, @sim_dev, @stats,
+ * @enabled and @stale) are protected by the host lock. The other flag
+ * copies are only touched under @ctrl_lock.
+ */
+struct ufs_mtk_wb {
+	struct ufs_hba *hba;
+	bool supported;
+	bool sim;
+	u8 mode;
+	bool enabled;
+	bool flush_en;
+	bool flush_h8;
+	bool screen_off;
+	bool screen_changed;
+	bool stale;
+	u8 avail;
+	u8 life;
+
+	struct mutex ctrl_lock;
+	struct work_struct ctrl_work;
+	struct delayed_work poll_work;
+	struct notifier_block fb_nb;
+
+	u64 burst_start_ns;
+	u64 burst_acc;
+	u64 last_burst_ns;
+	u64 rate_start_ns;
+	u64 rate_acc;
+
+	struct ufs_mtk_wb_sim sim_dev;
+	struct ufs_mtk_wb_stats stats;
+
+	struct device_attribute mode_attr;
+	struct device_attribute sim_attr;
+	struct device_attribute stats_attr;
+};
+
+void ufs_mtk_wb_init(struct ufs_hba *hba);
+void ufs_mtk_wb_probe(struct ufs_hba *hba);
+void ufs_mtk_wb_reset(struct ufs_hba *hba);
+void ufs_mtk_wb_issue(struct ufs_hba *hba, struct scsi_cmnd *cmd, u8 io_class);
+
+#endif /* _UFS_MTK_WB_H */
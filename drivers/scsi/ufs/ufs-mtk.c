@@ -943,6 +943,8 @@ static int ufs_mtk_init(struct ufs_hba *hba)
 	ufs_mtk_parse_auto_hibern8_timer(hba);
 
 	ufs_mtk_perf_init_crypto(hba);
+
+	ufs_mtk_wb_init(hba);
 out:
 	return err;
 }
@@ -2117,6 +2119,13 @@ static void ufs_mtk_auto_hibern8(struct ufs_hba *hba, bool enable)
 	}
 }
 
+/* reprogram a running auto-hibern8 timer after hba->ahit changed */
+void ufs_mtk_auto_hibern8_update(struct ufs_hba *hba)
+{
+	if (hba->ahit && ufs_mtk_auto_hibern8_enabled)
+		ufshcd_writel(hba, hba->ahit, REG_AUTO_HIBERNATE_IDLE_TIMER);
+}
+
 int ufs_mtk_auto_hiber8_quirk_handler(struct ufs_hba *hba, bool enable)
 {
 	/*
@@ -24,6 +24,7 @@
 #include <linux/hie.h>
 #include <linux/pm_qos.h>
 #include "ufshcd.h"
+#include "ufs-mtk-wb.h"
 
 #define UPIU_COMMAND_CRYPTO_EN_OFFSET	23
 
@@ -192,6 +193,8 @@ struct ufs_mtk_host {
 	struct delayed_work pm_qos_rel;
 	spinlock_t qos_lock;
 	int pm_qos_value;
+
+	struct ufs_mtk_wb wb;
 };
 
 enum {
@@ -208,6 +211,7 @@ extern bool ufs_mtk_host_deep_stall_enable;
 extern bool ufs_mtk_host_scramble_enable;
 
 void ufs_mtk_add_sysfs_nodes(struct ufs_hba *hba);
+void ufs_mtk_auto_hibern8_update(struct ufs_hba *hba);
 int ufs_mtk_auto_hiber8_quirk_handler(struct ufs_hba *hba, bool enable);
 void ufs_mtk_cache_setup_cmd(struct scsi_cmnd *cmd);
 void ufs_mtk_crypto_cal_dun(u32 alg_id, u64 iv, u32 *dunl, u32 *dunu);
@@ -147,6 +147,10 @@ enum flag_idn {
 	QUERY_FLAG_IDN_BKOPS_EN         = 0x04,
 	/* MTK PATCH: flag for fw update feasibility check */
 	QUERY_FLAG_IDN_PERMANENTLY_DISABLE_FW_UPDATE = 0xB,
+	/* MTK PATCH: write booster */
+	QUERY_FLAG_IDN_WB_EN			= 0x0E,
+	QUERY_FLAG_IDN_WB_BUFF_FLUSH_EN		= 0x0F,
+	QUERY_FLAG_IDN_WB_BUFF_FLUSH_DURING_HIBERN8 = 0x10,
 };
 
 /* Attribute idn for Query requests */
@@ -159,6 +163,11 @@ enum attr_idn {
 	QUERY_ATTR_IDN_EE_STATUS	= 0x0E,
 	/* MTK PATCH: attribute for FFU status check */
 	QUERY_ATTR_IDN_DEVICE_FFU_STATUS = 0x14,
+	/* MTK PATCH: write booster */
+	QUERY_ATTR_IDN_WB_FLUSH_STATUS	= 0x1C,
+	QUERY_ATTR_IDN_AVAIL_WB_BUFF_SIZE = 0x1D,
+	QUERY_ATTR_IDN_WB_BUFF_LIFE_TIME_EST = 0x1E,
+	QUERY_ATTR_IDN_CURR_WB_BUFF_SIZE = 0x1F,
 };
 
 /* MTK PATCH: status of FFU */
@@ -291,6 +300,29 @@ enum device_desc_param {
 #if defined(CONFIG_UFSHPB)
 	DEVICE_DESC_PARAM_HPB_VER		= 0x40,
 #endif
+	/* MTK PATCH: write booster, UFS 2.2 and 3.1 */
+	DEVICE_DESC_PARAM_EXT_UFS_FEATURE_SUP	= 0x4F,
+	DEVICE_DESC_PARAM_WB_PRESRV_USRSPC_EN	= 0x53,
+	DEVICE_DESC_PARAM_WB_TYPE		= 0x54,
+	DEVICE_DESC_PARAM_WB_SHARED_ALLOC_UNITS	= 0x55,
+};
+
+/* MTK PATCH: dExtendedUFSFeaturesSupport */
+#define UFS_DEV_WRITE_BOOSTER_SUP	(1 << 8)
+
+/* MTK PATCH: bWriteBoosterBufferType */
+enum ufs_wb_buffer_type {
+	WB_BUF_MODE_LU_DEDICATED	= 0x0,
+	WB_BUF_MODE_SHARED		= 0x1,
+};
+
+/* MTK PATCH: bWBBufferFlushStatus */
+enum ufs_wb_flush_status {
+	WB_FLUSH_STATUS_IDLE		= 0x0,
+	WB_FLUSH_STATUS_IN_PROGRESS	= 0x1,
+	WB_FLUSH_STATUS_STOPPED		= 0x2,
+	WB_FLUSH_STATUS_COMPLETED	= 0x3,
+	WB_FLUSH_STATUS_FAILURE		= 0x4,
 };
 
 /*
@@ -39,6 +39,7 @@
 
 #include <linux/async.h>
 #include <linux/devfreq.h>
+#include <linux/ioprio.h>
 #include <linux/nls.h>
 #include <linux/of.h>
 #include <linux/bitfield.h>
@@ -1917,6 +1918,7 @@ static ssize_t ufshcd_clkgate_delay_store(struct device *dev,
 
 	spin_lock_irqsave(hba->host->host_lock, flags);
 	hba->clk_gating.delay_ms = value;
+	hba->idle_fixed_gate_ms = value; /* MTK PATCH */
 	spin_unlock_irqrestore(hba->host->host_lock, flags);
 	return count;
 }
@@ -2038,6 +2040,100 @@ static void ufshcd_clk_scaling_update_busy(struct ufs_hba *hba)
 		scaling->is_busy_started = false;
 	}
 }
+/*
+ * MTK PATCH: idle timeout prediction
+ *
+ * The predictor sees a busy period start when a command is issued with
+ * nothing outstanding and an idle period start when the last outstanding
+ * command completes. Unless the policy is fixed, the timeout it predicts
+ * for the current workload phase replaces both the auto-hibern8 timer and
+ * the clock gating delay. Callers hold the host lock.
+ */
+static u32 ufshcd_ahit_to_us(u32 ahit)
+{
+	u32 us = FIELD_GET(UFSHCI_AHIBERN8_TIMER_MASK, ahit);
+	u32 scale = FIELD_GET(UFSHCI_AHIBERN8_SCALE_MASK, ahit);
+
+	/* scale 6 and 7 are reserved */
+	for (scale = min_t(u32, scale, 5); scale; scale--)
+		us *= UFSHCI_AHIBERN8_SCALE_FACTOR;
+
+	return us;
+}
+
+static u32 ufshcd_us_to_ahit(u32 us)
+{
+	u32 scale = 0;
+
+	us = min_t(u32, us, UFSHCI_AHIBERN8_MAX);
+	while (us > UFSHCI_AHIBERN8_TIMER_MASK) {
+		us = DIV_ROUND_UP(us, UFSHCI_AHIBERN8_SCALE_FACTOR);
+		scale++;
+	}
+
+	return FIELD_PREP(UFSHCI_AHIBERN8_TIMER_MASK, us) |
+	       FIELD_PREP(UFSHCI_AHIBERN8_SCALE_MASK, scale);
+}
+
+static void ufshcd_idle_set_timers(struct ufs_hba *hba, u32 ahit,
+				   unsigned long gate_ms)
+{
+	if (ufshcd_is_clkgating_allowed(hba))
+		hba->clk_gating.delay_ms = gate_ms;
+
+	if (hba->idle_fixed_ahit && ahit != hba->ahit) {
+		hba->ahit = ahit;
+		hba->idle_ahit_dirty = true;
+	}
+}
+
+static void ufshcd_idle_pred_busy(struct ufs_hba *hba, u64 now)
+{
+	u32 timeout_us;
+
+	ufs_idle_pred_busy(&hba->idle_pred, now);
+
+	if (hba->idle_pred.policy == UFS_IDLE_POLICY_FIXED)
+		return;
+
+	timeout_us = ufs_idle_pred_timeout_us(&hba->idle_pred);
+	ufshcd_idle_set_timers(hba, ufshcd_us_to_ahit(timeout_us),
+			       DIV_ROUND_UP(timeout_us, USEC_PER_MSEC));
+}
+
+static void ufshcd_idle_pred_idle(struct ufs_hba *hba)
+{
+	ufs_idle_pred_idle(&hba->idle_pred, sched_clock());
+
+	/*
+	 * A timer disabled before the doorbell picks up the new value when
+	 * it is enabled again, a running one must be reprogrammed.
+	 */
+	if (hba->idle_ahit_dirty && !hba->pm_op_in_progress) {
+		hba->idle_ahit_dirty = false;
+		ufs_mtk_auto_hibern8_update(hba);
+	}
+}
+
+static void ufshcd_init_idle_pred(struct ufs_hba *hba)
+{
+	u32 fixed_us;
+
+	hba->idle_fixed_ahit = hba->ahit;
+	hba->idle_fixed_gate_ms = hba->clk_gating.delay_ms;
+
+	if (hba->idle_fixed_ahit)
+		fixed_us = ufshcd_ahit_to_us(hba->idle_fixed_ahit);
+	else
+		fixed_us = hba->idle_fixed_gate_ms * USEC_PER_MSEC;
+
+	/* nothing to adapt without auto-hibern8 or clock gating */
+	ufs_idle_pred_init(&hba->idle_pred, max_t(u32, fixed_us, 1),
+			   UFS_IDLE_EXIT_US,
+			   fixed_us ? UFS_IDLE_POLICY_BALANCED :
+				      UFS_IDLE_POLICY_FIXED);
+}
+
 /**
  * MTK PATCH
  * ufshcd_send_command - Send SCSI or device management commands
@@ -2055,6 +2151,9 @@ void ufshcd_send_command(struct ufs_hba *hba, unsigned int task_tag)
 	ufshcd_vops_res_ctrl(hba, UFS_RESCTL_CMD_SEND);
 	ufs_mtk_auto_hiber8_quirk_handler(hba, false);
 
+	if (!hba->outstanding_reqs)
+		ufshcd_idle_pred_busy(hba, hba->lrb[task_tag].issue_time_stamp);
+
 	__set_bit(task_tag, &hba->outstanding_reqs);
 	ufs_mtk_biolog_check(hba->outstanding_reqs);
 	ufshcd_writel(hba, 1 << task_tag, REG_UTP_TRANSFER_REQ_DOOR_BELL);
@@ -2594,6 +2693,7 @@ static int ufshcd_comp_scsi_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
 						lrbp->cmd->sc_data_direction);
 		ufshcd_prepare_utp_scsi_cmd_upiu(lrbp, upiu_flags);
 #if defined(CONFIG_UFSHPB)
+		lrbp->hpb_read = false;
 		if (hba->ufshpb_state == HPB_PRESENT
 			&& hba->issue_ioctl == false)
 			ufshpb_prep_fn(hba, lrbp);
@@ -2637,6 +2737,152 @@ static inline u16 ufshcd_upiu_wlun_to_scsi_wlun(u8 upiu_wlun_id)
 }
 */
 
+/**
+ * MTK PATCH
+ * ufshcd_io_class - classify a request for tag reservation
+ * @rq: block layer request
+ *
+ * Requests carry the real-time I/O class when io_boost tagged them at
+ * submit_bio() time (UX threads and top-app tasks) or when the submitting
+ * task itself has that class. Those are foreground. Asynchronous and
+ * writeback writes are background unless they carry metadata.
+ */
+static u8 ufshcd_io_class(struct request *rq)
+{
+	if (blk_rq_is_passthrough(rq))
+		return UFS_IO_CLASS_BE;
+
+	if (IOPRIO_PRIO_CLASS(req_get_ioprio(rq)) == IOPRIO_CLASS_RT)
+		return UFS_IO_CLASS_FG;
+
+	if (rq_data_dir(rq) == WRITE &&
+	    !(rq->cmd_flags & (REQ_META | REQ_PRIO)) &&
+	    ((rq->cmd_flags & REQ_BACKGROUND) || !op_is_sync(rq->cmd_flags)))
+		return UFS_IO_CLASS_BG;
+
+	return UFS_IO_CLASS_BE;
+}
+
+/*
+ * MTK PATCH
+ * Whether background writes hold all tags they may take. The count is
+ * racy against completions, which only makes it more conservative for
+ * one request.
+ */
+static bool ufshcd_bg_tags_exhausted(struct ufs_hba *hba)
+{
+	int reserved = READ_ONCE(hba->fg_reserved_tags);
+	unsigned long bg_reqs;
+
+	if (!reserved)
+		return false;
+
+	bg_reqs = READ_ONCE(hba->outstanding_reqs) & READ_ONCE(hba->bg_reqs);
+
+	return hweight_long(bg_reqs) >= hba->nutrs - reserved;
+}
+
+/*
+ * MTK PATCH
+ * Find a request that is not a background write among the first
+ * UFS_FG_LOOKAHEAD requests behind @bg, asking the elevator for more when
+ * its dispatch list runs out. Called with the queue lock held.
+ */
+static struct request *ufshcd_find_fg_rq(struct request_queue *q,
+					 struct request *bg)
+{
+	struct request *rq = bg;
+	int i;
+
+	for (i = 0; i < UFS_FG_LOOKAHEAD; i++) {
+		if (list_is_last(&rq->queuelist, &q->queue_head) &&
+		    (!q->elevator ||
+		     !q->elevator->type->ops.sq.elevator_dispatch_fn(q, 0)))
+			return NULL;
+
+		rq = list_next_entry(rq, queuelist);
+		if (ufshcd_io_class(rq) != UFS_IO_CLASS_BG)
+			return rq;
+	}
+
+	return NULL;
+}
+
+/**
+ * MTK PATCH
+ * ufshcd_prep_rq - hold background writes back for foreground requests
+ * @q: request queue of a LU
+ * @rq: request at the head of its dispatch list
+ *
+ * Background writes may not take the last fg_reserved_tags tags, so a
+ * foreground request never waits for a tag behind a full queue of
+ * writeback. A background write that would take one of them is deferred
+ * before the SCSI prep, and a foreground request queued behind it is
+ * moved ahead and dispatched instead. The LU is never marked busy: the
+ * queue is run again right away when a request was moved ahead, and
+ * otherwise by the completion of a background write.
+ */
+static int ufshcd_prep_rq(struct request_queue *q, struct request *rq)
+{
+	struct scsi_device *sdev = q->queuedata;
+	struct ufs_hba *hba = shost_priv(sdev->host);
+	struct request *fg;
+
+	if (ufshcd_io_class(rq) != UFS_IO_CLASS_BG ||
+	    !ufshcd_bg_tags_exhausted(hba))
+		return hba->scsi_prep_rq(q, rq);
+
+	fg = ufshcd_find_fg_rq(q, rq);
+	if (fg) {
+		list_move(&fg->queuelist, &q->queue_head);
+		blk_run_queue_async(q);
+		return BLKPREP_DEFER;
+	}
+
+	/* pairs with the barrier in ufshcd_release_bg() */
+	WRITE_ONCE(hba->bg_held, true);
+	smp_mb();
+	if (!ufshcd_bg_tags_exhausted(hba))
+		return hba->scsi_prep_rq(q, rq);
+
+	return BLKPREP_DEFER;
+}
+
+/* MTK PATCH: run the LUs holding background writes back */
+static void ufshcd_release_bg(struct ufs_hba *hba, unsigned long completed)
+{
+	struct scsi_device *sdev;
+
+	if (!(completed & hba->bg_reqs))
+		return;
+
+	/* pairs with the barrier in ufshcd_prep_rq() */
+	smp_mb();
+	if (!READ_ONCE(hba->bg_held))
+		return;
+
+	WRITE_ONCE(hba->bg_held, false);
+	__shost_for_each_device(sdev, hba->host)
+		blk_run_queue_async(sdev->request_queue);
+}
+
+/* MTK PATCH */
+static void ufshcd_io_class_account(struct ufs_hba *hba,
+				    struct ufshcd_lrb *lrbp)
+{
+	struct ufs_io_class_stat *stat = &hba->io_class_stat[lrbp->io_class];
+	int dir = rq_data_dir(lrbp->cmd->request);
+	u64 lat_us;
+
+	lat_us = div_u64(lrbp->complete_time_stamp - lrbp->issue_time_stamp,
+			 NSEC_PER_USEC);
+
+	stat->cnt[dir]++;
+	stat->total_us[dir] += lat_us;
+	if (lat_us > stat->max_us[dir])
+		stat->max_us[dir] = lat_us;
+}
+
 /**
  * ufshcd_queuecommand - main entry point for SCSI requests
  * @cmd: command from SCSI Midlayer
@@ -2651,6 +2897,7 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	unsigned long flags;
 	int tag;
 	int err = 0;
+	u8 io_class;
 
 	hba = shost_priv(host);
 
@@ -2678,6 +2925,9 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 			__func__, tag, cmd, cmd->request);
 		BUG();
 	}
+
+	/* MTK PATCH: background writes were held back in ufshcd_prep_rq() */
+	io_class = ufshcd_io_class(cmd->request);
 	ufs_mtk_biolog_queue_command(tag, cmd);  /* MTK PATCH */
 
 	if (!down_read_trylock(&hba->clk_scaling_lock))
@@ -2744,6 +2994,7 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	lrbp->lun = ufshcd_scsi_to_upiu_lun(cmd->device->lun);
 	lrbp->intr_cmd = !ufshcd_is_intr_aggr_allowed(hba) ? true : false;
 	lrbp->req_abort_skip = false;
+	lrbp->io_class = io_class;	/* MTK PATCH */
 
 	/* reset crypto_en first and set it later only on encrypted request */
 	lrbp->crypto_en = 0;
@@ -2790,6 +3041,9 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 
 	err = ufshcd_map_sg(hba, lrbp);
 	if (err) {
+#if defined(CONFIG_UFSHPB)
+		ufshpb_restore_cdb(lrbp);
+#endif
 		lrbp->cmd = NULL;
 		clear_bit_unlock(tag, &hba->lrb_in_use);
 		goto out;
@@ -2801,6 +3055,12 @@ static int ufshcd_queuecommand(struct Scsi_Host *host, struct scsi_cmnd *cmd)
 	spin_lock_irqsave(hba->host->host_lock, flags);
 
 	ufshcd_vops_setup_xfer_req(hba, tag, (lrbp->cmd ? true : false));
+	/* MTK PATCH */
+	if (io_class == UFS_IO_CLASS_BG)
+		__set_bit(tag, &hba->bg_reqs);
+	else
+		__clear_bit(tag, &hba->bg_reqs);
+	ufs_mtk_wb_issue(hba, cmd, io_class);
 	ufshcd_send_command(hba, tag);
 
 /* MTK PATCH for SPOH */
@@ -4980,6 +5240,14 @@ static int ufshcd_slave_configure(struct scsi_device *sdev)
 	blk_queue_update_dma_pad(q, PRDT_DATA_BYTE_COUNT_PAD - 1);
 	blk_queue_max_segment_size(q, PRDT_DATA_BYTE_COUNT_MAX);
 
+	/* MTK PATCH: foreground tag reservation, legacy request path only */
+	if (!q->mq_ops && q->prep_rq_fn) {
+		struct ufs_hba *fg_hba = shost_priv(sdev->host);
+
+		fg_hba->scsi_prep_rq = q->prep_rq_fn;
+		blk_queue_prep_rq(q, ufshcd_prep_rq);
+	}
+
 	/*
 	 * MTK PATCH: invoke vendor specific callback if existed.
 	 */
@@ -5269,6 +5537,10 @@ static void __ufshcd_transfer_req_compl(struct ufs_hba *hba,
 			}
 #endif
 			lrbp->complete_time_stamp = sched_clock();
+			ufshcd_io_class_account(hba, lrbp); /* MTK PATCH */
+#if defined(CONFIG_UFSHPB)
+			ufshpb_restore_cdb(lrbp);
+#endif
 			/* Mark completed command as NULL in LRB */
 			lrbp->cmd = NULL;
 			clear_bit_unlock(index, &hba->lrb_in_use);
@@ -5324,10 +5596,13 @@ static void __ufshcd_transfer_req_compl(struct ufs_hba *hba,
 
 	/* clear corresponding bits of completed commands */
 	hba->outstanding_reqs ^= completed_reqs;
+	ufshcd_release_bg(hba, completed_reqs); /* MTK PATCH */
 	/* MTK PATCH */
 	ufshcd_vops_complete_xfer_req(hba);
 	ufs_mtk_biolog_check(hba->outstanding_reqs);
 	ufshcd_vops_res_ctrl(hba, UFS_RESCTL_CMD_COMP);
+	if (!hba->outstanding_reqs)
+		ufshcd_idle_pred_idle(hba);
 	ufs_mtk_auto_hiber8_quirk_handler(hba, true);
 
 	ufshcd_clk_scaling_update_busy(hba);
@@ -6612,8 +6887,13 @@ static int ufshcd_abort(struct scsi_cmnd *cmd)
 	spin_lock_irqsave(host->host_lock, flags);
 
 	ufshcd_outstanding_req_clear(hba, tag);
+#if defined(CONFIG_UFSHPB)
+	ufshpb_restore_cdb(&hba->lrb[tag]);
+#endif
 	hba->lrb[tag].cmd = NULL;
 	ufshcd_vops_res_ctrl(hba, UFS_RESCTL_CMD_COMP);
+	if (!hba->outstanding_reqs)
+		ufshcd_idle_pred_idle(hba);
 	ufs_mtk_auto_hiber8_quirk_handler(hba, true);
 
 	spin_unlock_irqrestore(host->host_lock, flags);
@@ -7760,6 +8040,7 @@ static int ufshcd_probe_hba(struct ufs_hba *hba)
 		}
 		hba->card = card;
 		ufs_fixup_device_setup(hba, card);
+		ufs_mtk_wb_probe(hba); /* MTK PATCH */
 	}
 
 	ufshcd_tune_unipro_params(hba);
@@ -7772,6 +8053,7 @@ static int ufshcd_probe_hba(struct ufs_hba *hba)
 	/* UFS device is also active now */
 	ufshcd_set_ufs_dev_active(hba);
 	ufshcd_force_reset_auto_bkops(hba);
+	ufs_mtk_wb_reset(hba); /* MTK PATCH */
 	hba->wlun_dev_clr_ua = true;
 
 	if (ufshcd_get_max_pwr_mode(hba)) {
@@ -9360,16 +9642,225 @@ static void ufshcd_add_spm_lvl_sysfs_nodes(struct ufs_hba *hba)
 		dev_err(hba->dev, "Failed to create sysfs for spm_lvl\n");
 }
 
+/* MTK PATCH */
+static ssize_t ufshcd_fg_reserved_tags_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", hba->fg_reserved_tags);
+}
+
+static ssize_t ufshcd_fg_reserved_tags_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned int value;
+
+	if (kstrtouint(buf, 0, &value))
+		return -EINVAL;
+
+	/* background writes must always be able to make progress */
+	if (value >= hba->nutrs)
+		return -EINVAL;
+
+	WRITE_ONCE(hba->fg_reserved_tags, value);
+
+	return count;
+}
+
+static ssize_t ufshcd_io_class_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	static const char * const names[UFS_IO_CLASS_MAX] = {
+		[UFS_IO_CLASS_FG] = "fg",
+		[UFS_IO_CLASS_BE] = "be",
+		[UFS_IO_CLASS_BG] = "bg",
+	};
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_io_class_stat stat[UFS_IO_CLASS_MAX];
+	unsigned long flags;
+	int curr_len = 0;
+	int i, dir;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memcpy(stat, hba->io_class_stat, sizeof(stat));
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	curr_len += snprintf(buf, PAGE_SIZE,
+			     "class dir count avg_us max_us\n");
+	for (i = 0; i < UFS_IO_CLASS_MAX; i++) {
+		for (dir = READ; dir <= WRITE; dir++) {
+			curr_len += snprintf((buf + curr_len),
+				(PAGE_SIZE - curr_len),
+				"%s %c %llu %llu %llu\n", names[i],
+				dir == READ ? 'R' : 'W',
+				stat[i].cnt[dir],
+				stat[i].cnt[dir] ?
+				div64_u64(stat[i].total_us[dir],
+					  stat[i].cnt[dir]) : 0,
+				stat[i].max_us[dir]);
+		}
+	}
+
+	return curr_len;
+}
+
+/* any write resets the counters */
+static ssize_t ufshcd_io_class_stat_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memset(hba->io_class_stat, 0, sizeof(hba->io_class_stat));
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static ssize_t ufshcd_idle_policy_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+
+	return snprintf(buf, PAGE_SIZE, "%s\n",
+			ufs_idle_pred_policy_name(hba->idle_pred.policy));
+}
+
+static ssize_t ufshcd_idle_policy_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags;
+	int policy;
+
+	policy = ufs_idle_pred_parse_policy(buf);
+	if (policy < 0)
+		return -EINVAL;
+
+	if (policy != UFS_IDLE_POLICY_FIXED && !hba->idle_fixed_ahit &&
+	    !ufshcd_is_clkgating_allowed(hba))
+		return -EOPNOTSUPP;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	ufs_idle_pred_set_policy(&hba->idle_pred, policy);
+	if (policy == UFS_IDLE_POLICY_FIXED)
+		ufshcd_idle_set_timers(hba, hba->idle_fixed_ahit,
+				       hba->idle_fixed_gate_ms);
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static ssize_t ufshcd_idle_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	static const char * const phases[UFS_IDLE_PHASE_MAX] = {
+		[UFS_IDLE_PHASE_LIGHT] = "light",
+		[UFS_IDLE_PHASE_MODERATE] = "moderate",
+		[UFS_IDLE_PHASE_HEAVY] = "heavy",
+	};
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	struct ufs_idle_stats stats;
+	u32 timeout_us[UFS_IDLE_PHASE_MAX];
+	u32 samples[UFS_IDLE_PHASE_MAX];
+	unsigned long flags;
+	int curr_len = 0;
+	u8 phase;
+	int i;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	stats = hba->idle_pred.stats;
+	memcpy(timeout_us, hba->idle_pred.timeout_us, sizeof(timeout_us));
+	memcpy(samples, hba->idle_pred.samples, sizeof(samples));
+	phase = hba->idle_pred.phase;
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	curr_len += snprintf(buf, PAGE_SIZE,
+			     "gaps: %llu\nexits: %llu\nfixed_exits: %llu\n"
+			     "decisions: %llu\nchanges: %llu\n"
+			     "phase_changes: %llu\nphase: %s\n",
+			     stats.gaps, stats.exits, stats.fixed_exits,
+			     stats.decisions, stats.changes,
+			     stats.phase_changes, phases[phase]);
+	for (i = 0; i < UFS_IDLE_PHASE_MAX; i++)
+		curr_len += snprintf((buf + curr_len), (PAGE_SIZE - curr_len),
+				     "%s: timeout_us %u samples %u\n",
+				     phases[i], timeout_us[i], samples[i]);
+
+	return curr_len;
+}
+
+/* any write resets the counters, the learned histograms are kept */
+static ssize_t ufshcd_idle_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ufs_hba *hba = dev_get_drvdata(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(hba->host->host_lock, flags);
+	memset(&hba->idle_pred.stats, 0, sizeof(hba->idle_pred.stats));
+	spin_unlock_irqrestore(hba->host->host_lock, flags);
+
+	return count;
+}
+
+static void ufshcd_add_idle_pred_sysfs_nodes(struct ufs_hba *hba)
+{
+	hba->idle_policy_attr.show = ufshcd_idle_policy_show;
+	hba->idle_policy_attr.store = ufshcd_idle_policy_store;
+	sysfs_attr_init(&hba->idle_policy_attr.attr);
+	hba->idle_policy_attr.attr.name = "idle_policy";
+	hba->idle_policy_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &hba->idle_policy_attr))
+		dev_err(hba->dev, "Failed to create sysfs for idle_policy\n");
+
+	hba->idle_stats_attr.show = ufshcd_idle_stats_show;
+	hba->idle_stats_attr.store = ufshcd_idle_stats_store;
+	sysfs_attr_init(&hba->idle_stats_attr.attr);
+	hba->idle_stats_attr.attr.name = "idle_stats";
+	hba->idle_stats_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &hba->idle_stats_attr))
+		dev_err(hba->dev, "Failed to create sysfs for idle_stats\n");
+}
+
+static void ufshcd_add_fg_io_sysfs_nodes(struct ufs_hba *hba)
+{
+	hba->fg_reserved_tags_attr.show = ufshcd_fg_reserved_tags_show;
+	hba->fg_reserved_tags_attr.store = ufshcd_fg_reserved_tags_store;
+	sysfs_attr_init(&hba->fg_reserved_tags_attr.attr);
+	hba->fg_reserved_tags_attr.attr.name = "fg_reserved_tags";
+	hba->fg_reserved_tags_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &hba->fg_reserved_tags_attr))
+		dev_err(hba->dev, "Failed to create sysfs for fg_reserved_tags\n");
+
+	hba->io_class_stat_attr.show = ufshcd_io_class_stat_show;
+	hba->io_class_stat_attr.store = ufshcd_io_class_stat_store;
+	sysfs_attr_init(&hba->io_class_stat_attr.attr);
+	hba->io_class_stat_attr.attr.name = "io_class_stat";
+	hba->io_class_stat_attr.attr.mode = 0644;
+	if (device_create_file(hba->dev, &hba->io_class_stat_attr))
+		dev_err(hba->dev, "Failed to create sysfs for io_class_stat\n");
+}
+
 static inline void ufshcd_add_sysfs_nodes(struct ufs_hba *hba)
 {
 	ufshcd_add_rpm_lvl_sysfs_nodes(hba);
 	ufshcd_add_spm_lvl_sysfs_nodes(hba);
+	ufshcd_add_fg_io_sysfs_nodes(hba);
+	ufshcd_add_idle_pred_sysfs_nodes(hba);
 }
 
 static inline void ufshcd_remove_sysfs_nodes(struct ufs_hba *hba)
 {
 	device_remove_file(hba->dev, &hba->rpm_lvl_attr);
 	device_remove_file(hba->dev, &hba->spm_lvl_attr);
+	device_remove_file(hba->dev, &hba->fg_reserved_tags_attr);
+	device_remove_file(hba->dev, &hba->io_class_stat_attr);
+	device_remove_file(hba->dev, &hba->idle_policy_attr);
+	device_remove_file(hba->dev, &hba->idle_stats_attr);
 }
 
 /**
@@ -9677,6 +10168,10 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 
 	hba->max_pwr_info.is_valid = false;
 
+	/* MTK PATCH: tags kept free of background writes */
+	hba->fg_reserved_tags = min_t(int, UFS_FG_RESERVED_TAGS_DEFAULT,
+				      hba->nutrs - 1);
+
 	/* Initailize wait queue for task management */
 	init_waitqueue_head(&hba->tm_wq);
 	init_waitqueue_head(&hba->tm_tag_wq);
@@ -9771,6 +10266,9 @@ int ufshcd_init(struct ufs_hba *hba, void __iomem *mmio_base, unsigned int irq)
 			    FIELD_PREP(UFSHCI_AHIBERN8_SCALE_MASK, 3);
 	}
 
+	/* MTK PATCH: timers above are the ones of the fixed idle policy */
+	ufshcd_init_idle_pred(hba);
+
 	/* Hold auto suspend until async scan completes */
 	pm_runtime_get_sync(dev);
 	atomic_set(&hba->scsi_block_reqs_cnt, 0);
@@ -71,6 +71,7 @@
 #if defined(CONFIG_UFSHPB)
 #include "ufshpb.h"
 #endif
+#include "ufs-idle-pred.h"
 
 /* MTK PATCH */
 #include <linux/rpmb.h>
@@ -173,6 +174,7 @@ struct ufs_pm_lvl_states {
  * @intr_cmd: Interrupt command (doesn't participate in interrupt aggregation)
  * @issue_time_stamp: time stamp for debug purposes
  * @req_abort_skip: skip request abort task flag
+ * @io_class: foreground/background class of the SCSI command
  */
 struct ufshcd_lrb {
 	struct utp_transfer_req_desc *utr_descriptor_ptr;
@@ -204,6 +206,15 @@ struct ufshcd_lrb {
 	u64 complete_time_stamp; /* only in memory dump */
 	bool req_abort_skip;
 
+	/* MTK PATCH */
+	u8 io_class;
+
+#if defined(CONFIG_UFSHPB)
+	/* MTK PATCH: CDB replaced by an HPB READ, see ufshpb_restore_cdb() */
+	bool hpb_read;
+	u8 hpb_orig_cdb[10];
+#endif
+
 	/* MTK PATCH */
 	u32 crypto_en;
 	u32 crypto_cfgid;
@@ -211,6 +222,37 @@ struct ufshcd_lrb {
 	u32 crypto_dunu;
 };
 
+/*
+ * MTK PATCH
+ * I/O classes used for foreground tag reservation and latency accounting.
+ * FG requests carry the real-time I/O priority (set by io_boost for UX
+ * and top-app submitters), BG requests are asynchronous or writeback
+ * writes and BE is everything else.
+ */
+enum ufs_io_class {
+	UFS_IO_CLASS_FG,
+	UFS_IO_CLASS_BE,
+	UFS_IO_CLASS_BG,
+	UFS_IO_CLASS_MAX,
+};
+
+/* default number of tags background writes may never occupy */
+#define UFS_FG_RESERVED_TAGS_DEFAULT	4
+/* requests searched behind a held background write for a foreground one */
+#define UFS_FG_LOOKAHEAD		8
+
+/**
+ * struct ufs_io_class_stat - completion latency of one I/O class
+ * @cnt: completed commands, per data direction
+ * @total_us: sum of issue-to-completion latencies in us
+ * @max_us: worst issue-to-completion latency in us
+ */
+struct ufs_io_class_stat {
+	u64 cnt[2];
+	u64 total_us[2];
+	u64 max_us[2];
+};
+
 /**
  * struct ufs_query - holds relevant data structures for query request
  * @request: request upiu and function
@@ -818,6 +860,7 @@ struct ufs_hba {
 	struct delayed_work ufshpb_init_work;
 	struct work_struct ufshpb_eh_work;
 	int ufshpb_state;
+	int ufshpb_init_retry;
 	struct scsi_device *sdev_ufs_lu[UFS_UPIU_MAX_GENERAL_LUN];
 	bool issue_ioctl;
 #endif
@@ -845,6 +888,34 @@ struct ufs_hba {
 	/* MTK PATCH */
 	struct mutex rpmb_lock;
 
+	/*
+	 * MTK PATCH: foreground I/O
+	 * bg_reqs marks the tags last issued to background writes; only the
+	 * bits also set in outstanding_reqs are meaningful. bg_held is set
+	 * when a LU deferred a background write, scsi_prep_rq is the SCSI
+	 * prep function ufshcd_prep_rq() wraps.
+	 */
+	unsigned long bg_reqs;
+	bool bg_held;
+	int fg_reserved_tags;
+	prep_rq_fn *scsi_prep_rq;
+	struct ufs_io_class_stat io_class_stat[UFS_IO_CLASS_MAX];
+	struct device_attribute fg_reserved_tags_attr;
+	struct device_attribute io_class_stat_attr;
+
+	/*
+	 * MTK PATCH: idle timeout prediction
+	 * idle_fixed_ahit and idle_fixed_gate_ms keep the configured timers,
+	 * restored by the fixed policy. idle_ahit_dirty is set when ahit
+	 * changed and the register still holds the previous value.
+	 */
+	struct ufs_idle_pred idle_pred;
+	u32 idle_fixed_ahit;
+	unsigned long idle_fixed_gate_ms;
+	bool idle_ahit_dirty;
+	struct device_attribute idle_policy_attr;
+	struct device_attribute idle_stats_attr;
+
 	struct ufs_dev_desc *card;
 
 	atomic_t scsi_block_reqs_cnt;
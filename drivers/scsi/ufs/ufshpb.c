@@ -0,0 +1,1374 @@
+/*
+ * Universal Flash Storage Host Performance Booster
+ *
+ * The host keeps a copy of the device L2P map for the hot part of each
+ * HPB logical unit and turns single block reads that hit it into HPB
+ * READs carrying the physical page number, so the device can skip its
+ * own map lookup.
+ *
+ * Maps are managed in host control mode:
+ *  - single block reads that miss heat up their subregion; once it sees
+ *    act_threshold misses within HPB_HEAT_WINDOW the map is loaded with
+ *    HPB READ BUFFER,
+ *  - loaded maps are bounded by map_mem_budget and by the device limit of
+ *    active regions, least recently hit regions are evicted first and
+ *    pinned regions never are,
+ *  - writes and unmaps mark the entries they touch dirty so they are not
+ *    served from a stale map, and a subregion that keeps missing on
+ *    dirty entries is reloaded,
+ *  - device hints in the response UPIU reload (active) or drop
+ *    (inactive) maps.
+ *
+ * The region manager only deals with region/subregion indexes; the
+ * SCSI side is confined to ufshpb_prep_fn(), ufshpb_rsp_upiu() and
+ * ufshpb_load_map().
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * See the COPYING file in the top-level directory or visit
+ * <http://www.gnu.org/licenses/gpl-2.0.html>
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/bio.h>
+#include <linux/bitmap.h>
+#include <linux/blkdev.h>
+#include <linux/log2.h>
+#include <linux/pm_runtime.h>
+#include <linux/rcupdate.h>
+#include <linux/sched/clock.h>
+#include <linux/slab.h>
+#include <linux/sysfs.h>
+#include <linux/vmalloc.h>
+#include <asm/unaligned.h>
+#include <scsi/scsi_device.h>
+#include <scsi/scsi_request.h>
+
+#include "ufshcd.h"
+#include "ufshpb.h"
+
+#define HPB_MAP_MEM_BUDGET_DEFAULT	(16 << 20)
+#define HPB_ACT_THRESHOLD_DEFAULT	4
+#define HPB_HEAT_WINDOW			(2 * HZ)
+
+#define HPB_MAP_REQ_TIMEOUT		(3 * HZ)
+#define HPB_MAP_REQ_RETRIES		3
+
+#define HPB_INIT_RETRY_MS		100
+#define HPB_INIT_MAX_RETRY		50
+
+struct ufshpb_active_field {
+	__be16 region;
+	__be16 subregion;
+} __packed;
+
+/* overlays the sense data area of a response UPIU */
+struct ufshpb_rsp_field {
+	__be16 sense_data_len;
+	u8 desc_type;
+	u8 additional_len;
+	u8 hpb_type;
+	u8 reserved;
+	u8 active_region_cnt;
+	u8 inactive_region_cnt;
+	struct ufshpb_active_field hpb_active_field[HPB_RSP_MAX_ACTIVE];
+	__be16 hpb_inactive_field[HPB_RSP_MAX_INACTIVE];
+} __packed;
+
+static inline struct ufshpb_lu *ufshpb_get_lu(struct ufs_hba *hba, int lun)
+{
+	if (lun < 0 || lun >= UFS_UPIU_MAX_GENERAL_LUN)
+		return NULL;
+
+	return READ_ONCE(hba->ufshpb_lup[lun]);
+}
+
+static inline void ufshpb_get_pos(struct ufshpb_lu *hpb, u64 lpn,
+				  u32 *rgn_idx, u32 *srgn_idx, u32 *offset)
+{
+	*rgn_idx = lpn >> hpb->entries_per_region_shift;
+	*srgn_idx = (lpn >> hpb->entries_per_subregion_shift) &
+		    (hpb->subregions_per_region - 1);
+	*offset = lpn & (hpb->entries_per_subregion - 1);
+}
+
+/* map entries of a subregion, the last one of the LU may be short */
+static u32 ufshpb_subregion_entries(struct ufshpb_lu *hpb, u32 rgn_idx,
+				    u32 srgn_idx)
+{
+	u64 start = ((u64)rgn_idx << hpb->entries_per_region_shift) +
+		    ((u64)srgn_idx << hpb->entries_per_subregion_shift);
+
+	if (start >= hpb->lu_blocks)
+		return 0;
+
+	return min_t(u64, hpb->entries_per_subregion, hpb->lu_blocks - start);
+}
+
+static inline int ufshpb_map_pages(struct ufshpb_lu *hpb)
+{
+	return DIV_ROUND_UP(hpb->entries_per_subregion, HPB_ENTRY_PER_PAGE);
+}
+
+static inline u64 ufshpb_map_bytes(struct ufshpb_lu *hpb)
+{
+	return (u64)ufshpb_map_pages(hpb) << PAGE_SHIFT;
+}
+
+static u32 ufshpb_max_loaded(struct ufshpb_lu *hpb)
+{
+	return max_t(u64, div64_u64(hpb->map_mem_budget,
+				    ufshpb_map_bytes(hpb)), 1);
+}
+
+static inline u64 ufshpb_get_ppn(struct ufshpb_map_ctx *mctx, u32 offset)
+{
+	u64 *ppn_table = page_address(mctx->m_page[offset /
+						     HPB_ENTRY_PER_PAGE]);
+
+	return ppn_table[offset % HPB_ENTRY_PER_PAGE];
+}
+
+static void ufshpb_mctx_free(struct ufshpb_lu *hpb,
+			     struct ufshpb_map_ctx *mctx)
+{
+	int i;
+
+	for (i = 0; i < ufshpb_map_pages(hpb); i++)
+		if (mctx->m_page[i])
+			__free_page(mctx->m_page[i]);
+
+	kfree(mctx->ppn_dirty);
+	kfree(mctx->m_page);
+	kfree(mctx);
+}
+
+static struct ufshpb_map_ctx *ufshpb_mctx_alloc(struct ufshpb_lu *hpb)
+{
+	struct ufshpb_map_ctx *mctx;
+	int i;
+
+	mctx = kzalloc(sizeof(*mctx), GFP_KERNEL);
+	if (!mctx)
+		return NULL;
+
+	mctx->m_page = kcalloc(ufshpb_map_pages(hpb), sizeof(struct page *),
+			       GFP_KERNEL);
+	mctx->ppn_dirty = kcalloc(BITS_TO_LONGS(hpb->entries_per_subregion),
+				  sizeof(unsigned long), GFP_KERNEL);
+	if (!mctx->m_page || !mctx->ppn_dirty)
+		goto out_free;
+
+	for (i = 0; i < ufshpb_map_pages(hpb); i++) {
+		mctx->m_page[i] = alloc_page(GFP_KERNEL);
+		if (!mctx->m_page[i])
+			goto out_free;
+	}
+
+	return mctx;
+
+out_free:
+	if (mctx->m_page) {
+		ufshpb_mctx_free(hpb, mctx);
+	} else {
+		kfree(mctx->ppn_dirty);
+		kfree(mctx);
+	}
+	return NULL;
+}
+
+static void ufshpb_free_list(struct ufshpb_lu *hpb, struct list_head *list)
+{
+	struct ufshpb_map_ctx *mctx, *next;
+
+	list_for_each_entry_safe(mctx, next, list, list_free) {
+		list_del(&mctx->list_free);
+		ufshpb_mctx_free(hpb, mctx);
+	}
+}
+
+/*
+ * Region manager. Everything below up to the SCSI glue is called with
+ * hpb_lock held.
+ */
+
+/* Drop the map of @srgn; it is queued on @free_list for the caller. */
+static void ufshpb_detach_map(struct ufshpb_lu *hpb,
+			      struct ufshpb_region *rgn,
+			      struct ufshpb_subregion *srgn,
+			      struct list_head *free_list)
+{
+	list_add(&srgn->mctx->list_free, free_list);
+	srgn->mctx = NULL;
+	srgn->state = HPB_SUBREGION_INACTIVE;
+	srgn->reload = false;
+	srgn->reads = 0;
+
+	hpb->loaded_subregions--;
+	if (--rgn->loaded == 0) {
+		list_del_init(&rgn->list_lru);
+		hpb->active_regions--;
+	}
+}
+
+static void ufshpb_attach_map(struct ufshpb_lu *hpb,
+			      struct ufshpb_region *rgn,
+			      struct ufshpb_subregion *srgn,
+			      struct ufshpb_map_ctx *mctx)
+{
+	srgn->mctx = mctx;
+
+	hpb->loaded_subregions++;
+	if (rgn->loaded++ == 0) {
+		list_add(&rgn->list_lru, &hpb->lru);
+		hpb->active_regions++;
+	}
+}
+
+static bool ufshpb_region_busy(struct ufshpb_lu *hpb,
+			       struct ufshpb_region *rgn)
+{
+	u32 i;
+
+	for (i = 0; i < hpb->subregions_per_region; i++)
+		if (rgn->subregion_tbl[i].state == HPB_SUBREGION_LOADING)
+			return true;
+
+	return false;
+}
+
+static void ufshpb_evict_region(struct ufshpb_lu *hpb,
+				struct ufshpb_region *rgn,
+				struct list_head *free_list)
+{
+	struct ufshpb_subregion *srgn;
+	u32 i;
+
+	for (i = 0; i < hpb->subregions_per_region; i++) {
+		srgn = &rgn->subregion_tbl[i];
+		if (!list_empty(&srgn->list_act))
+			list_del_init(&srgn->list_act);
+		if (srgn->mctx)
+			ufshpb_detach_map(hpb, rgn, srgn, free_list);
+	}
+}
+
+/* Least recently used region that may be evicted, other than @keep. */
+static struct ufshpb_region *ufshpb_pick_victim(struct ufshpb_lu *hpb,
+						struct ufshpb_region *keep)
+{
+	struct ufshpb_region *rgn;
+
+	list_for_each_entry_reverse(rgn, &hpb->lru, list_lru) {
+		if (rgn == keep || rgn->pinned)
+			continue;
+		if (ufshpb_region_busy(hpb, rgn))
+			continue;
+		return rgn;
+	}
+
+	return NULL;
+}
+
+/* Evict until one more subregion of @rgn fits in the budget. */
+static bool ufshpb_make_room(struct ufshpb_lu *hpb,
+			     struct ufshpb_region *rgn,
+			     struct list_head *free_list)
+{
+	struct ufshpb_region *victim;
+
+	while (hpb->loaded_subregions >= ufshpb_max_loaded(hpb) ||
+	       (!rgn->loaded && hpb->max_active_regions &&
+		hpb->active_regions >= hpb->max_active_regions)) {
+		victim = ufshpb_pick_victim(hpb, rgn);
+		if (!victim)
+			return false;
+		ufshpb_evict_region(hpb, victim, free_list);
+		hpb->stats.evict++;
+	}
+
+	return true;
+}
+
+/* Evict until the loaded maps fit in a (possibly lowered) budget. */
+static void ufshpb_shrink(struct ufshpb_lu *hpb, struct list_head *free_list)
+{
+	struct ufshpb_region *victim;
+
+	while (hpb->loaded_subregions > ufshpb_max_loaded(hpb)) {
+		victim = ufshpb_pick_victim(hpb, NULL);
+		if (!victim)
+			break;
+		ufshpb_evict_region(hpb, victim, free_list);
+		hpb->stats.evict++;
+	}
+}
+
+/* Returns true if the map worker has to be kicked. */
+static bool ufshpb_queue_subregion(struct ufshpb_lu *hpb,
+				   struct ufshpb_subregion *srgn)
+{
+	if (srgn->state == HPB_SUBREGION_CLEAN)
+		srgn->reload = true;
+
+	if (!list_empty(&srgn->list_act))
+		return false;
+
+	/* a loading subregion is queued again when its load completes */
+	if (srgn->state == HPB_SUBREGION_LOADING) {
+		srgn->reload = true;
+		return false;
+	}
+
+	list_add_tail(&srgn->list_act, &hpb->act_list);
+	return true;
+}
+
+/* A single block read missed @srgn; returns true if it became hot. */
+static bool ufshpb_heat(struct ufshpb_lu *hpb, struct ufshpb_subregion *srgn)
+{
+	if (srgn->state == HPB_SUBREGION_LOADING ||
+	    !list_empty(&srgn->list_act))
+		return false;
+
+	if (time_after(jiffies, srgn->read_stamp + HPB_HEAT_WINDOW)) {
+		srgn->read_stamp = jiffies;
+		srgn->reads = 0;
+	}
+
+	if (++srgn->reads < hpb->act_threshold)
+		return false;
+
+	srgn->reads = 0;
+	return ufshpb_queue_subregion(hpb, srgn);
+}
+
+static void ufshpb_set_dirty(struct ufshpb_lu *hpb, u64 lpn, u64 cnt)
+{
+	struct ufshpb_subregion *srgn;
+	u32 rgn_idx, srgn_idx, offset;
+	unsigned long flags;
+	u32 len;
+
+	if (lpn >= hpb->lu_blocks)
+		return;
+	cnt = min(cnt, hpb->lu_blocks - lpn);
+
+	spin_lock_irqsave(&hpb->hpb_lock, flags);
+	while (cnt) {
+		ufshpb_get_pos(hpb, lpn, &rgn_idx, &srgn_idx, &offset);
+		srgn = &hpb->region_tbl[rgn_idx].subregion_tbl[srgn_idx];
+		len = min_t(u64, cnt, hpb->entries_per_subregion - offset);
+
+		/* loading maps are marked too, they may predate the write */
+		if (srgn->mctx) {
+			bitmap_set(srgn->mctx->ppn_dirty, offset, len);
+			hpb->stats.dirty++;
+		}
+
+		lpn += len;
+		cnt -= len;
+	}
+	spin_unlock_irqrestore(&hpb->hpb_lock, flags);
+}
+
+/*
+ * SCSI glue
+ */
+
+static void ufshpb_set_read_buf_cmd(unsigned char *cdb, u32 rgn_idx,
+				    u32 srgn_idx, u32 alloc_len)
+{
+	cdb[0] = UFSHPB_READ_BUFFER;
+	cdb[1] = UFSHPB_READ_BUFFER_ID;
+	put_unaligned_be16(rgn_idx, &cdb[2]);
+	put_unaligned_be16(srgn_idx, &cdb[4]);
+	cdb[6] = (alloc_len >> 16) & 0xff;
+	put_unaligned_be16(alloc_len & 0xffff, &cdb[7]);
+	cdb[9] = 0x00;
+}
+
+static void ufshpb_map_end_io(struct bio *bio)
+{
+	bio_put(bio);
+}
+
+static int ufshpb_load_map(struct ufshpb_lu *hpb, u32 rgn_idx, u32 srgn_idx,
+			   struct ufshpb_map_ctx *mctx)
+{
+	struct request_queue *q = hpb->sdev->request_queue;
+	struct scsi_request *rq;
+	struct request *req;
+	struct bio *bio;
+	u32 alloc_len;
+	int nr_pages, len, i;
+	int ret;
+
+	alloc_len = ufshpb_subregion_entries(hpb, rgn_idx, srgn_idx) *
+		    HPB_ENTRY_SIZE;
+	nr_pages = DIV_ROUND_UP(alloc_len, PAGE_SIZE);
+
+	req = blk_get_request(q, REQ_OP_SCSI_IN, 0);
+	if (IS_ERR(req))
+		return PTR_ERR(req);
+
+	bio = bio_kmalloc(GFP_KERNEL, nr_pages);
+	if (!bio) {
+		ret = -ENOMEM;
+		goto out_put;
+	}
+
+	for (i = 0; i < nr_pages; i++) {
+		len = min_t(u32, PAGE_SIZE, alloc_len - i * PAGE_SIZE);
+		if (bio_add_pc_page(q, bio, mctx->m_page[i], len, 0) < len) {
+			bio_put(bio);
+			ret = -EINVAL;
+			goto out_put;
+		}
+	}
+
+	bio->bi_opf &= ~REQ_OP_MASK;
+	bio->bi_opf |= req_op(req);
+	bio->bi_end_io = ufshpb_map_end_io;
+
+	ret = blk_rq_append_bio(req, &bio);
+	if (ret) {
+		bio_put(bio);
+		goto out_put;
+	}
+
+	rq = scsi_req(req);
+	ufshpb_set_read_buf_cmd(rq->cmd, rgn_idx, srgn_idx, alloc_len);
+	rq->cmd_len = 10;
+	rq->retries = HPB_MAP_REQ_RETRIES;
+	req->timeout = HPB_MAP_REQ_TIMEOUT;
+	req->rq_flags |= RQF_QUIET;
+
+	blk_execute_rq(q, NULL, req, 1);
+	ret = rq->result ? -EIO : 0;
+
+out_put:
+	blk_put_request(req);
+	return ret;
+}
+
+static void ufshpb_map_work_handler(struct work_struct *work)
+{
+	struct ufshpb_lu *hpb = container_of(work, struct ufshpb_lu,
+					     map_work);
+	struct ufshpb_map_ctx *mctx, *map;
+	struct ufshpb_subregion *srgn;
+	struct ufshpb_region *rgn;
+	u32 index, rgn_idx, srgn_idx;
+	LIST_HEAD(free_list);
+	int ret;
+
+	for (;;) {
+		spin_lock_irq(&hpb->hpb_lock);
+		srgn = list_first_entry_or_null(&hpb->act_list,
+						struct ufshpb_subregion,
+						list_act);
+		if (!srgn) {
+			spin_unlock_irq(&hpb->hpb_lock);
+			break;
+		}
+		list_del_init(&srgn->list_act);
+		mctx = NULL;
+		if (srgn->state == HPB_SUBREGION_CLEAN && !srgn->reload) {
+			spin_unlock_irq(&hpb->hpb_lock);
+			continue;
+		}
+		spin_unlock_irq(&hpb->hpb_lock);
+
+		index = srgn - hpb->subregions;
+		rgn_idx = index / hpb->subregions_per_region;
+		srgn_idx = index % hpb->subregions_per_region;
+		rgn = &hpb->region_tbl[rgn_idx];
+
+		/* a reload reuses the current map, a first load needs one */
+		if (!READ_ONCE(srgn->mctx)) {
+			mctx = ufshpb_mctx_alloc(hpb);
+			if (!mctx) {
+				spin_lock_irq(&hpb->hpb_lock);
+				hpb->stats.map_fail++;
+				spin_unlock_irq(&hpb->hpb_lock);
+				continue;
+			}
+		}
+
+		spin_lock_irq(&hpb->hpb_lock);
+		if (!srgn->mctx) {
+			if (!mctx || !ufshpb_make_room(hpb, rgn, &free_list)) {
+				spin_unlock_irq(&hpb->hpb_lock);
+				if (mctx)
+					ufshpb_mctx_free(hpb, mctx);
+				ufshpb_free_list(hpb, &free_list);
+				continue;
+			}
+			ufshpb_attach_map(hpb, rgn, srgn, mctx);
+			mctx = NULL;
+		}
+		map = srgn->mctx;
+		/* queued again by a hint while we were allocating */
+		list_del_init(&srgn->list_act);
+		bitmap_zero(map->ppn_dirty, hpb->entries_per_subregion);
+		srgn->state = HPB_SUBREGION_LOADING;
+		srgn->reload = false;
+		hpb->stats.map_req++;
+		spin_unlock_irq(&hpb->hpb_lock);
+
+		if (mctx)
+			ufshpb_mctx_free(hpb, mctx);
+		ufshpb_free_list(hpb, &free_list);
+
+		ret = ufshpb_load_map(hpb, rgn_idx, srgn_idx, map);
+
+		spin_lock_irq(&hpb->hpb_lock);
+		if (ret) {
+			hpb->stats.map_fail++;
+			ufshpb_detach_map(hpb, rgn, srgn, &free_list);
+		} else {
+			srgn->state = HPB_SUBREGION_CLEAN;
+			if (srgn->reload && list_empty(&srgn->list_act))
+				list_add_tail(&srgn->list_act, &hpb->act_list);
+		}
+		spin_unlock_irq(&hpb->hpb_lock);
+
+		ufshpb_free_list(hpb, &free_list);
+
+		if (ret)
+			dev_info(hpb->hba->dev,
+				 "%s: lun %d region %u subregion %u load failed %d\n",
+				 __func__, hpb->lun, rgn_idx, srgn_idx, ret);
+	}
+}
+
+/*
+ * HPB 1.0 HPB READ: READ_16 with the LBA in bytes 2-5, the PPN in bytes
+ * 6-13 and a transfer length of one block.
+ */
+static void ufshpb_set_hpb_read(struct ufshcd_lrb *lrbp, u64 ppn)
+{
+	unsigned char cdb[MAX_CDB_SIZE] = { 0 };
+
+	memcpy(lrbp->hpb_orig_cdb, lrbp->cmd->cmnd, sizeof(lrbp->hpb_orig_cdb));
+	lrbp->hpb_read = true;
+
+	cdb[0] = READ_16;
+	memcpy(&cdb[2], &lrbp->cmd->cmnd[2], 4);
+	/* the PPN goes back to the device exactly as it was read */
+	put_unaligned(ppn, (u64 *)&cdb[6]);
+	cdb[15] = 0x01;
+
+	memcpy(lrbp->cmd->cmnd, cdb, MAX_CDB_SIZE);
+	lrbp->cmd->cmd_len = MAX_CDB_SIZE;
+	memcpy(lrbp->ucd_req_ptr->sc.cdb, cdb, MAX_CDB_SIZE);
+}
+
+/**
+ * ufshpb_restore_cdb - give an HPB READ back its original READ_10 CDB
+ * @lrbp: local reference block of a command leaving the driver
+ *
+ * The HPB READ is written over the command's own CDB. A command that is
+ * requeued or retried keeps RQF_DONTPREP and is not prepared by sd again,
+ * so it would be reissued with a PPN that may have gone stale meanwhile.
+ * Called whenever a prepared SCSI command is handed back to the midlayer.
+ */
+void ufshpb_restore_cdb(struct ufshcd_lrb *lrbp)
+{
+	struct scsi_cmnd *cmd = lrbp->cmd;
+
+	if (!lrbp->hpb_read)
+		return;
+
+	lrbp->hpb_read = false;
+	memset(cmd->cmnd, 0, MAX_CDB_SIZE);
+	memcpy(cmd->cmnd, lrbp->hpb_orig_cdb, sizeof(lrbp->hpb_orig_cdb));
+	cmd->cmd_len = sizeof(lrbp->hpb_orig_cdb);
+}
+
+static void ufshpb_prep_read(struct ufshpb_lu *hpb, struct ufshcd_lrb *lrbp)
+{
+	unsigned char *cmnd = lrbp->cmd->cmnd;
+	struct ufshpb_subregion *srgn;
+	struct ufshpb_region *rgn;
+	u32 rgn_idx, srgn_idx, offset;
+	unsigned long flags;
+	bool kick;
+	u64 lpn, ppn;
+
+	/* HPB 1.0 serves single block reads only */
+	if (get_unaligned_be16(&cmnd[7]) != 1)
+		return;
+
+	lpn = get_unaligned_be32(&cmnd[2]);
+	if (lpn >= hpb->lu_blocks)
+		return;
+
+	ufshpb_get_pos(hpb, lpn, &rgn_idx, &srgn_idx, &offset);
+	rgn = &hpb->region_tbl[rgn_idx];
+	srgn = &rgn->subregion_tbl[srgn_idx];
+
+	spin_lock_irqsave(&hpb->hpb_lock, flags);
+	if (srgn->state == HPB_SUBREGION_CLEAN &&
+	    !test_bit(offset, srgn->mctx->ppn_dirty)) {
+		ppn = ufshpb_get_ppn(srgn->mctx, offset);
+		list_move(&rgn->list_lru, &hpb->lru);
+		hpb->stats.hit++;
+		spin_unlock_irqrestore(&hpb->hpb_lock, flags);
+
+		ufshpb_set_hpb_read(lrbp, ppn);
+		return;
+	}
+
+	hpb->stats.miss++;
+	kick = ufshpb_heat(hpb, srgn);
+	spin_unlock_irqrestore(&hpb->hpb_lock, flags);
+
+	if (kick)
+		queue_work(system_unbound_wq, &hpb->map_work);
+}
+
+/**
+ * ufshpb_prep_fn - turn a read into an HPB READ or track a write
+ * @hba: per adapter instance
+ * @lrbp: local reference block of a prepared SCSI command
+ */
+void ufshpb_prep_fn(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+{
+	struct scsi_cmnd *cmd = lrbp->cmd;
+	struct request *rq = cmd->request;
+	struct ufshpb_lu *hpb;
+
+	rcu_read_lock();
+	hpb = ufshpb_get_lu(hba, lrbp->lun);
+	if (!hpb)
+		goto out;
+
+	switch (cmd->cmnd[0]) {
+	case READ_10:
+		if (!blk_rq_is_passthrough(rq))
+			ufshpb_prep_read(hpb, lrbp);
+		break;
+	case WRITE_10:
+		ufshpb_set_dirty(hpb, get_unaligned_be32(&cmd->cmnd[2]),
+				 get_unaligned_be16(&cmd->cmnd[7]));
+		break;
+	case WRITE_16:
+		ufshpb_set_dirty(hpb, get_unaligned_be64(&cmd->cmnd[2]),
+				 get_unaligned_be32(&cmd->cmnd[10]));
+		break;
+	case UNMAP:
+		/* the ranges of a passthrough UNMAP are in its payload */
+		if (!blk_rq_is_passthrough(rq))
+			ufshpb_set_dirty(hpb, blk_rq_pos(rq) >> 3,
+					 DIV_ROUND_UP(blk_rq_bytes(rq),
+						      1 << HPB_BLOCK_SHIFT));
+		break;
+	default:
+		break;
+	}
+out:
+	rcu_read_unlock();
+}
+
+static void ufshpb_account_read(struct ufshpb_lu *hpb,
+				struct ufshcd_lrb *lrbp)
+{
+	unsigned char *cmnd = lrbp->cmd->cmnd;
+	u64 lat = sched_clock() - lrbp->issue_time_stamp;
+	unsigned long flags;
+	bool hpb_read;
+
+	if (cmnd[0] == READ_16)
+		hpb_read = true;
+	else if (cmnd[0] == READ_10 && get_unaligned_be16(&cmnd[7]) == 1)
+		hpb_read = false;
+	else
+		return;
+
+	spin_lock_irqsave(&hpb->hpb_lock, flags);
+	if (hpb_read) {
+		hpb->stats.hpb_read_cnt++;
+		hpb->stats.hpb_read_ns += lat;
+	} else {
+		hpb->stats.normal_read_cnt++;
+		hpb->stats.normal_read_ns += lat;
+	}
+	spin_unlock_irqrestore(&hpb->hpb_lock, flags);
+}
+
+/**
+ * ufshpb_rsp_upiu - account a completed command and apply device hints
+ * @hba: per adapter instance
+ * @lrbp: local reference block of a successfully completed command
+ *
+ * Called from the completion path with the host lock held.
+ */
+void ufshpb_rsp_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp)
+{
+	struct ufshpb_rsp_field *rsp;
+	struct ufshpb_region *rgn;
+	struct ufshpb_lu *hpb;
+	LIST_HEAD(free_list);
+	unsigned long flags;
+	u32 data_seg_len;
+	u32 rgn_idx, srgn_idx;
+	bool kick = false;
+	int i;
+
+	if (!lrbp->cmd)
+		return;
+
+	rcu_read_lock();
+	hpb = ufshpb_get_lu(hba, lrbp->lun);
+	if (!hpb)
+		goto out;
+
+	ufshpb_account_read(hpb, lrbp);
+
+	data_seg_len = be32_to_cpu(lrbp->ucd_rsp_ptr->header.dword_2) &
+		       MASK_RSP_UPIU_DATA_SEG_LEN;
+	if (data_seg_len != HPB_RSP_DATA_SEG_LEN)
+		goto out;
+
+	rsp = (struct ufshpb_rsp_field *)&lrbp->ucd_rsp_ptr->sr.sense_data_len;
+	if (be16_to_cpu(rsp->sense_data_len) != HPB_RSP_SENSE_SEG_LEN ||
+	    rsp->desc_type != HPB_RSP_DESC_TYPE ||
+	    rsp->additional_len != HPB_RSP_ADDITIONAL_LEN ||
+	    rsp->hpb_type != HPB_RSP_REQ_REGION_UPDATE ||
+	    rsp->active_region_cnt > HPB_RSP_MAX_ACTIVE ||
+	    rsp->inactive_region_cnt > HPB_RSP_MAX_INACTIVE)
+		goto out;
+
+	spin_lock_irqsave(&hpb->hpb_lock, flags);
+	for (i = 0; i < rsp->active_region_cnt; i++) {
+		rgn_idx = be16_to_cpu(rsp->hpb_active_field[i].region);
+		srgn_idx = be16_to_cpu(rsp->hpb_active_field[i].subregion);
+		if (rgn_idx >= hpb->regions_per_lu ||
+		    srgn_idx >= hpb->subregions_per_region ||
+		    !ufshpb_subregion_entries(hpb, rgn_idx, srgn_idx))
+			continue;
+
+		/* the device map changed, or the device wants it loaded */
+		rgn = &hpb->region_tbl[rgn_idx];
+		kick |= ufshpb_queue_subregion(hpb,
+					       &rgn->subregion_tbl[srgn_idx]);
+		hpb->stats.rsp_active++;
+	}
+
+	for (i = 0; i < rsp->inactive_region_cnt; i++) {
+		rgn_idx = be16_to_cpu(rsp->hpb_inactive_field[i]);
+		if (rgn_idx >= hpb->regions_per_lu)
+			continue;
+
+		rgn = &hpb->region_tbl[rgn_idx];
+		if (rgn->loaded && !rgn->pinned &&
+		    !ufshpb_region_busy(hpb, rgn)) {
+			ufshpb_evict_region(hpb, rgn, &free_list);
+			hpb->stats.evict++;
+		}
+		hpb->stats.rsp_inactive++;
+	}
+	spin_unlock_irqrestore(&hpb->hpb_lock, flags);
+
+	ufshpb_free_list(hpb, &free_list);
+
+	if (kick)
+		queue_work(system_unbound_wq, &hpb->map_work);
+out:
+	rcu_read_unlock();
+}
+
+/**
+ * ufshpb_issue_req_dev_ctx - read the vendor device context buffer
+ * @hpb: HPB logical unit
+ * @buf: kernel buffer receiving the context
+ * @buf_length: size of @buf
+ */
+int ufshpb_issue_req_dev_ctx(struct ufshpb_lu *hpb, unsigned char *buf,
+			     int buf_length)
+{
+	unsigned char cdb[10] = { 0 };
+	int ret;
+
+	if (!hpb)
+		return -ENODEV;
+
+	if (buf_length <= 0 || buf_length > IOCTL_DEV_CTX_MAX_SIZE)
+		return -EINVAL;
+
+	cdb[0] = READ_BUFFER;
+	cdb[1] = 0x02;		/* data mode */
+	cdb[2] = UFSHPB_DEV_CTX_BUFFER_ID;
+	cdb[6] = (buf_length >> 16) & 0xff;
+	put_unaligned_be16(buf_length & 0xffff, &cdb[7]);
+
+	ret = scsi_execute(hpb->sdev, cdb, DMA_FROM_DEVICE, buf, buf_length,
+			   NULL, NULL, HPB_MAP_REQ_TIMEOUT, HPB_MAP_REQ_RETRIES,
+			   0, 0, NULL);
+
+	return ret ? -EIO : 0;
+}
+
+/*
+ * sysfs, on the SCSI device of each HPB logical unit
+ */
+
+static struct ufshpb_lu *ufshpb_dev_to_lu(struct device *dev)
+{
+	struct scsi_device *sdev = to_scsi_device(dev);
+	struct ufs_hba *hba = shost_priv(sdev->host);
+
+	return ufshpb_get_lu(hba, ufshcd_scsi_to_upiu_lun(sdev->lun));
+}
+
+static u64 ufshpb_avg_us(u64 ns, u64 cnt)
+{
+	return cnt ? div64_u64(ns, cnt * NSEC_PER_USEC) : 0;
+}
+
+static ssize_t hpb_stats_show(struct device *dev,
+			      struct device_attribute *attr, char *buf)
+{
+	struct ufshpb_lu *hpb = ufshpb_dev_to_lu(dev);
+	struct ufshpb_stats stats;
+	u32 active, loaded;
+	u64 hpb_us, normal_us;
+
+	if (!hpb)
+		return -ENODEV;
+
+	spin_lock_irq(&hpb->hpb_lock);
+	stats = hpb->stats;
+	active = hpb->active_regions;
+	loaded = hpb->loaded_subregions;
+	spin_unlock_irq(&hpb->hpb_lock);
+
+	hpb_us = ufshpb_avg_us(stats.hpb_read_ns, stats.hpb_read_cnt);
+	normal_us = ufshpb_avg_us(stats.normal_read_ns,
+				  stats.normal_read_cnt);
+
+	return scnprintf(buf, PAGE_SIZE,
+		"hit_count %llu\n"
+		"miss_count %llu\n"
+		"hit_rate %llu%%\n"
+		"map_req_count %llu\n"
+		"map_fail_count %llu\n"
+		"evict_count %llu\n"
+		"rsp_active_count %llu\n"
+		"rsp_inactive_count %llu\n"
+		"dirty_count %llu\n"
+		"active_regions %u/%u\n"
+		"loaded_subregions %u/%u\n"
+		"map_mem_bytes %llu\n"
+		"hpb_read_count %llu\n"
+		"hpb_read_avg_us %llu\n"
+		"normal_read_count %llu\n"
+		"normal_read_avg_us %llu\n"
+		"read_latency_delta_us %lld\n",
+		stats.hit, stats.miss,
+		stats.hit + stats.miss ?
+		div64_u64(stats.hit * 100, stats.hit + stats.miss) : 0,
+		stats.map_req, stats.map_fail, stats.evict,
+		stats.rsp_active, stats.rsp_inactive, stats.dirty,
+		active, hpb->max_active_regions,
+		loaded, ufshpb_max_loaded(hpb),
+		(u64)loaded * ufshpb_map_bytes(hpb),
+		stats.hpb_read_cnt, hpb_us,
+		stats.normal_read_cnt, normal_us,
+		(s64)normal_us - (s64)hpb_us);
+}
+
+/* any write resets the counters */
+static ssize_t hpb_stats_store(struct device *dev,
+			       struct device_attribute *attr,
+			       const char *buf, size_t count)
+{
+	struct ufshpb_lu *hpb = ufshpb_dev_to_lu(dev);
+
+	if (!hpb)
+		return -ENODEV;
+
+	spin_lock_irq(&hpb->hpb_lock);
+	memset(&hpb->stats, 0, sizeof(hpb->stats));
+	spin_unlock_irq(&hpb->hpb_lock);
+
+	return count;
+}
+static DEVICE_ATTR_RW(hpb_stats);
+
+static ssize_t hpb_map_mem_budget_show(struct device *dev,
+				       struct device_attribute *attr,
+				       char *buf)
+{
+	struct ufshpb_lu *hpb = ufshpb_dev_to_lu(dev);
+
+	if (!hpb)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%llu\n", hpb->map_mem_budget);
+}
+
+static ssize_t hpb_map_mem_budget_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	struct ufshpb_lu *hpb = ufshpb_dev_to_lu(dev);
+	LIST_HEAD(free_list);
+	u64 val;
+
+	if (!hpb)
+		return -ENODEV;
+
+	if (kstrtou64(buf, 0, &val) || val < ufshpb_map_bytes(hpb))
+		return -EINVAL;
+
+	spin_lock_irq(&hpb->hpb_lock);
+	hpb->map_mem_budget = val;
+	ufshpb_shrink(hpb, &free_list);
+	spin_unlock_irq(&hpb->hpb_lock);
+
+	ufshpb_free_list(hpb, &free_list);
+
+	return count;
+}
+static DEVICE_ATTR_RW(hpb_map_mem_budget);
+
+static ssize_t hpb_act_threshold_show(struct device *dev,
+				      struct device_attribute *attr,
+				      char *buf)
+{
+	struct ufshpb_lu *hpb = ufshpb_dev_to_lu(dev);
+
+	if (!hpb)
+		return -ENODEV;
+
+	return scnprintf(buf, PAGE_SIZE, "%u\n", hpb->act_threshold);
+}
+
+static ssize_t hpb_act_threshold_store(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct ufshpb_lu *hpb = ufshpb_dev_to_lu(dev);
+	unsigned int val;
+
+	if (!hpb)
+		return -ENODEV;
+
+	if (kstrtouint(buf, 0, &val) || !val)
+		return -EINVAL;
+
+	WRITE_ONCE(hpb->act_threshold, val);
+
+	return count;
+}
+static DEVICE_ATTR_RW(hpb_act_threshold);
+
+static struct attribute *ufshpb_attrs[] = {
+	&dev_attr_hpb_stats.attr,
+	&dev_attr_hpb_map_mem_budget.attr,
+	&dev_attr_hpb_act_threshold.attr,
+	NULL,
+};
+
+static const struct attribute_group ufshpb_attr_group = {
+	.attrs = ufshpb_attrs,
+};
+
+/*
+ * Probe, reset and release
+ */
+
+struct ufshpb_dev_info {
+	u32 region_bytes;
+	u32 subregion_bytes;
+	u32 max_active_regions;
+};
+
+static int ufshpb_read_desc(struct ufs_hba *hba, enum desc_idn idn,
+			    int index, u8 *buf)
+{
+	int len = QUERY_DESC_MAX_SIZE;
+	int err;
+
+	err = ufshcd_query_descriptor_retry(hba, UPIU_QUERY_OPCODE_READ_DESC,
+					    idn, index, 0, buf, &len);
+	if (err)
+		return err;
+
+	if (buf[QUERY_DESC_DESC_TYPE_OFFSET] != idn)
+		return -EINVAL;
+
+	return len;
+}
+
+static int ufshpb_get_dev_info(struct ufs_hba *hba,
+			       struct ufshpb_dev_info *info, u8 *desc_buf)
+{
+	int len;
+
+	len = ufshpb_read_desc(hba, QUERY_DESC_IDN_DEVICE, 0, desc_buf);
+	if (len < 0)
+		return len;
+
+	if (len <= DEVICE_DESC_PARAM_HPB_VER + 1 ||
+	    !(desc_buf[DEVICE_DESC_PARAM_FEAT_SUP] &
+	      UFS_FEATURE_SUPPORT_HPB_BIT))
+		return -ENODEV;
+
+	dev_info(hba->dev, "%s: HPB version 0x%x\n", __func__,
+		 get_unaligned_be16(&desc_buf[DEVICE_DESC_PARAM_HPB_VER]));
+
+	len = ufshpb_read_desc(hba, QUERY_DESC_IDN_GEOMETRY, 0, desc_buf);
+	if (len < 0)
+		return len;
+
+	if (len <= GEOMETRY_DESC_HPB_DEVICE_MAX_ACTIVE_REGIONS + 1 ||
+	    !desc_buf[GEOMETRY_DESC_HPB_NUMBER_LU])
+		return -ENODEV;
+
+	info->region_bytes = 512U << desc_buf[GEOMETRY_DESC_HPB_REGION_SIZE];
+	info->subregion_bytes =
+		512U << desc_buf[GEOMETRY_DESC_HPB_SUBREGION_SIZE];
+	info->max_active_regions = get_unaligned_be16(
+		&desc_buf[GEOMETRY_DESC_HPB_DEVICE_MAX_ACTIVE_REGIONS]);
+
+	if (info->subregion_bytes < (1 << HPB_BLOCK_SHIFT) ||
+	    info->subregion_bytes > info->region_bytes) {
+		dev_err(hba->dev, "%s: bad region %u / subregion %u size\n",
+			__func__, info->region_bytes, info->subregion_bytes);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Queue every subregion of the pinned regions for loading. */
+static bool ufshpb_queue_pinned(struct ufshpb_lu *hpb)
+{
+	struct ufshpb_region *rgn;
+	bool kick = false;
+	u32 i, j;
+
+	spin_lock_irq(&hpb->hpb_lock);
+	for (i = 0; i < hpb->regions_per_lu; i++) {
+		rgn = &hpb->region_tbl[i];
+		if (!rgn->pinned)
+			continue;
+		for (j = 0; j < hpb->subregions_per_region; j++)
+			if (ufshpb_subregion_entries(hpb, i, j))
+				kick |= ufshpb_queue_subregion(hpb,
+						&rgn->subregion_tbl[j]);
+	}
+	spin_unlock_irq(&hpb->hpb_lock);
+
+	return kick;
+}
+
+/* Drop all maps; the caller made sure the map worker is idle. */
+static void ufshpb_drop_maps(struct ufshpb_lu *hpb)
+{
+	LIST_HEAD(free_list);
+	u32 i;
+
+	spin_lock_irq(&hpb->hpb_lock);
+	for (i = 0; i < hpb->regions_per_lu; i++)
+		ufshpb_evict_region(hpb, &hpb->region_tbl[i], &free_list);
+	spin_unlock_irq(&hpb->hpb_lock);
+
+	ufshpb_free_list(hpb, &free_list);
+}
+
+static void ufshpb_lu_free(struct ufshpb_lu *hpb)
+{
+	if (hpb->sysfs_ready)
+		sysfs_remove_group(&hpb->sdev->sdev_gendev.kobj,
+				   &ufshpb_attr_group);
+
+	cancel_work_sync(&hpb->map_work);
+	if (hpb->region_tbl && hpb->subregions)
+		ufshpb_drop_maps(hpb);
+
+	vfree(hpb->subregions);
+	vfree(hpb->region_tbl);
+	put_device(&hpb->sdev->sdev_gendev);
+	kfree(hpb);
+}
+
+static struct ufshpb_lu *ufshpb_lu_alloc(struct ufs_hba *hba, int lun,
+					 struct ufshpb_dev_info *info,
+					 u8 *unit_desc)
+{
+	struct ufshpb_lu *hpb;
+	u32 pin_start, pin_num;
+	u32 lu_max_active;
+	u32 i, j;
+
+	hpb = kzalloc(sizeof(*hpb), GFP_KERNEL);
+	if (!hpb)
+		return NULL;
+
+	hpb->hba = hba;
+	hpb->lun = lun;
+	hpb->sdev = hba->sdev_ufs_lu[lun];
+	get_device(&hpb->sdev->sdev_gendev);
+
+	spin_lock_init(&hpb->hpb_lock);
+	INIT_LIST_HEAD(&hpb->lru);
+	INIT_LIST_HEAD(&hpb->act_list);
+	INIT_WORK(&hpb->map_work, ufshpb_map_work_handler);
+
+	hpb->entries_per_region_shift = ilog2(info->region_bytes) -
+					HPB_BLOCK_SHIFT;
+	hpb->entries_per_subregion_shift = ilog2(info->subregion_bytes) -
+					   HPB_BLOCK_SHIFT;
+	hpb->entries_per_subregion = 1U << hpb->entries_per_subregion_shift;
+	hpb->subregions_per_region = 1U << (hpb->entries_per_region_shift -
+					    hpb->entries_per_subregion_shift);
+
+	hpb->lu_blocks = get_unaligned_be64(
+		&unit_desc[UNIT_DESC_PARAM_LOGICAL_BLK_COUNT]);
+	hpb->regions_per_lu = (hpb->lu_blocks +
+			       (1ULL << hpb->entries_per_region_shift) - 1) >>
+			      hpb->entries_per_region_shift;
+
+	lu_max_active = get_unaligned_be16(
+		&unit_desc[UNIT_DESC_HPB_LU_MAX_ACTIVE_REGIONS]);
+	hpb->max_active_regions = lu_max_active ?: info->max_active_regions;
+	hpb->map_mem_budget = HPB_MAP_MEM_BUDGET_DEFAULT;
+	hpb->act_threshold = HPB_ACT_THRESHOLD_DEFAULT;
+
+	hpb->region_tbl = vzalloc(hpb->regions_per_lu *
+				  sizeof(struct ufshpb_region));
+	hpb->subregions = vzalloc((size_t)hpb->regions_per_lu *
+				  hpb->subregions_per_region *
+				  sizeof(struct ufshpb_subregion));
+	if (!hpb->region_tbl || !hpb->subregions)
+		goto out_free;
+
+	for (i = 0; i < hpb->regions_per_lu; i++) {
+		struct ufshpb_region *rgn = &hpb->region_tbl[i];
+
+		rgn->subregion_tbl = &hpb->subregions[i *
+					hpb->subregions_per_region];
+		INIT_LIST_HEAD(&rgn->list_lru);
+		for (j = 0; j < hpb->subregions_per_region; j++)
+			INIT_LIST_HEAD(&rgn->subregion_tbl[j].list_act);
+	}
+
+	pin_start = get_unaligned_be16(
+		&unit_desc[UNIT_DESC_HPB_LU_PIN_REGION_START_OFFSET]);
+	pin_num = get_unaligned_be16(
+		&unit_desc[UNIT_DESC_HPB_LU_NUM_PIN_REGIONS]);
+	for (i = pin_start; i < pin_start + pin_num &&
+	     i < hpb->regions_per_lu; i++)
+		hpb->region_tbl[i].pinned = true;
+
+	dev_info(hba->dev,
+		 "%s: lun %d regions %u x %u subregions, %u entries each, max active %u, pinned %u@%u\n",
+		 __func__, lun, hpb->regions_per_lu,
+		 hpb->subregions_per_region, hpb->entries_per_subregion,
+		 hpb->max_active_regions, pin_num, pin_start);
+
+	return hpb;
+
+out_free:
+	ufshpb_lu_free(hpb);
+	return NULL;
+}
+
+static int ufshpb_probe_lus(struct ufs_hba *hba)
+{
+	struct ufshpb_dev_info info;
+	struct ufshpb_lu *hpb;
+	u8 *desc_buf;
+	int lun, len;
+	int found = 0;
+	int ret;
+
+	desc_buf = kzalloc(QUERY_DESC_MAX_SIZE, GFP_KERNEL);
+	if (!desc_buf)
+		return -ENOMEM;
+
+	ret = ufshpb_get_dev_info(hba, &info, desc_buf);
+	if (ret)
+		goto out;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		len = ufshpb_read_desc(hba, QUERY_DESC_IDN_UNIT, lun,
+				       desc_buf);
+		if (len <= UNIT_DESC_HPB_LU_NUM_PIN_REGIONS + 1 ||
+		    desc_buf[UNIT_DESC_PARAM_LU_ENABLE] != LU_HPB_ENABLE)
+			continue;
+
+		if (desc_buf[UNIT_DESC_PARAM_LOGICAL_BLK_SIZE] !=
+		    HPB_BLOCK_SHIFT) {
+			dev_info(hba->dev, "%s: lun %d block size unsupported\n",
+				 __func__, lun);
+			continue;
+		}
+
+		/* the SCSI device shows up once the async scan is done */
+		if (!hba->sdev_ufs_lu[lun]) {
+			ret = -EAGAIN;
+			goto out;
+		}
+
+		hpb = ufshpb_lu_alloc(hba, lun, &info, desc_buf);
+		if (!hpb) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		hba->ufshpb_lup[lun] = hpb;
+		found++;
+	}
+
+	ret = found ? 0 : -ENODEV;
+out:
+	kfree(desc_buf);
+	return ret;
+}
+
+static void ufshpb_start(struct ufs_hba *hba)
+{
+	struct ufshpb_lu *hpb;
+	int lun;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		hpb = hba->ufshpb_lup[lun];
+		if (!hpb)
+			continue;
+
+		if (!hpb->sysfs_ready) {
+			if (sysfs_create_group(&hpb->sdev->sdev_gendev.kobj,
+					       &ufshpb_attr_group))
+				dev_err(hba->dev,
+					"%s: lun %d failed to create sysfs\n",
+					__func__, lun);
+			else
+				hpb->sysfs_ready = true;
+		}
+
+		if (ufshpb_queue_pinned(hpb))
+			queue_work(system_unbound_wq, &hpb->map_work);
+	}
+}
+
+static void ufshpb_probe(struct ufs_hba *hba)
+{
+	int ret;
+
+	pm_runtime_get_sync(hba->dev);
+	ret = ufshpb_probe_lus(hba);
+	pm_runtime_put_sync(hba->dev);
+
+	if (ret == -EAGAIN &&
+	    hba->ufshpb_init_retry++ < HPB_INIT_MAX_RETRY) {
+		ufshpb_release(hba, HPB_NEED_INIT);
+		schedule_delayed_work(&hba->ufshpb_init_work,
+				      msecs_to_jiffies(HPB_INIT_RETRY_MS));
+		return;
+	}
+
+	if (ret) {
+		ufshpb_release(hba, ret == -ENODEV ?
+			       HPB_NOT_SUPPORTED : HPB_FAILED);
+		if (ret != -ENODEV)
+			dev_err(hba->dev, "%s: HPB init failed %d\n",
+				__func__, ret);
+		return;
+	}
+
+	hba->ufshpb_init_retry = 0;
+	hba->ufshpb_state = HPB_PRESENT;
+	ufshpb_start(hba);
+}
+
+/* The device dropped its HPB state along with the link; start over. */
+static void ufshpb_reset(struct ufs_hba *hba)
+{
+	struct ufshpb_lu *hpb;
+	int lun;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		hpb = hba->ufshpb_lup[lun];
+		if (!hpb)
+			continue;
+
+		cancel_work_sync(&hpb->map_work);
+		ufshpb_drop_maps(hpb);
+	}
+
+	hba->ufshpb_state = HPB_PRESENT;
+	ufshpb_start(hba);
+}
+
+static bool ufshpb_has_lu(struct ufs_hba *hba)
+{
+	int lun;
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++)
+		if (hba->ufshpb_lup[lun])
+			return true;
+
+	return false;
+}
+
+void ufshpb_init_handler(struct work_struct *work)
+{
+	struct ufs_hba *hba = container_of(to_delayed_work(work),
+					   struct ufs_hba, ufshpb_init_work);
+
+	switch (hba->ufshpb_state) {
+	case HPB_NEED_INIT:
+		ufshpb_probe(hba);
+		break;
+	case HPB_RESET:
+		if (ufshpb_has_lu(hba))
+			ufshpb_reset(hba);
+		else
+			ufshpb_probe(hba);
+		break;
+	default:
+		break;
+	}
+}
+
+/**
+ * ufshpb_release - free all HPB logical units
+ * @hba: per adapter instance
+ * @state: HPB state to leave the host in
+ */
+void ufshpb_release(struct ufs_hba *hba, int state)
+{
+	struct ufshpb_lu *hpb[UFS_UPIU_MAX_GENERAL_LUN];
+	int lun;
+
+	hba->ufshpb_state = HPB_FAILED;
+
+	/* called from the init work itself on probe failures */
+	if (current_work() != &hba->ufshpb_init_work.work)
+		cancel_delayed_work_sync(&hba->ufshpb_init_work);
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++) {
+		hpb[lun] = hba->ufshpb_lup[lun];
+		WRITE_ONCE(hba->ufshpb_lup[lun], NULL);
+	}
+
+	/* wait for prep and completion paths still using the LUs */
+	synchronize_rcu();
+
+	for (lun = 0; lun < UFS_UPIU_MAX_GENERAL_LUN; lun++)
+		if (hpb[lun])
+			ufshpb_lu_free(hpb[lun]);
+
+	hba->ufshpb_state = state;
+}
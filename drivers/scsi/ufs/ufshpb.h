@@ -0,0 +1,196 @@
+/*
+ * Universal Flash Storage Host Performance Booster
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ * See the COPYING file in the top-level directory or visit
+ * <http://www.gnu.org/licenses/gpl-2.0.html>
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _UFSHPB_H_
+#define _UFSHPB_H_
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+#include <linux/types.h>
+#include <linux/workqueue.h>
+
+/* HPB READ BUFFER loads the L2P map of one subregion */
+#define UFSHPB_READ_BUFFER		0xF9
+#define UFSHPB_READ_BUFFER_ID		0x01
+
+/* bUFSFeaturesSupport bit advertising HPB */
+#define UFS_FEATURE_SUPPORT_HPB_BIT	0x80
+/* bLUEnable value of an HPB enabled logical unit */
+#define LU_HPB_ENABLE			0x02
+
+#define HPB_ENTRY_SIZE			8
+#define HPB_ENTRY_PER_PAGE		(PAGE_SIZE / HPB_ENTRY_SIZE)
+#define HPB_BLOCK_SHIFT			12	/* one entry per 4KB block */
+
+/* HPB response field layout in the sense data area of a response UPIU */
+#define HPB_RSP_DATA_SEG_LEN		0x14
+#define HPB_RSP_SENSE_SEG_LEN		0x12
+#define HPB_RSP_DESC_TYPE		0x80
+#define HPB_RSP_ADDITIONAL_LEN		0x10
+#define HPB_RSP_MAX_ACTIVE		2
+#define HPB_RSP_MAX_INACTIVE		2
+
+enum UFSHPB_RSP_TYPE {
+	HPB_RSP_NONE			= 0x00,
+	HPB_RSP_REQ_REGION_UPDATE	= 0x01,
+};
+
+/* device context buffer read through the HPB query ioctl */
+#define IOCTL_DEV_CTX_MAX_SIZE		PAGE_SIZE
+#define UFSHPB_DEV_CTX_BUFFER_ID	0x02
+
+enum UFSHPB_STATE {
+	HPB_PRESENT		= 1,
+	HPB_NEED_INIT		= 0,
+	HPB_NOT_SUPPORTED	= -1,
+	HPB_FAILED		= -2,
+	HPB_RESET		= -3,
+};
+
+enum UFSHPB_SUBREGION_STATE {
+	HPB_SUBREGION_INACTIVE,
+	HPB_SUBREGION_LOADING,
+	HPB_SUBREGION_CLEAN,
+};
+
+struct ufs_hba;
+struct ufshcd_lrb;
+struct scsi_device;
+
+/**
+ * struct ufshpb_map_ctx - host copy of the L2P map of one subregion
+ * @m_page: map pages, HPB_ENTRY_PER_PAGE entries each
+ * @ppn_dirty: entries written since the map was loaded
+ * @list_free: entry in a list of maps to free after eviction
+ */
+struct ufshpb_map_ctx {
+	struct page **m_page;
+	unsigned long *ppn_dirty;
+	struct list_head list_free;
+};
+
+/**
+ * struct ufshpb_subregion - unit of map loading
+ * @mctx: loaded map, NULL unless the subregion is loading or clean
+ * @list_act: entry in the activation list
+ * @reads: single block reads missed in the current heat window
+ * @read_stamp: jiffies at which the heat window started
+ * @state: enum UFSHPB_SUBREGION_STATE
+ * @reload: the map must be loaded again
+ */
+struct ufshpb_subregion {
+	struct ufshpb_map_ctx *mctx;
+	struct list_head list_act;
+	u32 reads;
+	unsigned long read_stamp;
+	u8 state;
+	bool reload;
+};
+
+/**
+ * struct ufshpb_region - unit of activation limits and LRU eviction
+ * @subregion_tbl: subregions of this region
+ * @list_lru: entry in the LRU list while any subregion is loaded
+ * @loaded: number of subregions with a map
+ * @pinned: region is pinned by the unit descriptor, never evicted
+ */
+struct ufshpb_region {
+	struct ufshpb_subregion *subregion_tbl;
+	struct list_head list_lru;
+	u16 loaded;
+	bool pinned;
+};
+
+struct ufshpb_stats {
+	u64 hit;
+	u64 miss;
+	u64 map_req;
+	u64 map_fail;
+	u64 evict;
+	u64 rsp_active;
+	u64 rsp_inactive;
+	u64 dirty;
+	u64 hpb_read_cnt;
+	u64 hpb_read_ns;
+	u64 normal_read_cnt;
+	u64 normal_read_ns;
+};
+
+/**
+ * struct ufshpb_lu - HPB state of one logical unit
+ * @hba: host the LU belongs to
+ * @sdev: SCSI device the map requests are issued to
+ * @lun: UPIU LUN
+ * @hpb_lock: protects regions, subregions, lists and stats
+ * @region_tbl: all regions of the LU
+ * @subregions: backing array of all subregions
+ * @lru: regions with loaded maps, most recently used first
+ * @act_list: subregions waiting for their map to be loaded
+ * @map_work: loads maps for subregions in @act_list
+ * @regions_per_lu: number of regions
+ * @subregions_per_region: subregions in a full region
+ * @entries_per_subregion: map entries in a full subregion
+ * @entries_per_region_shift: log2 of entries in a region
+ * @entries_per_subregion_shift: log2 of entries in a subregion
+ * @lu_blocks: LU size in 4KB blocks
+ * @max_active_regions: device limit of regions with a loaded map
+ * @active_regions: regions with a loaded map
+ * @loaded_subregions: subregions with a map
+ * @map_mem_budget: upper bound of host map memory in bytes
+ * @act_threshold: missed reads within the heat window to activate
+ * @sysfs_ready: attributes were added to @sdev
+ * @stats: counters exposed in sysfs
+ */
+struct ufshpb_lu {
+	struct ufs_hba *hba;
+	struct scsi_device *sdev;
+	int lun;
+
+	spinlock_t hpb_lock;
+
+	struct ufshpb_region *region_tbl;
+	struct ufshpb_subregion *subregions;
+	struct list_head lru;
+	struct list_head act_list;
+	struct work_struct map_work;
+
+	u32 regions_per_lu;
+	u32 subregions_per_region;
+	u32 entries_per_subregion;
+	u32 entries_per_region_shift;
+	u32 entries_per_subregion_shift;
+	u64 lu_blocks;
+
+	u32 max_active_regions;
+	u32 active_regions;
+	u32 loaded_subregions;
+
+	u64 map_mem_budget;
+	u32 act_threshold;
+	bool sysfs_ready;
+
+	struct ufshpb_stats stats;
+};
+
+void ufshpb_prep_fn(struct ufs_hba *hba, struct ufshcd_lrb *lrbp);
+void ufshpb_rsp_upiu(struct ufs_hba *hba, struct ufshcd_lrb *lrbp);
+void ufshpb_restore_cdb(struct ufshcd_lrb *lrbp);
+void ufshpb_init_handler(struct work_struct *work);
+void ufshpb_release(struct ufs_hba *hba, int state);
+int ufshpb_issue_req_dev_ctx(struct ufshpb_lu *hpb, unsigned char *buf,
+			     int buf_length);
+
+#endif /* _UFSHPB_H_ */
@@ -23,6 +23,11 @@
 #include <linux/module.h>
 #include <linux/moduleparam.h>
 #include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/mutex.h>
+#include <linux/slab.h>
+#include <linux/timekeeping.h>
+#include <linux/wait.h>
 #include <asm/uaccess.h>
 #include "dellog.h"
 
@@ -106,7 +111,7 @@ static const struct file_operations dellog_pipe_operations = {
 	.llseek		= dellog_llseek,
 };
 
-static const char DEF_DELLOG_VER_STR[] = "0.0.1\n";
+static const char DEF_DELLOG_VER_STR[] = "0.0.2\n";
 
 static ssize_t dellog_ver_read(struct file *file, char __user *buf,
 			 size_t count, loff_t *ppos)
@@ -136,20 +141,13 @@ static const struct file_operations dellog_ver_operations = {
 	.read		= dellog_ver_read,
 };
 
-static int __init dellog_init(void)
-{
-	proc_create("dellog", S_IRUGO, NULL, &dellog_operations);
-	proc_create("dellog_pipe", S_IRUGO, NULL, &dellog_pipe_operations);
-	proc_create("dellog_version", S_IRUGO, NULL, &dellog_ver_operations);
-	return 0;
-}
-module_init(dellog_init);
-
 #define CONFIG_DELBUF_SHIFT 19 /*512KB*/
 
 struct delbuf {
 	u16 len;
 	u16 text_len;
+	u32 cpu;
+	u64 ts_nsec;
 	struct timeval tv;
 	char comm[TASK_COMM_LEN];
 	char tgid_comm[TASK_COMM_LEN];
@@ -204,18 +202,39 @@ static u32 delbuf_next(u32 idx)
 	return idx + msg->len;
 }
 
-static void delbuf_store(const char *text, u16 text_len,
-		      struct task_struct *owner)
+/* padded size of a record carrying text_len bytes of text */
+static u32 delbuf_size(u16 text_len)
 {
-	struct delbuf *msg;
-	u32 size, pad_len;
-	struct task_struct *p = find_task_by_vpid(owner->tgid);
+	u32 size = sizeof(struct delbuf) + text_len;
 
 	/* number of '\0' padding bytes to next message */
-	size = sizeof(struct delbuf) + text_len;
-	pad_len = (-size) & (DELBUF_ALIGN - 1);
-	size += pad_len;
+	return size + ((-size) & (DELBUF_ALIGN - 1));
+}
 
+static void delbuf_fill(struct delbuf *msg, const char *text, u16 text_len,
+		      struct task_struct *owner)
+{
+	struct task_struct *p;
+
+	memcpy(delbuf_text(msg), text, text_len);
+	msg->text_len = text_len;
+	memcpy(msg->comm, owner->comm, TASK_COMM_LEN);
+	rcu_read_lock();
+	p = find_task_by_vpid(owner->tgid);
+	if (p)
+		memcpy(msg->tgid_comm, p->comm, TASK_COMM_LEN);
+	else
+		msg->tgid_comm[0] = 0;
+	rcu_read_unlock();
+	msg->len = delbuf_size(text_len);
+	msg->cpu = smp_processor_id();
+	msg->ts_nsec = ktime_get_ns();
+	do_gettimeofday(&msg->tv);
+}
+
+/* make room for a record of size bytes at delbuf_next_idx */
+static struct delbuf *delbuf_reserve(u32 size)
+{
 	while (delbuf_first_seq < delbuf_next_seq) {
 		u32 free;
 
@@ -237,23 +256,23 @@ static void delbuf_store(const char *text, u16 text_len,
 		delbuf_next_idx = 0;
 	}
 
-	/* fill message */
-	msg = (struct delbuf *)(delbuf_buf + delbuf_next_idx);
-	memcpy(delbuf_text(msg), text, text_len);
-	msg->text_len = text_len;
-	memcpy(msg->comm, owner->comm, TASK_COMM_LEN);
-	if (p)
-		memcpy(msg->tgid_comm, p->comm, TASK_COMM_LEN);
-	else
-		msg->tgid_comm[0] = 0;
-	msg->len = sizeof(struct delbuf) + text_len + pad_len;
-	do_gettimeofday(&msg->tv);
+	return (struct delbuf *)(delbuf_buf + delbuf_next_idx);
+}
 
+static void delbuf_commit(struct delbuf *msg)
+{
 	/* insert message */
 	delbuf_next_idx += msg->len;
 	delbuf_next_seq++;
-	wake_up_interruptible(&delbuf_wait);
+}
+
+/* copy a complete record, e.g. a staged one, into the ring */
+static void delbuf_store(const struct delbuf *rec)
+{
+	struct delbuf *msg = delbuf_reserve(rec->len);
 
+	memcpy(msg, rec, sizeof(struct delbuf) + rec->text_len);
+	delbuf_commit(msg);
 }
 
 static size_t dellog_print_pid(const struct delbuf *msg, char *buf)
@@ -439,6 +458,214 @@ static int dellog_print_all(char __user *buf, int size)
 	return len;
 }
 
+/*
+ * Deletes are staged per CPU and merged into the ring in batches by
+ * dellog_merger, so that mass unlinks on several CPUs do not serialize
+ * on delbuf_lock. Each CPU appends to its own staging ring under its
+ * stage lock, the merger takes the records off the tail under the same
+ * lock, one at a time.
+ */
+#define DELLOG_STAGE_SIZE	(16 << 10)
+/* merge early once a CPU has this much staged */
+#define DELLOG_STAGE_HIGH	(DELLOG_STAGE_SIZE / 2)
+/* otherwise a burst of deletes gets this long to collect */
+#define DELLOG_MERGE_DELAY	(HZ / 10)
+
+struct dellog_stage {
+	raw_spinlock_t lock;
+	/* free running byte positions, head - tail is in use */
+	u32 head;
+	u32 tail;
+	char text[DELBUF_LINE_MAX];
+	char buf[DELLOG_STAGE_SIZE] __aligned(DELBUF_ALIGN);
+};
+
+/* indexed by cpu, NULL if staging is off and records go to the ring */
+static struct dellog_stage **dellog_stages;
+/* time stamp of the tail record of each cpu, owned by the merger */
+static u64 *dellog_merge_ts;
+
+static DEFINE_MUTEX(dellog_merge_lock);
+static DECLARE_WAIT_QUEUE_HEAD(dellog_merge_wait);
+static bool dellog_pending;
+static bool dellog_urgent;
+
+static struct delbuf *dellog_stage_rec(struct dellog_stage *st, u32 pos)
+{
+	return (struct delbuf *)(st->buf + (pos & (DELLOG_STAGE_SIZE - 1)));
+}
+
+/*
+ * Room for a record of size bytes at st->head, NULL if the stage is full.
+ * A record does not wrap, a zero len marks the rest of the buffer unused.
+ */
+static struct delbuf *dellog_stage_reserve(struct dellog_stage *st, u32 size)
+{
+	u32 room = DELLOG_STAGE_SIZE - (st->head & (DELLOG_STAGE_SIZE - 1));
+	u32 need = size > room ? size + room : size;
+
+	if (st->head - st->tail + need > DELLOG_STAGE_SIZE)
+		return NULL;
+	if (size > room) {
+		dellog_stage_rec(st, st->head)->len = 0;
+		st->head += room;
+	}
+	return dellog_stage_rec(st, st->head);
+}
+
+/* oldest staged record of st, NULL if none; called with st->lock held */
+static struct delbuf *dellog_stage_peek(struct dellog_stage *st)
+{
+	struct delbuf *msg;
+
+	if (st->tail == st->head)
+		return NULL;
+	msg = dellog_stage_rec(st, st->tail);
+	if (!msg->len) {
+		st->tail += DELLOG_STAGE_SIZE -
+			    (st->tail & (DELLOG_STAGE_SIZE - 1));
+		msg = dellog_stage_rec(st, st->tail);
+	}
+	return msg;
+}
+
+/* time stamp of the oldest record of st up to cutoff, U64_MAX if none */
+static u64 dellog_stage_next_ts(struct dellog_stage *st, u64 cutoff)
+{
+	struct delbuf *msg = dellog_stage_peek(st);
+
+	return msg && msg->ts_nsec <= cutoff ? msg->ts_nsec : U64_MAX;
+}
+
+/*
+ * Move the records staged so far into the ring. Records of one CPU are
+ * already in time order, the CPUs are interleaved by time stamp. Records
+ * stamped after the merge started stay staged for the next batch, so a
+ * late record of one CPU never lands behind a newer one of another.
+ */
+static void dellog_merge(void)
+{
+	struct dellog_stage *st;
+	struct delbuf *msg;
+	unsigned int cpu, min_cpu;
+	u64 cutoff, min_ts;
+	bool merged = false;
+
+	if (!dellog_stages)
+		return;
+
+	mutex_lock(&dellog_merge_lock);
+	WRITE_ONCE(dellog_pending, false);
+	WRITE_ONCE(dellog_urgent, false);
+
+	/* everything stamped before this is staged once we took each lock */
+	cutoff = ktime_get_ns();
+	for_each_possible_cpu(cpu) {
+		st = dellog_stages[cpu];
+		raw_spin_lock_irq(&st->lock);
+		dellog_merge_ts[cpu] = dellog_stage_next_ts(st, cutoff);
+		raw_spin_unlock_irq(&st->lock);
+	}
+
+	for (;;) {
+		min_ts = U64_MAX;
+		min_cpu = 0;
+		for_each_possible_cpu(cpu) {
+			if (dellog_merge_ts[cpu] < min_ts) {
+				min_ts = dellog_merge_ts[cpu];
+				min_cpu = cpu;
+			}
+		}
+		if (min_ts == U64_MAX)
+			break;
+
+		st = dellog_stages[min_cpu];
+		raw_spin_lock_irq(&st->lock);
+		msg = dellog_stage_peek(st);
+		/* the writer moved its records on itself, look again */
+		if (!msg || msg->ts_nsec != min_ts) {
+			dellog_merge_ts[min_cpu] = dellog_stage_next_ts(st, cutoff);
+			raw_spin_unlock_irq(&st->lock);
+			continue;
+		}
+
+		raw_spin_lock(&delbuf_lock);
+		delbuf_store(msg);
+		raw_spin_unlock(&delbuf_lock);
+		st->tail += msg->len;
+		dellog_merge_ts[min_cpu] = dellog_stage_next_ts(st, cutoff);
+		raw_spin_unlock_irq(&st->lock);
+		merged = true;
+
+		cond_resched();
+	}
+
+	/* records of the next batch, the writers only kick an empty stage */
+	for_each_possible_cpu(cpu) {
+		st = dellog_stages[cpu];
+		if (READ_ONCE(st->head) != READ_ONCE(st->tail)) {
+			WRITE_ONCE(dellog_pending, true);
+			break;
+		}
+	}
+	mutex_unlock(&dellog_merge_lock);
+
+	if (merged)
+		wake_up_interruptible(&delbuf_wait);
+}
+
+static int dellog_merger(void *unused)
+{
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(dellog_merge_wait,
+			READ_ONCE(dellog_pending) || kthread_should_stop());
+		wait_event_interruptible_timeout(dellog_merge_wait,
+			READ_ONCE(dellog_urgent) || kthread_should_stop(),
+			DELLOG_MERGE_DELAY);
+		dellog_merge();
+	}
+	return 0;
+}
+
+static int __init dellog_stage_init(void)
+{
+	struct dellog_stage **stages;
+	struct task_struct *task;
+	unsigned int cpu;
+
+	dellog_merge_ts = kcalloc(nr_cpu_ids, sizeof(*dellog_merge_ts),
+				  GFP_KERNEL);
+	stages = kcalloc(nr_cpu_ids, sizeof(*stages), GFP_KERNEL);
+	if (!stages || !dellog_merge_ts) {
+		kfree(stages);
+		kfree(dellog_merge_ts);
+		dellog_merge_ts = NULL;
+		return -ENOMEM;
+	}
+
+	for_each_possible_cpu(cpu) {
+		stages[cpu] = kzalloc_node(sizeof(**stages), GFP_KERNEL,
+					   cpu_to_node(cpu));
+		if (!stages[cpu])
+			goto free;
+		raw_spin_lock_init(&stages[cpu]->lock);
+	}
+
+	dellog_stages = stages;
+	task = kthread_run(dellog_merger, NULL, "dellog_merge");
+	if (!IS_ERR(task))
+		return 0;
+	dellog_stages = NULL;
+
+free:
+	for_each_possible_cpu(cpu)
+		kfree(stages[cpu]);
+	kfree(stages);
+	kfree(dellog_merge_ts);
+	dellog_merge_ts = NULL;
+	return -ENOMEM;
+}
+
 int do_dellog(int type, char __user *buf, int len, bool from_file)
 {
 	int error=0;
@@ -477,6 +704,8 @@ int do_dellog(int type, char __user *buf, int len, bool from_file)
 			goto out;
 		}
 
+		/* dumpstate wants the deletes up to now */
+		dellog_merge();
 		error = dellog_print_all(buf, len);
 		if (error == 0) {
 			dellog_clear_seq=delbuf_first_seq;
@@ -531,37 +760,94 @@ int do_dellog_write(int type, const char __user *buf, int len, bool from_file)
 
 }
 
+/* format a record text into text, DELBUF_LINE_MAX bytes */
+static size_t dellog_format(char *text, const char *fmt, va_list args)
+{
+	size_t text_len = vscnprintf(text, DELBUF_LINE_MAX, fmt, args);
+
+	/* mark and strip a trailing newline */
+	if (text_len && text[text_len-1] == '\n')
+		text_len--;
+
+	return text_len;
+}
+
+/* store a record straight into the ring, called with delbuf_lock held */
+static void delbuf_store_text(const char *text, u16 text_len)
+{
+	struct delbuf *msg = delbuf_reserve(delbuf_size(text_len));
+
+	delbuf_fill(msg, text, text_len, current);
+	delbuf_commit(msg);
+}
+
 asmlinkage int vdellog(const char *fmt, va_list args)
 {
 	static char textbuf[DELBUF_LINE_MAX];
-	char *text = textbuf;
+	struct dellog_stage *st;
+	struct delbuf *msg, *old;
 	size_t text_len;
 	unsigned long flags;
-	int printed_len = 0;
-	bool stored = false;
+	u32 used, size;
+	bool kick = false, direct = false;
 
 	local_irq_save(flags);
 
-	raw_spin_lock(&delbuf_lock);
-
-	text_len = vscnprintf(text, sizeof(textbuf), fmt, args);
-
+	if (!dellog_stages) {
+		raw_spin_lock(&delbuf_lock);
+		text_len = dellog_format(textbuf, fmt, args);
+		delbuf_store_text(textbuf, text_len);
+		raw_spin_unlock(&delbuf_lock);
+		local_irq_restore(flags);
 
-	/* mark and strip a trailing newline */
-	if (text_len && text[text_len-1] == '\n') {
-		text_len--;
+		wake_up_interruptible(&delbuf_wait);
+		return text_len;
 	}
 
-	if (!stored)
-		delbuf_store(text, text_len,  current);
+	st = dellog_stages[smp_processor_id()];
+	raw_spin_lock(&st->lock);
+
+	text_len = dellog_format(st->text, fmt, args);
+	size = delbuf_size(text_len);
+	used = st->head - st->tail;
+	msg = dellog_stage_reserve(st, size);
+	if (!msg) {
+		/*
+		 * The merger is behind, do not lose the record. The records
+		 * of this CPU go to the ring first so that they stay in order.
+		 */
+		while ((old = dellog_stage_peek(st))) {
+			raw_spin_lock(&delbuf_lock);
+			delbuf_store(old);
+			raw_spin_unlock(&delbuf_lock);
+			st->tail += old->len;
+		}
+		used = 0;
+		msg = dellog_stage_reserve(st, size);
+		WRITE_ONCE(dellog_urgent, true);
+		kick = direct = true;
+	}
 
-	printed_len += text_len;
+	delbuf_fill(msg, st->text, text_len, current);
+	st->head += size;
+	if (!used)
+		kick = true;
+	if (used < DELLOG_STAGE_HIGH && used + size >= DELLOG_STAGE_HIGH) {
+		WRITE_ONCE(dellog_urgent, true);
+		kick = true;
+	}
+	if (kick)
+		WRITE_ONCE(dellog_pending, true);
 
-	raw_spin_unlock(&delbuf_lock);
+	raw_spin_unlock(&st->lock);
 	local_irq_restore(flags);
 
+	if (kick)
+		wake_up(&dellog_merge_wait);
+	if (direct)
+		wake_up_interruptible(&delbuf_wait);
 
-	return printed_len;
+	return text_len;
 }
 
 EXPORT_SYMBOL(vdellog);
@@ -583,3 +869,137 @@ asmlinkage int dellog(const char *fmt, ...)
 	return r;
 }
 EXPORT_SYMBOL(dellog);
+
+/*
+ * /proc/dellog_bin hands out the ring as struct dellog_bin_rec records,
+ * see include/uapi/linux/sdcardfs_dellog.h for the layout.
+ * Unlike /proc/dellog every open file has its own cursor, reading does
+ * not consume records for other readers.
+ */
+struct dellog_bin_cursor {
+	u64 seq;
+	u32 idx;
+};
+
+#define DELLOG_BIN_REC_MAX \
+	ALIGN(sizeof(struct dellog_bin_rec) + DELBUF_LINE_MAX, \
+	      DELLOG_BIN_REC_ALIGN)
+
+static int dellog_bin_open(struct inode *inode, struct file *file)
+{
+	struct dellog_bin_cursor *cur;
+
+	cur = kmalloc(sizeof(*cur), GFP_KERNEL);
+	if (!cur)
+		return -ENOMEM;
+
+	raw_spin_lock_irq(&delbuf_lock);
+	cur->seq = delbuf_first_seq;
+	cur->idx = delbuf_first_idx;
+	raw_spin_unlock_irq(&delbuf_lock);
+
+	file->private_data = cur;
+	return 0;
+}
+
+static int dellog_bin_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static size_t dellog_bin_fill(char *buf, const struct delbuf *msg, u64 seq)
+{
+	struct dellog_bin_rec *rec = (struct dellog_bin_rec *)buf;
+	size_t len = ALIGN(sizeof(*rec) + msg->text_len, DELLOG_BIN_REC_ALIGN);
+
+	BUILD_BUG_ON(sizeof(rec->comm) != TASK_COMM_LEN);
+	memset(rec, 0, len);
+	rec->seq = seq;
+	rec->ts_nsec = msg->ts_nsec;
+	rec->tv_sec = msg->tv.tv_sec;
+	rec->tv_usec = msg->tv.tv_usec;
+	rec->len = len;
+	rec->text_len = msg->text_len;
+	rec->cpu = msg->cpu;
+	memcpy(rec->comm, msg->comm, sizeof(rec->comm));
+	memcpy(rec->tgid_comm, msg->tgid_comm, sizeof(rec->tgid_comm));
+	memcpy(buf + sizeof(*rec), delbuf_text(msg), msg->text_len);
+
+	return len;
+}
+
+/*
+ * Returns whole records only, 0 once the cursor caught up with the ring
+ * and -EINVAL if count cannot hold the next record.
+ */
+static ssize_t dellog_bin_read(struct file *file, char __user *buf,
+			 size_t count, loff_t *ppos)
+{
+	struct dellog_bin_cursor *cur = file->private_data;
+	ssize_t len = 0;
+	size_t n;
+	char *rec;
+
+	rec = kmalloc(DELLOG_BIN_REC_MAX, GFP_KERNEL);
+	if (!rec)
+		return -ENOMEM;
+
+	dellog_merge();
+
+	for (;;) {
+		raw_spin_lock_irq(&delbuf_lock);
+		if (cur->seq < delbuf_first_seq) {
+			/* overwritten, the gap shows in rec->seq */
+			cur->seq = delbuf_first_seq;
+			cur->idx = delbuf_first_idx;
+		}
+		if (cur->seq == delbuf_next_seq) {
+			raw_spin_unlock_irq(&delbuf_lock);
+			break;
+		}
+
+		n = dellog_bin_fill(rec, delbuf_from_idx(cur->idx), cur->seq);
+		if (n > count) {
+			raw_spin_unlock_irq(&delbuf_lock);
+			if (!len)
+				len = -EINVAL;
+			break;
+		}
+		cur->idx = delbuf_next(cur->idx);
+		cur->seq++;
+		raw_spin_unlock_irq(&delbuf_lock);
+
+		if (copy_to_user(buf, rec, n)) {
+			if (!len)
+				len = -EFAULT;
+			break;
+		}
+		len += n;
+		count -= n;
+		buf += n;
+	}
+
+	kfree(rec);
+	return len;
+}
+
+static const struct file_operations dellog_bin_operations = {
+	.read		= dellog_bin_read,
+	.open		= dellog_bin_open,
+	.release	= dellog_bin_release,
+	.llseek		= noop_llseek,
+};
+
+static int __init dellog_init(void)
+{
+	if (dellog_stage_init())
+		pr_warn("dellog: per-cpu staging disabled\n");
+
+	proc_create("dellog", S_IRUGO, NULL, &dellog_operations);
+	proc_create("dellog_pipe", S_IRUGO, NULL, &dellog_pipe_operations);
+	proc_create("dellog_version", S_IRUGO, NULL, &dellog_ver_operations);
+	proc_create("dellog_bin", S_IRUGO, NULL, &dellog_bin_operations);
+	return 0;
+}
+module_init(dellog_init);
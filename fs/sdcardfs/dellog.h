@@ -16,6 +16,9 @@
 #ifndef _LINUX_DELLOG_H
 #define  _LINUX_DELLOG_H
 
+#include <linux/types.h>
+#include <linux/sdcardfs_dellog.h>
+
 #define DELLOG_ACTION_CLOSE          	0
 #define DELLOG_ACTION_OPEN           	1
 #define DELLOG_ACTION_READ		2
@@ -47,6 +47,10 @@ static int sdcardfs_d_revalidate(struct dentry *dentry, unsigned int flags)
 	}
 	spin_unlock(&dentry->d_lock);
 
+	/* packages.list changed for this user after we were looked up */
+	if (xchg(&SDCARDFS_D(dentry)->perm_stale, false))
+		update_derived_permission_lock(dentry);
+
 	/* check uninitialized obb_dentry and
 	 * whether the base obbpath has been changed or not
 	 */
@@ -137,6 +141,7 @@ static void sdcardfs_d_release(struct dentry *dentry)
 	if (has_graft_path(dentry))
 		sdcardfs_put_reset_orig_path(dentry);
 	sdcardfs_put_reset_lower_path(dentry);
+	pkg_index_remove(dentry);
 	free_dentry_private_data(dentry);
 }
 
@@ -58,15 +58,13 @@ void setup_derived_state(struct inode *inode, perm_t perm, userid_t userid,
 #endif /* VENDOR_EDIT */
 }
 
-/* While renaming, there is a point where we want the path from dentry,
- * but the name from newdentry
- */
-void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
-				const struct qstr *name)
+static void __get_derived_permission_new(struct dentry *parent,
+				struct dentry *dentry, const struct qstr *name)
 {
 	struct sdcardfs_inode_info *info = SDCARDFS_I(d_inode(dentry));
 	struct sdcardfs_inode_info *parent_info = SDCARDFS_I(d_inode(parent));
 	struct sdcardfs_inode_data *parent_data = parent_info->data;
+	struct qstr q_pkg;
 	appid_t appid;
 	unsigned long user_num;
 	int err;
@@ -171,8 +169,12 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	case PERM_ANDROID_DATA:
 	case PERM_ANDROID_MEDIA:
 		info->data->perm = PERM_ANDROID_PACKAGE;
-		appid = get_appid(name->name);
-		if (appid != 0 && !is_excluded(name->name, parent_data->userid))
+		/* hash once for both lookups */
+		q_pkg.name = name->name;
+		q_pkg.hash_len = hashlen_create(full_name_case_hash(NULL,
+				name->name, name->len), name->len);
+		appid = get_appid_qstr(&q_pkg);
+		if (appid != 0 && !is_excluded_qstr(&q_pkg, parent_data->userid))
 			info->data->d_uid =
 				multiuser_get_uid(parent_data->userid, appid);
 		break;
@@ -215,6 +217,61 @@ void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
 	}
 }
 
+/*
+ * Package directories (children of Android/data, obb and media) are kept in
+ * a per-superblock index keyed by the case folded package name, so that a
+ * packages.list update only has to touch the dentries of that package.
+ */
+static void pkg_index_update(struct dentry *dentry, const struct qstr *name)
+{
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(dentry->d_sb);
+	struct sdcardfs_dentry_info *di = SDCARDFS_D(dentry);
+	bool is_pkg = SDCARDFS_I(d_inode(dentry))->data->perm == PERM_ANDROID_PACKAGE;
+	unsigned int hash = 0;
+
+	if (!di || (!is_pkg && hlist_unhashed(&di->pkg_node)))
+		return;
+
+	if (is_pkg)
+		hash = full_name_case_hash(NULL, name->name, name->len);
+
+	spin_lock(&sbi->pkg_lock);
+	if (!hlist_unhashed(&di->pkg_node)) {
+		if (is_pkg && di->pkg_hash == hash)
+			goto out;
+		hash_del(&di->pkg_node);
+	}
+	if (is_pkg) {
+		di->pkg_hash = hash;
+		hash_add(sbi->pkg_index, &di->pkg_node, hash);
+	}
+out:
+	spin_unlock(&sbi->pkg_lock);
+}
+
+void pkg_index_remove(struct dentry *dentry)
+{
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(dentry->d_sb);
+	struct sdcardfs_dentry_info *di = SDCARDFS_D(dentry);
+
+	if (hlist_unhashed(&di->pkg_node))
+		return;
+
+	spin_lock(&sbi->pkg_lock);
+	hash_del(&di->pkg_node);
+	spin_unlock(&sbi->pkg_lock);
+}
+
+/* While renaming, there is a point where we want the path from dentry,
+ * but the name from newdentry
+ */
+void get_derived_permission_new(struct dentry *parent, struct dentry *dentry,
+				const struct qstr *name)
+{
+	__get_derived_permission_new(parent, dentry, name);
+	pkg_index_update(dentry, name);
+}
+
 void get_derived_permission(struct dentry *parent, struct dentry *dentry)
 {
 	get_derived_permission_new(parent, dentry, &dentry->d_name);
@@ -344,67 +401,63 @@ void fixup_lower_ownership(struct dentry *dentry, const char *name)
 	sdcardfs_put_lower_path(dentry, &path);
 }
 
-static int descendant_may_need_fixup(struct sdcardfs_inode_data *data,
-		struct limit_search *limit)
-{
-	if (data->perm == PERM_ROOT)
-		return (limit->flags & BY_USERID) ?
-				data->userid == limit->userid : 1;
-	if (data->perm == PERM_PRE_ROOT || data->perm == PERM_ANDROID)
-		return 1;
-	return 0;
-}
-
-static int needs_fixup(perm_t perm)
+/* called with sbi->pkg_lock held */
+static void fixup_package_perms(struct dentry *dentry, struct limit_search *limit)
 {
-	if (perm == PERM_ANDROID_DATA || perm == PERM_ANDROID_OBB
-			|| perm == PERM_ANDROID_MEDIA)
-		return 1;
-	return 0;
+	struct sdcardfs_inode_data *data;
+
+	spin_lock(&dentry->d_lock);
+	if (!d_inode(dentry))
+		goto out;
+	data = SDCARDFS_I(d_inode(dentry))->data;
+	if ((limit->flags & BY_USERID) && data->userid != limit->userid)
+		goto out;
+
+	if (limit->flags & BY_NAME) {
+		if (!qstr_case_eq(&dentry->d_name, &limit->name))
+			goto out;
+		__get_derived_permission_new(dentry->d_parent, dentry,
+				&dentry->d_name);
+		fixup_tmp_permissions(d_inode(dentry));
+	} else {
+		/*
+		 * A whole user changed, which may be hundreds of packages.
+		 * Let sdcardfs_d_revalidate() fix them up on the next lookup.
+		 */
+		WRITE_ONCE(SDCARDFS_D(dentry)->perm_stale, true);
+	}
+out:
+	spin_unlock(&dentry->d_lock);
 }
 
-static void __fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit, int depth)
+/*
+ * Fix up the package directories selected by @limit. limit->name must carry
+ * the full_name_case_hash() of the package name.
+ * Returns the number of index entries visited.
+ */
+unsigned int fixup_perms_indexed(struct super_block *sb, struct limit_search *limit)
 {
-	struct dentry *child;
-	struct sdcardfs_inode_info *info;
-
-	/*
-	 * All paths will terminate their recursion on hitting PERM_ANDROID_OBB,
-	 * PERM_ANDROID_MEDIA, or PERM_ANDROID_DATA. This happens at a depth of
-	 * at most 3.
-	 */
-	WARN(depth > 3, "%s: Max expected depth exceeded!\n", __func__);
-	spin_lock_nested(&dentry->d_lock, depth);
-	if (!d_inode(dentry)) {
-		spin_unlock(&dentry->d_lock);
-		return;
-	}
-	info = SDCARDFS_I(d_inode(dentry));
-
-	if (needs_fixup(info->data->perm)) {
-		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
-			spin_lock_nested(&child->d_lock, depth + 1);
-			if (!(limit->flags & BY_NAME) || qstr_case_eq(&child->d_name, &limit->name)) {
-				if (d_inode(child)) {
-					get_derived_permission(dentry, child);
-					fixup_tmp_permissions(d_inode(child));
-					spin_unlock(&child->d_lock);
-					break;
-				}
-			}
-			spin_unlock(&child->d_lock);
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(sb);
+	struct sdcardfs_dentry_info *di;
+	unsigned int visited = 0;
+	int bkt;
+
+	spin_lock(&sbi->pkg_lock);
+	if (limit->flags & BY_NAME) {
+		hash_for_each_possible(sbi->pkg_index, di, pkg_node, limit->name.hash) {
+			visited++;
+			if (di->pkg_hash == limit->name.hash)
+				fixup_package_perms(di->dentry, limit);
 		}
-	} else if (descendant_may_need_fixup(info->data, limit)) {
-		list_for_each_entry(child, &dentry->d_subdirs, d_child) {
-			__fixup_perms_recursive(child, limit, depth + 1);
+	} else {
+		hash_for_each(sbi->pkg_index, bkt, di, pkg_node) {
+			visited++;
+			fixup_package_perms(di->dentry, limit);
 		}
 	}
-	spin_unlock(&dentry->d_lock);
-}
+	spin_unlock(&sbi->pkg_lock);
 
-void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit)
-{
-	__fixup_perms_recursive(dentry, limit, 0);
+	return visited;
 }
 
 /* main function for updating derived permission */
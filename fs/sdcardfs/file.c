@@ -372,6 +372,17 @@ static loff_t sdcardfs_file_llseek(struct file *file, loff_t offset, int whence)
 	return err;
 }
 
+/* update upper inode times/sizes after a write to the lower file */
+static void sdcardfs_copy_write_attrs(struct inode *inode, struct file *lower_file)
+{
+	if (sizeof(loff_t) > sizeof(long))
+		inode_lock(inode);
+	fsstack_copy_inode_size(inode, file_inode(lower_file));
+	fsstack_copy_attr_times(inode, file_inode(lower_file));
+	if (sizeof(loff_t) > sizeof(long))
+		inode_unlock(inode);
+}
+
 /*
  * Sdcardfs read_iter, redirect modified iocb to lower read_iter
  */
@@ -420,18 +431,115 @@ ssize_t sdcardfs_write_iter(struct kiocb *iocb, struct iov_iter *iter)
 	iocb->ki_filp = file;
 	fput(lower_file);
 	/* update upper inode times/sizes as needed */
-	if (err >= 0 || err == -EIOCBQUEUED) {
-		if (sizeof(loff_t) > sizeof(long))
-			inode_lock(inode);
-		fsstack_copy_inode_size(inode, file_inode(lower_file));
-		fsstack_copy_attr_times(inode, file_inode(lower_file));
-		if (sizeof(loff_t) > sizeof(long))
-			inode_unlock(inode);
-	}
+	if (err >= 0 || err == -EIOCBQUEUED)
+		sdcardfs_copy_write_attrs(inode, lower_file);
 out:
 	return err;
 }
 
+/*
+ * Sdcardfs splice_read, hand the lower page cache pages to the pipe
+ */
+static ssize_t sdcardfs_splice_read(struct file *file, loff_t *ppos,
+				struct pipe_inode_info *pipe, size_t len,
+				unsigned int flags)
+{
+	ssize_t err;
+	struct file *lower_file;
+	const struct cred *saved_cred;
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(file_inode(file)->i_sb);
+
+	lower_file = sdcardfs_lower_file(file);
+	if (!lower_file->f_op->splice_read)
+		return generic_file_splice_read(file, ppos, pipe, len, flags);
+
+	saved_cred = override_fsids(sbi, SDCARDFS_I(file_inode(file))->data);
+	if (!saved_cred)
+		return -ENOMEM;
+
+	err = lower_file->f_op->splice_read(lower_file, ppos, pipe, len, flags);
+	/* update upper inode atime as needed */
+	if (err >= 0)
+		fsstack_copy_attr_atime(file_inode(file), file_inode(lower_file));
+	revert_fsids(saved_cred);
+	return err;
+}
+
+/*
+ * Sdcardfs splice_write, move the pipe pages straight into the lower file
+ */
+static ssize_t sdcardfs_splice_write(struct pipe_inode_info *pipe,
+				struct file *file, loff_t *ppos, size_t len,
+				unsigned int flags)
+{
+	ssize_t err;
+	struct file *lower_file;
+	const struct cred *saved_cred;
+	struct inode *inode = file_inode(file);
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(inode->i_sb);
+
+	/* check disk space */
+	if (!check_min_free_space(file->f_path.dentry, len, 0)) {
+		pr_err("No minimum free space.\n");
+		return -ENOSPC;
+	}
+
+	lower_file = sdcardfs_lower_file(file);
+	if (!lower_file->f_op->splice_write)
+		return iter_file_splice_write(pipe, file, ppos, len, flags);
+
+	saved_cred = override_fsids(sbi, SDCARDFS_I(inode)->data);
+	if (!saved_cred)
+		return -ENOMEM;
+
+	err = lower_file->f_op->splice_write(pipe, lower_file, ppos, len, flags);
+	if (err >= 0)
+		sdcardfs_copy_write_attrs(inode, lower_file);
+	revert_fsids(saved_cred);
+	return err;
+}
+
+/*
+ * Sdcardfs copy_file_range, let the lower fs clone or copy in place
+ */
+static ssize_t sdcardfs_copy_file_range(struct file *file_in, loff_t pos_in,
+				struct file *file_out, loff_t pos_out,
+				size_t len, unsigned int flags)
+{
+	ssize_t err;
+	struct file *lower_in, *lower_out;
+	const struct cred *saved_cred;
+	struct inode *inode = file_inode(file_out);
+	struct sdcardfs_sb_info *sbi = SDCARDFS_SB(inode->i_sb);
+
+	/* check disk space */
+	if (!check_min_free_space(file_out->f_path.dentry, len, 0)) {
+		pr_err("No minimum free space.\n");
+		return -ENOSPC;
+	}
+
+	lower_in = sdcardfs_lower_file(file_in);
+	lower_out = sdcardfs_lower_file(file_out);
+
+	saved_cred = override_fsids(sbi, SDCARDFS_I(inode)->data);
+	if (!saved_cred)
+		return -ENOMEM;
+
+	err = vfs_copy_file_range(lower_in, pos_in, lower_out, pos_out,
+				  len, flags);
+	if (err > 0) {
+		fsstack_copy_attr_atime(file_inode(file_in),
+					file_inode(lower_in));
+		sdcardfs_copy_write_attrs(inode, lower_out);
+	}
+	revert_fsids(saved_cred);
+
+	/* views of different lower fs, let the VFS splice between us */
+	if (err == -EXDEV)
+		err = -EOPNOTSUPP;
+	return err;
+}
+
 const struct file_operations sdcardfs_main_fops = {
 	.llseek		= generic_file_llseek,
 	.read		= sdcardfs_read,
@@ -448,6 +556,9 @@ const struct file_operations sdcardfs_main_fops = {
 	.fasync		= sdcardfs_fasync,
 	.read_iter	= sdcardfs_read_iter,
 	.write_iter	= sdcardfs_write_iter,
+	.splice_read	= sdcardfs_splice_read,
+	.splice_write	= sdcardfs_splice_write,
+	.copy_file_range = sdcardfs_copy_file_range,
 };
 
 /* trimmed directory options */
@@ -20,6 +20,8 @@
 
 #include "sdcardfs.h"
 #include "linux/delay.h"
+#include <linux/log2.h>
+#include <linux/timekeeping.h>
 
 /* The dentry cache is just so we have properly sized dentries */
 static struct kmem_cache *sdcardfs_dentry_cachep;
@@ -56,6 +58,7 @@ int new_dentry_private_data(struct dentry *dentry)
 		return -ENOMEM;
 
 	spin_lock_init(&info->lock);
+	info->dentry = dentry;
 	dentry->d_fsdata = info;
 
 	return 0;
@@ -220,29 +223,299 @@ int sdcardfs_interpose(struct dentry *dentry, struct super_block *sb,
 	return PTR_ERR(ret_dentry);
 }
 
+/*
+ * Case insensitive name index of a lower directory. It is built by the
+ * first lookup that misses on the exact name and dropped once the mtime
+ * of the lower directory moves, so further lookups of case variants or of
+ * absent names are answered without reading the directory again.
+ *
+ * A directory with more than CI_INDEX_MAX_NAMES entries gets an empty
+ * "large" index instead, so its misses scan for the first match without
+ * collecting names. Indexes of all directories share CI_INDEX_MEM_MAX.
+ */
+#define CI_INDEX_MAX_NAMES	8192
+#define CI_INDEX_MEM_MAX	(8UL << 20)
+/* changes within the same timestamp tick as the build would go unnoticed */
+#define CI_INDEX_RACY_SECS	2
+
+struct sdcardfs_ci_name {
+	struct hlist_node node;
+	unsigned int hash;
+	unsigned int len;
+	char name[];
+};
+
+struct sdcardfs_ci_index {
+	struct timespec mtime;
+	unsigned int bits;
+	bool large;
+	size_t bytes;
+	struct rcu_head rcu;
+	struct hlist_head buckets[];
+};
+
+/* how sdcardfs_ci_scan() reads the lower directory */
+enum ci_scan_mode {
+	CI_SCAN_FIND,	/* stop at the first case match */
+	CI_SCAN_COUNT,	/* count the entries to see if it is still large */
+	CI_SCAN_BUILD,	/* collect all names for an index */
+};
+
+struct sdcardfs_ci_stats sdcardfs_ci_stats;
+
+static inline size_t ci_name_size(unsigned int len)
+{
+	return sizeof(struct sdcardfs_ci_name) + len + 1;
+}
+
+static void ci_names_free(struct hlist_head *names)
+{
+	struct sdcardfs_ci_name *ent;
+	struct hlist_node *tmp;
+
+	hlist_for_each_entry_safe(ent, tmp, names, node)
+		kfree(ent);
+	INIT_HLIST_HEAD(names);
+}
+
+void free_ci_index(struct sdcardfs_ci_index *index)
+{
+	unsigned int i;
+
+	if (!index)
+		return;
+	for (i = 0; i < (1U << index->bits); i++)
+		ci_names_free(&index->buckets[i]);
+	atomic_long_sub(index->bytes, &sdcardfs_ci_stats.mem);
+	kvfree(index);
+}
+
+static void free_ci_index_rcu(struct rcu_head *head)
+{
+	free_ci_index(container_of(head, struct sdcardfs_ci_index, rcu));
+}
+
+/*
+ * Moves @names into a new index of @dir, or installs a large marker if
+ * @large. @names is left to the caller if the memory cap is reached.
+ */
+static void ci_index_install(struct inode *dir, struct hlist_head *names,
+		unsigned int count, size_t bytes, bool large,
+		const struct timespec *mtime)
+{
+	struct sdcardfs_ci_index *index, *old;
+	struct sdcardfs_ci_name *ent;
+	struct hlist_node *tmp;
+	unsigned int bits;
+	size_t size;
+
+	bits = large ? 0 :
+		clamp_t(unsigned int, ilog2(roundup_pow_of_two(count / 2 + 1)), 4, 12);
+	size = sizeof(*index) + (sizeof(struct hlist_head) << bits);
+	bytes += size;
+	if (atomic_long_add_return(bytes, &sdcardfs_ci_stats.mem) >
+			CI_INDEX_MEM_MAX && !large) {
+		atomic_long_sub(bytes, &sdcardfs_ci_stats.mem);
+		atomic_long_inc(&sdcardfs_ci_stats.capped);
+		return;
+	}
+
+	index = kvzalloc(size, GFP_KERNEL);
+	if (!index) {
+		atomic_long_sub(bytes, &sdcardfs_ci_stats.mem);
+		return;
+	}
+
+	index->mtime = *mtime;
+	index->bits = bits;
+	index->large = large;
+	index->bytes = bytes;
+	if (!large) {
+		hlist_for_each_entry_safe(ent, tmp, names, node) {
+			hlist_del(&ent->node);
+			hlist_add_head(&ent->node,
+				       &index->buckets[hash_min(ent->hash, bits)]);
+		}
+		atomic_long_inc(&sdcardfs_ci_stats.builds);
+	}
+
+	old = xchg(&SDCARDFS_I(dir)->ci_index, index);
+	if (old)
+		call_rcu(&old->rcu, free_ci_index_rcu);
+}
+
+/*
+ * Returns 1 and the on-disk name in @real_name if @name exists in another
+ * case, -ENOENT if it does not exist, -EAGAIN and how to read the lower
+ * directory in @mode if @dir has no usable index.
+ */
+static int ci_index_find(struct inode *dir, struct inode *lower_dir,
+		const struct qstr *name, char **real_name,
+		enum ci_scan_mode *mode)
+{
+	struct sdcardfs_ci_index *index;
+	struct sdcardfs_ci_name *ent;
+	unsigned int hash;
+	int ret = -EAGAIN;
+
+	*mode = CI_SCAN_BUILD;
+
+	rcu_read_lock();
+	index = rcu_dereference(SDCARDFS_I(dir)->ci_index);
+	if (!index)
+		goto out;
+	/* unlocked, a torn read only makes us drop it */
+	if (!timespec_equal(&index->mtime, &lower_dir->i_mtime)) {
+		/* a large directory most likely still is, count first */
+		if (index->large)
+			*mode = CI_SCAN_COUNT;
+		if (cmpxchg(&SDCARDFS_I(dir)->ci_index, index, NULL) == index) {
+			atomic_long_inc(&sdcardfs_ci_stats.stale);
+			call_rcu(&index->rcu, free_ci_index_rcu);
+		}
+		goto out;
+	}
+	if (index->large) {
+		*mode = CI_SCAN_FIND;
+		goto out;
+	}
+
+	hash = full_name_case_hash(NULL, name->name, name->len);
+	ret = -ENOENT;
+	hlist_for_each_entry(ent, &index->buckets[hash_min(hash, index->bits)], node) {
+		if (ent->hash == hash && ent->len == name->len &&
+				str_n_case_eq(ent->name, name->name, name->len)) {
+			*real_name = kmemdup(ent->name, ent->len + 1, GFP_ATOMIC);
+			ret = *real_name ? 1 : -ENOMEM;
+			break;
+		}
+	}
+	if (ret != -ENOMEM)
+		atomic_long_inc(&sdcardfs_ci_stats.hits);
+out:
+	rcu_read_unlock();
+	return ret;
+}
+
 struct sdcardfs_name_data {
 	struct dir_context ctx;
 	const struct qstr *to_find;
 	char *name;
 	bool found;
+	enum ci_scan_mode mode;
+	/* more than CI_INDEX_MAX_NAMES entries */
+	bool large;
+	unsigned int count;
+	size_t bytes;
+	struct hlist_head names;
 };
 
+static void ci_names_add(struct sdcardfs_name_data *buf, const char *name,
+		int namelen)
+{
+	struct sdcardfs_ci_name *ent;
+
+	if (buf->count >= CI_INDEX_MAX_NAMES) {
+		atomic_long_inc(&sdcardfs_ci_stats.overflows);
+		buf->large = true;
+		goto give_up;
+	}
+	buf->count++;
+	if (buf->mode == CI_SCAN_COUNT)
+		return;
+
+	ent = kmalloc(ci_name_size(namelen), GFP_KERNEL);
+	if (!ent)
+		goto give_up;
+	ent->hash = full_name_case_hash(NULL, name, namelen);
+	ent->len = namelen;
+	memcpy(ent->name, name, namelen);
+	ent->name[namelen] = '\0';
+	hlist_add_head(&ent->node, &buf->names);
+	buf->bytes += ci_name_size(namelen);
+	return;
+
+give_up:
+	buf->mode = CI_SCAN_FIND;
+	buf->bytes = 0;
+	ci_names_free(&buf->names);
+}
+
 static int sdcardfs_name_match(struct dir_context *ctx, const char *name,
 		int namelen, loff_t offset, u64 ino, unsigned int d_type)
 {
 	struct sdcardfs_name_data *buf = container_of(ctx, struct sdcardfs_name_data, ctx);
 	struct qstr candidate = QSTR_INIT(name, namelen);
 
-	if (qstr_case_eq(buf->to_find, &candidate)) {
+	if (!buf->found && qstr_case_eq(buf->to_find, &candidate)) {
 		buf->found = true;
 		buf->name = kmalloc(namelen + 1, GFP_KERNEL);
 		if (buf->name) {
 			memcpy(buf->name, name, namelen);
 			buf->name[namelen] = '\0';
 		}
-		return 1;
 	}
-	return 0;
+	if (buf->mode != CI_SCAN_FIND)
+		ci_names_add(buf, name, namelen);
+	/* stop once found, unless the whole directory is being read */
+	return buf->found && buf->mode == CI_SCAN_FIND;
+}
+
+/*
+ * Read the lower directory for a case variant of @name, indexing it on
+ * the way as @mode asks. Returns 1 and the on-disk name in @real_name, or
+ * -ERRNO.
+ */
+static int sdcardfs_ci_scan(struct path *lower_parent_path, struct inode *dir,
+		const struct qstr *name, char **real_name,
+		enum ci_scan_mode mode)
+{
+	struct inode *lower_dir = d_inode(lower_parent_path->dentry);
+	struct timespec mtime = lower_dir->i_mtime;
+	struct sdcardfs_name_data buffer = {
+		.ctx.actor = sdcardfs_name_match,
+		.to_find = name,
+		.found = false,
+		.mode = mode,
+		.names = HLIST_HEAD_INIT,
+	};
+	bool racy;
+	struct file *file;
+	int err;
+
+	atomic_long_inc(&sdcardfs_ci_stats.misses);
+	racy = ktime_get_real_seconds() - mtime.tv_sec < CI_INDEX_RACY_SECS;
+	if (racy)
+		buffer.mode = CI_SCAN_FIND;
+	/* no room for another index, only see whether this one is large */
+	if (buffer.mode == CI_SCAN_BUILD &&
+	    atomic_long_read(&sdcardfs_ci_stats.mem) >= CI_INDEX_MEM_MAX) {
+		atomic_long_inc(&sdcardfs_ci_stats.capped);
+		buffer.mode = CI_SCAN_COUNT;
+	}
+
+	file = dentry_open(lower_parent_path, O_RDONLY, current_cred());
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+
+	err = iterate_dir(file, &buffer.ctx);
+	fput(file);
+
+	if (!err && !racy && (buffer.large || buffer.mode == CI_SCAN_BUILD))
+		ci_index_install(dir, &buffer.names, buffer.count,
+				 buffer.bytes, buffer.large, &mtime);
+	ci_names_free(&buffer.names);
+
+	if (err) {
+		kfree(buffer.name);
+		return err;
+	}
+	if (!buffer.found)
+		return -ENOENT;
+	if (!buffer.name)
+		return -ENOMEM;
+	*real_name = buffer.name;
+	return 1;
 }
 
 /*
@@ -281,40 +554,21 @@ static struct dentry *__sdcardfs_lookup(struct dentry *dentry,
 				&lower_path);
 	/* check for other cases */
 	if (err == -ENOENT) {
-		struct file *file;
-		const struct cred *cred = current_cred();
-
-		struct sdcardfs_name_data buffer = {
-			.ctx.actor = sdcardfs_name_match,
-			.to_find = name,
-			.found = false,
-		};
-
-		file = dentry_open(lower_parent_path, O_RDONLY, cred);
-		if (IS_ERR(file)) {
-			err = PTR_ERR(file);
-			goto err;
-		}
-
-		err = iterate_dir(file, &buffer.ctx);
-		fput(file);
-		if (err)
+		struct inode *dir = d_inode(dentry->d_parent);
+		enum ci_scan_mode mode;
+		char *real_name;
+
+		err = ci_index_find(dir, d_inode(lower_dir_dentry), name,
+				    &real_name, &mode);
+		if (err == -EAGAIN)
+			err = sdcardfs_ci_scan(lower_parent_path, dir, name,
+					       &real_name, mode);
+		if (err != 1)
 			goto err;
 
-		if (buffer.found) {
-			if (!buffer.name) {
-				err = -ENOMEM;
-				goto out;
-			}
-
-			err = vfs_path_lookup(lower_dir_dentry,
-						lower_dir_mnt,
-						buffer.name, 0,
-						&lower_path);
-			kfree(buffer.name);
-		} else {
-			err = -ENOENT;
-		}
+		err = vfs_path_lookup(lower_dir_dentry, lower_dir_mnt,
+				      real_name, 0, &lower_path);
+		kfree(real_name);
 	}
 
 	/* no error: handle positive dentries */
@@ -297,6 +297,8 @@ static int sdcardfs_read_super(struct vfsmount *mnt, struct super_block *sb,
 	}
 
 	sb_info = sb->s_fs_info;
+	spin_lock_init(&sb_info->pkg_lock);
+	hash_init(sb_info->pkg_index);
 	/* parse options */
 	err = parse_options(sb, raw_data, silent, &debug, mnt_opt, &sb_info->options);
 	if (err) {
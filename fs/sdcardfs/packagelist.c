@@ -19,7 +19,8 @@
  */
 
 #include "sdcardfs.h"
-#include <linux/hashtable.h>
+#include <linux/rhashtable.h>
+#include <linux/jhash.h>
 #include <linux/ctype.h>
 #include <linux/delay.h>
 #include <linux/radix-tree.h>
@@ -32,20 +33,46 @@
 #include <linux/configfs.h>
 
 struct hashtable_entry {
-	struct hlist_node hlist;
+	struct rhlist_head hlist;
+	struct list_head list;	/* for walking the whole table */
 	struct hlist_node dlist; /* for deletion cleanup */
 	struct qstr key;
+	char *fold;		/* key.name in lower case */
 	atomic_t value;
 };
 
-static DEFINE_HASHTABLE(package_to_appid, 8);
-static DEFINE_HASHTABLE(package_to_userid, 8);
-static DEFINE_HASHTABLE(ext_to_groupid, 8);
+/*
+ * Negative cache: the bit of every key's hash is set, so a clear bit proves
+ * a name is not in the table without probing it. This is the common case
+ * for extensions and for non-package names below Android/. Bits of removed
+ * keys stay set until the filter is rebuilt.
+ */
+#define NAME_FILTER_BITS	12
+#define NAME_FILTER_MASK	((1U << NAME_FILTER_BITS) - 1)
+
+struct name_filter {
+	DECLARE_BITMAP(bits, 1U << NAME_FILTER_BITS);
+	struct rcu_head rcu;
+};
+
+/*
+ * The tables grow and shrink with the number of packages. Readers only take
+ * the RCU read lock, updates are serialized by sdcardfs_super_list_lock.
+ */
+struct name_table {
+	struct rhltable ht;
+	struct list_head entries;
+	struct name_filter __rcu *filter;
+};
+
+static struct name_table package_to_appid;
+static struct name_table package_to_userid;
+static struct name_table ext_to_groupid;
 
 
 static struct kmem_cache *hashtable_entry_cachep;
 
-static unsigned int full_name_case_hash(const void *salt, const unsigned char *name, unsigned int len)
+unsigned int full_name_case_hash(const void *salt, const unsigned char *name, unsigned int len)
 {
 	unsigned long hash = init_name_hash(salt);
 
@@ -68,23 +95,134 @@ static inline int qstr_copy(const struct qstr *src, struct qstr *dest)
 	return !!dest->name;
 }
 
+/* keys are struct qstr hashed with full_name_case_hash() */
+static u32 name_table_hashfn(const void *data, u32 len, u32 seed)
+{
+	const struct qstr *key = data;
+
+	return jhash_1word(key->hash, seed);
+}
 
-static appid_t __get_appid(const struct qstr *key)
+static u32 name_table_obj_hashfn(const void *data, u32 len, u32 seed)
+{
+	const struct hashtable_entry *entry = data;
+
+	return jhash_1word(entry->key.hash, seed);
+}
+
+static int name_table_obj_cmpfn(struct rhashtable_compare_arg *arg,
+				const void *obj)
+{
+	const struct qstr *key = arg->key;
+	const struct hashtable_entry *entry = obj;
+	unsigned int i;
+
+	if (key->hash_len != entry->key.hash_len)
+		return 1;
+	for (i = 0; i < key->len; i++) {
+		if (tolower(key->name[i]) != entry->fold[i])
+			return 1;
+	}
+	return 0;
+}
+
+static const struct rhashtable_params name_table_params = {
+	.head_offset		= offsetof(struct hashtable_entry, hlist),
+	.key_offset		= offsetof(struct hashtable_entry, key),
+	.hashfn			= name_table_hashfn,
+	.obj_hashfn		= name_table_obj_hashfn,
+	.obj_cmpfn		= name_table_obj_cmpfn,
+	.automatic_shrinking	= true,
+};
+
+static int name_table_init(struct name_table *table)
+{
+	struct name_filter *filter;
+	int err;
+
+	filter = kzalloc(sizeof(*filter), GFP_KERNEL);
+	if (!filter)
+		return -ENOMEM;
+	err = rhltable_init(&table->ht, &name_table_params);
+	if (err) {
+		kfree(filter);
+		return err;
+	}
+	INIT_LIST_HEAD(&table->entries);
+	RCU_INIT_POINTER(table->filter, filter);
+	return 0;
+}
+
+/* the table must be empty */
+static void name_table_destroy(struct name_table *table)
+{
+	rhltable_destroy(&table->ht);
+	kfree(rcu_dereference_protected(table->filter, 1));
+}
+
+/* returns the entries matching @key, call under rcu_read_lock() */
+static struct rhlist_head *name_table_lookup(struct name_table *table,
+				const struct qstr *key)
+{
+	struct name_filter *filter = rcu_dereference(table->filter);
+
+	if (!test_bit(key->hash & NAME_FILTER_MASK, filter->bits))
+		return NULL;
+	return rhltable_lookup(&table->ht, key, name_table_params);
+}
+
+static int name_table_insert(struct name_table *table,
+				struct hashtable_entry *entry)
+{
+	struct name_filter *filter = rcu_dereference_protected(table->filter,
+			lockdep_is_held(&sdcardfs_super_list_lock));
+	int err;
+
+	/* the bit must be visible before the entry is */
+	set_bit(entry->key.hash & NAME_FILTER_MASK, filter->bits);
+	err = rhltable_insert(&table->ht, &entry->hlist, name_table_params);
+	if (err)
+		return err;
+	list_add_tail_rcu(&entry->list, &table->entries);
+	return 0;
+}
+
+static void name_table_remove(struct name_table *table,
+				struct hashtable_entry *entry)
+{
+	rhltable_remove(&table->ht, &entry->hlist, name_table_params);
+	list_del_rcu(&entry->list);
+}
+
+/* drop the bits of removed keys from the negative cache */
+static void name_table_rebuild_filter(struct name_table *table)
 {
+	struct name_filter *old = rcu_dereference_protected(table->filter,
+			lockdep_is_held(&sdcardfs_super_list_lock));
+	struct name_filter *filter;
 	struct hashtable_entry *hash_cur;
-	unsigned int hash = key->hash;
-	appid_t ret_id;
+
+	filter = kzalloc(sizeof(*filter), GFP_KERNEL);
+	if (!filter)
+		return; /* a stale filter only costs extra lookups */
+	list_for_each_entry(hash_cur, &table->entries, list)
+		set_bit(hash_cur->key.hash & NAME_FILTER_MASK, filter->bits);
+	rcu_assign_pointer(table->filter, filter);
+	kfree_rcu(old, rcu);
+}
+
+static appid_t __get_appid(const struct qstr *key)
+{
+	struct rhlist_head *list;
+	appid_t ret_id = 0;
 
 	rcu_read_lock();
-	hash_for_each_possible_rcu(package_to_appid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key)) {
-			ret_id = atomic_read(&hash_cur->value);
-			rcu_read_unlock();
-			return ret_id;
-		}
-	}
+	list = name_table_lookup(&package_to_appid, key);
+	if (list)
+		ret_id = atomic_read(&container_of(list, struct hashtable_entry,
+						   hlist)->value);
 	rcu_read_unlock();
-	return 0;
+	return ret_id;
 }
 
 appid_t get_appid(const char *key)
@@ -95,22 +233,23 @@ appid_t get_appid(const char *key)
 	return __get_appid(&q);
 }
 
+appid_t get_appid_qstr(const struct qstr *key)
+{
+	return __get_appid(key);
+}
+
 static appid_t __get_ext_gid(const struct qstr *key)
 {
-	struct hashtable_entry *hash_cur;
-	unsigned int hash = key->hash;
-	appid_t ret_id;
+	struct rhlist_head *list;
+	appid_t ret_id = 0;
 
 	rcu_read_lock();
-	hash_for_each_possible_rcu(ext_to_groupid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key)) {
-			ret_id = atomic_read(&hash_cur->value);
-			rcu_read_unlock();
-			return ret_id;
-		}
-	}
+	list = name_table_lookup(&ext_to_groupid, key);
+	if (list)
+		ret_id = atomic_read(&container_of(list, struct hashtable_entry,
+						   hlist)->value);
 	rcu_read_unlock();
-	return 0;
+	return ret_id;
 }
 
 appid_t get_ext_gid(const char *key)
@@ -124,12 +263,12 @@ appid_t get_ext_gid(const char *key)
 static appid_t __is_excluded(const struct qstr *app_name, userid_t user)
 {
 	struct hashtable_entry *hash_cur;
-	unsigned int hash = app_name->hash;
+	struct rhlist_head *list, *pos;
 
 	rcu_read_lock();
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
-		if (atomic_read(&hash_cur->value) == user &&
-				qstr_case_eq(app_name, &hash_cur->key)) {
+	list = name_table_lookup(&package_to_userid, app_name);
+	rhl_for_each_entry_rcu(hash_cur, pos, list, hlist) {
+		if (atomic_read(&hash_cur->value) == user) {
 			rcu_read_unlock();
 			return 1;
 		}
@@ -145,6 +284,11 @@ appid_t is_excluded(const char *key, userid_t user)
 	return __is_excluded(&q, user);
 }
 
+appid_t is_excluded_qstr(const struct qstr *key, userid_t user)
+{
+	return __is_excluded(key, user);
+}
+
 /* Kernel has already enforced everything we returned through
  * derive_permissions_locked(), so this is used to lock down access
  * even further, such as enforcing that apps hold sdcard_rw.
@@ -179,114 +323,147 @@ static struct hashtable_entry *alloc_hashtable_entry(const struct qstr *key,
 {
 	struct hashtable_entry *ret = kmem_cache_alloc(hashtable_entry_cachep,
 			GFP_KERNEL);
+	unsigned int i;
+
 	if (!ret)
 		return NULL;
 	INIT_HLIST_NODE(&ret->dlist);
-	INIT_HLIST_NODE(&ret->hlist);
 
 	if (!qstr_copy(key, &ret->key)) {
 		kmem_cache_free(hashtable_entry_cachep, ret);
 		return NULL;
 	}
+	ret->fold = kstrdup(key->name, GFP_KERNEL);
+	if (!ret->fold) {
+		kfree(ret->key.name);
+		kmem_cache_free(hashtable_entry_cachep, ret);
+		return NULL;
+	}
+	for (i = 0; i < key->len; i++)
+		ret->fold[i] = tolower(ret->fold[i]);
 
 	atomic_set(&ret->value, value);
 	return ret;
 }
 
-static int insert_packagelist_appid_entry_locked(const struct qstr *key, appid_t value)
+static void free_hashtable_entry(struct hashtable_entry *entry)
+{
+	kfree(entry->fold);
+	kfree(entry->key.name);
+	kmem_cache_free(hashtable_entry_cachep, entry);
+}
+
+static int insert_new_entry_locked(struct name_table *table,
+				const struct qstr *key, appid_t value)
 {
-	struct hashtable_entry *hash_cur;
 	struct hashtable_entry *new_entry;
-	unsigned int hash = key->hash;
+	int err;
 
-	hash_for_each_possible_rcu(package_to_appid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key)) {
-			atomic_set(&hash_cur->value, value);
-			return 0;
-		}
-	}
 	new_entry = alloc_hashtable_entry(key, value);
 	if (!new_entry)
 		return -ENOMEM;
-	hash_add_rcu(package_to_appid, &new_entry->hlist, hash);
-	return 0;
+	err = name_table_insert(table, new_entry);
+	if (err)
+		free_hashtable_entry(new_entry);
+	return err;
+}
+
+static int insert_packagelist_appid_entry_locked(const struct qstr *key, appid_t value)
+{
+	struct rhlist_head *list;
+
+	rcu_read_lock();
+	list = rhltable_lookup(&package_to_appid.ht, key, name_table_params);
+	if (list) {
+		atomic_set(&container_of(list, struct hashtable_entry,
+					 hlist)->value, value);
+		rcu_read_unlock();
+		return 0;
+	}
+	rcu_read_unlock();
+	return insert_new_entry_locked(&package_to_appid, key, value);
 }
 
 static int insert_ext_gid_entry_locked(const struct qstr *key, appid_t value)
 {
-	struct hashtable_entry *hash_cur;
-	struct hashtable_entry *new_entry;
-	unsigned int hash = key->hash;
+	struct rhlist_head *list;
 
 	/* An extension can only belong to one gid */
-	hash_for_each_possible_rcu(ext_to_groupid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key))
-			return -EINVAL;
-	}
-	new_entry = alloc_hashtable_entry(key, value);
-	if (!new_entry)
-		return -ENOMEM;
-	hash_add_rcu(ext_to_groupid, &new_entry->hlist, hash);
-	return 0;
+	rcu_read_lock();
+	list = rhltable_lookup(&ext_to_groupid.ht, key, name_table_params);
+	rcu_read_unlock();
+	if (list)
+		return -EINVAL;
+	return insert_new_entry_locked(&ext_to_groupid, key, value);
 }
 
 static int insert_userid_exclude_entry_locked(const struct qstr *key, userid_t value)
 {
 	struct hashtable_entry *hash_cur;
-	struct hashtable_entry *new_entry;
-	unsigned int hash = key->hash;
+	struct rhlist_head *list, *pos;
 
 	/* Only insert if not already present */
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
-		if (atomic_read(&hash_cur->value) == value &&
-				qstr_case_eq(key, &hash_cur->key))
+	rcu_read_lock();
+	list = rhltable_lookup(&package_to_userid.ht, key, name_table_params);
+	rhl_for_each_entry_rcu(hash_cur, pos, list, hlist) {
+		if (atomic_read(&hash_cur->value) == value) {
+			rcu_read_unlock();
 			return 0;
+		}
 	}
-	new_entry = alloc_hashtable_entry(key, value);
-	if (!new_entry)
-		return -ENOMEM;
-	hash_add_rcu(package_to_userid, &new_entry->hlist, hash);
-	return 0;
+	rcu_read_unlock();
+	return insert_new_entry_locked(&package_to_userid, key, value);
 }
 
-static void fixup_all_perms_name(const struct qstr *key)
+/* package directories visited by fixups, protected by sdcardfs_super_list_lock */
+static struct {
+	unsigned long fixups;
+	unsigned long visited;
+	unsigned int last_visited;
+	unsigned int max_visited;
+} fixup_stats;
+
+static void fixup_all_perms(struct limit_search *limit)
 {
 	struct sdcardfs_sb_info *sbinfo;
-	struct limit_search limit = {
-		.flags = BY_NAME,
-		.name = QSTR_INIT(key->name, key->len),
-	};
+	unsigned int visited = 0;
+
 	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
 		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
+			visited += fixup_perms_indexed(sbinfo->sb, limit);
 	}
+	fixup_stats.fixups++;
+	fixup_stats.visited += visited;
+	fixup_stats.last_visited = visited;
+	fixup_stats.max_visited = max(fixup_stats.max_visited, visited);
+}
+
+static void fixup_all_perms_name(const struct qstr *key)
+{
+	struct limit_search limit = {
+		.flags = BY_NAME,
+		.name = *key,
+	};
+	fixup_all_perms(&limit);
 }
 
 static void fixup_all_perms_name_userid(const struct qstr *key, userid_t userid)
 {
-	struct sdcardfs_sb_info *sbinfo;
 	struct limit_search limit = {
 		.flags = BY_NAME | BY_USERID,
-		.name = QSTR_INIT(key->name, key->len),
+		.name = *key,
 		.userid = userid,
 	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
+	fixup_all_perms(&limit);
 }
 
 static void fixup_all_perms_userid(userid_t userid)
 {
-	struct sdcardfs_sb_info *sbinfo;
 	struct limit_search limit = {
 		.flags = BY_USERID,
 		.userid = userid,
 	};
-	list_for_each_entry(sbinfo, &sdcardfs_super_list, list) {
-		if (sbinfo_has_sdcard_magic(sbinfo))
-			fixup_perms_recursive(sbinfo->sb->s_root, &limit);
-	}
+	fixup_all_perms(&limit);
 }
 
 static int insert_packagelist_entry(const struct qstr *key, appid_t value)
@@ -326,37 +503,57 @@ static int insert_userid_exclude_entry(const struct qstr *key, userid_t value)
 	return err;
 }
 
-static void free_hashtable_entry(struct hashtable_entry *entry)
+/*
+ * Unlink the entries of @key, all of them or only those holding @value, and
+ * queue them on @free_list. They are freed after a grace period.
+ */
+static void name_table_unlink_locked(struct name_table *table,
+		const struct qstr *key, bool any_value, unsigned int value,
+		struct hlist_head *free_list)
 {
-	kfree(entry->key.name);
-	kmem_cache_free(hashtable_entry_cachep, entry);
+	struct hashtable_entry *hash_cur;
+	struct rhlist_head *list, *pos;
+	struct hlist_node *h_t;
+	HLIST_HEAD(found);
+
+	rcu_read_lock();
+	list = rhltable_lookup(&table->ht, key, name_table_params);
+	rhl_for_each_entry_rcu(hash_cur, pos, list, hlist) {
+		if (any_value || atomic_read(&hash_cur->value) == value)
+			hlist_add_head(&hash_cur->dlist, &found);
+	}
+	rcu_read_unlock();
+
+	hlist_for_each_entry_safe(hash_cur, h_t, &found, dlist) {
+		name_table_remove(table, hash_cur);
+		hlist_del(&hash_cur->dlist);
+		hlist_add_head(&hash_cur->dlist, free_list);
+	}
 }
 
-static void remove_packagelist_entry_locked(const struct qstr *key)
+static void free_hashtable_entries(struct hlist_head *free_list)
 {
 	struct hashtable_entry *hash_cur;
-	unsigned int hash = key->hash;
 	struct hlist_node *h_t;
-	HLIST_HEAD(free_list);
 
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key)) {
-			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
-		}
-	}
-	hash_for_each_possible_rcu(package_to_appid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key)) {
-			hash_del_rcu(&hash_cur->hlist);
-			hlist_add_head(&hash_cur->dlist, &free_list);
-			break;
-		}
-	}
+	if (hlist_empty(free_list))
+		return;
 	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist)
+	hlist_for_each_entry_safe(hash_cur, h_t, free_list, dlist)
 		free_hashtable_entry(hash_cur);
 }
 
+static void remove_packagelist_entry_locked(const struct qstr *key)
+{
+	HLIST_HEAD(free_list);
+
+	name_table_unlink_locked(&package_to_userid, key, true, 0, &free_list);
+	name_table_unlink_locked(&package_to_appid, key, true, 0, &free_list);
+	name_table_rebuild_filter(&package_to_userid);
+	name_table_rebuild_filter(&package_to_appid);
+	free_hashtable_entries(&free_list);
+}
+
 static void remove_packagelist_entry(const struct qstr *key)
 {
 	mutex_lock(&sdcardfs_super_list_lock);
@@ -367,17 +564,11 @@ static void remove_packagelist_entry(const struct qstr *key)
 
 static void remove_ext_gid_entry_locked(const struct qstr *key, gid_t group)
 {
-	struct hashtable_entry *hash_cur;
-	unsigned int hash = key->hash;
+	HLIST_HEAD(free_list);
 
-	hash_for_each_possible_rcu(ext_to_groupid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key) && atomic_read(&hash_cur->value) == group) {
-			hash_del_rcu(&hash_cur->hlist);
-			synchronize_rcu();
-			free_hashtable_entry(hash_cur);
-			break;
-		}
-	}
+	name_table_unlink_locked(&ext_to_groupid, key, false, group, &free_list);
+	name_table_rebuild_filter(&ext_to_groupid);
+	free_hashtable_entries(&free_list);
 }
 
 static void remove_ext_gid_entry(const struct qstr *key, gid_t group)
@@ -389,21 +580,17 @@ static void remove_ext_gid_entry(const struct qstr *key, gid_t group)
 
 static void remove_userid_all_entry_locked(userid_t userid)
 {
-	struct hashtable_entry *hash_cur;
-	struct hlist_node *h_t;
+	struct hashtable_entry *hash_cur, *h_t;
 	HLIST_HEAD(free_list);
-	int i;
 
-	hash_for_each_rcu(package_to_userid, i, hash_cur, hlist) {
+	list_for_each_entry_safe(hash_cur, h_t, &package_to_userid.entries, list) {
 		if (atomic_read(&hash_cur->value) == userid) {
-			hash_del_rcu(&hash_cur->hlist);
+			name_table_remove(&package_to_userid, hash_cur);
 			hlist_add_head(&hash_cur->dlist, &free_list);
 		}
 	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist) {
-		free_hashtable_entry(hash_cur);
-	}
+	name_table_rebuild_filter(&package_to_userid);
+	free_hashtable_entries(&free_list);
 }
 
 static void remove_userid_all_entry(userid_t userid)
@@ -416,18 +603,11 @@ static void remove_userid_all_entry(userid_t userid)
 
 static void remove_userid_exclude_entry_locked(const struct qstr *key, userid_t userid)
 {
-	struct hashtable_entry *hash_cur;
-	unsigned int hash = key->hash;
-
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(key, &hash_cur->key) &&
-				atomic_read(&hash_cur->value) == userid) {
-			hash_del_rcu(&hash_cur->hlist);
-			synchronize_rcu();
-			free_hashtable_entry(hash_cur);
-			break;
-		}
-	}
+	HLIST_HEAD(free_list);
+
+	name_table_unlink_locked(&package_to_userid, key, false, userid, &free_list);
+	name_table_rebuild_filter(&package_to_userid);
+	free_hashtable_entries(&free_list);
 }
 
 static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
@@ -438,25 +618,26 @@ static void remove_userid_exclude_entry(const struct qstr *key, userid_t userid)
 	mutex_unlock(&sdcardfs_super_list_lock);
 }
 
+static void name_table_clear_locked(struct name_table *table,
+		struct hlist_head *free_list)
+{
+	struct hashtable_entry *hash_cur, *h_t;
+
+	list_for_each_entry_safe(hash_cur, h_t, &table->entries, list) {
+		name_table_remove(table, hash_cur);
+		hlist_add_head(&hash_cur->dlist, free_list);
+	}
+}
+
 static void packagelist_destroy(void)
 {
-	struct hashtable_entry *hash_cur;
-	struct hlist_node *h_t;
 	HLIST_HEAD(free_list);
-	int i;
 
 	mutex_lock(&sdcardfs_super_list_lock);
-	hash_for_each_rcu(package_to_appid, i, hash_cur, hlist) {
-		hash_del_rcu(&hash_cur->hlist);
-		hlist_add_head(&hash_cur->dlist, &free_list);
-	}
-	hash_for_each_rcu(package_to_userid, i, hash_cur, hlist) {
-		hash_del_rcu(&hash_cur->hlist);
-		hlist_add_head(&hash_cur->dlist, &free_list);
-	}
-	synchronize_rcu();
-	hlist_for_each_entry_safe(hash_cur, h_t, &free_list, dlist)
-		free_hashtable_entry(hash_cur);
+	name_table_clear_locked(&package_to_appid, &free_list);
+	name_table_clear_locked(&package_to_userid, &free_list);
+	name_table_clear_locked(&ext_to_groupid, &free_list);
+	free_hashtable_entries(&free_list);
 	mutex_unlock(&sdcardfs_super_list_lock);
 	pr_info("sdcardfs: destroyed packagelist pkgld\n");
 }
@@ -524,14 +705,14 @@ static ssize_t package_details_excluded_userids_show(struct config_item *item,
 {
 	struct package_details *package_details = to_package_details(item);
 	struct hashtable_entry *hash_cur;
-	unsigned int hash = package_details->name.hash;
+	struct rhlist_head *list, *pos;
 	int count = 0;
 
 	rcu_read_lock();
-	hash_for_each_possible_rcu(package_to_userid, hash_cur, hlist, hash) {
-		if (qstr_case_eq(&package_details->name, &hash_cur->key))
-			count += scnprintf(page + count, PAGE_SIZE - count,
-					"%d ", atomic_read(&hash_cur->value));
+	list = name_table_lookup(&package_to_userid, &package_details->name);
+	rhl_for_each_entry_rcu(hash_cur, pos, list, hlist) {
+		count += scnprintf(page + count, PAGE_SIZE - count,
+				"%d ", atomic_read(&hash_cur->value));
 	}
 	rcu_read_unlock();
 	if (count)
@@ -751,22 +932,19 @@ static ssize_t packages_list_show(struct config_item *item, char *page)
 {
 	struct hashtable_entry *hash_cur_app;
 	struct hashtable_entry *hash_cur_user;
-	int i;
+	struct rhlist_head *users, *pos;
 	int count = 0, written = 0;
 	const char errormsg[] = "<truncated>\n";
-	unsigned int hash;
 
 	rcu_read_lock();
-	hash_for_each_rcu(package_to_appid, i, hash_cur_app, hlist) {
+	list_for_each_entry_rcu(hash_cur_app, &package_to_appid.entries, list) {
 		written = scnprintf(page + count, PAGE_SIZE - sizeof(errormsg) - count, "%s %d\n",
 					hash_cur_app->key.name, atomic_read(&hash_cur_app->value));
-		hash = hash_cur_app->key.hash;
-		hash_for_each_possible_rcu(package_to_userid, hash_cur_user, hlist, hash) {
-			if (qstr_case_eq(&hash_cur_app->key, &hash_cur_user->key)) {
-				written += scnprintf(page + count + written - 1,
-					PAGE_SIZE - sizeof(errormsg) - count - written + 1,
-					" %d\n", atomic_read(&hash_cur_user->value)) - 1;
-			}
+		users = name_table_lookup(&package_to_userid, &hash_cur_app->key);
+		rhl_for_each_entry_rcu(hash_cur_user, pos, users, hlist) {
+			written += scnprintf(page + count + written - 1,
+				PAGE_SIZE - sizeof(errormsg) - count - written + 1,
+				" %d\n", atomic_read(&hash_cur_user->value)) - 1;
 		}
 		if (count + written == PAGE_SIZE - sizeof(errormsg) - 1) {
 			count += scnprintf(page + count, PAGE_SIZE - count, errormsg);
@@ -799,11 +977,43 @@ static struct configfs_attribute packages_attr_packages_gid_list = {
 	.show		= packages_list_show,
 };
 
+static ssize_t packages_fixup_stats_show(struct config_item *item, char *page)
+{
+	ssize_t count;
+
+	mutex_lock(&sdcardfs_super_list_lock);
+	count = scnprintf(page, PAGE_SIZE,
+			"fixups %lu\nvisited %lu\nlast_visited %u\nmax_visited %u\n",
+			fixup_stats.fixups, fixup_stats.visited,
+			fixup_stats.last_visited, fixup_stats.max_visited);
+	mutex_unlock(&sdcardfs_super_list_lock);
+	return count;
+}
+
+static ssize_t packages_ci_index_stats_show(struct config_item *item, char *page)
+{
+	struct sdcardfs_ci_stats *stats = &sdcardfs_ci_stats;
+
+	return scnprintf(page, PAGE_SIZE,
+			"hits %ld\nmisses %ld\nbuilds %ld\nstale %ld\noverflows %ld\ncapped %ld\nmem %ld\n",
+			atomic_long_read(&stats->hits),
+			atomic_long_read(&stats->misses),
+			atomic_long_read(&stats->builds),
+			atomic_long_read(&stats->stale),
+			atomic_long_read(&stats->overflows),
+			atomic_long_read(&stats->capped),
+			atomic_long_read(&stats->mem));
+}
+
 SDCARDFS_CONFIGFS_ATTR_WO(packages_, remove_userid);
+SDCARDFS_CONFIGFS_ATTR_RO(packages_, fixup_stats);
+SDCARDFS_CONFIGFS_ATTR_RO(packages_, ci_index_stats);
 
 static struct configfs_attribute *packages_attrs[] = {
 	&packages_attr_packages_gid_list,
 	&packages_attr_remove_userid,
+	&packages_attr_fixup_stats,
+	&packages_attr_ci_index_stats,
 	NULL,
 };
 
@@ -862,6 +1072,8 @@ static void configfs_sdcardfs_exit(void)
 
 int packagelist_init(void)
 {
+	int err;
+
 	hashtable_entry_cachep =
 		kmem_cache_create("packagelist_hashtable_entry",
 					sizeof(struct hashtable_entry), 0, 0, NULL);
@@ -870,13 +1082,35 @@ int packagelist_init(void)
 		return -ENOMEM;
 	}
 
+	err = name_table_init(&package_to_appid);
+	if (err)
+		goto out_cache;
+	err = name_table_init(&package_to_userid);
+	if (err)
+		goto out_appid;
+	err = name_table_init(&ext_to_groupid);
+	if (err)
+		goto out_userid;
+
 	configfs_sdcardfs_init();
 	return 0;
+
+out_userid:
+	name_table_destroy(&package_to_userid);
+out_appid:
+	name_table_destroy(&package_to_appid);
+out_cache:
+	pr_err("sdcardfs: failed creating packagelist tables\n");
+	kmem_cache_destroy(hashtable_entry_cachep);
+	return err;
 }
 
 void packagelist_exit(void)
 {
 	configfs_sdcardfs_exit();
 	packagelist_destroy();
+	name_table_destroy(&ext_to_groupid);
+	name_table_destroy(&package_to_userid);
+	name_table_destroy(&package_to_appid);
 	kmem_cache_destroy(hashtable_entry_cachep);
 }
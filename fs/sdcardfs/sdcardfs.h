@@ -45,6 +45,7 @@
 #include <linux/security.h>
 #include <linux/string.h>
 #include <linux/list.h>
+#include <linux/hashtable.h>
 #include "multiuser.h"
 
 /* the file system name */
@@ -130,6 +131,7 @@ struct sdcardfs_sb_info;
 struct sdcardfs_mount_options;
 struct sdcardfs_inode_info;
 struct sdcardfs_inode_data;
+struct sdcardfs_ci_index;
 
 /* Do not directly use this function. Use OVERRIDE_CRED() instead. */
 const struct cred *override_fsids(struct sdcardfs_sb_info *sbi,
@@ -160,6 +162,19 @@ extern struct inode *sdcardfs_iget(struct super_block *sb,
 				 struct inode *lower_inode, userid_t id);
 extern int sdcardfs_interpose(struct dentry *dentry, struct super_block *sb,
 			    struct path *lower_path, userid_t id);
+extern void free_ci_index(struct sdcardfs_ci_index *index);
+
+/* lookups of names missing in their exact case */
+struct sdcardfs_ci_stats {
+	atomic_long_t hits;	/* answered by a directory index */
+	atomic_long_t misses;	/* read the lower directory */
+	atomic_long_t builds;	/* indexes built */
+	atomic_long_t stale;	/* indexes dropped on lower mtime change */
+	atomic_long_t overflows;	/* directories found too large to index */
+	atomic_long_t capped;	/* builds skipped at the memory cap */
+	atomic_long_t mem;	/* bytes held by all indexes */
+};
+extern struct sdcardfs_ci_stats sdcardfs_ci_stats;
 
 /* file private data */
 struct sdcardfs_file_info {
@@ -208,6 +223,9 @@ struct sdcardfs_inode_info {
 	spinlock_t top_lock;
 	struct sdcardfs_inode_data *top_data;
 
+	/* case insensitive name index of the lower directory, RCU */
+	struct sdcardfs_ci_index *ci_index;
+
 	struct inode vfs_inode;
 };
 
@@ -217,6 +235,13 @@ struct sdcardfs_dentry_info {
 	spinlock_t lock;	/* protects lower_path */
 	struct path lower_path;
 	struct path orig_path;
+
+	struct dentry *dentry;
+	/* entry in sbi->pkg_index if this is a package directory */
+	struct hlist_node pkg_node;
+	unsigned int pkg_hash;
+	/* derived permissions must be recomputed on the next revalidate */
+	bool perm_stale;
 };
 
 struct sdcardfs_mount_options {
@@ -252,6 +277,8 @@ struct sdcardfs_sb_info {
 	struct path obbpath;
 	void *pkgl_id;
 	struct list_head list;
+	spinlock_t pkg_lock;	/* protects pkg_index */
+	DECLARE_HASHTABLE(pkg_index, 8);
 };
 
 /*
@@ -516,9 +543,13 @@ extern struct mutex sdcardfs_super_list_lock;
 extern struct list_head sdcardfs_super_list;
 
 /* for packagelist.c */
+extern unsigned int full_name_case_hash(const void *salt, const unsigned char *name, unsigned int len);
 extern appid_t get_appid(const char *app_name);
 extern appid_t get_ext_gid(const char *app_name);
 extern appid_t is_excluded(const char *app_name, userid_t userid);
+/* the key must be hashed with full_name_case_hash() */
+extern appid_t get_appid_qstr(const struct qstr *key);
+extern appid_t is_excluded_qstr(const struct qstr *key, userid_t userid);
 extern int check_caller_access_to_name(struct inode *parent_node, const struct qstr *name);
 extern int packagelist_init(void);
 extern void packagelist_exit(void);
@@ -536,7 +567,8 @@ extern void setup_derived_state(struct inode *inode, perm_t perm,
 			userid_t userid, uid_t uid);
 extern void get_derived_permission(struct dentry *parent, struct dentry *dentry);
 extern void get_derived_permission_new(struct dentry *parent, struct dentry *dentry, const struct qstr *name);
-extern void fixup_perms_recursive(struct dentry *dentry, struct limit_search *limit);
+extern unsigned int fixup_perms_indexed(struct super_block *sb, struct limit_search *limit);
+extern void pkg_index_remove(struct dentry *dentry);
 
 extern void update_derived_permission_lock(struct dentry *dentry);
 void fixup_lower_ownership(struct dentry *dentry, const char *name);
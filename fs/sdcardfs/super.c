@@ -228,6 +228,7 @@ static void i_callback(struct rcu_head *head)
 	struct inode *inode = container_of(head, struct inode, i_rcu);
 
 	release_own_data(SDCARDFS_I(inode));
+	free_ci_index(SDCARDFS_I(inode)->ci_index);
 	kmem_cache_free(sdcardfs_inode_cachep, SDCARDFS_I(inode));
 }
 
@@ -5,9 +5,14 @@ static inline void init_task_ux_info(struct task_struct *p)
 {
     p->static_ux = 0;
     atomic64_set(&(p->dynamic_ux), 0);
-    INIT_LIST_HEAD(&p->ux_entry);
+    RB_CLEAR_NODE(&p->ux_node);
+    p->ux_vruntime = 0;
     p->ux_depth = 0;
     p->enqueue_time = 0;
     p->dynamic_ux_start = 0;
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+    p->ux_rwsem_dep = NULL;
+    p->ux_rwsem_reads = 0;
+#endif
 }
 #endif
@@ -3,4 +3,8 @@
 extern bool rwsem_list_add(struct task_struct *tsk, struct list_head *entry, struct list_head *head, struct rw_semaphore *sem);
 extern void rwsem_dynamic_ux_enqueue(struct task_struct *tsk, struct task_struct *waiter_task, struct task_struct *owner, struct rw_semaphore *sem);
 extern void rwsem_dynamic_ux_dequeue(struct rw_semaphore *sem, struct task_struct *tsk);
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+extern void rwsem_ux_reader_add(struct rw_semaphore *sem, struct task_struct *tsk);
+extern void rwsem_ux_reader_del(struct rw_semaphore *sem, struct task_struct *tsk);
+#endif
 #endif
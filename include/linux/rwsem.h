@@ -22,6 +22,10 @@
 
 struct rw_semaphore;
 
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+#define RWSEM_UX_READERS_MAX	4
+#endif
+
 #ifdef CONFIG_RWSEM_GENERIC_SPINLOCK
 #include <linux/rwsem-spinlock.h> /* use a generic implementation */
 #define __RWSEM_INIT_COUNT(name)	.count = RWSEM_UNLOCKED_VALUE
@@ -45,6 +49,10 @@ struct rw_semaphore {
 #ifdef VENDOR_EDIT
 // Liujie.Xie@TECH.Kernel.Sched, 2019/05/22, add for ui first
     struct task_struct *ux_dep_task;
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+    /* best-effort pids of current readers, boosted when a ux task blocks */
+    pid_t ux_readers[RWSEM_UX_READERS_MAX];
+#endif
 #endif
 };
 
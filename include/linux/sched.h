@@ -220,6 +220,12 @@ enum DYNAMIC_UX_TYPE
 
 extern int sysctl_uifirst_enabled;
 extern int sysctl_launcher_boost_enabled;
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+extern int sysctl_uifirst_rwsem_reader_boost;
+struct ctl_table;
+extern int sysctl_uifirst_rwsem_reader_boost_handler(struct ctl_table *table,
+		int write, void __user *buffer, size_t *lenp, loff_t *ppos);
+#endif
 #endif /* VENDOR_EDIT */
 
 /* Task command name length: */
@@ -321,6 +327,12 @@ enum uclamp_id {
 	UCLAMP_CNT
 };
 
+/*
+ * Runqueue latency histogram buckets: bucket 0 counts waits below 1us,
+ * bucket i waits in [2^(i-1), 2^i) us, the last one everything above.
+ */
+#define SCHED_LAT_HIST_BUCKETS		20
+
 struct sched_info {
 #ifdef CONFIG_SCHED_INFO
 	/* Cumulative counters: */
@@ -339,6 +351,10 @@ struct sched_info {
 	/* When were we last queued to run? */
 	unsigned long long		last_queued;
 
+#ifdef CONFIG_SCHEDSTATS
+	/* Wakeup/preemption to run latency, see SCHED_LAT_HIST_BUCKETS: */
+	unsigned int			lat_hist[SCHED_LAT_HIST_BUCKETS];
+#endif
 #endif /* CONFIG_SCHED_INFO */
 };
 
@@ -866,6 +882,11 @@ struct task_struct {
 	u64 last_sleep_ts;
 #endif
 	u64 last_enqueued_ts;
+	/* runtime on max capacity cpus, for fair big task rotation */
+	u64 big_runtime;
+	u64 big_runtime_epoch;
+	u64 big_runtime_sum;
+	unsigned int nr_big_rotations;
 
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group		*sched_task_group;
@@ -1443,10 +1464,15 @@ struct task_struct {
 // Liujie.Xie@TECH.Kernel.Sched, 2019/05/22, add for ui first
     int static_ux;
     atomic64_t dynamic_ux;
-    struct list_head ux_entry;
+    struct rb_node ux_node;
+    u64 ux_vruntime;
     int ux_depth;
     u64 enqueue_time;
     u64 dynamic_ux_start;
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+    struct rw_semaphore *ux_rwsem_dep;
+    int ux_rwsem_reads;
+#endif
 #endif /* VENDOR_EDIT */
 	/*
 	 * New fields for task_struct should be added above here, so that
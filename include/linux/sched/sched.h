@@ -51,6 +51,7 @@ typedef int (*busy_power_func)(int, int, void*, int);
 
 #ifdef CONFIG_SCHED_TUNE
 extern int set_stune_task_threshold(int threshold);
+extern bool schedtune_task_in_group(struct task_struct *p, const char *name);
 #endif
 
 struct hmp_domain {
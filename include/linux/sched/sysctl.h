@@ -44,6 +44,7 @@ extern unsigned int sysctl_sched_isolation_hint_enable;
 #endif
 
 extern unsigned int sysctl_sched_rotation_enable;
+extern unsigned int sysctl_sched_rotation_window_ms;
 
 enum sched_tunable_scaling {
 	SCHED_TUNABLESCALING_NONE,
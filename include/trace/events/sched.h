@@ -1419,6 +1419,38 @@ TRACE_EVENT(walt_migration_update_sum,
 		  __entry->nt_cs, __entry->nt_ps, __entry->pid)
 );
 #endif /* CONFIG_SCHED_WALT */
+
+/*
+ * Tracepoint for the schedutil frequency input, with both the PELT and
+ * the WALT signal so their decisions can be compared.
+ */
+TRACE_EVENT(sugov_util_input,
+
+	TP_PROTO(int cpu, int input, unsigned long pelt_util,
+		unsigned long walt_util, unsigned long util),
+
+	TP_ARGS(cpu, input, pelt_util, walt_util, util),
+
+	TP_STRUCT__entry(
+		__field(int,		cpu)
+		__field(int,		input)
+		__field(unsigned long,	pelt_util)
+		__field(unsigned long,	walt_util)
+		__field(unsigned long,	util)
+	),
+
+	TP_fast_assign(
+		__entry->cpu		= cpu;
+		__entry->input		= input;
+		__entry->pelt_util	= pelt_util;
+		__entry->walt_util	= walt_util;
+		__entry->util		= util;
+	),
+
+	TP_printk("cpu=%d input=%d pelt_util=%lu walt_util=%lu util=%lu",
+		  __entry->cpu, __entry->input, __entry->pelt_util,
+		  __entry->walt_util, __entry->util)
+);
 #endif /* CONFIG_SMP */
 
 #ifdef CONFIG_UCLAMP_TASK
@@ -1764,6 +1796,71 @@ TRACE_EVENT(sched_isolate,
 		  __entry->time, __entry->isolate)
 );
 
+#ifdef VENDOR_EDIT
+struct rw_semaphore;
+
+/*
+ * Tracepoint for ux tasks blocked on an rwsem, for comparing
+ * uifirst_rwsem_reader_boost on and off:
+ */
+TRACE_EVENT(sched_ux_rwsem_blocked,
+
+	TP_PROTO(struct rw_semaphore *sem, bool read, u64 delta),
+
+	TP_ARGS(sem, read, delta),
+
+	TP_STRUCT__entry(
+		__array(char,		comm,	TASK_COMM_LEN)
+		__field(pid_t,		pid)
+		__field(void *,		sem)
+		__field(bool,		read)
+		__field(u64,		delta)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, current->comm, TASK_COMM_LEN);
+		__entry->pid	= current->pid;
+		__entry->sem	= sem;
+		__entry->read	= read;
+		__entry->delta	= delta;
+	),
+
+	TP_printk("comm=%s pid=%d sem=%p read=%d blocked=%llu ns",
+		  __entry->comm, __entry->pid, __entry->sem,
+		  __entry->read, __entry->delta)
+);
+
+/*
+ * Tracepoint for a ux task boosting the recorded readers of an rwsem:
+ */
+TRACE_EVENT(sched_ux_rwsem_boost,
+
+	TP_PROTO(struct task_struct *tsk, struct rw_semaphore *sem, int nr_boosted),
+
+	TP_ARGS(tsk, sem, nr_boosted),
+
+	TP_STRUCT__entry(
+		__array(char,		comm,	TASK_COMM_LEN)
+		__field(pid_t,		pid)
+		__field(int,		ux_depth)
+		__field(void *,		sem)
+		__field(int,		nr_boosted)
+	),
+
+	TP_fast_assign(
+		memcpy(__entry->comm, tsk->comm, TASK_COMM_LEN);
+		__entry->pid		= tsk->pid;
+		__entry->ux_depth	= tsk->ux_depth;
+		__entry->sem		= sem;
+		__entry->nr_boosted	= nr_boosted;
+	),
+
+	TP_printk("comm=%s pid=%d ux_depth=%d sem=%p nr_boosted=%d",
+		  __entry->comm, __entry->pid, __entry->ux_depth,
+		  __entry->sem, __entry->nr_boosted)
+);
+#endif /* VENDOR_EDIT */
+
 
 #include "sched_enhance.h"
 
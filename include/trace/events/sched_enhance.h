@@ -759,3 +759,38 @@ TRACE_EVENT(sched_big_task_rotation,
 		__entry->src_cpu, __entry->dst_cpu,
 		__entry->src_pid, __entry->dst_pid)
 );
+
+/*
+ * Tracepoint for fair big task rotation
+ */
+TRACE_EVENT(sched_big_task_fair_rotation,
+
+	TP_PROTO(int src_cpu, int dst_cpu, struct task_struct *src,
+		struct task_struct *dst, u64 src_big_runtime,
+		u64 dst_big_runtime),
+
+	TP_ARGS(src_cpu, dst_cpu, src, dst, src_big_runtime, dst_big_runtime),
+
+	TP_STRUCT__entry(
+		__field(int, src_cpu)
+		__field(int, dst_cpu)
+		__field(int, src_pid)
+		__field(int, dst_pid)
+		__field(u64, src_big_runtime)
+		__field(u64, dst_big_runtime)
+	),
+
+	TP_fast_assign(
+		__entry->src_cpu	= src_cpu;
+		__entry->dst_cpu	= dst_cpu;
+		__entry->src_pid	= src->pid;
+		__entry->dst_pid	= dst->pid;
+		__entry->src_big_runtime	= src_big_runtime;
+		__entry->dst_big_runtime	= dst_big_runtime;
+	),
+
+	TP_printk("src_cpu=%d dst_cpu=%d src_pid=%d dst_pid=%d src_big_runtime=%llu dst_big_runtime=%llu",
+		__entry->src_cpu, __entry->dst_cpu,
+		__entry->src_pid, __entry->dst_pid,
+		__entry->src_big_runtime, __entry->dst_big_runtime)
+);
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0 WITH Linux-syscall-note */
+/*
+ * sdcardfs delete log, binary interface
+ *
+ * /proc/dellog_bin hands out the delete log as a stream of records.
+ * Every open file has its own cursor, starting at the oldest record
+ * still in the log, and reading does not consume records for other
+ * readers or for /proc/dellog.
+ *
+ * read() returns whole records only. It returns 0 once the cursor has
+ * caught up with the log and fails with EINVAL when the buffer cannot
+ * hold the next record; a buffer of 2048 bytes always can.
+ *
+ * Each record is a struct dellog_bin_rec followed by text_len bytes of
+ * text, e.g. "[10123] del IMG_0001.jpg\n", which is not NUL terminated.
+ * len is the size of the whole record including zero padding up to a
+ * multiple of 8, so the next record starts len bytes further on.
+ *
+ * seq counts records from boot. A gap in seq between two records means
+ * the records in between were overwritten before this file read them.
+ */
+#ifndef _UAPI_LINUX_SDCARDFS_DELLOG_H
+#define _UAPI_LINUX_SDCARDFS_DELLOG_H
+
+#include <linux/types.h>
+
+#define DELLOG_BIN_REC_ALIGN	8
+
+struct dellog_bin_rec {
+	__u64 seq;
+	__u64 ts_nsec;		/* CLOCK_MONOTONIC */
+	__s64 tv_sec;		/* wall clock */
+	__u32 tv_usec;
+	__u16 len;		/* header, text and padding */
+	__u16 text_len;
+	__u32 cpu;		/* cpu the delete was logged on */
+	__u32 reserved;
+	char comm[16];		/* task that deleted */
+	char tgid_comm[16];	/* its thread group leader */
+};
+
+#endif /* _UAPI_LINUX_SDCARDFS_DELLOG_H */
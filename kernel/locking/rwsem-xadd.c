@@ -18,6 +18,11 @@
 #include <linux/sched/wake_q.h>
 #include <linux/sched/debug.h>
 #include <linux/osq_lock.h>
+#ifdef VENDOR_EDIT
+#include <linux/sched/clock.h>
+#include <linux/oppocfs/oppo_cfs_common.h>
+#include <trace/events/sched.h>
+#endif
 
 #include "rwsem.h"
 
@@ -93,6 +98,9 @@ void __init_rwsem(struct rw_semaphore *sem, const char *name,
 #ifdef VENDOR_EDIT
 // Liujie.Xie@TECH.Kernel.Sched, 2019/05/22, add for ui first
     sem->ux_dep_task = NULL;
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+    memset(sem->ux_readers, 0, sizeof(sem->ux_readers));
+#endif
 #endif
 }
 
@@ -255,6 +263,12 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	long count, adjustment = -RWSEM_ACTIVE_READ_BIAS;
 	struct rwsem_waiter waiter;
 	DEFINE_WAKE_Q(wake_q);
+#ifdef VENDOR_EDIT
+	u64 ux_wait_start = 0;
+
+	if (sysctl_uifirst_enabled && test_task_ux(current))
+		ux_wait_start = local_clock();
+#endif
 
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_READ;
@@ -304,6 +318,10 @@ __rwsem_down_read_failed_common(struct rw_semaphore *sem, int state)
 	}
 
 	__set_current_state(TASK_RUNNING);
+#ifdef VENDOR_EDIT
+	if (ux_wait_start)
+		trace_sched_ux_rwsem_blocked(sem, true, local_clock() - ux_wait_start);
+#endif
 	return sem;
 out_nolock:
 	list_del(&waiter.list);
@@ -532,6 +550,9 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	struct rwsem_waiter waiter;
 	struct rw_semaphore *ret = sem;
 	DEFINE_WAKE_Q(wake_q);
+#ifdef VENDOR_EDIT
+	u64 ux_wait_start = 0;
+#endif
 
 	/* undo write bias from down_write operation, stop active locking */
 	count = atomic_long_sub_return(RWSEM_ACTIVE_WRITE_BIAS, &sem->count);
@@ -546,6 +567,10 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	 */
 	waiter.task = current;
 	waiter.type = RWSEM_WAITING_FOR_WRITE;
+#ifdef VENDOR_EDIT
+	if (sysctl_uifirst_enabled && test_task_ux(current))
+		ux_wait_start = local_clock();
+#endif
 
 	raw_spin_lock_irq(&sem->wait_lock);
 
@@ -615,6 +640,10 @@ __rwsem_down_write_failed_common(struct rw_semaphore *sem, int state)
 	__set_current_state(TASK_RUNNING);
 	list_del(&waiter.list);
 	raw_spin_unlock_irq(&sem->wait_lock);
+#ifdef VENDOR_EDIT
+	if (ux_wait_start)
+		trace_sched_ux_rwsem_blocked(sem, false, local_clock() - ux_wait_start);
+#endif
 
 	return ret;
 
@@ -15,6 +15,29 @@
 
 #include "rwsem.h"
 
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+#include <linux/jump_label.h>
+
+DECLARE_STATIC_KEY_TRUE(rwsem_ux_reader_key);
+
+// Only owner-released acquisitions are tracked, up_read() always drops the record
+static inline void rwsem_ux_reader_track(struct rw_semaphore *sem)
+{
+	if (static_branch_likely(&rwsem_ux_reader_key) && sysctl_uifirst_enabled)
+		rwsem_ux_reader_add(sem, current);
+}
+
+// Tasks that never got a slot skip the scan, whatever the sysctl says now
+static inline void rwsem_ux_reader_untrack(struct rw_semaphore *sem)
+{
+	if (unlikely(current->ux_rwsem_reads || current->ux_rwsem_dep))
+		rwsem_ux_reader_del(sem, current);
+}
+#else
+static inline void rwsem_ux_reader_track(struct rw_semaphore *sem) {}
+static inline void rwsem_ux_reader_untrack(struct rw_semaphore *sem) {}
+#endif
+
 /*
  * lock for reading
  */
@@ -25,6 +48,9 @@ void __sched down_read(struct rw_semaphore *sem)
 
 	LOCK_CONTENDED(sem, __down_read_trylock, __down_read);
 	rwsem_set_reader_owned(sem);
+#ifdef VENDOR_EDIT
+	rwsem_ux_reader_track(sem);
+#endif
 }
 
 EXPORT_SYMBOL(down_read);
@@ -39,6 +65,9 @@ int down_read_trylock(struct rw_semaphore *sem)
 	if (ret == 1) {
 		rwsem_acquire_read(&sem->dep_map, 0, 1, _RET_IP_);
 		rwsem_set_reader_owned(sem);
+#ifdef VENDOR_EDIT
+		rwsem_ux_reader_track(sem);
+#endif
 	}
 	return ret;
 }
@@ -101,6 +130,9 @@ EXPORT_SYMBOL(down_write_trylock);
 void up_read(struct rw_semaphore *sem)
 {
 	rwsem_release(&sem->dep_map, 1, _RET_IP_);
+#ifdef VENDOR_EDIT
+	rwsem_ux_reader_untrack(sem);
+#endif
 
 	__up_read(sem);
 }
@@ -128,6 +160,9 @@ void downgrade_write(struct rw_semaphore *sem)
 	lock_downgrade(&sem->dep_map, _RET_IP_);
 
 	rwsem_set_reader_owned(sem);
+#ifdef VENDOR_EDIT
+	rwsem_ux_reader_track(sem);
+#endif
 	__downgrade_write(sem);
 }
 
@@ -142,6 +177,9 @@ void down_read_nested(struct rw_semaphore *sem, int subclass)
 
 	LOCK_CONTENDED(sem, __down_read_trylock, __down_read);
 	rwsem_set_reader_owned(sem);
+#ifdef VENDOR_EDIT
+	rwsem_ux_reader_track(sem);
+#endif
 }
 
 EXPORT_SYMBOL(down_read_nested);
@@ -3,6 +3,7 @@
 #include <linux/version.h>
 #include <linux/sched.h>
 #include <linux/list.h>
+#include <linux/rbtree.h>
 #include <linux/jiffies.h>
 #include <trace/events/sched.h>
 #include <../sched/sched.h>
@@ -19,89 +20,104 @@ int ux_min_migration_delay = 10;        /*ux min migration delay time(ms)*/
 int ux_max_over_thresh = 2000; /* ms */
 #define S2NS_T 1000000
 
-static int entity_before(struct sched_entity *a,
+static int entity_over(struct sched_entity *a,
 				struct sched_entity *b)
 {
-	return (s64)(a->vruntime - b->vruntime) < 0;
+	return (s64)(a->vruntime - b->vruntime) > (s64)ux_max_over_thresh * S2NS_T;
 }
 
-static int entity_over(struct sched_entity *a,
-				struct sched_entity *b)
+static inline bool ux_task_queued(struct task_struct *p)
 {
-	return (s64)(a->vruntime - b->vruntime) > (s64)ux_max_over_thresh * S2NS_T;
+	return !RB_EMPTY_NODE(&p->ux_node);
 }
 
-void enqueue_ux_thread(struct rq *rq, struct task_struct *p)
+/*
+ * ux tasks are kept in a per-rq rbtree ordered by the vruntime sampled at
+ * insert time. Only a task that ran since then can carry a stale key, and
+ * its vruntime only grows, so pick_first_ux_thread() re-sorts lazily.
+ */
+static void __enqueue_ux_node(struct rq *rq, struct task_struct *p)
+{
+	struct rb_node **link = &rq->ux_thread_root.rb_root.rb_node;
+	struct rb_node *parent = NULL;
+	struct task_struct *entry;
+	bool leftmost = true;
+
+	p->ux_vruntime = p->se.vruntime;
+	while (*link) {
+		parent = *link;
+		entry = rb_entry(parent, struct task_struct, ux_node);
+		if ((s64)(p->ux_vruntime - entry->ux_vruntime) < 0) {
+			link = &parent->rb_left;
+		} else {
+			link = &parent->rb_right;
+			leftmost = false;
+		}
+	}
+
+	rb_link_node(&p->ux_node, parent, link);
+	rb_insert_color_cached(&p->ux_node, &rq->ux_thread_root, leftmost);
+}
+
+static void __dequeue_ux_node(struct rq *rq, struct task_struct *p)
 {
-	struct list_head *pos, *n;
-	bool exist = false;
+	rb_erase_cached(&p->ux_node, &rq->ux_thread_root);
+	RB_CLEAR_NODE(&p->ux_node);
+}
 
-	if (!rq || !p || !list_empty(&p->ux_entry)) {
+void enqueue_ux_thread(struct rq *rq, struct task_struct *p)
+{
+	if (!rq || !p || ux_task_queued(p)) {
 		return;
 	}
 	p->enqueue_time = rq->clock;
 	if (p->static_ux || atomic64_read(&p->dynamic_ux)) {
-		list_for_each_safe(pos, n, &rq->ux_thread_list) {
-			if (pos == &p->ux_entry) {
-				exist = true;
-				break;
-			}
-		}
-		if (!exist) {
-			list_add_tail(&p->ux_entry, &rq->ux_thread_list);
-			get_task_struct(p);
-		}
+		__enqueue_ux_node(rq, p);
+		get_task_struct(p);
 	}
 }
 
 void dequeue_ux_thread(struct rq *rq, struct task_struct *p)
 {
-	struct list_head *pos, *n;
 	u64 now =  jiffies_to_nsecs(jiffies);
 
 	if (!rq || !p) {
 		return;
 	}
 	p->enqueue_time = 0;
-	if (!list_empty(&p->ux_entry)) {
-		list_for_each_safe(pos, n, &rq->ux_thread_list) {
-			if (atomic64_read(&p->dynamic_ux) && (now - p->dynamic_ux_start) > (u64)ux_max_dynamic_granularity * S2NS_T) {
-				atomic64_set(&p->dynamic_ux, 0);
-			}
-		}
-		list_for_each_safe(pos, n, &rq->ux_thread_list) {
-			if (pos == &p->ux_entry) {
-				list_del_init(&p->ux_entry);
-				put_task_struct(p);
-				return;
-			}
+	if (ux_task_queued(p)) {
+		if (atomic64_read(&p->dynamic_ux) && (now - p->dynamic_ux_start) > (u64)ux_max_dynamic_granularity * S2NS_T) {
+			atomic64_set(&p->dynamic_ux, 0);
 		}
+		__dequeue_ux_node(rq, p);
+		put_task_struct(p);
 	}
 }
 
 static struct task_struct *pick_first_ux_thread(struct rq *rq)
 {
-	struct list_head *ux_thread_list = &rq->ux_thread_list;
-	struct list_head *pos = NULL;
-	struct list_head *n = NULL;
-	struct task_struct *temp = NULL;
-	struct task_struct *leftmost_task = NULL;
-	list_for_each_safe(pos, n, ux_thread_list) {
-		temp = list_entry(pos, struct task_struct, ux_entry);
+	struct rb_node *left;
+	struct task_struct *temp;
+
+	while ((left = rb_first_cached(&rq->ux_thread_root))) {
+		temp = rb_entry(left, struct task_struct, ux_node);
 		/*ensure ux task in current rq cpu otherwise delete it*/
 		if (unlikely(task_cpu(temp) != rq->cpu)) {
 			printk(KERN_WARNING "task(%s,%d,%d) does not belong to cpu%d", temp->comm, task_cpu(temp), temp->policy, rq->cpu);
-			list_del_init(&temp->ux_entry);
+			__dequeue_ux_node(rq, temp);
+			put_task_struct(temp);
 			continue;
 		}
-		if (leftmost_task == NULL) {
-			leftmost_task = temp;
-		} else if (entity_before(&temp->se, &leftmost_task->se)) {
-			leftmost_task = temp;
+		if (likely(temp->ux_vruntime == temp->se.vruntime)) {
+			return temp;
 		}
+		/* key went stale while it ran, re-sort; vruntime only grows so this terminates */
+		rb_erase_cached(&temp->ux_node, &rq->ux_thread_root);
+		__enqueue_ux_node(rq, temp);
+		schedstat_inc(rq->ux_resort_count);
 	}
 
-	return leftmost_task;
+	return NULL;
 }
 
 void pick_ux_thread(struct rq *rq, struct task_struct **p, struct sched_entity **se)
@@ -114,7 +130,7 @@ void pick_ux_thread(struct rq *rq, struct task_struct **p, struct sched_entity *
 	}
 	ori_p = *p;
 	if (ori_p && !ori_p->static_ux && !atomic64_read(&ori_p->dynamic_ux)) {
-		if (!list_empty(&rq->ux_thread_list)) {
+		if (!RB_EMPTY_ROOT(&rq->ux_thread_root.rb_root)) {
 			key_task = pick_first_ux_thread(rq);
             /* in case that ux thread keep running too long */
             if (key_task && entity_over(&key_task->se, &ori_p->se))
@@ -126,6 +142,7 @@ void pick_ux_thread(struct rq *rq, struct task_struct **p, struct sched_entity *
 				rq->clock - key_task->enqueue_time >= ((u64)ux_min_sched_delay_granularity * S2NS_T)) {
 					*p = key_task;
 					*se = key_se;
+					schedstat_inc(rq->ux_pick_count);
 				}
 			}
 		}
@@ -151,17 +168,6 @@ bool test_dynamic_ux(struct task_struct *task, int type)
 	return dynamic_ux_get_bits(dynamic_ux, type) > 0;
 }
 
-static bool test_task_exist(struct task_struct *task, struct list_head *head)
-{
-	struct list_head *pos, *n;
-	list_for_each_safe(pos, n, head) {
-		if (pos == &task->ux_entry) {
-			return true;
-		}
-	}
-	return false;
-}
-
 static inline void dynamic_ux_dec(struct task_struct *task, int type)
 {
 	atomic64_sub(dynamic_ux_one(type), &task->dynamic_ux);
@@ -179,7 +185,6 @@ static void __dynamic_ux_dequeue(struct task_struct *task, int type)
 #else
         struct rq_flags flags;
 #endif
-	bool exist = false;
 	struct rq *rq = NULL;
 	u64 dynamic_ux = 0;
 
@@ -197,9 +202,8 @@ static void __dynamic_ux_dequeue(struct task_struct *task, int type)
 	}
 	task->ux_depth = 0;
 
-	exist = test_task_exist(task, &rq->ux_thread_list);
-	if (exist) {
-		list_del_init(&task->ux_entry);
+	if (ux_task_queued(task)) {
+		__dequeue_ux_node(rq, task);
 		put_task_struct(task);
 	}
 	task_rq_unlock(rq, task, &flags);
@@ -221,7 +225,6 @@ static void __dynamic_ux_enqueue(struct task_struct *task, int type, int depth)
 #else
         struct rq_flags flags;
 #endif
-	bool exist = false;
 	struct rq *rq = NULL;
 
 	rq = task_rq_lock(task, &flags);
@@ -229,8 +232,8 @@ static void __dynamic_ux_enqueue(struct task_struct *task, int type, int depth)
 		task_rq_unlock(rq, task, &flags);
 		return;
 	}
-	if (unlikely(!list_empty(&task->ux_entry))) {
-		printk(KERN_WARNING "task(%s,%d,%d) is already in another list", task->comm, task->pid, task->policy);
+	if (unlikely(ux_task_queued(task))) {
+		printk(KERN_WARNING "task(%s,%d,%d) is already in ux tree", task->comm, task->pid, task->policy);
 		task_rq_unlock(rq, task, &flags);
 		return;
 	}
@@ -239,11 +242,8 @@ static void __dynamic_ux_enqueue(struct task_struct *task, int type, int depth)
 	task->dynamic_ux_start = jiffies_to_nsecs(jiffies);
 	task->ux_depth = task->ux_depth > depth + 1 ? task->ux_depth : depth + 1;
 	if (task->state == TASK_RUNNING) {
-		exist = test_task_exist(task, &rq->ux_thread_list);
-		if (!exist) {
-			get_task_struct(task);
-			list_add_tail(&task->ux_entry, &rq->ux_thread_list);
-		}
+		get_task_struct(task);
+		__enqueue_ux_node(rq, task);
 	}
 	task_rq_unlock(rq, task, &flags);
 }
@@ -273,15 +273,13 @@ inline bool test_set_dynamic_ux(struct task_struct *tsk)
 
 static struct task_struct *check_ux_delayed(struct rq *rq)
 {
-	struct list_head *pos = NULL;
-	struct list_head *n = NULL;
+	struct rb_node *node;
 	struct task_struct *tsk = NULL;
-	struct list_head *ux_thread_list = NULL;
-	ux_thread_list = &rq->ux_thread_list;
 
-	list_for_each_safe(pos, n, ux_thread_list) {
-		tsk = list_entry(pos, struct task_struct, ux_entry);
-		if (tsk && (rq->clock - tsk->enqueue_time) >= (u64)ux_min_migration_delay * S2NS_T)
+	for (node = rb_first_cached(&rq->ux_thread_root); node; node = rb_next(node)) {
+		tsk = rb_entry(node, struct task_struct, ux_node);
+		schedstat_inc(rq->ux_balance_scan);
+		if ((rq->clock - tsk->enqueue_time) >= (u64)ux_min_migration_delay * S2NS_T)
 			return tsk;
 	}
 	return NULL;
@@ -340,7 +338,7 @@ static int ux_can_migrate(struct task_struct *p, struct rq *src_rq, struct rq *d
 		return 0;
 	if (task_rq(p) != src_rq) /*lint !e58*/
 		return 0;
-	if (!test_task_exist(p, &src_rq->ux_thread_list))
+	if (!ux_task_queued(p))
 		return 0;
 	return 1;
 }
@@ -349,7 +347,9 @@ static int __do_ux_balance(void *data)
 {
 	struct rq *src_rq = data;
 	struct rq *dst_rq = NULL;
+	struct rq *rq = NULL;
 	int src_cpu = cpu_of(src_rq);
+	unsigned long util, best_util = ULONG_MAX;
 	int i = 0;
 	struct task_struct *p = NULL;
 	bool is_mig = false;
@@ -369,24 +369,31 @@ static int __do_ux_balance(void *data)
 	}
 
 	raw_spin_unlock(&src_rq->lock);
+	/*
+	 * pick the least utilized cpu in the cluster that runs neither rt
+	 * nor ux tasks, so that ux tasks do not bounce between busy cpus
+	 */
 	for_each_cpu_and(i, &(p->cpus_allowed), cpu_coregroup_mask(src_cpu)) {
 		if (i == src_cpu || !cpu_online(i))
 			continue;
-		dst_rq = cpu_rq(i);
-		raw_spin_lock(&dst_rq->lock);
-		if (!dst_rq->rt.rt_nr_running || list_empty(&dst_rq->ux_thread_list)) {
-			raw_spin_unlock(&dst_rq->lock);
-			break;
-		} else {
-			raw_spin_unlock(&dst_rq->lock);
+		rq = cpu_rq(i);
+		raw_spin_lock(&rq->lock);
+		if (!rq->rt.rt_nr_running && RB_EMPTY_ROOT(&rq->ux_thread_root.rb_root)) {
+			util = rq->cfs.avg.util_avg;
+			if (util < best_util) {
+				best_util = util;
+				dst_rq = rq;
+			}
 		}
+		raw_spin_unlock(&rq->lock);
 	}
 
 	/*move p from src to dst cpu*/
 	raw_spin_lock(&src_rq->lock);
-	if (i != nr_cpu_ids && p != NULL && dst_rq != NULL) {
+	if (p != NULL && dst_rq != NULL) {
 		if (ux_can_migrate(p, src_rq, dst_rq)) {
 			detach_task(p, src_rq, dst_rq);
+			schedstat_inc(src_rq->ux_forced_migration);
 			is_mig = true;
 		}
 	}
@@ -429,6 +436,6 @@ void ux_init_rq_data(struct rq *rq)
 		return;
 	}
 	rq->active_ux_balance = 0;
-	INIT_LIST_HEAD(&rq->ux_thread_list);
+	rq->ux_thread_root = RB_ROOT_CACHED;
 }
 #endif /* VENDOR_EDIT */
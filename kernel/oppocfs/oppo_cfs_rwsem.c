@@ -4,7 +4,13 @@
 #include <linux/sched.h>
 #include <linux/list.h>
 #include <linux/rwsem.h>
+#include <linux/rcupdate.h>
+#include <linux/pid_namespace.h>
+#include <linux/jump_label.h>
+#include <linux/mutex.h>
+#include <linux/sysctl.h>
 #include <linux/oppocfs/oppo_cfs_common.h>
+#include <trace/events/sched.h>
 
 enum rwsem_waiter_type {
 	RWSEM_WAITING_FOR_WRITE,
@@ -58,6 +64,122 @@ bool rwsem_list_add(struct task_struct *tsk, struct list_head *entry, struct lis
     return false;
 }
 
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+/*
+ * Readers are not owners of an rwsem, so remember the pids of up to
+ * RWSEM_UX_READERS_MAX of them in the sem itself. A slot is cleared in
+ * up_read() before the lock is dropped, but an up_read() by another task
+ * leaves it behind; the booster only resolves pids under RCU and clears
+ * slots of tasks that are gone or hold no recorded read any more.
+ * tsk->ux_rwsem_reads counts the slots a task holds, so that up_read() of
+ * everybody else never looks at them.
+ */
+DEFINE_STATIC_KEY_TRUE(rwsem_ux_reader_key);
+
+int sysctl_uifirst_rwsem_reader_boost_handler(struct ctl_table *table,
+		int write, void __user *buffer, size_t *lenp, loff_t *ppos)
+{
+	static DEFINE_MUTEX(mutex);
+	int ret;
+
+	mutex_lock(&mutex);
+	ret = proc_dointvec_minmax(table, write, buffer, lenp, ppos);
+	if (!ret && write) {
+		if (sysctl_uifirst_rwsem_reader_boost)
+			static_branch_enable(&rwsem_ux_reader_key);
+		else
+			static_branch_disable(&rwsem_ux_reader_key);
+	}
+	mutex_unlock(&mutex);
+
+	return ret;
+}
+
+/* a booster owns tsk->ux_rwsem_dep but has not enqueued the task yet */
+static inline struct rw_semaphore *rwsem_ux_dep_pending(struct rw_semaphore *sem)
+{
+	return (struct rw_semaphore *)((unsigned long)sem | 1UL);
+}
+
+static void rwsem_ux_unboost(struct task_struct *tsk, struct rw_semaphore *sem)
+{
+	if (cmpxchg(&tsk->ux_rwsem_dep, sem, NULL) == sem &&
+	    test_dynamic_ux(tsk, DYNAMIC_UX_RWSEM))
+		dynamic_ux_dequeue(tsk, DYNAMIC_UX_RWSEM);
+}
+
+void rwsem_ux_reader_add(struct rw_semaphore *sem, struct task_struct *tsk)
+{
+	int i;
+
+	for (i = 0; i < RWSEM_UX_READERS_MAX; i++) {
+		if (!READ_ONCE(sem->ux_readers[i]) &&
+		    !cmpxchg_relaxed(&sem->ux_readers[i], 0, tsk->pid)) {
+			tsk->ux_rwsem_reads++;
+			return;
+		}
+	}
+}
+
+void rwsem_ux_reader_del(struct rw_semaphore *sem, struct task_struct *tsk)
+{
+	int i;
+
+	/* full barrier: the slot is gone before we look at ux_rwsem_dep */
+	for (i = 0; tsk->ux_rwsem_reads && i < RWSEM_UX_READERS_MAX; i++) {
+		if (READ_ONCE(sem->ux_readers[i]) == tsk->pid &&
+		    cmpxchg(&sem->ux_readers[i], tsk->pid, 0) == tsk->pid) {
+			tsk->ux_rwsem_reads--;
+			break;
+		}
+	}
+	if (unlikely(READ_ONCE(tsk->ux_rwsem_dep) == sem))
+		rwsem_ux_unboost(tsk, sem);
+}
+
+/*
+ * Boost the recorded readers of @sem on behalf of ux task @tsk, depth is
+ * bounded by UX_DEPTH_MAX. A reader may drop the lock while we boost it:
+ * the dep is published only after the enqueue and the slot is checked
+ * again afterwards, so either the reader's up_read() or we undo the boost.
+ */
+static void rwsem_ux_boost_readers(struct task_struct *tsk, struct rw_semaphore *sem)
+{
+	struct rw_semaphore *pending = rwsem_ux_dep_pending(sem);
+	struct task_struct *reader;
+	int i, nr_boosted = 0;
+	pid_t pid;
+
+	rcu_read_lock();
+	for (i = 0; i < RWSEM_UX_READERS_MAX; i++) {
+		pid = READ_ONCE(sem->ux_readers[i]);
+		if (!pid || pid == tsk->pid)
+			continue;
+		reader = find_task_by_pid_ns(pid, &init_pid_ns);
+		if (!reader || !READ_ONCE(reader->ux_rwsem_reads)) {
+			/* left by a non-owner up_read() */
+			cmpxchg(&sem->ux_readers[i], pid, 0);
+			continue;
+		}
+		if (test_task_ux(reader))
+			continue;
+		if (cmpxchg(&reader->ux_rwsem_dep, NULL, pending) != NULL)
+			continue;
+		dynamic_ux_enqueue(reader, DYNAMIC_UX_RWSEM, tsk->ux_depth);
+		smp_store_mb(reader->ux_rwsem_dep, sem);
+		if (READ_ONCE(sem->ux_readers[i]) != pid) {
+			rwsem_ux_unboost(reader, sem);
+			continue;
+		}
+		nr_boosted++;
+	}
+	rcu_read_unlock();
+
+	if (nr_boosted)
+		trace_sched_ux_rwsem_boost(tsk, sem, nr_boosted);
+}
+#endif /* CONFIG_RWSEM_UX_READER_BOOST */
+
 void rwsem_dynamic_ux_enqueue(struct task_struct *tsk, struct task_struct *waiter_task, struct task_struct *owner, struct rw_semaphore *sem)
 {
 	bool is_ux = test_set_dynamic_ux(tsk);
@@ -66,6 +188,11 @@ void rwsem_dynamic_ux_enqueue(struct task_struct *tsk, struct task_struct *waite
 			dynamic_ux_enqueue(owner, DYNAMIC_UX_RWSEM, tsk->ux_depth);
 			sem->ux_dep_task = owner;
 		}
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+		else if (owner == RWSEM_READER_OWNED && sem && sysctl_uifirst_rwsem_reader_boost) {
+			rwsem_ux_boost_readers(tsk, sem);
+		}
+#endif
 	}
 }
 
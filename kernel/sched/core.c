@@ -3416,6 +3416,10 @@ static void __sched_fork(unsigned long clone_flags, struct task_struct *p)
 #ifdef CONFIG_SCHED_WALT
 	p->last_sleep_ts		= 0;
 #endif
+	p->big_runtime			= 0;
+	p->big_runtime_epoch		= 0;
+	p->big_runtime_sum		= 0;
+	p->nr_big_rotations		= 0;
 
 	INIT_LIST_HEAD(&p->se.group_node);
 	walt_init_new_task_load(p);
@@ -34,6 +34,7 @@ struct sugov_tunables {
 	struct gov_attr_set attr_set;
 	unsigned int up_rate_limit_us;
 	unsigned int down_rate_limit_us;
+	unsigned int freq_input;
 };
 
 struct sugov_policy {
@@ -239,16 +240,21 @@ static unsigned int get_next_freq(struct sugov_policy *sg_policy,
 }
 #endif
 
-static void sugov_get_util(unsigned long *util, unsigned long *max, int cpu)
+static void sugov_get_util(unsigned long *util, unsigned long *max, int cpu,
+			   unsigned int input)
 {
 	unsigned long max_cap;
 
 	max_cap = arch_scale_cpu_capacity(NULL, cpu);
 
-	*util = boosted_cpu_util(cpu);
+	*util = sched_freq_input_util(cpu, input);
 	if (idle_cpu(cpu))
 		*util = 0;
 
+	if (trace_sugov_util_input_enabled())
+		trace_sugov_util_input(cpu, input, cpu_util_freq_pelt(cpu),
+				       cpu_util_freq_walt(cpu), *util);
+
 	*util = min(*util, max_cap);
 	*max = max_cap;
 }
@@ -356,7 +362,8 @@ static void sugov_update_single(struct update_util_data *hook, u64 time,
 	if (flags & SCHED_CPUFREQ_DL) {
 		next_f = policy->cpuinfo.max_freq;
 	} else {
-		sugov_get_util(&util, &max, sg_cpu->cpu);
+		sugov_get_util(&util, &max, sg_cpu->cpu,
+			       READ_ONCE(sg_policy->tunables->freq_input));
 		sugov_iowait_boost(sg_cpu, &util, &max);
 		next_f = get_next_freq(sg_policy, util, max);
 		/*
@@ -441,7 +448,8 @@ static void sugov_update_shared(struct update_util_data *hook, u64 time,
 	unsigned long util, max;
 	unsigned int next_f;
 
-	sugov_get_util(&util, &max, sg_cpu->cpu);
+	sugov_get_util(&util, &max, sg_cpu->cpu,
+		       READ_ONCE(sg_policy->tunables->freq_input));
 
 	raw_spin_lock(&sg_policy->update_lock);
 
@@ -573,6 +581,33 @@ static ssize_t down_rate_limit_us_store(struct gov_attr_set *attr_set,
 	return count;
 }
 
+static ssize_t freq_input_show(struct gov_attr_set *attr_set, char *buf)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+
+	return sprintf(buf, "%u\n", tunables->freq_input);
+}
+
+/*
+ * 0: follow sched_use_walt_cpu_util, 1: PELT, 2: WALT windowed demand
+ */
+static ssize_t freq_input_store(struct gov_attr_set *attr_set,
+				const char *buf, size_t count)
+{
+	struct sugov_tunables *tunables = to_sugov_tunables(attr_set);
+	unsigned int input;
+
+	if (kstrtouint(buf, 10, &input))
+		return -EINVAL;
+
+	if (input > SCHED_FREQ_INPUT_WALT)
+		return -EINVAL;
+
+	WRITE_ONCE(tunables->freq_input, input);
+
+	return count;
+}
+
 int schedutil_set_down_rate_limit_us(int cpu, unsigned int rate_limit_us)
 {
 	struct cpufreq_policy *policy;
@@ -655,10 +690,12 @@ EXPORT_SYMBOL(schedutil_set_up_rate_limit_us);
 
 static struct governor_attr up_rate_limit_us = __ATTR_RW(up_rate_limit_us);
 static struct governor_attr down_rate_limit_us = __ATTR_RW(down_rate_limit_us);
+static struct governor_attr freq_input = __ATTR_RW(freq_input);
 
 static struct attribute *sugov_attributes[] = {
 	&up_rate_limit_us.attr,
 	&down_rate_limit_us.attr,
+	&freq_input.attr,
 	NULL
 };
 
@@ -806,6 +843,7 @@ static int sugov_init(struct cpufreq_policy *policy)
 
 	tunables->up_rate_limit_us = cpufreq_policy_transition_delay_us(policy);
 	tunables->down_rate_limit_us = cpufreq_policy_transition_delay_us(policy);
+	tunables->freq_input = SCHED_FREQ_INPUT_DEFAULT;
 
 	policy->governor_data = sg_policy;
 	sg_policy->tunables = tunables;
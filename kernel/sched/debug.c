@@ -774,6 +774,22 @@ do {									\
 		P(sched_goidle);
 		P(ttwu_count);
 		P(ttwu_local);
+		P(eas_energy_count);
+		SEQ_printf(m, "  .%-30s: %llu\n", "eas_energy_time",
+			   schedstat_val(rq->eas_energy_time));
+#ifdef CONFIG_MTK_IDLE_BALANCE_ENHANCEMENT
+		P(idle_pull_cold);
+		P(idle_pull_hot);
+		P(idle_pull_moved);
+		P(idle_pull_failed);
+#endif
+#ifdef VENDOR_EDIT
+		P(ux_pick_count);
+		P(ux_resort_count);
+		P(ux_balance_scan);
+		P(ux_wakeup_placement);
+		P(ux_forced_migration);
+#endif
 	}
 #undef P
 
@@ -1032,9 +1048,12 @@ void proc_sched_show_task(struct task_struct *p, struct pid_namespace *ns,
 	nr_switches = p->nvcsw + p->nivcsw;
 
 	P(se.nr_migrations);
+	PN(big_runtime_sum);
+	P(nr_big_rotations);
 
 	if (schedstat_enabled()) {
 		u64 avg_atom, avg_per_cpu;
+		int i;
 
 		PN_SCHEDSTAT(se.statistics.sum_sleep_runtime);
 		PN_SCHEDSTAT(se.statistics.wait_start);
@@ -1080,6 +1099,11 @@ void proc_sched_show_task(struct task_struct *p, struct pid_namespace *ns,
 
 		__PN(avg_atom);
 		__PN(avg_per_cpu);
+
+		SEQ_printf(m, "%-45s:", "sched_info.lat_hist");
+		for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+			SEQ_printf(m, " %u", p->sched_info.lat_hist[i]);
+		SEQ_printf(m, "\n");
 	}
 
 	__P(nr_switches);
@@ -1128,6 +1152,7 @@ void proc_sched_set_task(struct task_struct *p)
 {
 #ifdef CONFIG_SCHEDSTATS
 	memset(&p->se.statistics, 0, sizeof(p->se.statistics));
+	memset(p->sched_info.lat_hist, 0, sizeof(p->sched_info.lat_hist));
 #endif
 }
 
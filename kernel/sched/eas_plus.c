@@ -11,6 +11,7 @@
  * See http://www.gnu.org/licenses/gpl-2.0.html for more details.
  */
 #include <linux/stop_machine.h>
+#include <linux/cacheinfo.h>
 static inline unsigned long task_util(struct task_struct *p);
 static int select_max_spare_capacity(struct task_struct *p, int target);
 int cpu_eff_tp = 1024;
@@ -266,6 +267,106 @@ int find_best_idle_cpu(struct task_struct *p, bool prefer_idle)
 	return best_idle_cpu;
 }
 
+#ifdef VENDOR_EDIT
+/*
+ * @p: the waking ux task
+ * @prev_cpu: the cpu @p last ran on
+ *
+ * Place a ux task on the least utilized idle CPU of its preferred cluster:
+ * the cluster of @prev_cpu if @p fits there, else the biggest one. The ux
+ * balance stop-work is then only needed as a fallback.
+ *
+ * Return:
+ *
+ * cpu id or
+ * -1 if no idle CPU is found in the preferred cluster
+ */
+static int select_ux_wakeup_cpu(struct task_struct *p, int prev_cpu)
+{
+	struct root_domain *rd = cpu_rq(smp_processor_id())->rd;
+	unsigned long util, best_util = ULONG_MAX;
+	struct cpumask cls_cpus;
+	int target = prev_cpu;
+	int best_cpu = -1;
+	int cpu;
+
+	if (rd->max_cap_orig_cpu >= 0 &&
+		!task_fits_capacity(p, capacity_orig_of(prev_cpu)))
+		target = rd->max_cap_orig_cpu;
+
+	arch_get_cluster_cpus(&cls_cpus, arch_get_cluster_id(target));
+
+	for_each_cpu_and(cpu, &p->cpus_allowed, &cls_cpus) {
+		if (!cpu_online(cpu) || cpu_isolated(cpu) || !idle_cpu(cpu))
+			continue;
+
+		util = cpu_util(cpu);
+
+		/* keep cache affinity with prev_cpu on ties */
+		if (util < best_util || (util == best_util && cpu == prev_cpu)) {
+			best_util = util;
+			best_cpu = cpu;
+		}
+	}
+
+	if (best_cpu >= 0)
+		schedstat_inc(cpu_rq(best_cpu)->ux_wakeup_placement);
+
+	return best_cpu;
+}
+#endif
+
+#ifdef CONFIG_MTK_SCHED_RQAVG_KS
+/*
+ * Per-cluster sum of the boosted util of its online CPUs. Each rq folds
+ * the change of its own contribution in at the PELT update points, from
+ * cfs_rq_util_change() under its rq lock, so readers get the cluster
+ * usage in O(1). Changes below CLUSTER_UTIL_SLACK are not folded in, so
+ * that the shared sum is not written on every small decay; the sum lags
+ * each CPU by less than that. WALT window rollover and schedtune margin
+ * changes are picked up by the next update of the rq, at the latest on
+ * its next tick.
+ */
+#define CLUSTER_UTIL_SLACK	(SCHED_CAPACITY_SCALE >> 7)
+
+struct cluster_util {
+	atomic_long_t sum;
+} ____cacheline_aligned_in_smp;
+
+static struct cluster_util cluster_util[NR_CPUS];
+static DEFINE_PER_CPU(unsigned long, cluster_util_contrib);
+
+static void update_cluster_util(struct rq *rq, bool online)
+{
+	int cpu = cpu_of(rq);
+	unsigned long *contrib = &per_cpu(cluster_util_contrib, cpu);
+	unsigned long util = 0;
+	long delta;
+
+	lockdep_assert_held(&rq->lock);
+
+	if (online) {
+		util = cpu_util_freq(cpu);
+		util += schedtune_cpu_margin(util, cpu);
+	}
+
+	delta = (long)util - (long)*contrib;
+	if (online && util && abs(delta) < CLUSTER_UTIL_SLACK)
+		return;
+
+	atomic_long_add(delta, &cluster_util[arch_get_cluster_id(cpu)].sum);
+	*contrib = util;
+}
+
+unsigned long sched_cluster_util_sum(int cluster_id)
+{
+	long sum = atomic_long_read(&cluster_util[cluster_id].sum);
+
+	return sum > 0 ? sum : 0;
+}
+EXPORT_SYMBOL(sched_cluster_util_sum);
+#endif
+
 static int init_cpu_info(void)
 {
 	int i;
@@ -413,6 +514,70 @@ bool idle_lb_enhance(struct task_struct *p, int cpu)
 	return 0;
 }
 
+/*
+ * Cache-hot threshold of each cluster for the aggressive idle pull: a task
+ * that ran on its source CPU more recently than this still has its working
+ * set in that cluster's L2. sysctl_sched_migration_cost is scaled by the
+ * L2 size of the cluster relative to IDLE_PULL_REF_L2, as a bigger cache
+ * takes longer to warm up again on the destination.
+ */
+#define IDLE_PULL_REF_L2	(256 * 1024)
+
+static u64 cluster_migration_cost[NR_CPUS];
+
+static unsigned int cpu_l2_size(int cpu)
+{
+	struct cpu_cacheinfo *cci = get_cpu_cacheinfo(cpu);
+	unsigned int i;
+
+	if (!cci || !cci->info_list)
+		return 0;
+
+	for (i = 0; i < cci->num_leaves; i++) {
+		struct cacheinfo *ci = cci->info_list + i;
+
+		if (ci->level == 2 && ci->type == CACHE_TYPE_UNIFIED)
+			return ci->size;
+	}
+
+	return 0;
+}
+
+static int __init init_cluster_migration_cost(void)
+{
+	u64 base = sysctl_sched_migration_cost;
+	int cpu, cid;
+
+	for_each_possible_cpu(cpu) {
+		unsigned int l2 = cpu_l2_size(cpu);
+		u64 cost = base;
+
+		cid = arch_get_cluster_id(cpu);
+		if (l2)
+			cost = clamp_t(u64, div_u64(base * l2, IDLE_PULL_REF_L2),
+				       base >> 1, base << 2);
+
+		cluster_migration_cost[cid] = max(cluster_migration_cost[cid],
+						  cost);
+	}
+
+	return 0;
+}
+late_initcall(init_cluster_migration_cost);
+
+static inline bool idle_pull_task_hot(struct task_struct *p, int cpu)
+{
+	u64 cost = cluster_migration_cost[arch_get_cluster_id(cpu)];
+	s64 delta;
+
+	if (!cost)
+		cost = sysctl_sched_migration_cost;
+
+	delta = rq_clock_task(cpu_rq(cpu)) - p->se.exec_start;
+
+	return delta < (s64)cost;
+}
+
 /* must hold runqueue lock for queue se is currently on */
 static const int idle_prefer_max_tasks = 5;
 static struct sched_entity
@@ -424,7 +589,7 @@ static struct sched_entity
 	int src_capacity;
 	unsigned int util_min;
 	struct cfs_rq *cfs_rq;
-	struct sched_entity *se;
+	struct sched_entity *se, *hot_se = NULL;
 
 	if (target_cpu >= 0)
 		hmp_target_mask = cpumask_of(target_cpu);
@@ -434,6 +599,9 @@ static struct sched_entity
 	/* The currently running task is not on the runqueue
 	 *	a. idle prefer
 	 *	b. task_capacity > belonged CPU
+	 *
+	 * Among the candidates, the first one whose cache is already cold
+	 * is taken; a cache-hot one only if no cold one is found.
 	 */
 	src_capacity = capacity_orig_of(cpu);
 	cfs_rq = &cpu_rq(cpu)->cfs;
@@ -443,24 +611,24 @@ static struct sched_entity
 		    cpumask_intersects(hmp_target_mask,
 				       &(task_of(se)->cpus_allowed))) {
 			struct task_struct *p;
+			bool pick = false;
 
 			p = task_of(se);
 			util_min = uclamp_task_effective_util(p, UCLAMP_MIN);
 
 #ifdef CONFIG_MTK_SCHED_BOOST
 			if (!task_prefer_match_on_cpu(p, cpu, target_cpu))
-				return se;
+				pick = true;
 #endif
 
 			if (check_min_cap && util_min >= src_capacity)
-				return se;
+				pick = true;
 
-			if (schedtune_prefer_idle(task_of(se)) &&
+			if (!pick && schedtune_prefer_idle(task_of(se)) &&
 					cpu_rq(cpu)->nr_running > 1) {
 				if (!check_min_cap)
-					return se;
-
-				if (backup_task && !*backup_task) {
+					pick = true;
+				else if (backup_task && !*backup_task) {
 					*backup_cpu = cpu;
 					/* get task and selection inside
 					 * rq lock
@@ -469,12 +637,25 @@ static struct sched_entity
 					get_task_struct(*backup_task);
 				}
 			}
+
+			if (pick) {
+				if (!idle_pull_task_hot(p, cpu)) {
+					schedstat_inc(cpu_rq(target_cpu)->idle_pull_cold);
+					return se;
+				}
+
+				if (!hot_se)
+					hot_se = se;
+			}
 		}
 		se = __pick_next_entity(se);
 		num_tasks--;
 	}
 
-	return NULL;
+	if (hot_se)
+		schedstat_inc(cpu_rq(target_cpu)->idle_pull_hot);
+
+	return hot_se;
 }
 
 static void
@@ -822,8 +1003,13 @@ static unsigned int aggressive_idle_pull(int this_cpu)
 
 done:
 	spin_unlock(&hmp_force_migration);
-	if (p)
+	if (p) {
+		if (moved)
+			schedstat_inc(cpu_rq(this_cpu)->idle_pull_moved);
+		else
+			schedstat_inc(cpu_rq(this_cpu)->idle_pull_failed);
 		put_task_struct(p);
+	}
 
 	return moved;
 }
@@ -1329,6 +1515,72 @@ int mtk_busy_power(int cpu_idx, int cpu, void *argu, int sd_level)
 
 	return energy_cost;
 }
+
+/*
+ * OPP of the co-buck domain as seen by candidate cpu_idx; only a cluster
+ * sharing our buck makes it differ between candidates, the CCI OPP is the
+ * same for all candidates of one decision.
+ */
+static inline int co_buck_key(struct energy_env *eenv, int cpu_idx, int cid)
+{
+	int co_buck_cid;
+
+	if (!is_share_buck(cid, &co_buck_cid))
+		return -1;
+
+	if (co_buck_cid < arch_get_nr_clusters())
+		return eenv->cpu[cpu_idx].cap_idx[co_buck_cid];
+
+	return -2;
+}
+
+/*
+ * mtk_sg_power_batch: busy/idle power of the sched_group led by @cpu for
+ * every candidate of @eenv in one pass.
+ *
+ * The power only depends on the OPP of the group's cluster and of its
+ * co-buck domain, and most candidates leave a given cluster at the same
+ * OPP, so the power model is evaluated once per distinct OPP pair and
+ * the result is shared by the other candidates.
+ */
+void mtk_sg_power_batch(struct energy_env *eenv, int cpu, int sd_level)
+{
+#ifdef CONFIG_ARM64
+	int cid = cpu_topology[cpu].cluster_id;
+#else
+	int cid = cpu_topology[cpu].socket_id;
+#endif
+	int cpu_idx, i;
+
+	for (cpu_idx = EAS_CPU_PRV; cpu_idx < eenv->max_cpu_count; ++cpu_idx) {
+		struct eenv_cpu *c = &eenv->cpu[cpu_idx];
+
+		if (c->cpu_id == -1)
+			continue;
+
+		/* keys live in the per-cpu eenv, nothing sized by NR_CPUS on stack */
+		c->sg_cap_key = c->cap_idx[cid];
+		c->sg_co_key = co_buck_key(eenv, cpu_idx, cid);
+
+		for (i = EAS_CPU_PRV; i < cpu_idx; i++) {
+			if (eenv->cpu[i].cpu_id == -1)
+				continue;
+
+			if (eenv->cpu[i].sg_cap_key == c->sg_cap_key &&
+			    eenv->cpu[i].sg_co_key == c->sg_co_key)
+				break;
+		}
+
+		if (i < cpu_idx) {
+			c->busy_power = eenv->cpu[i].busy_power;
+			c->idle_power = eenv->cpu[i].idle_power;
+			continue;
+		}
+
+		c->busy_power = mtk_busy_power(cpu_idx, cpu, eenv, sd_level);
+		c->idle_power = mtk_idle_power(cpu_idx, 0, cpu, eenv, sd_level);
+	}
+}
 #endif
 
 #ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
@@ -1449,6 +1701,56 @@ struct task_rotate_work {
 
 static DEFINE_PER_CPU(struct task_rotate_work, task_rotate_works);
 unsigned int sysctl_sched_rotation_enable;
+unsigned int sysctl_sched_rotation_window_ms = 100;
+
+/*
+ * Big core runtime is accounted per rotation window. All tasks share the
+ * window boundaries, so the runtime of a task last accounted in an older
+ * window reads as zero.
+ *
+ * The window number is cached per rq, so the division is only done when
+ * the rq clock crosses into another window instead of on every tick.
+ */
+static inline u64 big_runtime_epoch(struct rq *rq)
+{
+	u64 window = (u64)sysctl_sched_rotation_window_ms * NSEC_PER_MSEC;
+	u64 now = rq_clock(rq);
+
+	if (unlikely(window != rq->rotation_window ||
+		     now - rq->rotation_epoch_start >= window)) {
+		rq->rotation_window = window;
+		rq->rotation_epoch = div64_u64(now, window);
+		rq->rotation_epoch_start = rq->rotation_epoch * window;
+	}
+
+	return rq->rotation_epoch;
+}
+
+static inline u64 task_big_runtime(struct task_struct *p, u64 epoch)
+{
+	return p->big_runtime_epoch == epoch ? p->big_runtime : 0;
+}
+
+static void update_big_runtime(struct rq *rq, struct task_struct *p,
+			u64 delta_exec)
+{
+	u64 epoch;
+
+	if (sysctl_sched_rotation_enable != ROTATION_FAIR)
+		return;
+
+	if (!is_max_capacity_cpu(cpu_of(rq)))
+		return;
+
+	epoch = big_runtime_epoch(rq);
+	if (p->big_runtime_epoch != epoch) {
+		p->big_runtime_epoch = epoch;
+		p->big_runtime = 0;
+	}
+
+	p->big_runtime += delta_exec;
+	p->big_runtime_sum += delta_exec;
+}
 
 void set_sched_rotation_enable(bool enable)
 {
@@ -1480,13 +1782,124 @@ void task_rotate_work_init(void)
 	}
 }
 
+static void queue_task_rotation(struct rq *src_rq, int dst_cpu)
+{
+	struct rq *dst_rq = cpu_rq(dst_cpu);
+	int src_cpu = cpu_of(src_rq);
+	struct task_rotate_work *wr = NULL;
+	u64 src_big = 0, dst_big = 0;
+
+	double_rq_lock(src_rq, dst_rq);
+	if (dst_rq->curr->sched_class == &fair_sched_class) {
+		get_task_struct(src_rq->curr);
+		get_task_struct(dst_rq->curr);
+
+		mark_reserved(src_cpu);
+		mark_reserved(dst_cpu);
+		wr = &per_cpu(task_rotate_works, src_cpu);
+
+		wr->src_task = src_rq->curr;
+		wr->dst_task = dst_rq->curr;
+
+		wr->src_cpu = src_cpu;
+		wr->dst_cpu = dst_cpu;
+
+		if (sysctl_sched_rotation_enable == ROTATION_FAIR) {
+			u64 epoch = big_runtime_epoch(src_rq);
+
+			src_big = task_big_runtime(wr->src_task, epoch);
+			dst_big = task_big_runtime(wr->dst_task, epoch);
+			wr->src_task->nr_big_rotations++;
+			wr->dst_task->nr_big_rotations++;
+		}
+	}
+	double_rq_unlock(src_rq, dst_rq);
+
+	if (wr) {
+		queue_work_on(src_cpu, system_highpri_wq, &wr->w);
+		if (sysctl_sched_rotation_enable == ROTATION_FAIR)
+			trace_sched_big_task_fair_rotation(src_cpu, dst_cpu,
+					wr->src_task, wr->dst_task,
+					src_big, dst_big);
+		else
+			trace_sched_big_task_rotation(src_cpu, dst_cpu,
+					src_rq->curr->pid, dst_rq->curr->pid);
+	}
+}
+
+/*
+ * Fair rotation: swap the misfit task that got the least big core runtime
+ * in the current window with the big core task that got the most, once the
+ * gap between them exceeds TASK_ROTATION_THRESHOLD_NS. With N equal
+ * workers on fewer big cores this evens out their big core share.
+ */
+static void task_check_for_fair_rotation(struct rq *src_rq)
+{
+	u64 epoch, big, min_big = U64_MAX, max_big = 0;
+	int deserved_cpu = nr_cpu_ids, dst_cpu = nr_cpu_ids;
+	int i, src_cpu = cpu_of(src_rq);
+
+	epoch = big_runtime_epoch(src_rq);
+
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+
+		if (is_max_capacity_cpu(i))
+			continue;
+
+		if (is_reserved(i))
+			continue;
+
+		if (!rq->misfit_task_load || rq->curr->sched_class !=
+						&fair_sched_class)
+			continue;
+
+		big = task_big_runtime(rq->curr, epoch);
+		if (big < min_big) {
+			min_big = big;
+			deserved_cpu = i;
+		}
+	}
+
+	if (deserved_cpu != src_cpu)
+		return;
+
+	for_each_possible_cpu(i) {
+		struct rq *rq = cpu_rq(i);
+
+		if (!is_max_capacity_cpu(i))
+			continue;
+
+		if (is_reserved(i))
+			continue;
+
+		if (rq->curr->sched_class != &fair_sched_class)
+			continue;
+
+		if (rq->nr_running > 1)
+			continue;
+
+		big = task_big_runtime(rq->curr, epoch);
+		if (big > max_big) {
+			max_big = big;
+			dst_cpu = i;
+		}
+	}
+
+	if (dst_cpu == nr_cpu_ids)
+		return;
+
+	if (max_big - min_big < TASK_ROTATION_THRESHOLD_NS)
+		return;
+
+	queue_task_rotation(src_rq, dst_cpu);
+}
+
 void task_check_for_rotation(struct rq *src_rq)
 {
 	u64 wc, wait, max_wait = 0, run, max_run = 0;
 	int deserved_cpu = nr_cpu_ids, dst_cpu = nr_cpu_ids;
 	int i, src_cpu = cpu_of(src_rq);
-	struct rq *dst_rq;
-	struct task_rotate_work *wr = NULL;
 	int heavy_task = 0;
 
 	if (!sysctl_sched_rotation_enable)
@@ -1507,6 +1920,11 @@ void task_check_for_rotation(struct rq *src_rq)
 	if (heavy_task < HEAVY_TASK_NUM)
 		return;
 
+	if (sysctl_sched_rotation_enable == ROTATION_FAIR) {
+		task_check_for_fair_rotation(src_rq);
+		return;
+	}
+
 	wc = ktime_get_ns();
 	for_each_possible_cpu(i) {
 		struct rq *rq = cpu_rq(i);
@@ -1560,28 +1978,5 @@ void task_check_for_rotation(struct rq *src_rq)
 	if (dst_cpu == nr_cpu_ids)
 		return;
 
-	dst_rq = cpu_rq(dst_cpu);
-
-	double_rq_lock(src_rq, dst_rq);
-	if (dst_rq->curr->sched_class == &fair_sched_class) {
-		get_task_struct(src_rq->curr);
-		get_task_struct(dst_rq->curr);
-
-		mark_reserved(src_cpu);
-		mark_reserved(dst_cpu);
-		wr = &per_cpu(task_rotate_works, src_cpu);
-
-		wr->src_task = src_rq->curr;
-		wr->dst_task = dst_rq->curr;
-
-		wr->src_cpu = src_cpu;
-		wr->dst_cpu = dst_cpu;
-	}
-	double_rq_unlock(src_rq, dst_rq);
-
-	if (wr) {
-		queue_work_on(src_cpu, system_highpri_wq, &wr->w);
-		trace_sched_big_task_rotation(src_cpu, dst_cpu,
-					src_rq->curr->pid, dst_rq->curr->pid);
-	}
+	queue_task_rotation(src_rq, dst_cpu);
 }
@@ -26,6 +26,14 @@ static inline unsigned long task_util(struct task_struct *p);
 bool is_intra_domain(int prev, int target);
 static int select_max_spare_capacity(struct task_struct *p, int target);
 static int init_cpu_info(void);
+#ifdef CONFIG_MTK_SCHED_RQAVG_KS
+static void update_cluster_util(struct rq *rq, bool online);
+#else
+static inline void update_cluster_util(struct rq *rq, bool online) { }
+#endif
+#ifdef VENDOR_EDIT
+static int select_ux_wakeup_cpu(struct task_struct *p, int prev_cpu);
+#endif
 static unsigned int aggressive_idle_pull(int this_cpu);
 bool idle_lb_enhance(struct task_struct *p, int cpu);
 static int
@@ -86,6 +94,12 @@ struct eenv_cpu {
 #else
 	int     cap_idx[3];             /* [FIXME] cluster may > 3 */
 	int     cap[3];
+
+	/* power of the sched_group being evaluated, see mtk_sg_power_batch */
+	unsigned int busy_power;
+	unsigned int idle_power;
+	int sg_cap_key;
+	int sg_co_key;
 #endif
 
 	/* Estimated system energy */
@@ -136,6 +150,9 @@ struct energy_env {
 };
 
 void mtk_update_new_capacity(struct energy_env *eenv);
+#ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
+void mtk_sg_power_batch(struct energy_env *eenv, int cpu, int sd_level);
+#endif
 
 static void select_task_prefer_cpu_fair(struct task_struct *p, int *result);
 inline int valid_cpu_prefer(int task_prefer);
@@ -144,6 +161,8 @@ int cpu_prefer(struct task_struct *p);
 extern unsigned int hmp_cpu_is_fastest(int cpu);
 
 static int check_freq_turning(void);
+static void update_big_runtime(struct rq *rq, struct task_struct *p,
+			u64 delta_exec);
 struct rq *__migrate_task(struct rq *rq, struct rq_flags *rf,
 				struct task_struct *p, int dest_cpu);
 
@@ -926,6 +926,7 @@ static void update_curr(struct cfs_rq *cfs_rq)
 		trace_sched_stat_runtime(curtask, delta_exec, curr->vruntime);
 		cpuacct_charge(curtask, delta_exec);
 		account_group_exec_runtime(curtask, delta_exec);
+		update_big_runtime(rq_of(cfs_rq), curtask, delta_exec);
 	}
 
 	account_cfs_rq_runtime(cfs_rq, delta_exec);
@@ -2919,6 +2920,9 @@ static inline void cfs_rq_util_change(struct cfs_rq *cfs_rq)
 		 * See cpu_util().
 		 */
 		cpufreq_update_util(rq, 0);
+#ifdef CONFIG_SMP
+		update_cluster_util(rq, rq->online);
+#endif
 	}
 }
 
@@ -5996,6 +6000,44 @@ static inline unsigned long cpu_util_freq(int cpu)
 #endif
 }
 
+/* cfs + rt PELT utilization, whatever sched_use_walt_cpu_util says */
+unsigned long cpu_util_freq_pelt(int cpu)
+{
+	struct cfs_rq *cfs_rq = &cpu_rq(cpu)->cfs;
+	unsigned long util = READ_ONCE(cfs_rq->avg.util_avg);
+
+	if (sched_feat(UTIL_EST))
+		util = max_t(unsigned long, util,
+			     READ_ONCE(cfs_rq->avg.util_est.enqueued));
+
+	return min(util + cpu_util_rt(cpu), capacity_orig_of(cpu));
+}
+
+/*
+ * WALT busy time of the last window, or the demand of the tasks that
+ * run in the current window if that is higher, so that a burst or a new
+ * heavy task raises the frequency in the window it starts in rather than
+ * after several PELT half-lives.
+ */
+unsigned long cpu_util_freq_walt(int cpu)
+{
+#ifdef CONFIG_SCHED_WALT
+	struct rq *rq = cpu_rq(cpu);
+	u64 walt_cpu_util;
+
+	if (unlikely(walt_disabled))
+		return cpu_util_freq_pelt(cpu);
+
+	walt_cpu_util = max(rq->prev_runnable_sum, rq->cum_window_demand);
+	walt_cpu_util <<= SCHED_CAPACITY_SHIFT;
+	do_div(walt_cpu_util, walt_ravg_window);
+
+	return min_t(unsigned long, walt_cpu_util, capacity_orig_of(cpu));
+#else
+	return cpu_util_freq_pelt(cpu);
+#endif
+}
+
 
 /*
  * cpu_util_without: compute cpu utilization without any contributions from *p
@@ -6317,6 +6359,10 @@ static void calc_sg_energy(struct energy_env *eenv, struct sched_domain *sd)
 #endif
 	int cpu_idx;
 
+#if defined(CONFIG_MTK_UNIFY_POWER) && defined(CONFIG_MTK_SCHED_EAS_POWER_SUPPORT)
+	mtk_sg_power_batch(eenv, group_first_cpu(sg), (sd->child) ? 1 : 0);
+#endif
+
 	for (cpu_idx = EAS_CPU_PRV; cpu_idx < eenv->max_cpu_count; ++cpu_idx) {
 		if (eenv->cpu[cpu_idx].cpu_id == -1)
 			continue;
@@ -6328,8 +6374,7 @@ static void calc_sg_energy(struct energy_env *eenv, struct sched_domain *sd)
 
 #ifdef CONFIG_MTK_UNIFY_POWER
 #ifdef CONFIG_MTK_SCHED_EAS_POWER_SUPPORT
-		busy_power = sg->sge->busy_power(cpu_idx, group_first_cpu(sg),
-				eenv, (sd->child) ? 1 : 0);
+		busy_power = eenv->cpu[cpu_idx].busy_power;
 		/*
 		 * in order to calculate cpu_norm_util, we need to know which
 		 * capacity level the group will be at, so calculate that first
@@ -6340,9 +6385,7 @@ static void calc_sg_energy(struct energy_env *eenv, struct sched_domain *sd)
 
 		/* Compute IDLE energy */
 		idle_idx = group_idle_state(eenv, cpu_idx);
-		idle_power = sg->sge->idle_power(cpu_idx, idle_idx,
-				group_first_cpu(sg), eenv,
-				(sd->child) ? 1 : 0);
+		idle_power = eenv->cpu[cpu_idx].idle_power;
 
 		idle_energy   = SCHED_CAPACITY_SCALE - sg_util;
 		idle_energy  *= idle_power;
@@ -6921,6 +6964,29 @@ boosted_cpu_util(int cpu)
 	return util + margin;
 }
 
+/*
+ * Boosted utilization of @cpu as seen by schedutil for the given
+ * SCHED_FREQ_INPUT_* mode. The default follows cpu_util_freq(), the
+ * other modes pick one signal for frequency selection only.
+ */
+unsigned long sched_freq_input_util(int cpu, int input)
+{
+	unsigned long util;
+
+	switch (input) {
+	case SCHED_FREQ_INPUT_PELT:
+		util = cpu_util_freq_pelt(cpu);
+		break;
+	case SCHED_FREQ_INPUT_WALT:
+		util = cpu_util_freq_walt(cpu);
+		break;
+	default:
+		return boosted_cpu_util(cpu);
+	}
+
+	return util + schedtune_cpu_margin(util, cpu);
+}
+
 static inline unsigned long
 boosted_task_util(struct task_struct *task)
 {
@@ -8115,6 +8181,7 @@ static int find_energy_efficient_cpu(struct sched_domain *sd,
 	int target_cpu = -1;
 	struct energy_env *eenv;
 	unsigned int task_clamped_util;
+	u64 eval_start = 0;
 
 	if (sysctl_sched_sync_hint_enable && sync) {
 		if (cpumask_test_cpu(cpu, &p->cpus_allowed) &&
@@ -8123,6 +8190,14 @@ static int find_energy_efficient_cpu(struct sched_domain *sd,
 		}
 	}
 
+#ifdef VENDOR_EDIT
+	if (sysctl_uifirst_enabled && test_task_ux(p)) {
+		target_cpu = select_ux_wakeup_cpu(p, prev_cpu);
+		if (target_cpu >= 0)
+			return target_cpu;
+	}
+#endif
+
 	/* prepopulate energy diff environment */
 	eenv = get_eenv(p, prev_cpu);
 	if (eenv->max_cpu_count < 2)
@@ -8233,8 +8308,15 @@ static int find_energy_efficient_cpu(struct sched_domain *sd,
 	}
 
 	/* find most energy-efficient CPU */
+	if (schedstat_enabled())
+		eval_start = sched_clock();
 	target_cpu = select_energy_cpu_idx(eenv) < 0 ? -1 :
 					eenv->cpu[eenv->next_idx].cpu_id;
+	if (eval_start) {
+		schedstat_inc(this_rq()->eas_energy_count);
+		schedstat_add(this_rq()->eas_energy_time,
+			      sched_clock() - eval_start);
+	}
 
 	return target_cpu;
 }
@@ -12008,6 +12090,8 @@ static void rq_online_fair(struct rq *rq)
 	if (sched_feat(SCHED_HMP))
 		hmp_online_cpu(rq->cpu);
 
+	update_cluster_util(rq, true);
+
 	update_sysctl();
 
 	update_runtime_enabled(rq);
@@ -12018,6 +12102,8 @@ static void rq_offline_fair(struct rq *rq)
 	if (sched_feat(SCHED_HMP))
 		hmp_offline_cpu(rq->cpu);
 
+	update_cluster_util(rq, false);
+
 	update_sysctl();
 
 	/* Ensure any throttled groups are reachable by pick_next_task */
@@ -911,6 +911,18 @@ struct rq {
 	/* try_to_wake_up() stats */
 	unsigned int ttwu_count;
 	unsigned int ttwu_local;
+
+	/* energy evaluations of wakeups on this cpu and their cost in ns */
+	unsigned int eas_energy_count;
+	u64 eas_energy_time;
+
+#ifdef CONFIG_MTK_IDLE_BALANCE_ENHANCEMENT
+	/* aggressive_idle_pull() picks by cache state, and their outcome */
+	unsigned int idle_pull_cold;
+	unsigned int idle_pull_hot;
+	unsigned int idle_pull_moved;
+	unsigned int idle_pull_failed;
+#endif
 #endif
 
 #ifdef CONFIG_SMP
@@ -923,11 +935,23 @@ struct rq {
 	int idle_state_idx;
 #endif
 	unsigned long rotate_flags;
+	/* rotation window containing rq clock, see big_runtime_epoch() */
+	u64 rotation_epoch;
+	u64 rotation_epoch_start;
+	u64 rotation_window;
 #ifdef VENDOR_EDIT
 // Liujie.Xie@TECH.Kernel.Sched, 2019/05/22, add for ui first
-    struct list_head ux_thread_list;
+    struct rb_root_cached ux_thread_root;
     int active_ux_balance;
     struct cpu_stop_work ux_balance_work;
+#ifdef CONFIG_SCHEDSTATS
+    /* ux picks overriding cfs, lazy re-sorts on pick, nodes scanned by ux balance */
+    unsigned int ux_pick_count;
+    unsigned int ux_resort_count;
+    unsigned int ux_balance_scan;
+    unsigned int ux_wakeup_placement;
+    unsigned int ux_forced_migration;
+#endif
 #endif /* VENDOR_EDIT */
 };
 
@@ -1982,6 +2006,15 @@ extern unsigned int sysctl_sched_use_walt_cpu_util;
 extern unsigned int walt_ravg_window;
 extern bool walt_disabled;
 
+/* schedutil frequency input, see sched_freq_input_util() */
+#define SCHED_FREQ_INPUT_DEFAULT	0
+#define SCHED_FREQ_INPUT_PELT		1
+#define SCHED_FREQ_INPUT_WALT		2
+
+extern unsigned long cpu_util_freq_pelt(int cpu);
+extern unsigned long cpu_util_freq_walt(int cpu);
+extern unsigned long sched_freq_input_util(int cpu, int input);
+
 #endif /* CONFIG_SMP */
 
 #ifdef CONFIG_MEDIATEK_SOLUTION
@@ -61,6 +61,9 @@ inline unsigned int freq_util(unsigned long util);
 #define TASK_ROTATION_THRESHOLD_NS      6000000
 #define HEAVY_TASK_NUM  4
 
+/* sysctl_sched_rotation_enable */
+#define ROTATION_FAIR   2	/* equalise big core runtime in a window */
+
 extern void task_rotate_work_init(void);
 extern void check_for_migration(struct rq *rq, struct task_struct *p);
 extern void task_check_for_rotation(struct rq *rq);
@@ -4,6 +4,8 @@
 #include <linux/fs.h>
 #include <linux/seq_file.h>
 #include <linux/proc_fs.h>
+#include <linux/hashtable.h>
+#include <linux/vmalloc.h>
 
 #include "sched.h"
 
@@ -137,3 +139,106 @@ static int __init proc_schedstat_init(void)
 	return 0;
 }
 subsys_initcall(proc_schedstat_init);
+
+/*
+ * /proc/sched_latency_hist_uid: runqueue latency histograms of the live
+ * threads summed up per uid, see SCHED_LAT_HIST_BUCKETS for the buckets.
+ */
+#define LAT_HIST_UID_MAX	1024
+
+struct lat_hist_uid {
+	struct hlist_node node;
+	uid_t uid;
+	u64 hist[SCHED_LAT_HIST_BUCKETS];
+};
+
+struct lat_hist_uid_table {
+	DECLARE_HASHTABLE(head, 8);
+	int nr;
+	struct lat_hist_uid ent[LAT_HIST_UID_MAX];
+};
+
+static struct lat_hist_uid *
+lat_hist_uid_get(struct lat_hist_uid_table *tbl, uid_t uid)
+{
+	struct lat_hist_uid *ent;
+
+	hash_for_each_possible(tbl->head, ent, node, uid)
+		if (ent->uid == uid)
+			return ent;
+
+	if (tbl->nr >= LAT_HIST_UID_MAX)
+		return NULL;
+
+	ent = &tbl->ent[tbl->nr++];
+	ent->uid = uid;
+	hash_add(tbl->head, &ent->node, uid);
+
+	return ent;
+}
+
+static int show_lat_hist_uid(struct seq_file *seq, void *v)
+{
+	struct lat_hist_uid_table *tbl;
+	struct task_struct *g, *t;
+	struct lat_hist_uid *ent;
+	int i, bkt;
+
+	tbl = vzalloc(sizeof(*tbl));
+	if (!tbl)
+		return -ENOMEM;
+
+	hash_init(tbl->head);
+
+	rcu_read_lock();
+	for_each_process_thread(g, t) {
+		ent = lat_hist_uid_get(tbl, from_kuid_munged(&init_user_ns,
+							     task_uid(t)));
+		if (!ent)
+			continue;
+
+		for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+			ent->hist[i] += t->sched_info.lat_hist[i];
+	}
+	rcu_read_unlock();
+
+	seq_puts(seq, "uid");
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS - 1; i++)
+		seq_printf(seq, " <%luus", 1UL << i);
+	seq_printf(seq, " >=%luus", 1UL << (i - 1));
+	seq_putc(seq, '\n');
+
+	hash_for_each(tbl->head, bkt, ent, node) {
+		seq_printf(seq, "%u", ent->uid);
+		for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+			seq_printf(seq, " %llu", ent->hist[i]);
+		seq_putc(seq, '\n');
+	}
+
+	if (tbl->nr >= LAT_HIST_UID_MAX)
+		seq_puts(seq, "truncated\n");
+
+	vfree(tbl);
+
+	return 0;
+}
+
+static int lat_hist_uid_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, show_lat_hist_uid, NULL);
+}
+
+static const struct file_operations proc_lat_hist_uid_operations = {
+	.open    = lat_hist_uid_open,
+	.read    = seq_read,
+	.llseek  = seq_lseek,
+	.release = single_release,
+};
+
+static int __init proc_lat_hist_uid_init(void)
+{
+	proc_create("sched_latency_hist_uid", 0444, NULL,
+		    &proc_lat_hist_uid_operations);
+	return 0;
+}
+subsys_initcall(proc_lat_hist_uid_init);
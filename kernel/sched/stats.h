@@ -30,6 +30,21 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 	if (rq)
 		rq->rq_sched_info.run_delay += delta;
 }
+
+/*
+ * Account one runqueue wait of @delta ns in the task's latency histogram.
+ * ns >> 10 is close enough to us for log2 buckets.
+ */
+static inline void
+sched_lat_hist_add(struct task_struct *t, unsigned long long delta)
+{
+	int bucket = fls64(delta >> 10);
+
+	if (bucket >= SCHED_LAT_HIST_BUCKETS)
+		bucket = SCHED_LAT_HIST_BUCKETS - 1;
+
+	t->sched_info.lat_hist[bucket]++;
+}
 #define schedstat_enabled()		static_branch_unlikely(&sched_schedstats)
 #define schedstat_inc(var)		do { if (schedstat_enabled()) { var++; } } while (0)
 #define schedstat_add(var, amt)		do { if (schedstat_enabled()) { var += (amt); } } while (0)
@@ -47,6 +62,9 @@ rq_sched_info_dequeued(struct rq *rq, unsigned long long delta)
 static inline void
 rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 {}
+static inline void
+sched_lat_hist_add(struct task_struct *t, unsigned long long delta)
+{}
 #define schedstat_enabled()		0
 #define schedstat_inc(var)		do { } while (0)
 #define schedstat_add(var, amt)		do { } while (0)
@@ -175,8 +193,11 @@ static void sched_info_arrive(struct rq *rq, struct task_struct *t)
 {
 	unsigned long long now = rq_clock(rq), delta = 0;
 
-	if (t->sched_info.last_queued)
+	if (t->sched_info.last_queued) {
 		delta = now - t->sched_info.last_queued;
+		if (schedstat_enabled())
+			sched_lat_hist_add(t, delta);
+	}
 	sched_info_reset_dequeued(t);
 	t->sched_info.run_delay += delta;
 	t->sched_info.last_arrival = now;
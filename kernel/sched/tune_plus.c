@@ -236,6 +236,24 @@ int group_prefer_idle_read(int group_idx)
 }
 EXPORT_SYMBOL(group_prefer_idle_read);
 
+/* mtk: whether a task sits in the stune group of the given name */
+bool schedtune_task_in_group(struct task_struct *p, const char *name)
+{
+	struct cgroup *cgrp;
+	bool ret;
+
+	if (unlikely(!schedtune_initialized))
+		return false;
+
+	rcu_read_lock();
+	cgrp = task_schedtune(p)->css.cgroup;
+	ret = cgrp->kn && !strcmp(cgrp->kn->name, name);
+	rcu_read_unlock();
+
+	return ret;
+}
+EXPORT_SYMBOL(schedtune_task_in_group);
+
 #ifdef CONFIG_MTK_SCHED_RQAVG_KS
 /* mtk: a linear boost value for tuning */
 int linear_real_boost(int linear_boost)
@@ -362,6 +362,9 @@ static int max_sched_tunable_scaling = SCHED_TUNABLESCALING_END-1;
 // Liujie.Xie@TECH.Kernel.Sched, 2019/05/22, add for ui first
 int sysctl_uifirst_enabled = 1;
 int sysctl_launcher_boost_enabled = 0;
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+int sysctl_uifirst_rwsem_reader_boost = 1;
+#endif
 #endif /* VENDOR_EDIT */
 
 #ifdef CONFIG_COMPACTION
@@ -539,7 +542,15 @@ static struct ctl_table kern_table[] = {
 		.mode		= 0644,
 		.proc_handler	= proc_dointvec_minmax,
 		.extra1		= &zero,
-		.extra2		= &one,
+		.extra2		= &two,
+	},
+	{
+		.procname	= "sched_big_task_rotation_window_ms",
+		.data		= &sysctl_sched_rotation_window_ms,
+		.maxlen		= sizeof(unsigned int),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &one,
 	},
 #ifdef CONFIG_SCHEDSTATS
 	{
@@ -1461,6 +1472,17 @@ static struct ctl_table kern_table[] = {
         .mode       = 0666,
         .proc_handler = proc_dointvec,
     },
+#ifdef CONFIG_RWSEM_UX_READER_BOOST
+    {
+        .procname   = "uifirst_rwsem_reader_boost",
+        .data       = &sysctl_uifirst_rwsem_reader_boost,
+        .maxlen     = sizeof(int),
+        .mode       = 0666,
+        .proc_handler = sysctl_uifirst_rwsem_reader_boost_handler,
+        .extra1     = &zero,
+        .extra2     = &one,
+    },
+#endif
 #endif /* VENDOR_EDIT */
 #ifdef VENDOR_EDIT
 /* Hailong.Liu@TECH.Kernel.CPU, 2019/10/24, stat cpu usage on each tick. */
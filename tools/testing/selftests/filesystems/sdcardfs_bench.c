@@ -0,0 +1,447 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Compare sdcardfs throughput with its lower filesystem
+ *
+ * Usage: sdcardfs_bench [-s size_mb] [-u files] <lower_dir> <sdcardfs_dir>
+ *
+ * Both directories should be the same directory seen directly and
+ * through sdcardfs, e.g. /data/media/0/bench and /sdcard/bench. For each
+ * of them a file of size_mb is written and read back sequentially with
+ * 4K and 1M buffers, then copied with sendfile() and copy_file_range().
+ * Page cache is dropped before every read pass when running as root.
+ * MB/s of each pass and the sdcardfs/lower ratio are printed.
+ *
+ * Then files 4K files (default 4096, 0 skips this) are created in each
+ * directory and unlinked in parallel by 1, 4 and 8 threads, like a
+ * gallery deleting a batch of photos. Unlinks/s are printed, and for
+ * the sdcardfs pass the records that showed up in /proc/dellog_bin and
+ * the ones lost to ring wraparound. sdcardfs only logs deletes in the
+ * protected directories, so use e.g. /sdcard/DCIM/Camera/bench to count
+ * the delete log in.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/sdcardfs_dellog.h>
+
+#define BENCH_FILE	"sdcardfs_bench.dat"
+#define BENCH_COPY	"sdcardfs_bench.copy"
+#define BENCH_UNLINK	"sdcardfs_bench.del"
+#define DELLOG_BIN	"/proc/dellog_bin"
+#define UNLINK_SIZE	4096
+
+enum {
+	PASS_WRITE_4K,
+	PASS_READ_4K,
+	PASS_WRITE_1M,
+	PASS_READ_1M,
+	PASS_SENDFILE,
+	PASS_COPY_RANGE,
+	NR_PASSES,
+};
+
+static const char * const pass_names[NR_PASSES] = {
+	[PASS_WRITE_4K]		= "write 4K",
+	[PASS_READ_4K]		= "read 4K",
+	[PASS_WRITE_1M]		= "write 1M",
+	[PASS_READ_1M]		= "read 1M",
+	[PASS_SENDFILE]		= "sendfile",
+	[PASS_COPY_RANGE]	= "copy_file_range",
+};
+
+static const int nr_threads_list[] = { 1, 4, 8 };
+
+struct unlinker {
+	pthread_t thread;
+	const char *dir;
+	int id;
+	int nr_threads;
+	int err;
+};
+
+struct dellog_reader {
+	int fd;
+	bool started;
+	unsigned long long next_seq;
+	unsigned long long records;
+	unsigned long long lost;
+};
+
+static size_t file_size = 256UL << 20;
+static size_t unlink_files = 4096;
+static char *buf;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void drop_caches(void)
+{
+	int fd;
+
+	sync();
+	fd = open("/proc/sys/vm/drop_caches", O_WRONLY);
+	if (fd < 0)
+		return;
+	if (write(fd, "3", 1) < 0)
+		perror("drop_caches");
+	close(fd);
+}
+
+static double mbps(double sec)
+{
+	return sec > 0 ? file_size / sec / (1 << 20) : 0;
+}
+
+static double bench_write(const char *path, size_t bs)
+{
+	size_t done;
+	double start;
+	int fd;
+
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	start = now_sec();
+	for (done = 0; done < file_size; done += bs) {
+		if (write(fd, buf, bs) != (ssize_t)bs) {
+			perror("write");
+			close(fd);
+			return -1;
+		}
+	}
+	fsync(fd);
+	close(fd);
+
+	return mbps(now_sec() - start);
+}
+
+static double bench_read(const char *path, size_t bs)
+{
+	double start;
+	ssize_t ret;
+	int fd;
+
+	drop_caches();
+	fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		perror(path);
+		return -1;
+	}
+
+	start = now_sec();
+	while ((ret = read(fd, buf, bs)) > 0)
+		;
+	if (ret < 0)
+		perror("read");
+	close(fd);
+
+	return ret < 0 ? -1 : mbps(now_sec() - start);
+}
+
+static ssize_t copy_range(int in, int out, size_t len)
+{
+#ifdef __NR_copy_file_range
+	return syscall(__NR_copy_file_range, in, NULL, out, NULL, len, 0);
+#else
+	errno = ENOSYS;
+	return -1;
+#endif
+}
+
+static double bench_copy(const char *src, const char *dst, int use_range)
+{
+	size_t done = 0;
+	double start;
+	ssize_t ret = 0;
+	int in, out;
+
+	drop_caches();
+	in = open(src, O_RDONLY);
+	if (in < 0) {
+		perror(src);
+		return -1;
+	}
+	out = open(dst, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+	if (out < 0) {
+		perror(dst);
+		close(in);
+		return -1;
+	}
+
+	start = now_sec();
+	while (done < file_size) {
+		if (use_range)
+			ret = copy_range(in, out, file_size - done);
+		else
+			ret = sendfile(out, in, NULL, file_size - done);
+		if (ret <= 0)
+			break;
+		done += ret;
+	}
+	if (ret < 0)
+		perror(use_range ? "copy_file_range" : "sendfile");
+	else
+		fsync(out);
+	close(out);
+	close(in);
+	unlink(dst);
+
+	return ret < 0 ? -1 : mbps(now_sec() - start);
+}
+
+static int bench_dir(const char *dir, double *res)
+{
+	char file[4096], copy[4096];
+
+	snprintf(file, sizeof(file), "%s/%s", dir, BENCH_FILE);
+	snprintf(copy, sizeof(copy), "%s/%s", dir, BENCH_COPY);
+
+	res[PASS_WRITE_4K] = bench_write(file, 4096);
+	res[PASS_READ_4K] = bench_read(file, 4096);
+	res[PASS_WRITE_1M] = bench_write(file, 1 << 20);
+	res[PASS_READ_1M] = bench_read(file, 1 << 20);
+	res[PASS_SENDFILE] = bench_copy(file, copy, 0);
+	res[PASS_COPY_RANGE] = bench_copy(file, copy, 1);
+
+	unlink(file);
+
+	return res[PASS_WRITE_4K] < 0 ? -1 : 0;
+}
+
+static void unlink_path(char *path, size_t len, const char *dir, size_t i)
+{
+	snprintf(path, len, "%s/%s.%zu", dir, BENCH_UNLINK, i);
+}
+
+static void unlink_all(const char *dir)
+{
+	char path[4096];
+	size_t i;
+
+	for (i = 0; i < unlink_files; i++) {
+		unlink_path(path, sizeof(path), dir, i);
+		unlink(path);
+	}
+}
+
+static int create_files(const char *dir)
+{
+	char path[4096];
+	size_t i;
+	int fd;
+
+	for (i = 0; i < unlink_files; i++) {
+		unlink_path(path, sizeof(path), dir, i);
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0660);
+		if (fd < 0) {
+			perror(path);
+			return -1;
+		}
+		if (write(fd, buf, UNLINK_SIZE) != UNLINK_SIZE) {
+			perror("write");
+			close(fd);
+			return -1;
+		}
+		close(fd);
+	}
+	sync();
+
+	return 0;
+}
+
+static void *unlink_fn(void *arg)
+{
+	struct unlinker *u = arg;
+	char path[4096];
+	size_t i;
+
+	for (i = u->id; i < unlink_files; i += u->nr_threads) {
+		unlink_path(path, sizeof(path), u->dir, i);
+		if (unlink(path) && !u->err)
+			u->err = errno;
+	}
+
+	return NULL;
+}
+
+/* unlinks/s of nr_threads threads sharing the files of dir */
+static double bench_unlink(const char *dir, int nr_threads)
+{
+	struct unlinker u[8];
+	double start, sec;
+	int i, err = 0;
+
+	if (create_files(dir)) {
+		unlink_all(dir);
+		return -1;
+	}
+
+	start = now_sec();
+	for (i = 0; i < nr_threads; i++) {
+		u[i].dir = dir;
+		u[i].id = i;
+		u[i].nr_threads = nr_threads;
+		u[i].err = 0;
+		if (pthread_create(&u[i].thread, NULL, unlink_fn, &u[i])) {
+			nr_threads = i;
+			err = EAGAIN;
+			break;
+		}
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(u[i].thread, NULL);
+		if (u[i].err)
+			err = u[i].err;
+	}
+	sec = now_sec() - start;
+
+	if (err) {
+		fprintf(stderr, "unlink: %s\n", strerror(err));
+		unlink_all(dir);
+		return -1;
+	}
+
+	return sec > 0 ? unlink_files / sec : 0;
+}
+
+/* consume the records logged since the last call */
+static int dellog_read(struct dellog_reader *r)
+{
+	static char rbuf[64 << 10] __attribute__((aligned(8)));
+	struct dellog_bin_rec *rec;
+	ssize_t n, off;
+
+	while ((n = read(r->fd, rbuf, sizeof(rbuf))) > 0) {
+		for (off = 0; off + (ssize_t)sizeof(*rec) <= n; off += rec->len) {
+			rec = (struct dellog_bin_rec *)(rbuf + off);
+			if (rec->len < sizeof(*rec) ||
+			    rec->len % DELLOG_BIN_REC_ALIGN) {
+				fprintf(stderr, "%s: bad record\n", DELLOG_BIN);
+				return -1;
+			}
+			if (r->started && rec->seq > r->next_seq)
+				r->lost += rec->seq - r->next_seq;
+			r->started = true;
+			r->next_seq = rec->seq + 1;
+			r->records++;
+		}
+	}
+
+	return n < 0 ? -1 : 0;
+}
+
+static void run_unlink(const char *lower_dir, const char *upper_dir,
+		       int nr_threads)
+{
+	struct dellog_reader r = { 0 };
+	double lower, upper;
+	char name[32];
+
+	snprintf(name, sizeof(name), "%d thread%s", nr_threads,
+		 nr_threads > 1 ? "s" : "");
+
+	lower = bench_unlink(lower_dir, nr_threads);
+
+	/* skip what was logged before the pass */
+	r.fd = open(DELLOG_BIN, O_RDONLY);
+	if (r.fd >= 0 && dellog_read(&r)) {
+		close(r.fd);
+		r.fd = -1;
+	}
+	r.records = 0;
+	r.lost = 0;
+
+	upper = bench_unlink(upper_dir, nr_threads);
+	if (r.fd >= 0 && dellog_read(&r)) {
+		close(r.fd);
+		r.fd = -1;
+	}
+
+	if (lower < 0 || upper < 0) {
+		printf("%-16s %10s\n", name, "failed");
+	} else if (r.fd < 0) {
+		printf("%-16s %10.0f %10.0f %6.2fx %8s %6s\n", name, lower,
+		       upper, lower ? upper / lower : 0, "-", "-");
+	} else {
+		printf("%-16s %10.0f %10.0f %6.2fx %8llu %6llu\n", name, lower,
+		       upper, lower ? upper / lower : 0, r.records, r.lost);
+	}
+
+	if (r.fd >= 0)
+		close(r.fd);
+}
+
+int main(int argc, char **argv)
+{
+	double lower[NR_PASSES], upper[NR_PASSES];
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "s:u:")) != -1) {
+		switch (opt) {
+		case 's':
+			file_size = strtoul(optarg, NULL, 0) << 20;
+			break;
+		case 'u':
+			unlink_files = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind != 2 || !file_size)
+		goto usage;
+
+	buf = malloc(1 << 20);
+	if (!buf)
+		return 1;
+	memset(buf, 0x5a, 1 << 20);
+
+	if (bench_dir(argv[optind], lower) ||
+	    bench_dir(argv[optind + 1], upper))
+		return 1;
+
+	printf("%-16s %10s %10s %7s\n", "MB/s", "lower", "sdcardfs", "ratio");
+	for (i = 0; i < NR_PASSES; i++) {
+		if (lower[i] < 0 || upper[i] < 0) {
+			printf("%-16s %10s\n", pass_names[i], "failed");
+			continue;
+		}
+		printf("%-16s %10.1f %10.1f %6.2fx\n", pass_names[i],
+		       lower[i], upper[i], lower[i] ? upper[i] / lower[i] : 0);
+	}
+
+	if (unlink_files) {
+		printf("\n%-16s %10s %10s %7s %8s %6s\n", "unlinks/s", "lower",
+		       "sdcardfs", "ratio", "dellog", "lost");
+		for (i = 0; i < (int)(sizeof(nr_threads_list) /
+				      sizeof(nr_threads_list[0])); i++)
+			run_unlink(argv[optind], argv[optind + 1],
+				   nr_threads_list[i]);
+	}
+
+	free(buf);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-s size_mb] [-u files] <lower_dir> <sdcardfs_dir>\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,223 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay a wakeup pattern and report the cost of the EAS energy evaluation
+ *
+ * Every worker thread loops over busy <run_us> / sleep <sleep_us>, so each
+ * of its wakeups goes through find_energy_efficient_cpu(). The per-cpu
+ * eas_energy_count/eas_energy_time schedstats in /proc/sched_debug are
+ * sampled before and after the replay and the average ns per energy
+ * evaluation is printed.
+ *
+ * Usage: eas_wakeup_replay [-d seconds] [pattern-file]
+ *
+ * The pattern file has one "<run_us> <sleep_us>" line per worker thread.
+ * Without it a game-like pattern is replayed: a render and a logic thread
+ * running every frame, plus short audio/input/network wakeups.
+ *
+ * Needs CONFIG_SCHEDSTATS with kernel.sched_schedstats=1 and an EAS kernel,
+ * the test is skipped otherwise.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../kselftest.h"
+
+#define MAX_WORKERS	64
+#define SCHED_DEBUG	"/proc/sched_debug"
+#define SCHEDSTATS	"/proc/sys/kernel/sched_schedstats"
+
+struct worker {
+	pthread_t thread;
+	unsigned long run_us;
+	unsigned long sleep_us;
+	unsigned long loops;
+};
+
+static struct worker workers[MAX_WORKERS];
+static int nr_workers;
+static volatile int stop;
+
+static const unsigned long default_pattern[][2] = {
+	{ 8000, 8600 },		/* render, 60 fps */
+	{ 5000, 11600 },	/* logic */
+	{ 300, 5000 },		/* audio */
+	{ 100, 4000 },		/* input */
+	{ 200, 16000 },		/* network */
+	{ 1000, 33000 },	/* worker pool */
+	{ 1000, 33000 },
+	{ 1000, 33000 },
+};
+
+static unsigned long long now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+static void *worker_fn(void *arg)
+{
+	struct worker *w = arg;
+	struct timespec ts;
+	unsigned long long end;
+
+	ts.tv_sec = w->sleep_us / 1000000;
+	ts.tv_nsec = (w->sleep_us % 1000000) * 1000;
+
+	while (!stop) {
+		end = now_us() + w->run_us;
+		while (now_us() < end)
+			;
+		nanosleep(&ts, NULL);
+		w->loops++;
+	}
+
+	return NULL;
+}
+
+/* sum the per-cpu energy evaluation schedstats, -1 if not exported */
+static int read_energy_stats(unsigned long long *count,
+			     unsigned long long *ns)
+{
+	char line[256];
+	unsigned long long val;
+	int found = 0;
+	FILE *f;
+
+	f = fopen(SCHED_DEBUG, "r");
+	if (!f)
+		return -1;
+
+	*count = *ns = 0;
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, " .eas_energy_count : %llu", &val) == 1) {
+			*count += val;
+			found = 1;
+		} else if (sscanf(line, " .eas_energy_time : %llu", &val) == 1) {
+			*ns += val;
+		}
+	}
+	fclose(f);
+
+	return found ? 0 : -1;
+}
+
+static int schedstats_enabled(void)
+{
+	int val = 0;
+	FILE *f;
+
+	f = fopen(SCHEDSTATS, "r");
+	if (!f)
+		return 0;
+	if (fscanf(f, "%d", &val) != 1)
+		val = 0;
+	fclose(f);
+
+	return val;
+}
+
+static int load_pattern(const char *path)
+{
+	unsigned long run, sleep;
+	char line[128];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f) && nr_workers < MAX_WORKERS) {
+		if (line[0] == '#')
+			continue;
+		if (sscanf(line, "%lu %lu", &run, &sleep) != 2)
+			continue;
+		workers[nr_workers].run_us = run;
+		workers[nr_workers].sleep_us = sleep;
+		nr_workers++;
+	}
+	fclose(f);
+
+	return nr_workers ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long long count0, ns0, count1, ns1, wakeups = 0;
+	unsigned int duration = 5;
+	int opt, i;
+
+	while ((opt = getopt(argc, argv, "d:")) != -1) {
+		switch (opt) {
+		case 'd':
+			duration = atoi(optarg);
+			break;
+		default:
+			printf("Usage: %s [-d seconds] [pattern-file]\n",
+			       argv[0]);
+			return ksft_exit_fail();
+		}
+	}
+
+	if (optind < argc) {
+		if (load_pattern(argv[optind]))
+			return ksft_exit_fail();
+	} else {
+		nr_workers = sizeof(default_pattern) /
+			     sizeof(default_pattern[0]);
+		for (i = 0; i < nr_workers; i++) {
+			workers[i].run_us = default_pattern[i][0];
+			workers[i].sleep_us = default_pattern[i][1];
+		}
+	}
+
+	if (!schedstats_enabled())
+		return ksft_exit_skip("schedstats disabled\n");
+	if (read_energy_stats(&count0, &ns0))
+		return ksft_exit_skip("no energy evaluation stats in %s\n",
+				      SCHED_DEBUG);
+
+	for (i = 0; i < nr_workers; i++) {
+		if (pthread_create(&workers[i].thread, NULL, worker_fn,
+				   &workers[i])) {
+			perror("pthread_create");
+			stop = 1;
+			while (i--)
+				pthread_join(workers[i].thread, NULL);
+			return ksft_exit_fail();
+		}
+	}
+
+	sleep(duration);
+	stop = 1;
+	for (i = 0; i < nr_workers; i++) {
+		pthread_join(workers[i].thread, NULL);
+		wakeups += workers[i].loops;
+	}
+
+	if (read_energy_stats(&count1, &ns1))
+		return ksft_exit_fail();
+
+	printf("workers: %d duration: %us wakeups: %llu\n",
+	       nr_workers, duration, wakeups);
+	printf("energy evaluations: %llu total_ns: %llu\n",
+	       count1 - count0, ns1 - ns0);
+
+	if (count1 == count0) {
+		/* EAS not active, e.g. overutilized the whole time */
+		return ksft_exit_skip("no energy evaluation happened\n");
+	}
+
+	printf("avg_ns per evaluation: %llu\n",
+	       (ns1 - ns0) / (count1 - count0));
+
+	return ksft_exit_pass();
+}
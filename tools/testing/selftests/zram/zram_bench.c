@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure zram write throughput with and without batched writes
+ *
+ * Usage: zram_bench [-s size_mb] [-b bio_kb] [-m swap_mb] <zram_dev>
+ *
+ * The device must be initialized (disksize set) and not in use. For 1, 4
+ * and 8 threads, each thread writes its own part of the device with
+ * O_DIRECT writes of bio_kb, once with batch_write_pages as configured
+ * and once with it set to 0. Every page is half random and half zero, so
+ * it compresses about 2:1 and deduplication does not kick in.
+ *
+ * Reported are MB/s, the CPU time of the writers and the CPU time of all
+ * kswapd threads during the pass. With -m, swap_mb of anonymous memory
+ * is touched by the same threads instead, to measure kswapd under swap
+ * pressure when the device is the swap device.
+ */
+#define _GNU_SOURCE
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <linux/fs.h>
+
+#define PAGE_SZ		4096
+
+static const int nr_threads_list[] = { 1, 4, 8 };
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	off_t start;
+	size_t len;
+	size_t bio;
+	int err;
+};
+
+static char dev_name[64];
+static size_t size_mb = 512;
+static size_t bio_kb = 512;
+static size_t swap_mb;
+
+static double now_sec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static double self_cpu_sec(void)
+{
+	struct rusage ru;
+
+	getrusage(RUSAGE_SELF, &ru);
+	return ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 +
+	       ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+}
+
+/* utime + stime of every kswapd thread, in clock ticks */
+static unsigned long long kswapd_ticks(void)
+{
+	unsigned long long sum = 0, utime, stime;
+	char path[288], buf[512], *p;
+	struct dirent *de;
+	DIR *dir;
+	FILE *f;
+
+	dir = opendir("/proc");
+	if (!dir)
+		return 0;
+
+	while ((de = readdir(dir))) {
+		if (!isdigit(de->d_name[0]))
+			continue;
+		snprintf(path, sizeof(path), "/proc/%s/stat", de->d_name);
+		f = fopen(path, "r");
+		if (!f)
+			continue;
+		if (!fgets(buf, sizeof(buf), f) || !strstr(buf, "(kswapd")) {
+			fclose(f);
+			continue;
+		}
+		fclose(f);
+		/* fields 14 and 15, counted after the ")" of comm */
+		p = strrchr(buf, ')');
+		if (p && sscanf(p + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+				&utime, &stime) == 2)
+			sum += utime + stime;
+	}
+	closedir(dir);
+
+	return sum;
+}
+
+static int sysfs_write(const char *attr, const char *val)
+{
+	char path[128];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/%s", dev_name, attr);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	ret = write(fd, val, strlen(val)) < 0 ? -errno : 0;
+	close(fd);
+
+	return ret;
+}
+
+static int sysfs_read(const char *attr, char *val, size_t len)
+{
+	char path[128];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/%s", dev_name, attr);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	n = read(fd, val, len - 1);
+	close(fd);
+	if (n < 0)
+		return -errno;
+	val[n] = '\0';
+
+	return 0;
+}
+
+static void fill_page(char *page, unsigned long seed)
+{
+	unsigned int *w = (unsigned int *)page;
+	size_t i;
+
+	for (i = 0; i < PAGE_SZ / 2 / sizeof(*w); i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		w[i] = seed >> 32;
+	}
+	memset(page + PAGE_SZ / 2, 0, PAGE_SZ / 2);
+}
+
+static void *write_fn(void *arg)
+{
+	struct worker *w = arg;
+	size_t done, i;
+	char *buf;
+
+	if (posix_memalign((void **)&buf, PAGE_SZ, w->bio)) {
+		w->err = ENOMEM;
+		return NULL;
+	}
+
+	for (done = 0; done < w->len; done += w->bio) {
+		for (i = 0; i < w->bio; i += PAGE_SZ)
+			fill_page(buf + i, w->start + done + i);
+		if (pwrite(w->fd, buf, w->bio, w->start + done) !=
+		    (ssize_t)w->bio) {
+			w->err = errno;
+			break;
+		}
+	}
+	free(buf);
+
+	return NULL;
+}
+
+static void *touch_fn(void *arg)
+{
+	struct worker *w = arg;
+	size_t i;
+	char *mem;
+
+	mem = mmap(NULL, w->len, PROT_READ | PROT_WRITE,
+		   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED) {
+		w->err = errno;
+		return NULL;
+	}
+	for (i = 0; i < w->len; i += PAGE_SZ)
+		fill_page(mem + i, w->start + i);
+	munmap(mem, w->len);
+
+	return NULL;
+}
+
+static int run_pass(int fd, int nr_threads, double *mbps, double *cpu,
+		    double *kswapd_ms)
+{
+	struct worker workers[8];
+	size_t total = (swap_mb ? swap_mb : size_mb) << 20;
+	size_t per = total / nr_threads / (bio_kb << 10) * (bio_kb << 10);
+	unsigned long long k0;
+	double start, cpu0;
+	int i, err = 0;
+
+	k0 = kswapd_ticks();
+	cpu0 = self_cpu_sec();
+	start = now_sec();
+
+	for (i = 0; i < nr_threads; i++) {
+		workers[i].fd = fd;
+		workers[i].start = (off_t)i * per;
+		workers[i].len = per;
+		workers[i].bio = bio_kb << 10;
+		workers[i].err = 0;
+		if (pthread_create(&workers[i].thread, NULL,
+				   swap_mb ? touch_fn : write_fn, &workers[i])) {
+			nr_threads = i;
+			err = EAGAIN;
+			break;
+		}
+	}
+	for (i = 0; i < nr_threads; i++) {
+		pthread_join(workers[i].thread, NULL);
+		if (workers[i].err)
+			err = workers[i].err;
+	}
+
+	*mbps = (double)per * nr_threads / (now_sec() - start) / (1 << 20);
+	*cpu = self_cpu_sec() - cpu0;
+	*kswapd_ms = (kswapd_ticks() - k0) * 1000.0 / sysconf(_SC_CLK_TCK);
+
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	char batch_pages[32] = "";
+	double mbps, cpu, kswapd_ms;
+	unsigned long long dev_size;
+	const char *dev, *p;
+	int opt, fd = -1, i, batch;
+
+	while ((opt = getopt(argc, argv, "s:b:m:")) != -1) {
+		switch (opt) {
+		case 's':
+			size_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'b':
+			bio_kb = strtoul(optarg, NULL, 0);
+			break;
+		case 'm':
+			swap_mb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (argc - optind != 1 || !size_mb || !bio_kb || bio_kb % 4)
+		goto usage;
+
+	dev = argv[optind];
+	p = strrchr(dev, '/');
+	snprintf(dev_name, sizeof(dev_name), "%s", p ? p + 1 : dev);
+
+	if (!swap_mb) {
+		fd = open(dev, O_WRONLY | O_DIRECT);
+		if (fd < 0) {
+			perror(dev);
+			return 1;
+		}
+		if (ioctl(fd, BLKGETSIZE64, &dev_size) ||
+		    (size_mb << 20) > dev_size) {
+			fprintf(stderr, "%s is smaller than %zu MB\n", dev,
+				size_mb);
+			return 1;
+		}
+	}
+
+	/* kernels without CONFIG_ZRAM_BATCH_WRITE only get the plain pass */
+	if (sysfs_read("batch_write_pages", batch_pages, sizeof(batch_pages)))
+		batch_pages[0] = '\0';
+	batch_pages[strcspn(batch_pages, "\n")] = '\0';
+
+	printf("%-8s %-7s %10s %10s %12s\n", "threads", "batch", "MB/s",
+	       "cpu s", "kswapd ms");
+	for (i = 0; i < (int)(sizeof(nr_threads_list) /
+			      sizeof(nr_threads_list[0])); i++) {
+		for (batch = batch_pages[0] ? 1 : 0; batch >= 0; batch--) {
+			if (batch_pages[0] &&
+			    sysfs_write("batch_write_pages",
+					batch ? batch_pages : "0")) {
+				perror("batch_write_pages");
+				return 1;
+			}
+			if (run_pass(fd, nr_threads_list[i], &mbps, &cpu,
+				     &kswapd_ms)) {
+				printf("%-8d %-7s %10s\n", nr_threads_list[i],
+				       batch ? batch_pages : "off", "failed");
+				continue;
+			}
+			printf("%-8d %-7s %10.1f %10.2f %12.0f\n",
+			       nr_threads_list[i], batch ? batch_pages : "off",
+			       mbps, cpu, kswapd_ms);
+		}
+	}
+
+	if (batch_pages[0])
+		sysfs_write("batch_write_pages", batch_pages);
+	if (fd >= 0)
+		close(fd);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-s size_mb] [-b bio_kb] [-m swap_mb] <zram_dev>\n",
+		argv[0]);
+	return 1;
+}
@@ -0,0 +1,354 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay swap-in patterns against a zram device with a backing device
+ *
+ * Usage: zram_wb_replay [-r ra_pages] [-g gap_us] <zram_dev> [trace]
+ *
+ * The device must be initialized with a backing_dev and not in use. For
+ * each pattern every slot of it is written, all slots are marked idle and
+ * written back, then the slots are read in pattern order with O_DIRECT,
+ * gap_us apart. This is done with writeback_ra_pages at 0 and at ra_pages
+ * (default 8), and the read latencies and backing device reads of both
+ * runs are printed.
+ *
+ * A trace has one "<slot> [gap_us]" line per swap-in, slots in pages from
+ * the start of the device. Without a trace, synthetic patterns are
+ * replayed: apps whose pages were swapped out together are swapped in in
+ * order, in order with holes, and at random.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+
+#define PAGE_SZ		4096
+#define APP_PAGES	256
+#define NR_APPS		16
+
+struct swapin {
+	unsigned long slot;
+	unsigned int gap_us;
+};
+
+struct pattern {
+	const char *name;
+	struct swapin *ev;
+	size_t nr;
+	size_t size;
+};
+
+struct result {
+	double mean_us;
+	double p50_us;
+	double p99_us;
+	unsigned long long bd_reads;
+	unsigned long long ra_pages;
+};
+
+static char dev_name[64];
+static unsigned long dev_pages;
+static unsigned int default_gap_us = 50;
+static char *page;
+
+static int sysfs_write(const char *attr, const char *val)
+{
+	char path[128];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/%s", dev_name, attr);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	ret = write(fd, val, strlen(val)) < 0 ? -errno : 0;
+	close(fd);
+
+	return ret;
+}
+
+/* bd_stat: bd_count bd_reads bd_writes bd_ra_pages */
+static int read_bd_stat(unsigned long long *reads, unsigned long long *ra)
+{
+	unsigned long long count, writes;
+	char path[128];
+	FILE *f;
+	int n;
+
+	snprintf(path, sizeof(path), "/sys/block/%s/bd_stat", dev_name);
+	f = fopen(path, "r");
+	if (!f)
+		return -errno;
+	n = fscanf(f, "%llu %llu %llu %llu", &count, reads, &writes, ra);
+	fclose(f);
+
+	return n == 4 ? 0 : -EINVAL;
+}
+
+static void pattern_add(struct pattern *p, unsigned long slot,
+			unsigned int gap_us)
+{
+	if (p->nr == p->size) {
+		p->size = p->size ? p->size * 2 : 1024;
+		p->ev = realloc(p->ev, p->size * sizeof(*p->ev));
+		if (!p->ev) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	p->ev[p->nr].slot = slot;
+	p->ev[p->nr].gap_us = gap_us;
+	p->nr++;
+}
+
+static double now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void fill_page(unsigned long seed)
+{
+	unsigned int *w = (unsigned int *)page;
+	size_t i;
+
+	/* half random, half zero: compressible, distinct and not same-filled */
+	for (i = 0; i < PAGE_SZ / 2 / sizeof(*w); i++) {
+		seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+		w[i] = seed >> 32;
+	}
+	memset(page + PAGE_SZ / 2, 0, PAGE_SZ / 2);
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/* store every slot of @p and push them all to the backing device */
+static int swap_out(int fd, struct pattern *p)
+{
+	size_t i;
+	int ret;
+
+	for (i = 0; i < p->nr; i++) {
+		fill_page(p->ev[i].slot);
+		if (pwrite(fd, page, PAGE_SZ, p->ev[i].slot * PAGE_SZ) !=
+		    PAGE_SZ) {
+			perror("pwrite");
+			return -1;
+		}
+	}
+
+	ret = sysfs_write("idle", "all");
+	if (!ret)
+		ret = sysfs_write("writeback", "idle");
+	if (ret) {
+		fprintf(stderr, "writeback: %s\n", strerror(-ret));
+		return -1;
+	}
+
+	return 0;
+}
+
+static int replay(int fd, struct pattern *p, const char *ra_pages,
+		  struct result *res)
+{
+	unsigned long long reads0, ra0;
+	double *lat, start, sum = 0;
+	size_t i;
+
+	if (sysfs_write("writeback_ra_pages", ra_pages)) {
+		perror("writeback_ra_pages");
+		return -1;
+	}
+	if (swap_out(fd, p) || read_bd_stat(&reads0, &ra0))
+		return -1;
+
+	lat = calloc(p->nr, sizeof(*lat));
+	if (!lat)
+		return -1;
+
+	for (i = 0; i < p->nr; i++) {
+		if (p->ev[i].gap_us)
+			usleep(p->ev[i].gap_us);
+		start = now_us();
+		if (pread(fd, page, PAGE_SZ, p->ev[i].slot * PAGE_SZ) !=
+		    PAGE_SZ) {
+			perror("pread");
+			free(lat);
+			return -1;
+		}
+		lat[i] = now_us() - start;
+		sum += lat[i];
+	}
+
+	if (read_bd_stat(&res->bd_reads, &res->ra_pages)) {
+		free(lat);
+		return -1;
+	}
+	res->bd_reads -= reads0;
+	res->ra_pages -= ra0;
+
+	qsort(lat, p->nr, sizeof(*lat), cmp_double);
+	res->mean_us = sum / p->nr;
+	res->p50_us = lat[p->nr / 2];
+	res->p99_us = lat[p->nr * 99 / 100];
+	free(lat);
+
+	return 0;
+}
+
+static void run(int fd, struct pattern *p, const char *ra_pages)
+{
+	struct result off, on;
+
+	printf("%s: %zu swap-ins\n", p->name, p->nr);
+	if (replay(fd, p, "0", &off) || replay(fd, p, ra_pages, &on)) {
+		printf("  failed\n");
+		return;
+	}
+
+	printf("  %-8s %10s %10s %10s %10s %10s\n", "ra", "mean us",
+	       "p50 us", "p99 us", "bd reads", "ra pages");
+	printf("  %-8s %10.1f %10.1f %10.1f %10llu %10llu\n", "0",
+	       off.mean_us, off.p50_us, off.p99_us, off.bd_reads,
+	       off.ra_pages);
+	printf("  %-8s %10.1f %10.1f %10.1f %10llu %10llu\n", ra_pages,
+	       on.mean_us, on.p50_us, on.p99_us, on.bd_reads, on.ra_pages);
+}
+
+/*
+ * NR_APPS apps of APP_PAGES slots each, laid out one after another as if
+ * each app had been swapped out at once.
+ */
+static void synthetic(int fd, const char *ra_pages)
+{
+	struct pattern p = { 0 };
+	unsigned long app, i;
+
+	p.name = "in-order";
+	for (app = 0; app < NR_APPS; app++)
+		for (i = 0; i < APP_PAGES; i++)
+			pattern_add(&p, app * APP_PAGES + i, default_gap_us);
+	run(fd, &p, ra_pages);
+
+	/* an app touching three pages out of four, e.g. a partial launch */
+	p.nr = 0;
+	p.name = "holes";
+	for (app = 0; app < NR_APPS; app++)
+		for (i = 0; i < APP_PAGES; i++)
+			if (i % 4 != 3)
+				pattern_add(&p, app * APP_PAGES + i,
+					    default_gap_us);
+	run(fd, &p, ra_pages);
+
+	/* random faults all over the swapped out apps */
+	p.nr = 0;
+	p.name = "random";
+	srand(1);
+	for (i = 0; i < NR_APPS * APP_PAGES / 2; i++)
+		pattern_add(&p, rand() % (NR_APPS * APP_PAGES),
+			    default_gap_us);
+	run(fd, &p, ra_pages);
+
+	free(p.ev);
+}
+
+static int load_trace(const char *path, struct pattern *p)
+{
+	unsigned long slot;
+	unsigned int gap;
+	char line[128];
+	FILE *f;
+	int n;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -1;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		n = sscanf(line, "%lu %u", &slot, &gap);
+		if (n < 1 || slot >= dev_pages)
+			continue;
+		pattern_add(p, slot, n == 2 ? gap : default_gap_us);
+	}
+	fclose(f);
+
+	return p->nr ? 0 : -1;
+}
+
+int main(int argc, char **argv)
+{
+	const char *ra_pages = "8", *dev, *s;
+	unsigned long long size;
+	struct pattern trace = { 0 };
+	int opt, fd;
+
+	while ((opt = getopt(argc, argv, "r:g:")) != -1) {
+		switch (opt) {
+		case 'r':
+			ra_pages = optarg;
+			break;
+		case 'g':
+			default_gap_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (optind >= argc || argc - optind > 2)
+		goto usage;
+
+	dev = argv[optind];
+	s = strrchr(dev, '/');
+	snprintf(dev_name, sizeof(dev_name), "%s", s ? s + 1 : dev);
+
+	if (posix_memalign((void **)&page, PAGE_SZ, PAGE_SZ))
+		return 1;
+
+	fd = open(dev, O_RDWR | O_DIRECT);
+	if (fd < 0) {
+		perror(dev);
+		return 1;
+	}
+	if (ioctl(fd, BLKGETSIZE64, &size)) {
+		perror("BLKGETSIZE64");
+		return 1;
+	}
+	dev_pages = size / PAGE_SZ;
+
+	if (optind + 1 < argc) {
+		if (load_trace(argv[optind + 1], &trace))
+			return 1;
+		trace.name = argv[optind + 1];
+		run(fd, &trace, ra_pages);
+		free(trace.ev);
+	} else {
+		if (dev_pages < NR_APPS * APP_PAGES) {
+			fprintf(stderr, "%s is smaller than %d pages\n", dev,
+				NR_APPS * APP_PAGES);
+			return 1;
+		}
+		synthetic(fd, ra_pages);
+	}
+
+	close(fd);
+	free(page);
+	return 0;
+
+usage:
+	fprintf(stderr, "Usage: %s [-r ra_pages] [-g gap_us] <zram_dev> [trace]\n",
+		argv[0]);
+	return 1;
+}
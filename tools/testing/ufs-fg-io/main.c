@@ -0,0 +1,329 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Measure app launch reads under background writeback on UFS
+ *
+ * Usage: main -s <ufs_sysfs_dir> [-t tags] [-n launches] [-a app_mb]
+ *             [-w dirty_mb] <dir>
+ *
+ * An "app" of app_mb is laid out in files under dir. Each launch drops
+ * the app from the page cache and reads it back the way a launch does:
+ * the files in order with 128KB reads, then a burst of random 4KB reads.
+ * Meanwhile a writer keeps dirtying dirty_mb of a file without syncing,
+ * so the flusher keeps the device queue full of background writes.
+ *
+ * The launcher runs with the real-time I/O class, which UFS counts as
+ * foreground like UX and top-app I/O tagged by io_boost. The launches
+ * are timed with fg_reserved_tags at 0 and at tags (default: the value
+ * found in sysfs). For both runs the launch times and the per-class
+ * completion latencies of io_class_stat are printed.
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+#define APP_FILE_MB	4
+#define SEQ_READ	(128 << 10)
+#define RAND_READ	4096
+#define RAND_READS	256
+
+#define IOPRIO_CLASS_SHIFT	13
+#define IOPRIO_CLASS_RT		1
+#define IOPRIO_WHO_PROCESS	1
+
+static const char *sysfs_dir;
+static const char *dir;
+static unsigned int nr_launches = 20;
+static unsigned int app_mb = 64;
+static unsigned int dirty_mb = 256;
+static volatile int stop_writer;
+static char *buf;
+
+static int sysfs_write(const char *attr, const char *val)
+{
+	char path[256];
+	int fd, ret;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+	fd = open(path, O_WRONLY);
+	if (fd < 0)
+		return -errno;
+	ret = write(fd, val, strlen(val)) < 0 ? -errno : 0;
+	close(fd);
+
+	return ret;
+}
+
+static int sysfs_read(const char *attr, char *val, size_t len)
+{
+	char path[256];
+	ssize_t n;
+	int fd;
+
+	snprintf(path, sizeof(path), "%s/%s", sysfs_dir, attr);
+	fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return -errno;
+	n = read(fd, val, len - 1);
+	close(fd);
+	if (n < 0)
+		return -errno;
+	val[n] = '\0';
+
+	return 0;
+}
+
+static double now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static int cmp_double(const void *a, const void *b)
+{
+	double x = *(const double *)a, y = *(const double *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void app_path(char *path, size_t len, unsigned int i)
+{
+	snprintf(path, len, "%s/ufs_fg_app.%u", dir, i);
+}
+
+static int app_create(void)
+{
+	unsigned int i, j;
+	char path[256];
+	int fd;
+
+	for (i = 0; i < app_mb / APP_FILE_MB; i++) {
+		app_path(path, sizeof(path), i);
+		fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+		if (fd < 0) {
+			perror(path);
+			return -1;
+		}
+		for (j = 0; j < (APP_FILE_MB << 20) / SEQ_READ; j++) {
+			if (write(fd, buf, SEQ_READ) != SEQ_READ) {
+				perror("write");
+				close(fd);
+				return -1;
+			}
+		}
+		fsync(fd);
+		close(fd);
+	}
+
+	return 0;
+}
+
+static void app_remove(void)
+{
+	char path[256];
+	unsigned int i;
+
+	for (i = 0; i < app_mb / APP_FILE_MB; i++) {
+		app_path(path, sizeof(path), i);
+		unlink(path);
+	}
+}
+
+/* read the app back cold, returns the launch time in ms */
+static double app_launch(void)
+{
+	unsigned int nr = app_mb / APP_FILE_MB, i;
+	double start;
+	char path[256];
+	off_t off;
+	int fd;
+
+	for (i = 0; i < nr; i++) {
+		app_path(path, sizeof(path), i);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return -1;
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+
+	start = now_ms();
+	for (i = 0; i < nr; i++) {
+		app_path(path, sizeof(path), i);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return -1;
+		/* the first half in order, like the code and resources */
+		for (off = 0; off < (APP_FILE_MB << 20) / 2; off += SEQ_READ)
+			if (pread(fd, buf, SEQ_READ, off) != SEQ_READ)
+				break;
+		close(fd);
+	}
+	for (i = 0; i < RAND_READS; i++) {
+		app_path(path, sizeof(path), rand() % nr);
+		fd = open(path, O_RDONLY);
+		if (fd < 0)
+			return -1;
+		off = (rand() % ((APP_FILE_MB << 20) / RAND_READ)) *
+			(off_t)RAND_READ;
+		pread(fd, buf, RAND_READ, off);
+		close(fd);
+	}
+
+	return now_ms() - start;
+}
+
+static void *writer_fn(void *arg)
+{
+	char path[256], *wbuf;
+	size_t len = (size_t)dirty_mb << 20;
+	off_t off = 0;
+	int fd;
+
+	wbuf = malloc(SEQ_READ);
+	if (!wbuf)
+		return NULL;
+	memset(wbuf, 0x5a, SEQ_READ);
+
+	snprintf(path, sizeof(path), "%s/ufs_fg_dirty", dir);
+	fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+	if (fd < 0) {
+		perror(path);
+		free(wbuf);
+		return NULL;
+	}
+
+	/* overwrite in a loop, the flusher writes it back asynchronously */
+	while (!stop_writer) {
+		if (pwrite(fd, wbuf, SEQ_READ, off) != SEQ_READ)
+			break;
+		off = (off + SEQ_READ) % len;
+	}
+
+	close(fd);
+	unlink(path);
+	free(wbuf);
+	return NULL;
+}
+
+static int run(const char *tags)
+{
+	char stat[1024];
+	double *lat, sum = 0;
+	unsigned int i;
+
+	if (sysfs_write("fg_reserved_tags", tags)) {
+		perror("fg_reserved_tags");
+		return -1;
+	}
+	sysfs_write("io_class_stat", "0");
+
+	lat = calloc(nr_launches, sizeof(*lat));
+	if (!lat)
+		return -1;
+
+	srand(1);
+	for (i = 0; i < nr_launches; i++) {
+		lat[i] = app_launch();
+		if (lat[i] < 0) {
+			perror("launch");
+			free(lat);
+			return -1;
+		}
+		sum += lat[i];
+	}
+	qsort(lat, nr_launches, sizeof(*lat), cmp_double);
+
+	printf("fg_reserved_tags %s: launch mean %.1f ms, p50 %.1f ms, max %.1f ms\n",
+	       tags, sum / nr_launches, lat[nr_launches / 2],
+	       lat[nr_launches - 1]);
+	if (!sysfs_read("io_class_stat", stat, sizeof(stat)))
+		printf("%s", stat);
+	free(lat);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	char tags[32] = "", orig[32];
+	pthread_t writer;
+	int opt, ret;
+
+	while ((opt = getopt(argc, argv, "s:t:n:a:w:")) != -1) {
+		switch (opt) {
+		case 's':
+			sysfs_dir = optarg;
+			break;
+		case 't':
+			snprintf(tags, sizeof(tags), "%s", optarg);
+			break;
+		case 'n':
+			nr_launches = strtoul(optarg, NULL, 0);
+			break;
+		case 'a':
+			app_mb = strtoul(optarg, NULL, 0);
+			break;
+		case 'w':
+			dirty_mb = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			goto usage;
+		}
+	}
+	if (!sysfs_dir || argc - optind != 1 || !nr_launches ||
+	    app_mb < APP_FILE_MB || !dirty_mb)
+		goto usage;
+	dir = argv[optind];
+
+	if (sysfs_read("fg_reserved_tags", orig, sizeof(orig))) {
+		fprintf(stderr, "%s/fg_reserved_tags: %s\n", sysfs_dir,
+			strerror(errno));
+		return 1;
+	}
+	orig[strcspn(orig, "\n")] = '\0';
+	if (!tags[0])
+		snprintf(tags, sizeof(tags), "%s", orig);
+
+	buf = malloc(SEQ_READ);
+	if (!buf)
+		return 1;
+	memset(buf, 0xa5, SEQ_READ);
+	if (app_create())
+		return 1;
+
+	if (pthread_create(&writer, NULL, writer_fn, NULL)) {
+		perror("pthread_create");
+		return 1;
+	}
+	/* foreground like a UX or top-app launcher, the writer stays BE */
+	if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0,
+		    IOPRIO_CLASS_RT << IOPRIO_CLASS_SHIFT | 4))
+		perror("ioprio_set");
+	/* let the flusher fill the device queue */
+	sleep(5);
+
+	ret = run("0");
+	if (!ret)
+		ret = run(tags);
+
+	stop_writer = 1;
+	pthread_join(writer, NULL);
+	sysfs_write("fg_reserved_tags", orig);
+	app_remove();
+
+	return ret ? 1 : 0;
+
+usage:
+	fprintf(stderr, "Usage: %s -s <ufs_sysfs_dir> [-t tags] [-n launches] [-a app_mb] [-w dirty_mb] <dir>\n",
+		argv[0]);
+	return 1;
+}
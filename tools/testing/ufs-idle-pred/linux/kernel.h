@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFS_IDLE_PRED_KERNEL_H
+#define _UFS_IDLE_PRED_KERNEL_H
+
+#include "../../../include/linux/kernel.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#define U32_MAX		((u32)~0U)
+#define U64_MAX		((u64)~0ULL)
+
+#define min_t(type, x, y) ({			\
+	type __min1 = (x);			\
+	type __min2 = (y);			\
+	__min1 < __min2 ? __min1 : __min2; })
+
+#define clamp_t(type, val, lo, hi) min_t(type, max((type)(val), (type)(lo)), hi)
+
+#endif /* _UFS_IDLE_PRED_KERNEL_H */
@@ -0,0 +1,8 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFS_IDLE_PRED_LOG2_H
+#define _UFS_IDLE_PRED_LOG2_H
+
+/* only what the predictor needs, @n must not be 0 */
+#define ilog2(n) (63 - __builtin_clzll((unsigned long long)(n)))
+
+#endif /* _UFS_IDLE_PRED_LOG2_H */
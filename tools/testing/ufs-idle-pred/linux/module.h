@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFS_IDLE_PRED_MODULE_H
+#define _UFS_IDLE_PRED_MODULE_H
+
+#define EXPORT_SYMBOL_GPL(sym)
+#define MODULE_DESCRIPTION(desc)
+#define MODULE_LICENSE(license)
+
+#endif /* _UFS_IDLE_PRED_MODULE_H */
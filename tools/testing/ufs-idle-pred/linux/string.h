@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFS_IDLE_PRED_STRING_H
+#define _UFS_IDLE_PRED_STRING_H
+
+#include <errno.h>
+#include <string.h>
+#include <linux/kernel.h>
+
+static inline int __sysfs_match_string(const char * const *array, size_t n,
+				       const char *str)
+{
+	size_t len;
+	size_t i;
+
+	len = strcspn(str, "\n");
+	for (i = 0; i < n; i++)
+		if (array[i] && strlen(array[i]) == len &&
+		    !strncmp(array[i], str, len))
+			return i;
+
+	return -EINVAL;
+}
+
+#define sysfs_match_string(_a, _s) \
+	__sysfs_match_string(_a, ARRAY_SIZE(_a), _s)
+
+#endif /* _UFS_IDLE_PRED_STRING_H */
@@ -0,0 +1,316 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Replay UFS request traces through the idle gap predictor
+ *
+ * The predictor in drivers/scsi/ufs/ufs-idle-pred.c is built unchanged
+ * and fed the busy/idle transitions of a trace, once per policy. For
+ * every policy the hibern8 exits and the link time spent active while
+ * idle are reported next to the fixed timer.
+ *
+ * Usage: main [-f fixed_us] [-e exit_us] [trace]
+ *
+ * A trace has one "<issue_ns> <complete_ns>" line per request, in any
+ * order. Without a trace a set of synthetic workloads is replayed and
+ * checked: timeouts stay within the policy bounds, the fixed policy
+ * matches the fixed timer, and the adaptive policies cut idle link time
+ * where an exit is cheap and exits where it is not.
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <linux/kernel.h>
+#include "../../../drivers/scsi/ufs/ufs-idle-pred.h"
+
+struct event {
+	u64 ns;
+	int delta;	/* +1 issue, -1 completion */
+};
+
+struct trace {
+	struct event *ev;
+	size_t nr;
+	size_t size;
+};
+
+struct result {
+	u64 gaps;
+	u64 exits;
+	u64 fixed_exits;
+	u64 idle_active_us;
+	u32 min_timeout_us;
+	u32 max_timeout_us;
+};
+
+static u32 fixed_us = 10000;
+static u32 exit_us = UFS_IDLE_EXIT_US;
+static int failures;
+
+static void trace_add(struct trace *t, u64 ns, int delta)
+{
+	if (t->nr == t->size) {
+		t->size = t->size ? t->size * 2 : 1024;
+		t->ev = realloc(t->ev, t->size * sizeof(*t->ev));
+		if (!t->ev) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+	t->ev[t->nr].ns = ns;
+	t->ev[t->nr].delta = delta;
+	t->nr++;
+}
+
+static void trace_add_req(struct trace *t, u64 issue_ns, u64 complete_ns)
+{
+	trace_add(t, issue_ns, 1);
+	trace_add(t, complete_ns, -1);
+}
+
+static int event_cmp(const void *a, const void *b)
+{
+	const struct event *x = a, *y = b;
+
+	if (x->ns != y->ns)
+		return x->ns < y->ns ? -1 : 1;
+	/* issue before completion at the same time stamp */
+	return y->delta - x->delta;
+}
+
+static void replay(struct trace *t, enum ufs_idle_policy policy,
+		   struct result *res)
+{
+	struct ufs_idle_pred pred;
+	u64 idle_start = 0, gap_us;
+	u32 timeout = 0;
+	int outstanding = 0;
+	size_t i;
+
+	memset(res, 0, sizeof(*res));
+	res->min_timeout_us = U32_MAX;
+	ufs_idle_pred_init(&pred, fixed_us, exit_us, policy);
+
+	for (i = 0; i < t->nr; i++) {
+		struct event *ev = &t->ev[i];
+
+		if (ev->delta > 0 && outstanding++ == 0) {
+			if (timeout) {
+				gap_us = (ev->ns - idle_start) / 1000;
+				res->idle_active_us += gap_us < timeout ?
+						       gap_us : timeout;
+				if (gap_us > timeout)
+					res->exits++;
+			}
+			ufs_idle_pred_busy(&pred, ev->ns);
+		} else if (ev->delta < 0 && --outstanding == 0) {
+			ufs_idle_pred_idle(&pred, ev->ns);
+			idle_start = ev->ns;
+			timeout = ufs_idle_pred_timeout_us(&pred);
+			if (timeout < res->min_timeout_us)
+				res->min_timeout_us = timeout;
+			if (timeout > res->max_timeout_us)
+				res->max_timeout_us = timeout;
+		}
+	}
+
+	res->gaps = pred.stats.gaps;
+	res->fixed_exits = pred.stats.fixed_exits;
+	if (res->exits != pred.stats.exits) {
+		printf("  %s: replayed %llu exits, predictor counted %llu\n",
+		       ufs_idle_pred_policy_name(policy),
+		       (unsigned long long)res->exits,
+		       (unsigned long long)pred.stats.exits);
+		failures++;
+	}
+}
+
+static void check(int cond, const char *name, const char *what)
+{
+	if (cond)
+		return;
+	printf("  FAIL %s: %s\n", name, what);
+	failures++;
+}
+
+static void run(const char *name, struct trace *t, int synthetic)
+{
+	static const u32 max_mult[UFS_IDLE_POLICY_MAX] = { 1, 1, 2, 4 };
+	struct result res[UFS_IDLE_POLICY_MAX];
+	u32 min_us = fixed_us < UFS_IDLE_MIN_TIMEOUT_US ?
+		     fixed_us : UFS_IDLE_MIN_TIMEOUT_US;
+	int p;
+
+	qsort(t->ev, t->nr, sizeof(*t->ev), event_cmp);
+
+	printf("%s: %zu requests\n", name, t->nr / 2);
+	for (p = 0; p < UFS_IDLE_POLICY_MAX; p++) {
+		replay(t, p, &res[p]);
+		printf("  %-12s gaps %8llu exits %8llu (fixed %8llu) idle active %10llu us timeout %u..%u us\n",
+		       ufs_idle_pred_policy_name(p),
+		       (unsigned long long)res[p].gaps,
+		       (unsigned long long)res[p].exits,
+		       (unsigned long long)res[p].fixed_exits,
+		       (unsigned long long)res[p].idle_active_us,
+		       res[p].min_timeout_us, res[p].max_timeout_us);
+
+		if (!res[p].gaps)
+			continue;
+		check(res[p].min_timeout_us >= min_us, name,
+		      "timeout below the lower bound");
+		check(res[p].max_timeout_us <= fixed_us * max_mult[p], name,
+		      "timeout above the policy bound");
+	}
+
+	if (!synthetic)
+		return;
+
+	check(res[UFS_IDLE_POLICY_FIXED].exits ==
+	      res[UFS_IDLE_POLICY_FIXED].fixed_exits, name,
+	      "fixed policy differs from the fixed timer");
+	check(res[UFS_IDLE_POLICY_POWER].idle_active_us <=
+	      res[UFS_IDLE_POLICY_FIXED].idle_active_us, name,
+	      "power policy keeps the link active longer than fixed");
+	check(res[UFS_IDLE_POLICY_PERFORMANCE].exits <=
+	      res[UFS_IDLE_POLICY_BALANCED].exits, name,
+	      "performance policy exits more often than balanced");
+}
+
+/* requests of @req_us every @period_us, @n times */
+static void gen_periodic(struct trace *t, u64 *now, u64 period_us,
+			 u64 req_us, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++) {
+		trace_add_req(t, *now, *now + req_us * 1000);
+		*now += period_us * 1000;
+	}
+}
+
+static void synthetic(void)
+{
+	struct trace t = { 0 };
+	struct result fixed, res;
+	u32 saved_fixed_us = fixed_us;
+	u64 now = 0;
+
+	/*
+	 * Gaps just above the fixed timer and long against an exit: every
+	 * gap is an exit when fixed, the adaptive policies should rather
+	 * enter hibern8 early than keep the link up until the timer fires.
+	 */
+	gen_periodic(&t, &now, fixed_us * 12 / 10, 200, 2000);
+	run("just-above-fixed", &t, 1);
+	replay(&t, UFS_IDLE_POLICY_FIXED, &fixed);
+	replay(&t, UFS_IDLE_POLICY_BALANCED, &res);
+	check(res.idle_active_us < fixed.idle_active_us / 2,
+	      "just-above-fixed", "balanced policy does not cut idle time");
+	t.nr = 0;
+
+	/*
+	 * Gaps just above a short fixed timer and short against an exit:
+	 * waiting a bit longer is cheaper than the exit for balanced and
+	 * performance.
+	 */
+	fixed_us = 1000;
+	now = 0;
+	gen_periodic(&t, &now, 1200, 100, 2000);
+	run("exit-bound", &t, 1);
+	replay(&t, UFS_IDLE_POLICY_FIXED, &fixed);
+	replay(&t, UFS_IDLE_POLICY_BALANCED, &res);
+	check(res.exits < fixed.exits / 2, "exit-bound",
+	      "balanced policy does not avoid the exits");
+	fixed_us = saved_fixed_us;
+	t.nr = 0;
+
+	/* gaps well below the fixed timer */
+	now = 0;
+	gen_periodic(&t, &now, 2000, 100, 4000);
+	run("short-gaps", &t, 1);
+	replay(&t, UFS_IDLE_POLICY_BALANCED, &res);
+	check(!res.exits, "short-gaps",
+	      "balanced policy exits on gaps below the fixed timer");
+	t.nr = 0;
+
+	/* long idle periods between bursts */
+	now = 0;
+	while (now < 60ULL * NSEC_PER_SEC) {
+		gen_periodic(&t, &now, 300, 150, 50);
+		now += 500ULL * NSEC_PER_MSEC;
+	}
+	run("bursts", &t, 1);
+	t.nr = 0;
+
+	/* phase changes: heavy, light, heavy again */
+	now = 0;
+	gen_periodic(&t, &now, 500, 300, 20000);
+	gen_periodic(&t, &now, fixed_us * 3, 500, 500);
+	gen_periodic(&t, &now, 500, 300, 20000);
+	run("phases", &t, 1);
+
+	free(t.ev);
+}
+
+static int load_trace(const char *path, struct trace *t)
+{
+	unsigned long long issue, complete;
+	char line[128];
+	FILE *f;
+
+	f = fopen(path, "r");
+	if (!f) {
+		perror(path);
+		return -errno;
+	}
+
+	while (fgets(line, sizeof(line), f)) {
+		if (sscanf(line, "%llu %llu", &issue, &complete) != 2)
+			continue;
+		if (complete < issue)
+			continue;
+		trace_add_req(t, issue, complete);
+	}
+	fclose(f);
+
+	return t->nr ? 0 : -EINVAL;
+}
+
+int main(int argc, char **argv)
+{
+	struct trace t = { 0 };
+	int opt;
+
+	while ((opt = getopt(argc, argv, "f:e:")) != -1) {
+		switch (opt) {
+		case 'f':
+			fixed_us = strtoul(optarg, NULL, 0);
+			break;
+		case 'e':
+			exit_us = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-f fixed_us] [-e exit_us] [trace]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	if (!fixed_us) {
+		fprintf(stderr, "fixed_us must not be 0\n");
+		return 1;
+	}
+
+	if (optind < argc) {
+		if (load_trace(argv[optind], &t))
+			return 1;
+		run(argv[optind], &t, 0);
+		free(t.ev);
+	} else {
+		synthetic();
+	}
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,57 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_UNALIGNED_H
+#define _UFSHPB_TEST_UNALIGNED_H
+
+#include <string.h>
+#include <linux/types.h>
+
+static inline u16 get_unaligned_be16(const void *p)
+{
+	const u8 *b = p;
+
+	return b[0] << 8 | b[1];
+}
+
+static inline u32 get_unaligned_be32(const void *p)
+{
+	return (u32)get_unaligned_be16(p) << 16 |
+	       get_unaligned_be16((const u8 *)p + 2);
+}
+
+static inline u64 get_unaligned_be64(const void *p)
+{
+	return (u64)get_unaligned_be32(p) << 32 |
+	       get_unaligned_be32((const u8 *)p + 4);
+}
+
+static inline void put_unaligned_be16(u16 val, void *p)
+{
+	u8 *b = p;
+
+	b[0] = val >> 8;
+	b[1] = val;
+}
+
+static inline void put_unaligned_be32(u32 val, void *p)
+{
+	put_unaligned_be16(val >> 16, p);
+	put_unaligned_be16(val, (u8 *)p + 2);
+}
+
+static inline void put_unaligned_be64(u64 val, void *p)
+{
+	put_unaligned_be32(val >> 32, p);
+	put_unaligned_be32(val, (u8 *)p + 4);
+}
+
+#define get_unaligned(ptr) ({					\
+	__typeof__(*(ptr)) __v;					\
+	memcpy(&__v, (ptr), sizeof(__v));			\
+	__v; })
+
+#define put_unaligned(val, ptr) do {				\
+	__typeof__(*(ptr)) __v = (val);				\
+	memcpy((ptr), &__v, sizeof(__v));			\
+} while (0)
+
+#endif /* _UFSHPB_TEST_UNALIGNED_H */
@@ -0,0 +1,42 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_BIO_H
+#define _UFSHPB_TEST_BIO_H
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+
+#define REQ_OP_BITS	8
+#define REQ_OP_MASK	((1 << REQ_OP_BITS) - 1)
+
+enum req_opf {
+	REQ_OP_READ		= 0,
+	REQ_OP_WRITE		= 1,
+	REQ_OP_DISCARD		= 3,
+	REQ_OP_SCSI_IN		= 32,
+	REQ_OP_SCSI_OUT		= 33,
+};
+
+struct bio;
+typedef void (bio_end_io_t)(struct bio *bio);
+
+struct bio_page {
+	struct page *page;
+	unsigned int len;
+};
+
+struct bio {
+	unsigned int bi_opf;
+	bio_end_io_t *bi_end_io;
+	unsigned short bi_vcnt;
+	unsigned short bi_max_vecs;
+	struct bio_page bi_io_vec[];
+};
+
+struct request_queue;
+
+struct bio *bio_kmalloc(gfp_t gfp_mask, unsigned int nr_iovecs);
+void bio_put(struct bio *bio);
+int bio_add_pc_page(struct request_queue *q, struct bio *bio,
+		    struct page *page, unsigned int len, unsigned int offset);
+
+#endif /* _UFSHPB_TEST_BIO_H */
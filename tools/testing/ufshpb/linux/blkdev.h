@@ -0,0 +1,53 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_BLKDEV_H
+#define _UFSHPB_TEST_BLKDEV_H
+
+#include <linux/bio.h>
+#include <linux/kernel.h>
+
+typedef u64 sector_t;
+
+#define RQF_QUIET	(1 << 11)
+
+struct request_queue {
+	int dummy;
+};
+
+struct gendisk;
+
+/* followed by the scsi_request, see scsi_req() */
+struct request {
+	struct request_queue *q;
+	unsigned int cmd_flags;
+	unsigned int rq_flags;
+	sector_t __sector;
+	unsigned int __data_len;
+	unsigned int timeout;
+	struct bio *bio;
+};
+
+#define req_op(req)	((req)->cmd_flags & REQ_OP_MASK)
+
+static inline bool blk_rq_is_passthrough(struct request *rq)
+{
+	return req_op(rq) == REQ_OP_SCSI_IN || req_op(rq) == REQ_OP_SCSI_OUT;
+}
+
+static inline sector_t blk_rq_pos(const struct request *rq)
+{
+	return rq->__sector;
+}
+
+static inline unsigned int blk_rq_bytes(const struct request *rq)
+{
+	return rq->__data_len;
+}
+
+struct request *blk_get_request(struct request_queue *q, unsigned int op,
+				gfp_t gfp_mask);
+void blk_put_request(struct request *req);
+int blk_rq_append_bio(struct request *rq, struct bio **bio);
+void blk_execute_rq(struct request_queue *q, struct gendisk *bd_disk,
+		    struct request *rq, int at_head);
+
+#endif /* _UFSHPB_TEST_BLKDEV_H */
@@ -0,0 +1,56 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_DEVICE_H
+#define _UFSHPB_TEST_DEVICE_H
+
+#include <sys/types.h>
+#include <linux/kernel.h>
+#include <linux/sysfs.h>
+
+struct device {
+	struct kobject kobj;
+	int refcount;
+};
+
+struct device_attribute {
+	struct attribute attr;
+	ssize_t (*show)(struct device *dev, struct device_attribute *attr,
+			char *buf);
+	ssize_t (*store)(struct device *dev, struct device_attribute *attr,
+			 const char *buf, size_t count);
+};
+
+#define DEVICE_ATTR_RW(_name)						\
+	struct device_attribute dev_attr_##_name = {			\
+		.attr	= { .name = #_name, .mode = 0644 },		\
+		.show	= _name##_show,					\
+		.store	= _name##_store,				\
+	}
+
+static inline struct device *get_device(struct device *dev)
+{
+	dev->refcount++;
+	return dev;
+}
+
+static inline void put_device(struct device *dev)
+{
+	dev->refcount--;
+}
+
+/* printed with -v */
+extern int verbose;
+
+#define dev_info(dev, fmt, ...)						\
+	do {								\
+		(void)(dev);						\
+		if (verbose)						\
+			printf(fmt, ##__VA_ARGS__);			\
+	} while (0)
+
+#define dev_err(dev, fmt, ...)						\
+	do {								\
+		(void)(dev);						\
+		fprintf(stderr, fmt, ##__VA_ARGS__);			\
+	} while (0)
+
+#endif /* _UFSHPB_TEST_DEVICE_H */
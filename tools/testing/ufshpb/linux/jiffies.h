@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_JIFFIES_H
+#define _UFSHPB_TEST_JIFFIES_H
+
+#include <linux/kernel.h>
+
+#define HZ		100
+
+/* advanced by the test */
+extern unsigned long jiffies;
+
+#define time_after(a, b)	((long)((b) - (a)) < 0)
+
+static inline unsigned long msecs_to_jiffies(unsigned int m)
+{
+	return DIV_ROUND_UP(m * HZ, 1000);
+}
+
+#endif /* _UFSHPB_TEST_JIFFIES_H */
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_KERNEL_H
+#define _UFSHPB_TEST_KERNEL_H
+
+#include "../../../include/linux/kernel.h"
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <linux/compiler.h>
+#include <linux/err.h>
+#include <linux/types.h>
+
+#define U32_MAX		((u32)~0U)
+
+#define NSEC_PER_USEC	1000ULL
+
+#define min_t(type, x, y) ({			\
+	type __min1 = (x);			\
+	type __min2 = (y);			\
+	__min1 < __min2 ? __min1 : __min2; })
+
+#define max_t(type, x, y) ({			\
+	type __max1 = (x);			\
+	type __max2 = (y);			\
+	__max1 > __max2 ? __max1 : __max2; })
+
+static inline u64 div64_u64(u64 dividend, u64 divisor)
+{
+	return dividend / divisor;
+}
+
+static inline int kstrtou64(const char *s, unsigned int base, u64 *res)
+{
+	char *end;
+
+	errno = 0;
+	*res = strtoull(s, &end, base);
+	if (errno || end == s || (*end && *end != '\n'))
+		return -EINVAL;
+
+	return 0;
+}
+
+static inline int kstrtouint(const char *s, unsigned int base,
+			     unsigned int *res)
+{
+	u64 val;
+
+	if (kstrtou64(s, base, &val) || val > U32_MAX)
+		return -EINVAL;
+	*res = val;
+
+	return 0;
+}
+
+#endif /* _UFSHPB_TEST_KERNEL_H */
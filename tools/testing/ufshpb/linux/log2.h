@@ -0,0 +1,7 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_LOG2_H
+#define _UFSHPB_TEST_LOG2_H
+
+#define ilog2(n)	(63 - __builtin_clzll(n))
+
+#endif /* _UFSHPB_TEST_LOG2_H */
@@ -0,0 +1,17 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_PM_RUNTIME_H
+#define _UFSHPB_TEST_PM_RUNTIME_H
+
+#include <linux/device.h>
+
+static inline int pm_runtime_get_sync(struct device *dev)
+{
+	return 0;
+}
+
+static inline int pm_runtime_put_sync(struct device *dev)
+{
+	return 0;
+}
+
+#endif /* _UFSHPB_TEST_PM_RUNTIME_H */
@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_RCUPDATE_H
+#define _UFSHPB_TEST_RCUPDATE_H
+
+#define rcu_read_lock()		do { } while (0)
+#define rcu_read_unlock()	do { } while (0)
+#define synchronize_rcu()	do { } while (0)
+
+#endif /* _UFSHPB_TEST_RCUPDATE_H */
@@ -0,0 +1,9 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SCHED_CLOCK_H
+#define _UFSHPB_TEST_SCHED_CLOCK_H
+
+#include <linux/types.h>
+
+u64 sched_clock(void);
+
+#endif /* _UFSHPB_TEST_SCHED_CLOCK_H */
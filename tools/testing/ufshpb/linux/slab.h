@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SLAB_H
+#define _UFSHPB_TEST_SLAB_H
+
+#include <linux/kernel.h>
+
+#define PAGE_SHIFT	12
+#define PAGE_SIZE	(1UL << PAGE_SHIFT)
+
+/* counted and failed on demand by the test */
+void *kzalloc(size_t size, gfp_t flags);
+void *kcalloc(size_t n, size_t size, gfp_t flags);
+void kfree(const void *p);
+
+struct page *alloc_page(gfp_t flags);
+void __free_page(struct page *page);
+
+static inline void *page_address(struct page *page)
+{
+	return page;
+}
+
+#endif /* _UFSHPB_TEST_SLAB_H */
@@ -0,0 +1,32 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SPINLOCK_H
+#define _UFSHPB_TEST_SPINLOCK_H
+
+#include <assert.h>
+#include <stdbool.h>
+
+/* single threaded, only checks that the lock is not taken recursively */
+typedef struct {
+	bool locked;
+} spinlock_t;
+
+#define spin_lock_init(l)	((l)->locked = false)
+
+static inline void spin_lock(spinlock_t *l)
+{
+	assert(!l->locked);
+	l->locked = true;
+}
+
+static inline void spin_unlock(spinlock_t *l)
+{
+	assert(l->locked);
+	l->locked = false;
+}
+
+#define spin_lock_irq(l)		spin_lock(l)
+#define spin_unlock_irq(l)		spin_unlock(l)
+#define spin_lock_irqsave(l, f)		do { (f) = 0; spin_lock(l); } while (0)
+#define spin_unlock_irqrestore(l, f)	do { (void)(f); spin_unlock(l); } while (0)
+
+#endif /* _UFSHPB_TEST_SPINLOCK_H */
@@ -0,0 +1,26 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SYSFS_H
+#define _UFSHPB_TEST_SYSFS_H
+
+#include <linux/kernel.h>
+
+struct kobject {
+	int dummy;
+};
+
+struct attribute {
+	const char *name;
+	unsigned short mode;
+};
+
+struct attribute_group {
+	struct attribute **attrs;
+};
+
+/* the test keeps the group to reach the attributes */
+int sysfs_create_group(struct kobject *kobj,
+		       const struct attribute_group *grp);
+void sysfs_remove_group(struct kobject *kobj,
+			const struct attribute_group *grp);
+
+#endif /* _UFSHPB_TEST_SYSFS_H */
@@ -0,0 +1,10 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_VMALLOC_H
+#define _UFSHPB_TEST_VMALLOC_H
+
+#include <linux/slab.h>
+
+#define vzalloc(size)	kzalloc(size, GFP_KERNEL)
+#define vfree(p)	kfree(p)
+
+#endif /* _UFSHPB_TEST_VMALLOC_H */
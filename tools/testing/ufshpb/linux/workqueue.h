@@ -0,0 +1,40 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_WORKQUEUE_H
+#define _UFSHPB_TEST_WORKQUEUE_H
+
+#include <stdbool.h>
+#include <linux/jiffies.h>
+#include <linux/kernel.h>
+
+/* work is only run when the test calls run_work() */
+struct work_struct;
+typedef void (*work_func_t)(struct work_struct *work);
+
+struct work_struct {
+	work_func_t func;
+	bool pending;
+};
+
+struct delayed_work {
+	struct work_struct work;
+	unsigned long delay;
+};
+
+struct workqueue_struct;
+extern struct workqueue_struct *system_unbound_wq;
+
+#define INIT_WORK(w, f)		do { (w)->func = (f); (w)->pending = false; } while (0)
+#define INIT_DELAYED_WORK(w, f)	INIT_WORK(&(w)->work, f)
+
+static inline struct delayed_work *to_delayed_work(struct work_struct *work)
+{
+	return container_of(work, struct delayed_work, work);
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work);
+bool schedule_delayed_work(struct delayed_work *dwork, unsigned long delay);
+bool cancel_work_sync(struct work_struct *work);
+bool cancel_delayed_work_sync(struct delayed_work *dwork);
+struct work_struct *current_work(void);
+
+#endif /* _UFSHPB_TEST_WORKQUEUE_H */
@@ -0,0 +1,1066 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Drive the HPB region manager against a simulated device
+ *
+ * drivers/scsi/ufs/ufshpb.c is built unchanged on top of a stub host and
+ * block layer. The simulated device answers the descriptor queries with
+ * one HPB logical unit and serves HPB READ BUFFER from its own L2P map,
+ * which every write and unmap changes.
+ *
+ * Usage: main [-v] [-n ops] [-s seed]
+ *
+ * The checks cover probe and pinned regions, activation by missed reads,
+ * LRU eviction under the map memory budget and the active region limit,
+ * dirty entries and their reload by hint or heat, device hints, map
+ * allocation and load failures, and release. A random mix of ops then
+ * runs with the bookkeeping checked after every map load. Every HPB READ
+ * issued is checked against the device map, so a stale PPN fails the run,
+ * and kernel allocations must all be freed in the end.
+ */
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <asm/unaligned.h>
+#include <scsi/scsi_request.h>
+#include "ufshcd.h"
+
+/* 16MB regions of four 4MB subregions, two map pages per subregion */
+#define DEV_REGION_SIZE		15	/* 512 << 15 bytes */
+#define DEV_SUBREGION_SIZE	13	/* 512 << 13 bytes */
+#define DEV_REGION_ENTRIES	4096
+#define DEV_SUBREGION_ENTRIES	1024
+#define DEV_SUBREGIONS		4
+#define DEV_REGIONS		16
+/* the last subregion is short */
+#define DEV_LU_BLOCKS		(DEV_REGIONS * DEV_REGION_ENTRIES - 100)
+#define DEV_MAX_ACTIVE		8
+#define DEV_PIN_START		0
+#define DEV_PIN_NUM		1
+#define HPB_LUN			0
+
+#define MAP_BYTES		(2 * PAGE_SIZE)
+/* beyond HPB_HEAT_WINDOW */
+#define HEAT_WINDOW_GAP		(2 * HZ + 1)
+
+int verbose;
+unsigned long jiffies = 1000;
+struct workqueue_struct *system_unbound_wq;
+
+static unsigned long nr_ops = 200000;
+static unsigned int seed = 1;
+static int failures;
+
+static u64 clock_ns;
+static long nr_allocs;		/* outstanding kernel allocations */
+static int fail_alloc;		/* fail the n-th allocation from now */
+static struct work_struct *cur_work;
+static const struct attribute_group *hpb_group;
+
+/* the simulated device */
+static u64 dev_ppn[DEV_LU_BLOCKS];
+static u64 dev_next_ppn;
+static u64 dev_map_reads;
+static int dev_fail_map;
+static void (*dev_load_hook)(void);
+
+static struct device host_dev;
+static struct Scsi_Host *shost;
+static struct ufs_hba *hba;
+static struct request_queue queue;
+static struct scsi_device sdev;
+static struct ufshpb_lu *hpb;
+
+struct cmd_ctx {
+	struct request rq;
+	struct scsi_cmnd cmd;
+	struct utp_upiu_req req;
+	struct utp_upiu_rsp rsp;
+	struct ufshcd_lrb lrb;
+	unsigned char cdb[MAX_CDB_SIZE];
+};
+
+static void check(int cond, const char *name, const char *what)
+{
+	if (cond)
+		return;
+	printf("  FAIL %s: %s\n", name, what);
+	failures++;
+}
+
+/*
+ * Kernel stubs
+ */
+
+u64 sched_clock(void)
+{
+	return clock_ns += 1000;
+}
+
+int scnprintf(char *buf, size_t size, const char *fmt, ...)
+{
+	va_list args;
+	int i;
+
+	va_start(args, fmt);
+	i = vsnprintf(buf, size, fmt, args);
+	va_end(args);
+
+	return i < (int)size ? i : (int)size - 1;
+}
+
+static void *test_alloc(size_t size)
+{
+	void *p;
+
+	if (fail_alloc && !--fail_alloc)
+		return NULL;
+
+	p = calloc(1, size);
+	if (p)
+		nr_allocs++;
+
+	return p;
+}
+
+void *kzalloc(size_t size, gfp_t flags)
+{
+	return test_alloc(size);
+}
+
+void *kcalloc(size_t n, size_t size, gfp_t flags)
+{
+	return test_alloc(n * size);
+}
+
+void kfree(const void *p)
+{
+	if (!p)
+		return;
+	nr_allocs--;
+	free((void *)p);
+}
+
+struct page *alloc_page(gfp_t flags)
+{
+	return test_alloc(PAGE_SIZE);
+}
+
+void __free_page(struct page *page)
+{
+	kfree(page);
+}
+
+bool queue_work(struct workqueue_struct *wq, struct work_struct *work)
+{
+	if (work->pending)
+		return false;
+	work->pending = true;
+
+	return true;
+}
+
+bool schedule_delayed_work(struct delayed_work *dwork, unsigned long delay)
+{
+	dwork->delay = delay;
+
+	return queue_work(NULL, &dwork->work);
+}
+
+bool cancel_work_sync(struct work_struct *work)
+{
+	bool pending = work->pending;
+
+	work->pending = false;
+
+	return pending;
+}
+
+bool cancel_delayed_work_sync(struct delayed_work *dwork)
+{
+	return cancel_work_sync(&dwork->work);
+}
+
+struct work_struct *current_work(void)
+{
+	return cur_work;
+}
+
+static bool run_work(struct work_struct *work)
+{
+	if (!work->pending)
+		return false;
+
+	work->pending = false;
+	cur_work = work;
+	work->func(work);
+	cur_work = NULL;
+
+	return true;
+}
+
+int sysfs_create_group(struct kobject *kobj,
+		       const struct attribute_group *grp)
+{
+	hpb_group = grp;
+
+	return 0;
+}
+
+void sysfs_remove_group(struct kobject *kobj,
+			const struct attribute_group *grp)
+{
+	hpb_group = NULL;
+}
+
+struct bio *bio_kmalloc(gfp_t gfp_mask, unsigned int nr_iovecs)
+{
+	struct bio *bio;
+
+	bio = test_alloc(sizeof(*bio) + nr_iovecs * sizeof(struct bio_page));
+	if (bio)
+		bio->bi_max_vecs = nr_iovecs;
+
+	return bio;
+}
+
+void bio_put(struct bio *bio)
+{
+	kfree(bio);
+}
+
+int bio_add_pc_page(struct request_queue *q, struct bio *bio,
+		    struct page *page, unsigned int len, unsigned int offset)
+{
+	if (bio->bi_vcnt == bio->bi_max_vecs || len > PAGE_SIZE)
+		return 0;
+
+	bio->bi_io_vec[bio->bi_vcnt].page = page;
+	bio->bi_io_vec[bio->bi_vcnt].len = len;
+	bio->bi_vcnt++;
+
+	return len;
+}
+
+struct request *blk_get_request(struct request_queue *q, unsigned int op,
+				gfp_t gfp_mask)
+{
+	struct request *rq;
+
+	rq = test_alloc(sizeof(*rq) + sizeof(struct scsi_request));
+	if (!rq)
+		return ERR_PTR(-ENOMEM);
+	rq->q = q;
+	rq->cmd_flags = op;
+
+	return rq;
+}
+
+void blk_put_request(struct request *req)
+{
+	kfree(req);
+}
+
+int blk_rq_append_bio(struct request *rq, struct bio **bio)
+{
+	rq->bio = *bio;
+
+	return 0;
+}
+
+/* HPB READ BUFFER: copy the device map of one subregion */
+void blk_execute_rq(struct request_queue *q, struct gendisk *bd_disk,
+		    struct request *rq, int at_head)
+{
+	struct scsi_request *sreq = scsi_req(rq);
+	unsigned char *cdb = sreq->cmd;
+	struct bio *bio = rq->bio;
+	void (*hook)(void) = dev_load_hook;
+	u32 rgn, srgn, len, n = 0, i, j;
+	u64 lpn, *ppn;
+
+	rgn = get_unaligned_be16(&cdb[2]);
+	srgn = get_unaligned_be16(&cdb[4]);
+	len = cdb[6] << 16 | get_unaligned_be16(&cdb[7]);
+	lpn = (u64)rgn * DEV_REGION_ENTRIES + srgn * DEV_SUBREGION_ENTRIES;
+
+	if (cdb[0] != UFSHPB_READ_BUFFER || cdb[1] != UFSHPB_READ_BUFFER_ID ||
+	    req_op(rq) != REQ_OP_SCSI_IN || rgn >= DEV_REGIONS ||
+	    srgn >= DEV_SUBREGIONS || lpn >= DEV_LU_BLOCKS ||
+	    len != min_t(u64, DEV_SUBREGION_ENTRIES,
+			 DEV_LU_BLOCKS - lpn) * HPB_ENTRY_SIZE) {
+		check(0, "device", "bad HPB READ BUFFER");
+		sreq->result = -1;
+		goto out;
+	}
+
+	dev_map_reads++;
+	if (dev_fail_map) {
+		dev_fail_map--;
+		sreq->result = -1;
+		goto out;
+	}
+
+	for (i = 0; i < bio->bi_vcnt; i++) {
+		ppn = page_address(bio->bi_io_vec[i].page);
+		for (j = 0; j < bio->bi_io_vec[i].len / HPB_ENTRY_SIZE; j++)
+			ppn[j] = dev_ppn[lpn + n++];
+	}
+	check(n * HPB_ENTRY_SIZE == len, "device", "short map transfer");
+	sreq->result = 0;
+
+	/* a command completing while the map is in flight */
+	if (hook) {
+		dev_load_hook = NULL;
+		hook();
+	}
+out:
+	if (bio)
+		bio->bi_end_io(bio);
+}
+
+int scsi_execute(struct scsi_device *sdev, const unsigned char *cmd,
+		 int data_direction, void *buffer, unsigned int bufflen,
+		 unsigned char *sense, struct scsi_sense_hdr *sshdr,
+		 int timeout, int retries, u64 flags, unsigned int rq_flags,
+		 int *resid)
+{
+	if (cmd[0] != READ_BUFFER || cmd[2] != UFSHPB_DEV_CTX_BUFFER_ID ||
+	    (cmd[6] << 16 | get_unaligned_be16(&cmd[7])) != bufflen)
+		return -1;
+	memset(buffer, 0xa5, bufflen);
+
+	return 0;
+}
+
+int ufshcd_query_descriptor_retry(struct ufs_hba *hba,
+	enum query_opcode opcode, enum desc_idn idn, u8 index,
+	u8 selector, u8 *desc_buf, int *buf_len)
+{
+	memset(desc_buf, 0, *buf_len);
+	desc_buf[QUERY_DESC_DESC_TYPE_OFFSET] = idn;
+
+	switch (idn) {
+	case QUERY_DESC_IDN_DEVICE:
+		desc_buf[DEVICE_DESC_PARAM_FEAT_SUP] =
+			UFS_FEATURE_SUPPORT_HPB_BIT;
+		put_unaligned_be16(0x0100,
+				   &desc_buf[DEVICE_DESC_PARAM_HPB_VER]);
+		break;
+	case QUERY_DESC_IDN_GEOMETRY:
+		desc_buf[GEOMETRY_DESC_HPB_REGION_SIZE] = DEV_REGION_SIZE;
+		desc_buf[GEOMETRY_DESC_HPB_SUBREGION_SIZE] = DEV_SUBREGION_SIZE;
+		desc_buf[GEOMETRY_DESC_HPB_NUMBER_LU] = 1;
+		put_unaligned_be16(DEV_MAX_ACTIVE, &desc_buf[
+			GEOMETRY_DESC_HPB_DEVICE_MAX_ACTIVE_REGIONS]);
+		break;
+	case QUERY_DESC_IDN_UNIT:
+		if (index != HPB_LUN) {
+			desc_buf[UNIT_DESC_PARAM_LU_ENABLE] = 1;
+			break;
+		}
+		desc_buf[UNIT_DESC_PARAM_LU_ENABLE] = LU_HPB_ENABLE;
+		desc_buf[UNIT_DESC_PARAM_LOGICAL_BLK_SIZE] = HPB_BLOCK_SHIFT;
+		put_unaligned_be64(DEV_LU_BLOCKS,
+			&desc_buf[UNIT_DESC_PARAM_LOGICAL_BLK_COUNT]);
+		put_unaligned_be16(DEV_PIN_START,
+			&desc_buf[UNIT_DESC_HPB_LU_PIN_REGION_START_OFFSET]);
+		put_unaligned_be16(DEV_PIN_NUM,
+			&desc_buf[UNIT_DESC_HPB_LU_NUM_PIN_REGIONS]);
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Host side
+ */
+
+static struct device_attribute *find_attr(const char *name)
+{
+	struct attribute **attr;
+
+	if (!hpb_group)
+		return NULL;
+
+	for (attr = hpb_group->attrs; *attr; attr++)
+		if (!strcmp((*attr)->name, name))
+			return container_of(*attr, struct device_attribute,
+					    attr);
+
+	return NULL;
+}
+
+static ssize_t attr_store(const char *name, const char *val)
+{
+	struct device_attribute *dattr = find_attr(name);
+
+	if (!dattr)
+		return -ENOENT;
+
+	return dattr->store(&sdev.sdev_gendev, dattr, val, strlen(val));
+}
+
+static ssize_t attr_store_u64(const char *name, u64 val)
+{
+	char buf[32];
+
+	snprintf(buf, sizeof(buf), "%llu\n", (unsigned long long)val);
+
+	return attr_store(name, buf);
+}
+
+static void cmd_init(struct cmd_ctx *c, unsigned int op, u8 opcode)
+{
+	memset(c, 0, sizeof(*c));
+	c->rq.cmd_flags = op;
+	c->cmd.device = &sdev;
+	c->cmd.request = &c->rq;
+	c->cmd.cmnd = c->cdb;
+	c->cmd.cmd_len = 10;
+	c->cdb[0] = opcode;
+	c->lrb.cmd = &c->cmd;
+	c->lrb.lun = HPB_LUN;
+	c->lrb.ucd_req_ptr = &c->req;
+	c->lrb.ucd_rsp_ptr = &c->rsp;
+}
+
+/* what ufshcd does around queuecommand and completion */
+static void cmd_prep(struct cmd_ctx *c)
+{
+	memcpy(c->req.sc.cdb, c->cdb, MAX_CDB_SIZE);
+	ufshpb_prep_fn(hba, &c->lrb);
+	c->lrb.issue_time_stamp = sched_clock();
+}
+
+static void cmd_complete(struct cmd_ctx *c)
+{
+	ufshpb_rsp_upiu(hba, &c->lrb);
+}
+
+/* a read of @lpn; returns true if it went out as an HPB READ */
+static bool read_blocks(u64 lpn, u16 cnt)
+{
+	struct cmd_ctx c;
+	bool hpb_read;
+	u64 ppn;
+
+	cmd_init(&c, REQ_OP_READ, READ_10);
+	put_unaligned_be32(lpn, &c.cdb[2]);
+	put_unaligned_be16(cnt, &c.cdb[7]);
+	c.rq.__sector = lpn << 3;
+	c.rq.__data_len = cnt << HPB_BLOCK_SHIFT;
+	cmd_prep(&c);
+
+	hpb_read = c.cdb[0] == READ_16;
+	check(hpb_read == c.lrb.hpb_read, "read", "hpb_read flag");
+	if (hpb_read) {
+		ppn = get_unaligned((u64 *)&c.cdb[6]);
+		check(cnt == 1, "read", "HPB READ of more than one block");
+		check(get_unaligned_be32(&c.cdb[2]) == lpn && c.cdb[15] == 1,
+		      "read", "HPB READ LBA or length");
+		check(!memcmp(c.req.sc.cdb, c.cdb, MAX_CDB_SIZE), "read",
+		      "UPIU CDB not updated");
+		check(c.cmd.cmd_len == MAX_CDB_SIZE, "read", "HPB READ length");
+		if (lpn < DEV_LU_BLOCKS && ppn != dev_ppn[lpn]) {
+			printf("  lpn %llu: PPN %llx, device %llx\n",
+			       (unsigned long long)lpn,
+			       (unsigned long long)ppn,
+			       (unsigned long long)dev_ppn[lpn]);
+			check(0, "read", "stale PPN");
+		}
+	}
+	cmd_complete(&c);
+
+	return hpb_read;
+}
+
+static bool read_block(u64 lpn)
+{
+	return read_blocks(lpn, 1);
+}
+
+static void dev_remap(u64 lpn, u64 cnt)
+{
+	for (; cnt && lpn < DEV_LU_BLOCKS; lpn++, cnt--)
+		dev_ppn[lpn] = ++dev_next_ppn;
+}
+
+static void write_blocks(u64 lpn, u16 cnt)
+{
+	struct cmd_ctx c;
+
+	cmd_init(&c, REQ_OP_WRITE, WRITE_10);
+	put_unaligned_be32(lpn, &c.cdb[2]);
+	put_unaligned_be16(cnt, &c.cdb[7]);
+	cmd_prep(&c);
+	dev_remap(lpn, cnt);
+	cmd_complete(&c);
+}
+
+static void write16_blocks(u64 lpn, u32 cnt)
+{
+	struct cmd_ctx c;
+
+	cmd_init(&c, REQ_OP_WRITE, WRITE_16);
+	c.cmd.cmd_len = 16;
+	put_unaligned_be64(lpn, &c.cdb[2]);
+	put_unaligned_be32(cnt, &c.cdb[10]);
+	cmd_prep(&c);
+	dev_remap(lpn, cnt);
+	cmd_complete(&c);
+}
+
+static void unmap_blocks(u64 lpn, u32 cnt)
+{
+	struct cmd_ctx c;
+
+	cmd_init(&c, REQ_OP_DISCARD, UNMAP);
+	c.rq.__sector = lpn << 3;
+	c.rq.__data_len = cnt << HPB_BLOCK_SHIFT;
+	cmd_prep(&c);
+	dev_remap(lpn, cnt);
+	cmd_complete(&c);
+}
+
+/* a completion carrying an HPB response; -1 leaves a field out */
+static void hint(int act_rgn, int act_srgn, int inact_rgn)
+{
+	struct cmd_ctx c;
+	u8 *f;
+
+	cmd_init(&c, REQ_OP_READ, READ_10);
+	put_unaligned_be16(8, &c.cdb[7]);
+	cmd_prep(&c);
+
+	c.rsp.header.dword_2 = cpu_to_be32(HPB_RSP_DATA_SEG_LEN);
+	f = (u8 *)&c.rsp.sr.sense_data_len;
+	put_unaligned_be16(HPB_RSP_SENSE_SEG_LEN, &f[0]);
+	f[2] = HPB_RSP_DESC_TYPE;
+	f[3] = HPB_RSP_ADDITIONAL_LEN;
+	f[4] = HPB_RSP_REQ_REGION_UPDATE;
+	if (act_rgn >= 0) {
+		f[6] = 1;
+		put_unaligned_be16(act_rgn, &f[8]);
+		put_unaligned_be16(act_srgn, &f[10]);
+	}
+	if (inact_rgn >= 0) {
+		f[7] = 1;
+		put_unaligned_be16(inact_rgn, &f[16]);
+	}
+	cmd_complete(&c);
+}
+
+static u64 lpn_of(u32 rgn, u32 srgn, u32 offset)
+{
+	return (u64)rgn * DEV_REGION_ENTRIES + srgn * DEV_SUBREGION_ENTRIES +
+	       offset;
+}
+
+static struct ufshpb_subregion *srgn_of(u32 rgn, u32 srgn)
+{
+	return &hpb->region_tbl[rgn].subregion_tbl[srgn];
+}
+
+static bool loaded(u32 rgn, u32 srgn)
+{
+	return srgn_of(rgn, srgn)->state == HPB_SUBREGION_CLEAN;
+}
+
+static bool run_map_work(void)
+{
+	return run_work(&hpb->map_work);
+}
+
+/* heat a subregion up with missed reads and load its map */
+static bool activate(u32 rgn, u32 srgn)
+{
+	u32 i;
+
+	for (i = 0; i < hpb->act_threshold; i++)
+		read_block(lpn_of(rgn, srgn, i * 7));
+	run_map_work();
+
+	return loaded(rgn, srgn);
+}
+
+static u32 max_loaded(void)
+{
+	return max_t(u64, hpb->map_mem_budget / MAP_BYTES, 1);
+}
+
+/* the counters agree with the tables and the limits hold */
+static void check_lu(const char *name)
+{
+	u32 rgns = 0, srgns = 0, pinned = 0, on_lru = 0, n, i, j;
+	struct ufshpb_subregion *srgn;
+	struct ufshpb_region *rgn;
+	bool ok = true;
+
+	list_for_each_entry(rgn, &hpb->lru, list_lru)
+		on_lru++;
+
+	for (i = 0; i < hpb->regions_per_lu; i++) {
+		rgn = &hpb->region_tbl[i];
+		n = 0;
+		for (j = 0; j < hpb->subregions_per_region; j++) {
+			srgn = &rgn->subregion_tbl[j];
+			if (srgn->state == HPB_SUBREGION_LOADING ||
+			    !!srgn->mctx != (srgn->state == HPB_SUBREGION_CLEAN))
+				ok = false;
+			n += !!srgn->mctx;
+		}
+		if (n != rgn->loaded || (n && list_empty(&rgn->list_lru)) ||
+		    (!n && !list_empty(&rgn->list_lru)))
+			ok = false;
+		if (rgn->pinned)
+			pinned += n;
+		rgns += !!n;
+		srgns += n;
+	}
+
+	check(ok, name, "subregion state and region counts disagree");
+	check(!hpb->hpb_lock.locked, name, "hpb_lock left held");
+	check(srgns == hpb->loaded_subregions, name, "loaded_subregions");
+	check(rgns == hpb->active_regions && on_lru == rgns, name,
+	      "active_regions");
+	check(srgns <= max_t(u32, max_loaded(), pinned), name,
+	      "over the map memory budget");
+	check(!hpb->max_active_regions ||
+	      rgns <= max_t(u32, hpb->max_active_regions, DEV_PIN_NUM), name,
+	      "over the active region limit");
+}
+
+/* drop every map and load the pinned ones again, as after a link reset */
+static void reset_lu(void)
+{
+	hba->ufshpb_state = HPB_RESET;
+	schedule_delayed_work(&hba->ufshpb_init_work, 0);
+	run_work(&hba->ufshpb_init_work.work);
+	run_map_work();
+	memset(&hpb->stats, 0, sizeof(hpb->stats));
+}
+
+/*
+ * Tests
+ */
+
+static void test_probe(void)
+{
+	unsigned char buf[64];
+	u32 j;
+
+	printf("probe\n");
+
+	/* the SCSI device is not there yet: retried later */
+	hba->ufshpb_state = HPB_NEED_INIT;
+	schedule_delayed_work(&hba->ufshpb_init_work, 0);
+	run_work(&hba->ufshpb_init_work.work);
+	check(hba->ufshpb_state == HPB_NEED_INIT &&
+	      hba->ufshpb_init_work.work.pending && !hba->ufshpb_lup[HPB_LUN],
+	      "probe", "no retry before the SCSI device shows up");
+
+	hba->sdev_ufs_lu[HPB_LUN] = &sdev;
+	run_work(&hba->ufshpb_init_work.work);
+	hpb = hba->ufshpb_lup[HPB_LUN];
+	check(hba->ufshpb_state == HPB_PRESENT && hpb, "probe", "no HPB LU");
+	if (!hpb)
+		exit(1);
+
+	check(hpb->regions_per_lu == DEV_REGIONS &&
+	      hpb->subregions_per_region == DEV_SUBREGIONS &&
+	      hpb->entries_per_subregion == DEV_SUBREGION_ENTRIES &&
+	      hpb->lu_blocks == DEV_LU_BLOCKS &&
+	      hpb->max_active_regions == DEV_MAX_ACTIVE, "probe", "geometry");
+	check(hpb_group && sdev.sdev_gendev.refcount == 1, "probe",
+	      "sysfs or device reference");
+
+	/* pinned regions are loaded right away */
+	check(run_map_work(), "probe", "pinned maps not queued");
+	for (j = 0; j < DEV_SUBREGIONS; j++)
+		check(loaded(DEV_PIN_START, j), "probe", "pinned map not loaded");
+	check(dev_map_reads == DEV_SUBREGIONS, "probe", "map reads");
+	check(read_block(lpn_of(DEV_PIN_START, 3, 1)), "probe",
+	      "pinned read not HPB");
+	check_lu("probe");
+
+	check(ufshpb_issue_req_dev_ctx(hpb, buf, sizeof(buf)) == 0 &&
+	      buf[0] == 0xa5, "probe", "device context read");
+	check(ufshpb_issue_req_dev_ctx(hpb, buf, 0) == -EINVAL &&
+	      ufshpb_issue_req_dev_ctx(hpb, buf, PAGE_SIZE + 1) == -EINVAL &&
+	      ufshpb_issue_req_dev_ctx(NULL, buf, 1) == -ENODEV, "probe",
+	      "device context arguments");
+}
+
+static void test_activation(void)
+{
+	u64 lpn = lpn_of(5, 1, 10);
+	struct cmd_ctx c;
+	u32 i;
+
+	printf("activation\n");
+	reset_lu();
+
+	for (i = 0; i + 1 < hpb->act_threshold; i++)
+		check(!read_block(lpn_of(5, 1, i)), "activation", "cold hit");
+	check(!hpb->map_work.pending, "activation", "loaded below threshold");
+	read_block(lpn_of(5, 1, i));
+	check(run_map_work() && loaded(5, 1), "activation",
+	      "not loaded at threshold");
+	check(read_block(lpn), "activation", "read after load not HPB");
+	check(!read_blocks(lpn, 8), "activation", "multi block read is HPB");
+	check(!read_block(lpn_of(5, 2, 10)), "activation",
+	      "neighbour subregion hit");
+	check(hpb->stats.hit == 1 && hpb->stats.map_req == 1, "activation",
+	      "stats");
+
+	/* misses spread out over more than the heat window stay cold */
+	for (i = 0; i < 2 * hpb->act_threshold; i++) {
+		jiffies += HEAT_WINDOW_GAP;
+		read_block(lpn_of(6, 0, i));
+	}
+	check(!hpb->map_work.pending && !loaded(6, 0), "activation",
+	      "loaded by cold misses");
+
+	check(attr_store("hpb_act_threshold", "0") == -EINVAL, "activation",
+	      "threshold 0 accepted");
+	check(attr_store("hpb_act_threshold", "1") > 0, "activation",
+	      "threshold not set");
+	read_block(lpn_of(6, 0, 0));
+	check(run_map_work() && loaded(6, 0), "activation",
+	      "threshold 1 did not load");
+	check(attr_store("hpb_act_threshold", "4") > 0, "activation",
+	      "threshold not restored");
+
+	/* a requeued HPB READ gets its READ_10 back */
+	cmd_init(&c, REQ_OP_READ, READ_10);
+	put_unaligned_be32(lpn, &c.cdb[2]);
+	put_unaligned_be16(1, &c.cdb[7]);
+	cmd_prep(&c);
+	check(c.cdb[0] == READ_16, "activation", "no HPB READ to restore");
+	ufshpb_restore_cdb(&c.lrb);
+	check(c.cdb[0] == READ_10 && get_unaligned_be32(&c.cdb[2]) == lpn &&
+	      get_unaligned_be16(&c.cdb[7]) == 1 && c.cmd.cmd_len == 10 &&
+	      !c.lrb.hpb_read, "activation", "CDB not restored");
+
+	check_lu("activation");
+}
+
+static void test_lru(void)
+{
+	long allocs;
+
+	printf("lru\n");
+	reset_lu();
+
+	/* the pinned region takes four of eight maps */
+	check(attr_store_u64("hpb_map_mem_budget", 8 * MAP_BYTES) > 0, "lru",
+	      "budget not set");
+	check(activate(3, 0) && activate(4, 0) && activate(5, 0) &&
+	      activate(6, 0), "lru", "activation within the budget");
+	check(hpb->loaded_subregions == 8 && !hpb->stats.evict, "lru",
+	      "evicted within the budget");
+
+	/* hitting region 3 leaves region 4 least recently used */
+	check(read_block(lpn_of(3, 0, 1)), "lru", "hit in region 3");
+	check(activate(7, 0), "lru", "activation over the budget");
+	check(!loaded(4, 0) && loaded(3, 0) && loaded(5, 0) && loaded(6, 0),
+	      "lru", "victim is not the least recently used region");
+	check(hpb->stats.evict == 1 && hpb->loaded_subregions == 8, "lru",
+	      "evictions over the budget");
+	check(!read_block(lpn_of(4, 0, 1)), "lru", "hit in an evicted region");
+
+	/* a second subregion of a loaded region still needs room */
+	check(activate(7, 1) && !loaded(5, 0) && loaded(6, 0), "lru",
+	      "room for a second subregion");
+	check_lu("lru");
+
+	/* shrinking drops everything but the pinned region */
+	check(attr_store_u64("hpb_map_mem_budget", MAP_BYTES - 1) == -EINVAL,
+	      "lru", "budget below one map accepted");
+	check(attr_store_u64("hpb_map_mem_budget", 4 * MAP_BYTES) > 0, "lru",
+	      "budget not lowered");
+	check(hpb->loaded_subregions == DEV_SUBREGIONS &&
+	      hpb->active_regions == 1 && loaded(DEV_PIN_START, 0), "lru",
+	      "shrink");
+	check_lu("lru shrink");
+
+	/* pinned maps alone exceed the budget: nothing else is loaded */
+	check(attr_store_u64("hpb_map_mem_budget", 2 * MAP_BYTES) > 0, "lru",
+	      "budget not lowered");
+	allocs = nr_allocs;
+	check(!activate(3, 0) && nr_allocs == allocs, "lru",
+	      "loaded without room or leaked the map");
+	check(hpb->loaded_subregions == DEV_SUBREGIONS, "lru",
+	      "pinned map evicted");
+	check_lu("lru pinned");
+
+	/* the device limit of active regions */
+	check(attr_store_u64("hpb_map_mem_budget", 16 << 20) > 0, "lru",
+	      "budget not restored");
+	hpb->max_active_regions = 3;
+	check(activate(3, 0) && activate(4, 0), "lru", "active regions");
+	check(activate(5, 0) && !loaded(3, 0) && loaded(4, 0), "lru",
+	      "active region limit");
+	check(activate(5, 1) && loaded(4, 0) && hpb->active_regions == 3,
+	      "lru", "evicted for a loaded region");
+	check_lu("lru active");
+	hpb->max_active_regions = DEV_MAX_ACTIVE;
+}
+
+static void write_during_load(void)
+{
+	write_blocks(lpn_of(2, 0, 300), 1);
+}
+
+static void hint_during_load(void)
+{
+	hint(2, 0, -1);
+}
+
+static void test_dirty(void)
+{
+	u64 lpn = lpn_of(2, 0, 100), reads;
+	u32 i;
+
+	printf("dirty\n");
+	reset_lu();
+
+	check(activate(2, 0) && read_block(lpn), "dirty", "not loaded");
+
+	write_blocks(lpn, 4);
+	check(!read_block(lpn) && !read_block(lpn + 3), "dirty",
+	      "written block served from the map");
+	check(read_block(lpn + 4) && read_block(lpn - 1), "dirty",
+	      "unwritten block missed");
+
+	write16_blocks(lpn + 50, 1);
+	check(!read_block(lpn + 50) && read_block(lpn + 51), "dirty",
+	      "WRITE_16");
+	unmap_blocks(lpn + 200, 8);
+	check(!read_block(lpn + 200) && !read_block(lpn + 207) &&
+	      read_block(lpn + 208), "dirty", "UNMAP");
+
+	/* a write across subregions only touches what it covers */
+	write_blocks(lpn_of(2, 0, DEV_SUBREGION_ENTRIES - 4), 8);
+	check(!read_block(lpn_of(2, 0, DEV_SUBREGION_ENTRIES - 1)) &&
+	      read_block(lpn_of(2, 0, DEV_SUBREGION_ENTRIES - 5)) &&
+	      !loaded(2, 1), "dirty", "write across subregions");
+	check(hpb->stats.dirty == 4, "dirty", "dirty count");
+
+	/* the device asks for a reload: everything hits again */
+	reads = dev_map_reads;
+	hint(2, 0, -1);
+	check(run_map_work() && dev_map_reads == reads + 1, "dirty",
+	      "hint did not reload");
+	check(read_block(lpn) && read_block(lpn + 50) &&
+	      read_block(lpn + 200), "dirty", "miss after reload");
+
+	/* dirty misses heat the subregion up for a reload as well */
+	write_blocks(lpn, 1);
+	for (i = 0; i < hpb->act_threshold; i++)
+		check(!read_block(lpn), "dirty", "dirty hit");
+	check(run_map_work() && read_block(lpn), "dirty",
+	      "dirty misses did not reload");
+
+	/* a write while the map is loading must not be served from it */
+	dev_load_hook = write_during_load;
+	hint(2, 0, -1);
+	run_map_work();
+	check(!read_block(lpn_of(2, 0, 300)) && read_block(lpn_of(2, 0, 301)),
+	      "dirty", "write during load");
+
+	/* a hint while the map is loading loads it once more */
+	reads = dev_map_reads;
+	dev_load_hook = hint_during_load;
+	hint(2, 0, -1);
+	run_map_work();
+	check(dev_map_reads == reads + 2 && read_block(lpn_of(2, 0, 300)),
+	      "dirty", "hint during load");
+	check_lu("dirty");
+
+	/* inactive hints drop a region, but not a pinned one */
+	hint(-1, 0, 2);
+	check(!loaded(2, 0) && hpb->stats.rsp_inactive == 1, "dirty",
+	      "inactive hint");
+	hint(-1, 0, DEV_PIN_START);
+	check(loaded(DEV_PIN_START, 0), "dirty", "pinned region dropped");
+
+	/* hints out of range are ignored */
+	hint(DEV_REGIONS, 0, DEV_REGIONS);
+	hint(0, DEV_SUBREGIONS, -1);
+	check(!hpb->map_work.pending, "dirty", "bad hint queued a load");
+	check_lu("dirty hints");
+}
+
+static void test_failures(void)
+{
+	u64 fails;
+	long allocs;
+	int n;
+
+	printf("failures\n");
+	reset_lu();
+
+	/*
+	 * Fail each allocation of a map load in turn: the map context, its
+	 * page array, its dirty bitmap, its two pages, then the request
+	 * and the bio of the HPB READ BUFFER.
+	 */
+	for (n = 1; n <= 7; n++) {
+		allocs = nr_allocs;
+		fails = hpb->stats.map_fail;
+		fail_alloc = n;
+		check(!activate(8, 0), "failures", "loaded without memory");
+		fail_alloc = 0;
+		check(nr_allocs == allocs, "failures", "leak on a failed load");
+		check(hpb->stats.map_fail == fails + 1, "failures",
+		      "map_fail not counted");
+		check_lu("failures");
+	}
+
+	dev_fail_map = 1;
+	allocs = nr_allocs;
+	check(!activate(8, 0) && nr_allocs == allocs, "failures",
+	      "device error");
+	check(activate(8, 0) && read_block(lpn_of(8, 0, 0)), "failures",
+	      "no load after a device error");
+	check_lu("failures");
+}
+
+static void test_random(void)
+{
+	int failed = failures;
+	u64 lpn, hits = 0;
+	unsigned long i;
+	u32 r;
+
+	printf("random: %lu ops\n", nr_ops);
+	reset_lu();
+	srand(seed);
+
+	for (i = 0; i < nr_ops; i++) {
+		r = rand() % 100;
+		/* most I/O goes to the first quarter of the LU */
+		lpn = rand() % 4 ? DEV_LU_BLOCKS / 4 : DEV_LU_BLOCKS;
+		lpn = rand() % lpn;
+
+		if (r < 60)
+			hits += read_block(lpn);
+		else if (r < 72)
+			write_blocks(lpn, 1 + rand() % 16);
+		else if (r < 75)
+			unmap_blocks(lpn, 1 + rand() % 64);
+		else if (r < 80)
+			hint(rand() % (DEV_REGIONS + 1),
+			     rand() % DEV_SUBREGIONS, -1);
+		else if (r < 82)
+			hint(-1, 0, rand() % DEV_REGIONS);
+		else if (r < 83)
+			attr_store_u64("hpb_map_mem_budget",
+				       (1 + rand() % 24) * MAP_BYTES);
+		else if (r < 84)
+			dev_load_hook = rand() % 2 ? write_during_load :
+						     hint_during_load;
+		else if (r < 85)
+			fail_alloc = 1 + rand() % 7;
+		else if (r < 86)
+			dev_fail_map = 1;
+		else if (r < 88)
+			jiffies += HZ;
+		else if (run_map_work())
+			check_lu("random");
+
+		if (failures != failed)
+			break;
+	}
+
+	fail_alloc = 0;
+	dev_fail_map = 0;
+	dev_load_hook = NULL;
+	run_map_work();
+	check_lu("random");
+	check(hits > 0, "random", "no hits");
+	printf("  hits %llu of %llu reads, %llu map loads, %llu evictions\n",
+	       (unsigned long long)hits,
+	       (unsigned long long)(hpb->stats.hit + hpb->stats.miss),
+	       (unsigned long long)hpb->stats.map_req,
+	       (unsigned long long)hpb->stats.evict);
+}
+
+static void test_release(void)
+{
+	struct device_attribute *stats = find_attr("hpb_stats");
+	char buf[PAGE_SIZE];
+	u64 lpn = lpn_of(DEV_PIN_START, 0, 0);
+
+	printf("release\n");
+
+	if (verbose && stats && stats->show(&sdev.sdev_gendev, stats, buf) > 0)
+		printf("%s", buf);
+
+	ufshpb_release(hba, HPB_NOT_SUPPORTED);
+	check(!hba->ufshpb_lup[HPB_LUN] &&
+	      hba->ufshpb_state == HPB_NOT_SUPPORTED, "release", "LU left");
+	check(!hpb_group && !sdev.sdev_gendev.refcount, "release",
+	      "sysfs or device reference left");
+	check(!nr_allocs, "release", "memory left allocated");
+	hpb = NULL;
+
+	check(!read_block(lpn), "release", "HPB READ after release");
+}
+
+int main(int argc, char **argv)
+{
+	u64 lpn;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "vn:s:")) != -1) {
+		switch (opt) {
+		case 'v':
+			verbose = 1;
+			break;
+		case 'n':
+			nr_ops = strtoul(optarg, NULL, 0);
+			break;
+		case 's':
+			seed = strtoul(optarg, NULL, 0);
+			break;
+		default:
+			fprintf(stderr, "Usage: %s [-v] [-n ops] [-s seed]\n",
+				argv[0]);
+			return 1;
+		}
+	}
+
+	for (lpn = 0; lpn < DEV_LU_BLOCKS; lpn++)
+		dev_ppn[lpn] = ++dev_next_ppn;
+
+	shost = calloc(1, sizeof(*shost) + sizeof(*hba));
+	if (!shost)
+		return 1;
+	hba = shost_priv(shost);
+	hba->dev = &host_dev;
+	INIT_DELAYED_WORK(&hba->ufshpb_init_work, ufshpb_init_handler);
+	sdev.host = shost;
+	sdev.request_queue = &queue;
+	sdev.lun = HPB_LUN;
+
+	test_probe();
+	test_activation();
+	test_lru();
+	test_dirty();
+	test_failures();
+	test_random();
+	test_release();
+
+	free(shost);
+
+	printf("%s\n", failures ? "FAILED" : "PASSED");
+	return failures ? 1 : 0;
+}
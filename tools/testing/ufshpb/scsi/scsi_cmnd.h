@@ -0,0 +1,16 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SCSI_CMND_H
+#define _UFSHPB_TEST_SCSI_CMND_H
+
+#include <linux/blkdev.h>
+
+struct scsi_device;
+
+struct scsi_cmnd {
+	struct scsi_device *device;
+	struct request *request;
+	unsigned short cmd_len;
+	unsigned char *cmnd;
+};
+
+#endif /* _UFSHPB_TEST_SCSI_CMND_H */
@@ -0,0 +1,43 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SCSI_DEVICE_H
+#define _UFSHPB_TEST_SCSI_DEVICE_H
+
+#include <linux/blkdev.h>
+#include <linux/device.h>
+#include <scsi/scsi_proto.h>
+
+enum dma_data_direction {
+	DMA_BIDIRECTIONAL	= 0,
+	DMA_TO_DEVICE		= 1,
+	DMA_FROM_DEVICE		= 2,
+	DMA_NONE		= 3,
+};
+
+struct scsi_sense_hdr;
+
+/* hostdata holds the ufs_hba */
+struct Scsi_Host {
+	unsigned long hostdata[0];
+};
+
+struct scsi_device {
+	struct Scsi_Host *host;
+	struct request_queue *request_queue;
+	u64 lun;
+	struct device sdev_gendev;
+};
+
+#define to_scsi_device(d)	container_of(d, struct scsi_device, sdev_gendev)
+
+static inline void *shost_priv(struct Scsi_Host *shost)
+{
+	return (void *)shost->hostdata;
+}
+
+int scsi_execute(struct scsi_device *sdev, const unsigned char *cmd,
+		 int data_direction, void *buffer, unsigned int bufflen,
+		 unsigned char *sense, struct scsi_sense_hdr *sshdr,
+		 int timeout, int retries, u64 flags, unsigned int rq_flags,
+		 int *resid);
+
+#endif /* _UFSHPB_TEST_SCSI_DEVICE_H */
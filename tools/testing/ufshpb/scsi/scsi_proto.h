@@ -0,0 +1,12 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SCSI_PROTO_H
+#define _UFSHPB_TEST_SCSI_PROTO_H
+
+#define READ_10		0x28
+#define WRITE_10	0x2a
+#define READ_BUFFER	0x3c
+#define UNMAP		0x42
+#define READ_16		0x88
+#define WRITE_16	0x8a
+
+#endif /* _UFSHPB_TEST_SCSI_PROTO_H */
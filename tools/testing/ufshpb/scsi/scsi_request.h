@@ -0,0 +1,19 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_SCSI_REQUEST_H
+#define _UFSHPB_TEST_SCSI_REQUEST_H
+
+#include <linux/blkdev.h>
+
+struct scsi_request {
+	unsigned char cmd[16];
+	unsigned short cmd_len;
+	int result;
+	int retries;
+};
+
+static inline struct scsi_request *scsi_req(struct request *rq)
+{
+	return (struct scsi_request *)(rq + 1);
+}
+
+#endif /* _UFSHPB_TEST_SCSI_REQUEST_H */
@@ -0,0 +1,44 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _UFSHPB_TEST_UFSHCD_H
+#define _UFSHPB_TEST_UFSHCD_H
+
+/* the parts of the host driver ufshpb.c uses */
+
+#include <linux/blkdev.h>
+#include <linux/device.h>
+#include <linux/workqueue.h>
+#include <scsi/scsi_cmnd.h>
+#include <scsi/scsi_device.h>
+
+#include "../../../drivers/scsi/ufs/ufs.h"
+#include "ufshpb.h"
+
+struct ufshcd_lrb {
+	struct utp_upiu_req *ucd_req_ptr;
+	struct utp_upiu_rsp *ucd_rsp_ptr;
+	struct scsi_cmnd *cmd;
+	u8 lun;
+	u64 issue_time_stamp;
+	bool hpb_read;
+	u8 hpb_orig_cdb[10];
+};
+
+struct ufs_hba {
+	struct device *dev;
+	struct ufshpb_lu *ufshpb_lup[UFS_UPIU_MAX_GENERAL_LUN];
+	struct delayed_work ufshpb_init_work;
+	int ufshpb_state;
+	int ufshpb_init_retry;
+	struct scsi_device *sdev_ufs_lu[UFS_UPIU_MAX_GENERAL_LUN];
+};
+
+static inline u8 ufshcd_scsi_to_upiu_lun(unsigned int scsi_lun)
+{
+	return scsi_lun & UFS_UPIU_MAX_UNIT_NUM_ID;
+}
+
+int ufshcd_query_descriptor_retry(struct ufs_hba *hba,
+	enum query_opcode opcode, enum desc_idn idn, u8 index,
+	u8 selector, u8 *desc_buf, int *buf_len);
+
+#endif /* _UFSHPB_TEST_UFSHCD_H */